@@ -59,6 +59,18 @@ if(CMAKE_SYSTEM_NAME STREQUAL "Linux")
 		}"
 		HAVE_LINUX_IF_BONDING_H
 	)
+	#
+	# dumpcap can read packets straight from a TPACKET_V3 ring.
+	#
+	check_c_source_compiles(
+		"#include <sys/socket.h>
+		#include <linux/if_packet.h>
+		int main(void)
+		{
+			return TPACKET_V3;
+		}"
+		HAVE_TPACKET3
+	)
 endif()
 
 #Functions
@@ -116,6 +128,8 @@ else()
 	#
 	check_include_file("alloca.h"    HAVE_ALLOCA_H)
 endif()
+check_function_exists("fopencookie"      HAVE_FOPENCOOKIE)
+check_function_exists("funopen"          HAVE_FUNOPEN)
 check_function_exists("getifaddrs"       HAVE_GETIFADDRS)
 check_function_exists("issetugid"        HAVE_ISSETUGID)
 check_function_exists("mkstemps"         HAVE_MKSTEMPS)
@@ -250,6 +250,11 @@ sync_pipe_start(capture_options *capture_opts, capture_session *cap_session, inf
         argv = sync_pipe_add_arg(argv, &argc, capture_opts->capture_comment);
     }
 
+    if (capture_opts->compress_type) {
+        argv = sync_pipe_add_arg(argv, &argc, "--compress");
+        argv = sync_pipe_add_arg(argv, &argc, capture_opts->compress_type);
+    }
+
     if (capture_opts->multi_files_on) {
         if (capture_opts->has_autostop_filesize) {
             char sfilesize[ARGV_NUMBER_LEN];
@@ -58,6 +58,7 @@
 #include <glib.h>
 
 #include <wiretap/wtap.h>
+#include <wiretap/wtap_chunk.h>
 
 #include <wsutil/cmdarg_err.h>
 #include <wsutil/crash_info.h>
@@ -1054,150 +1055,366 @@ cleanup_capture_info(capture_info *cf_info)
   cf_info->idb_info_strings = NULL;
 }
 
-static int
-process_cap_file(wtap *wth, const char *filename)
-{
-  int                   status = 0;
-  int                   err;
-  gchar                *err_info;
-  gint64                size;
-  gint64                data_offset;
-
-  guint32               packet = 0;
-  gint64                bytes  = 0;
-  guint32               snaplen_min_inferred = 0xffffffff;
-  guint32               snaplen_max_inferred =          0;
-  wtap_rec             *rec;
-  capture_info          cf_info;
-  gboolean              have_times = TRUE;
+/*
+ * What's tallied up from the records of a file, or, when the file is
+ * read in chunks, from the records of one chunk.
+ */
+typedef struct _record_tally {
+  guint32               packet;
+  gint64                bytes;
+  guint32               snaplen_min_inferred;
+  guint32               snaplen_max_inferred;
+  gboolean              have_times;
+  gboolean              seen_time;                /* a record had a time stamp */
+  nstime_t              first_time;               /* the first such time stamp */
   nstime_t              start_time;
   int                   start_time_tsprec;
   nstime_t              stop_time;
   int                   stop_time_tsprec;
   nstime_t              cur_time;
   nstime_t              prev_time;
-  gboolean              know_order = FALSE;
-  order_t               order = IN_ORDER;
-  guint                 i;
-  wtapng_iface_descriptions_t *idb_info;
-
-  g_assert(wth != NULL);
-  g_assert(filename != NULL);
+  order_t               order;
+  int                  *encap_counts;
+  guint                 num_interfaces;
+  GArray               *interface_packet_counts;
+  guint32               pkt_interface_id_unknown;
+  guint32               unknown_encaps;           /* packets with an unknown encapsulation */
+} record_tally;
 
-  nstime_set_zero(&start_time);
-  start_time_tsprec = WTAP_TSPREC_UNKNOWN;
-  nstime_set_zero(&stop_time);
-  stop_time_tsprec = WTAP_TSPREC_UNKNOWN;
-  nstime_set_zero(&cur_time);
-  nstime_set_zero(&prev_time);
+static void
+init_record_tally(record_tally *tally, wtap *wth)
+{
+  wtapng_iface_descriptions_t *idb_info;
 
-  cf_info.shb = wtap_file_get_shb(wth);
+  memset(tally, 0, sizeof *tally);
+  tally->snaplen_min_inferred = 0xffffffff;
+  tally->have_times = TRUE;
+  tally->start_time_tsprec = WTAP_TSPREC_UNKNOWN;
+  tally->stop_time_tsprec = WTAP_TSPREC_UNKNOWN;
+  tally->order = IN_ORDER;
 
-  cf_info.encap_counts = g_new0(int,WTAP_NUM_ENCAP_TYPES);
+  tally->encap_counts = g_new0(int,WTAP_NUM_ENCAP_TYPES);
 
   idb_info = wtap_file_get_idb_info(wth);
 
   g_assert(idb_info->interface_data != NULL);
 
-  cf_info.num_interfaces = idb_info->interface_data->len;
-  cf_info.interface_packet_counts  = g_array_sized_new(FALSE, TRUE, sizeof(guint32), cf_info.num_interfaces);
-  g_array_set_size(cf_info.interface_packet_counts, cf_info.num_interfaces);
-  cf_info.pkt_interface_id_unknown = 0;
+  tally->num_interfaces = idb_info->interface_data->len;
+  tally->interface_packet_counts  = g_array_sized_new(FALSE, TRUE, sizeof(guint32), tally->num_interfaces);
+  g_array_set_size(tally->interface_packet_counts, tally->num_interfaces);
 
   g_free(idb_info);
-  idb_info = NULL;
+}
 
-  /* Tally up data that we need to parse through the file to find */
-  while (wtap_read(wth, &err, &err_info, &data_offset))  {
-    rec = wtap_get_rec(wth);
-    if (rec->presence_flags & WTAP_HAS_TS) {
-      prev_time = cur_time;
-      cur_time = rec->ts;
-      if (packet == 0) {
-        start_time = rec->ts;
-        start_time_tsprec = rec->tsprec;
-        stop_time  = rec->ts;
-        stop_time_tsprec = rec->tsprec;
-        prev_time  = rec->ts;
-      }
-      if (nstime_cmp(&cur_time, &prev_time) < 0) {
-        order = NOT_IN_ORDER;
+static void
+free_record_tally(record_tally *tally)
+{
+  g_free(tally->encap_counts);
+  tally->encap_counts = NULL;
+  if (tally->interface_packet_counts)
+    g_array_free(tally->interface_packet_counts, TRUE);
+  tally->interface_packet_counts = NULL;
+}
+
+/*
+ * Tally up the record that has just been read.  Unknown encapsulations
+ * are reported only if filename is not NULL.
+ */
+static void
+tally_record(record_tally *tally, wtap *wth, const char *filename)
+{
+  wtap_rec             *rec;
+  wtapng_iface_descriptions_t *idb_info;
+
+  rec = wtap_get_rec(wth);
+  if (rec->presence_flags & WTAP_HAS_TS) {
+    tally->prev_time = tally->cur_time;
+    tally->cur_time = rec->ts;
+    if (!tally->seen_time) {
+      tally->seen_time = TRUE;
+      tally->first_time = rec->ts;
+    }
+    if (tally->packet == 0) {
+      tally->start_time = rec->ts;
+      tally->start_time_tsprec = rec->tsprec;
+      tally->stop_time  = rec->ts;
+      tally->stop_time_tsprec = rec->tsprec;
+      tally->prev_time  = rec->ts;
+    }
+    if (nstime_cmp(&tally->cur_time, &tally->prev_time) < 0) {
+      tally->order = NOT_IN_ORDER;
+    }
+    if (nstime_cmp(&tally->cur_time, &tally->start_time) < 0) {
+      tally->start_time = tally->cur_time;
+      tally->start_time_tsprec = rec->tsprec;
+    }
+    if (nstime_cmp(&tally->cur_time, &tally->stop_time) > 0) {
+      tally->stop_time = tally->cur_time;
+      tally->stop_time_tsprec = rec->tsprec;
+    }
+  } else {
+    tally->have_times = FALSE; /* at least one packet has no time stamp */
+    if (tally->order != NOT_IN_ORDER)
+      tally->order = ORDER_UNKNOWN;
+  }
+
+  if (rec->rec_type == REC_TYPE_PACKET) {
+    tally->bytes += rec->rec_header.packet_header.len;
+    tally->packet++;
+
+    /* If caplen < len for a rcd, then presumably           */
+    /* 'Limit packet capture length' was done for this rcd. */
+    /* Keep track as to the min/max actual snapshot lengths */
+    /*  seen for this file.                                 */
+    if (rec->rec_header.packet_header.caplen < rec->rec_header.packet_header.len) {
+      if (rec->rec_header.packet_header.caplen < tally->snaplen_min_inferred)
+        tally->snaplen_min_inferred = rec->rec_header.packet_header.caplen;
+      if (rec->rec_header.packet_header.caplen > tally->snaplen_max_inferred)
+        tally->snaplen_max_inferred = rec->rec_header.packet_header.caplen;
+    }
+
+    if ((rec->rec_header.packet_header.pkt_encap > 0) &&
+        (rec->rec_header.packet_header.pkt_encap < WTAP_NUM_ENCAP_TYPES)) {
+      tally->encap_counts[rec->rec_header.packet_header.pkt_encap] += 1;
+    } else {
+      tally->unknown_encaps++;
+      if (filename != NULL)
+        fprintf(stderr, "capinfos: Unknown packet encapsulation %d in frame %u of file \"%s\"\n",
+                rec->rec_header.packet_header.pkt_encap, tally->packet, filename);
+    }
+
+    /* Packet interface_id info */
+    if (rec->presence_flags & WTAP_HAS_INTERFACE_ID) {
+      /* tally->num_interfaces is size, not index, so it's one more than max index */
+      if (rec->rec_header.packet_header.interface_id >= tally->num_interfaces) {
+        /*
+         * OK, re-fetch the number of interfaces, as there might have
+         * been an interface that was in the middle of packets, and
+         * grow the array to be big enough for the new number of
+         * interfaces.
+         */
+        idb_info = wtap_file_get_idb_info(wth);
+
+        tally->num_interfaces = idb_info->interface_data->len;
+        g_array_set_size(tally->interface_packet_counts, tally->num_interfaces);
+
+        g_free(idb_info);
+        idb_info = NULL;
       }
-      if (nstime_cmp(&cur_time, &start_time) < 0) {
-        start_time = cur_time;
-        start_time_tsprec = rec->tsprec;
+      if (rec->rec_header.packet_header.interface_id < tally->num_interfaces) {
+        g_array_index(tally->interface_packet_counts, guint32,
+                      rec->rec_header.packet_header.interface_id) += 1;
       }
-      if (nstime_cmp(&cur_time, &stop_time) > 0) {
-        stop_time = cur_time;
-        stop_time_tsprec = rec->tsprec;
+      else {
+        tally->pkt_interface_id_unknown += 1;
       }
-    } else {
-      have_times = FALSE; /* at least one packet has no time stamp */
-      if (order != NOT_IN_ORDER)
-        order = ORDER_UNKNOWN;
     }
-
-    if (rec->rec_type == REC_TYPE_PACKET) {
-      bytes += rec->rec_header.packet_header.len;
-      packet++;
-
-      /* If caplen < len for a rcd, then presumably           */
-      /* 'Limit packet capture length' was done for this rcd. */
-      /* Keep track as to the min/max actual snapshot lengths */
-      /*  seen for this file.                                 */
-      if (rec->rec_header.packet_header.caplen < rec->rec_header.packet_header.len) {
-        if (rec->rec_header.packet_header.caplen < snaplen_min_inferred)
-          snaplen_min_inferred = rec->rec_header.packet_header.caplen;
-        if (rec->rec_header.packet_header.caplen > snaplen_max_inferred)
-          snaplen_max_inferred = rec->rec_header.packet_header.caplen;
+    else {
+      /* it's for interface_id 0 */
+      if (tally->num_interfaces != 0) {
+        g_array_index(tally->interface_packet_counts, guint32, 0) += 1;
       }
-
-      if ((rec->rec_header.packet_header.pkt_encap > 0) &&
-          (rec->rec_header.packet_header.pkt_encap < WTAP_NUM_ENCAP_TYPES)) {
-        cf_info.encap_counts[rec->rec_header.packet_header.pkt_encap] += 1;
-      } else {
-        fprintf(stderr, "capinfos: Unknown packet encapsulation %d in frame %u of file \"%s\"\n",
-                rec->rec_header.packet_header.pkt_encap, packet, filename);
+      else {
+        tally->pkt_interface_id_unknown += 1;
       }
+    }
+  }
+}
 
-      /* Packet interface_id info */
-      if (rec->presence_flags & WTAP_HAS_INTERFACE_ID) {
-        /* cf_info.num_interfaces is size, not index, so it's one more than max index */
-        if (rec->rec_header.packet_header.interface_id >= cf_info.num_interfaces) {
-          /*
-           * OK, re-fetch the number of interfaces, as there might have
-           * been an interface that was in the middle of packets, and
-           * grow the array to be big enough for the new number of
-           * interfaces.
-           */
-          idb_info = wtap_file_get_idb_info(wth);
-
-          cf_info.num_interfaces = idb_info->interface_data->len;
-          g_array_set_size(cf_info.interface_packet_counts, cf_info.num_interfaces);
-
-          g_free(idb_info);
-          idb_info = NULL;
-        }
-        if (rec->rec_header.packet_header.interface_id < cf_info.num_interfaces) {
-          g_array_index(cf_info.interface_packet_counts, guint32,
-                        rec->rec_header.packet_header.interface_id) += 1;
-        }
-        else {
-          cf_info.pkt_interface_id_unknown += 1;
-        }
+/*
+ * Add the tally for a chunk of a file to the tally for the chunks
+ * before it, as if its records had been tallied up after theirs.
+ */
+static void
+merge_record_tally(record_tally *tally, const record_tally *part)
+{
+  int encap;
+  guint i;
+
+  if (part->seen_time) {
+    if (tally->seen_time) {
+      if (nstime_cmp(&part->first_time, &tally->cur_time) < 0)
+        tally->order = NOT_IN_ORDER;
+      if (nstime_cmp(&part->start_time, &tally->start_time) < 0) {
+        tally->start_time = part->start_time;
+        tally->start_time_tsprec = part->start_time_tsprec;
       }
-      else {
-        /* it's for interface_id 0 */
-        if (cf_info.num_interfaces != 0) {
-          g_array_index(cf_info.interface_packet_counts, guint32, 0) += 1;
-        }
-        else {
-          cf_info.pkt_interface_id_unknown += 1;
-        }
+      if (nstime_cmp(&part->stop_time, &tally->stop_time) > 0) {
+        tally->stop_time = part->stop_time;
+        tally->stop_time_tsprec = part->stop_time_tsprec;
       }
+    } else {
+      tally->seen_time = TRUE;
+      tally->first_time = part->first_time;
+      tally->start_time = part->start_time;
+      tally->start_time_tsprec = part->start_time_tsprec;
+      tally->stop_time = part->stop_time;
+      tally->stop_time_tsprec = part->stop_time_tsprec;
     }
+    tally->prev_time = part->prev_time;
+    tally->cur_time = part->cur_time;
+  }
+  if (!part->have_times)
+    tally->have_times = FALSE;
+  if (part->order == NOT_IN_ORDER)
+    tally->order = NOT_IN_ORDER;
+  else if (part->order == ORDER_UNKNOWN && tally->order != NOT_IN_ORDER)
+    tally->order = ORDER_UNKNOWN;
+
+  tally->packet += part->packet;
+  tally->bytes += part->bytes;
+  if (part->snaplen_min_inferred < tally->snaplen_min_inferred)
+    tally->snaplen_min_inferred = part->snaplen_min_inferred;
+  if (part->snaplen_max_inferred > tally->snaplen_max_inferred)
+    tally->snaplen_max_inferred = part->snaplen_max_inferred;
+  for (encap = 0; encap < WTAP_NUM_ENCAP_TYPES; encap++)
+    tally->encap_counts[encap] += part->encap_counts[encap];
+  for (i = 0; i < tally->num_interfaces && i < part->num_interfaces; i++)
+    g_array_index(tally->interface_packet_counts, guint32, i) +=
+      g_array_index(part->interface_packet_counts, guint32, i);
+  tally->pkt_interface_id_unknown += part->pkt_interface_id_unknown;
+  tally->unknown_encaps += part->unknown_encaps;
+}
+
+typedef struct {
+  wtap_chunk_t         *chunk;
+  record_tally          tally;
+  int                   err;
+  gchar                *err_info;
+} chunk_reader;
+
+static gpointer
+read_chunk(gpointer data)
+{
+  chunk_reader         *reader = (chunk_reader *)data;
+  gint64                data_offset;
+
+  while (wtap_chunk_read(reader->chunk, &reader->err, &reader->err_info, &data_offset))
+    tally_record(&reader->tally, wtap_chunk_wtap(reader->chunk), NULL);
+  return NULL;
+}
+
+/*
+ * Tally up the records of a big file by reading chunks of it on
+ * threads of their own.  Returns FALSE, having tallied nothing, if the
+ * file can't be read that way, or if anything out of the ordinary
+ * turns up, such as an error or interfaces being described after the
+ * first packet; the file then has to be read through, so that that's
+ * dealt with as it always is.
+ */
+static gboolean
+tally_chunks(wtap *wth, const char *filename, record_tally *tally)
+{
+  GArray               *bounds;
+  GPtrArray            *chunks;
+  chunk_reader         *readers;
+  GThread             **threads;
+  guint                 n_chunks;
+  guint                 max_chunks = 1;
+  guint                 i;
+  gboolean              ok = TRUE;
+  int                   err;
+  gchar                *err_info;
+  wtapng_iface_descriptions_t *idb_info;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+  max_chunks = g_get_num_processors();
+#endif
+  bounds = wtap_chunk_split(wth, max_chunks);
+  if (bounds == NULL)
+    return FALSE;
+  n_chunks = bounds->len - 1;
+
+  chunks = g_ptr_array_new_with_free_func((GDestroyNotify)wtap_chunk_close);
+  readers = g_new0(chunk_reader, n_chunks);
+  for (i = 0; i < n_chunks; i++) {
+    readers[i].chunk = wtap_chunk_open(filename,
+                                       g_array_index(bounds, gint64, i),
+                                       g_array_index(bounds, gint64, i + 1),
+                                       &err, &err_info);
+    if (readers[i].chunk == NULL) {
+      g_free(err_info);
+      ok = FALSE;
+      break;
+    }
+    g_ptr_array_add(chunks, readers[i].chunk);
+    init_record_tally(&readers[i].tally, wtap_chunk_wtap(readers[i].chunk));
+  }
+
+  if (ok) {
+    threads = g_new(GThread *, n_chunks);
+    for (i = 0; i < n_chunks; i++)
+      threads[i] = g_thread_new("capinfos chunk reader", read_chunk, &readers[i]);
+    for (i = 0; i < n_chunks; i++)
+      g_thread_join(threads[i]);
+    g_free(threads);
+
+    for (i = 0; i < n_chunks; i++) {
+      if (readers[i].err != 0 || readers[i].tally.unknown_encaps != 0)
+        ok = FALSE;
+    }
+    if (ok)
+      ok = wtap_chunks_consistent(chunks);
+    if (ok) {
+      /*
+       * The last chunk may describe interfaces that the file's
+       * beginning didn't; we'd have neither their packet counts nor
+       * their descriptions, so read the file through instead.
+       */
+      idb_info = wtap_file_get_idb_info(wtap_chunk_wtap(readers[n_chunks - 1].chunk));
+      if (idb_info->interface_data->len != tally->num_interfaces)
+        ok = FALSE;
+      g_free(idb_info);
+    }
+    if (ok) {
+      for (i = 0; i < n_chunks; i++)
+        merge_record_tally(tally, &readers[i].tally);
+    }
+  }
+
+  for (i = 0; i < chunks->len; i++) {
+    free_record_tally(&readers[i].tally);
+    g_free(readers[i].err_info);
+  }
+  g_free(readers);
+  g_ptr_array_free(chunks, TRUE);
+  g_array_free(bounds, TRUE);
+  return ok;
+}
+
+static int
+process_cap_file(wtap *wth, const char *filename)
+{
+  int                   status = 0;
+  int                   err = 0;
+  gchar                *err_info = NULL;
+  gint64                size;
+  gint64                data_offset;
+
+  record_tally          tally;
+  capture_info          cf_info;
+  gboolean              know_order = FALSE;
+  guint                 i;
+  wtapng_iface_descriptions_t *idb_info;
+
+  g_assert(wth != NULL);
+  g_assert(filename != NULL);
+
+  cf_info.shb = wtap_file_get_shb(wth);
+
+  init_record_tally(&tally, wth);
+
+  /* Tally up data that we need to parse through the file to find */
+  if (!tally_chunks(wth, filename, &tally)) {
+    while (wtap_read(wth, &err, &err_info, &data_offset))  {
+      tally_record(&tally, wth, filename);
+    } /* while */
+  }
 
-  } /* while */
+  cf_info.encap_counts = tally.encap_counts;
+  cf_info.num_interfaces = tally.num_interfaces;
+  cf_info.interface_packet_counts = tally.interface_packet_counts;
+  cf_info.pkt_interface_id_unknown = tally.pkt_interface_id_unknown;
 
   /*
    * Get IDB info strings.
@@ -1220,7 +1437,7 @@ process_cap_file(wtap *wth, const char *filename)
   if (err != 0) {
     fprintf(stderr,
         "capinfos: An error occurred after reading %u packets from \"%s\".\n",
-        packet, filename);
+        tally.packet, filename);
     cfile_read_failure_message("capinfos", filename, err, err_info);
     if (err == WTAP_ERR_SHORT_READ) {
         /* Don't give up completely with this one. */
@@ -1261,41 +1478,41 @@ process_cap_file(wtap *wth, const char *filename)
   else
     cf_info.snap_set = FALSE;
 
-  cf_info.snaplen_min_inferred = snaplen_min_inferred;
-  cf_info.snaplen_max_inferred = snaplen_max_inferred;
+  cf_info.snaplen_min_inferred = tally.snaplen_min_inferred;
+  cf_info.snaplen_max_inferred = tally.snaplen_max_inferred;
 
   /* # of packets */
-  cf_info.packet_count = packet;
+  cf_info.packet_count = tally.packet;
 
   /* File Times */
-  cf_info.times_known = have_times;
-  cf_info.start_time = start_time;
-  cf_info.start_time_tsprec = start_time_tsprec;
-  cf_info.stop_time = stop_time;
-  cf_info.stop_time_tsprec = stop_time_tsprec;
-  nstime_delta(&cf_info.duration, &stop_time, &start_time);
+  cf_info.times_known = tally.have_times;
+  cf_info.start_time = tally.start_time;
+  cf_info.start_time_tsprec = tally.start_time_tsprec;
+  cf_info.stop_time = tally.stop_time;
+  cf_info.stop_time_tsprec = tally.stop_time_tsprec;
+  nstime_delta(&cf_info.duration, &tally.stop_time, &tally.start_time);
   /* Duration precision is the higher of the start and stop time precisions. */
   if (cf_info.stop_time_tsprec > cf_info.start_time_tsprec)
     cf_info.duration_tsprec = cf_info.stop_time_tsprec;
   else
     cf_info.duration_tsprec = cf_info.start_time_tsprec;
   cf_info.know_order = know_order;
-  cf_info.order = order;
+  cf_info.order = tally.order;
 
   /* Number of packet bytes */
-  cf_info.packet_bytes = bytes;
+  cf_info.packet_bytes = tally.bytes;
 
   cf_info.data_rate   = 0.0;
   cf_info.packet_rate = 0.0;
   cf_info.packet_size = 0.0;
 
-  if (packet > 0) {
-    double delta_time = nstime_to_sec(&stop_time) - nstime_to_sec(&start_time);
+  if (tally.packet > 0) {
+    double delta_time = nstime_to_sec(&tally.stop_time) - nstime_to_sec(&tally.start_time);
     if (delta_time > 0.0) {
-      cf_info.data_rate   = (double)bytes  / delta_time; /* Data rate per second */
-      cf_info.packet_rate = (double)packet / delta_time; /* packet rate per second */
+      cf_info.data_rate   = (double)tally.bytes  / delta_time; /* Data rate per second */
+      cf_info.packet_rate = (double)tally.packet / delta_time; /* packet rate per second */
     }
-    cf_info.packet_size = (double)bytes / packet;                  /* Avg packet size      */
+    cf_info.packet_size = (double)tally.bytes / tally.packet;      /* Avg packet size      */
   }
 
   if (long_report) {
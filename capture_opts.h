@@ -316,6 +316,8 @@ typedef struct capture_options_tag {
 
     gchar             *capture_comment;       /** capture comment to write to the
                                                   output file */
+    gchar             *compress_type;         /**< compression to write the output
+                                                   file(s) with, or NULL */
 
     /* internally used (don't touch from outside) */
     gboolean           output_to_pipe;        /**< save_file is a pipe (named or stdout) */
@@ -0,0 +1,403 @@
+/* capture-tpacket.c
+ * Routines for capturing from a Linux TPACKET_V3 ring
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#if defined(HAVE_LIBPCAP) && defined(HAVE_TPACKET3)
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <netinet/in.h>
+
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#include <glib.h>
+
+#include "caputils/capture-tpacket.h"
+
+struct _tpacket_ring {
+    int                  fd;
+    int                  ifindex;
+    int                  linktype;
+    int                  snaplen;
+    tpacket_fanout_mode  fanout_mode;
+    guint16              fanout_group;
+    guint8              *map;
+    size_t               map_size;
+    guint                block_size;
+    guint                block_count;
+    guint                current;       /* the block we're reading, or will read next */
+    gboolean             in_block;      /* we're reading the current block */
+    guint32              remaining;     /* packets of the current block not yet read */
+    struct tpacket3_hdr *next;          /* the next of them */
+    guint64              received;      /* totals from PACKET_STATISTICS, which */
+    guint64              dropped;       /* resets the kernel's counts */
+};
+
+static struct tpacket_block_desc *
+current_block(tpacket_ring *ring)
+{
+    return (struct tpacket_block_desc *)(void *)
+        (ring->map + (size_t)ring->current * ring->block_size);
+}
+
+static guint32
+block_status(struct tpacket_block_desc *block)
+{
+    /* The kernel sets it after it's filled in the block. */
+    return (guint32)g_atomic_int_get((gint *)&block->hdr.bh1.block_status);
+}
+
+tpacket_ring *
+tpacket_ring_open(const char *iface, const tpacket_ring_params *params,
+                  int snaplen, gboolean promisc, char *errmsg,
+                  size_t errmsg_len)
+{
+    tpacket_ring *ring;
+    struct ifreq ifr;
+    struct tpacket_req3 req;
+    struct packet_mreq mr;
+    int version = TPACKET_V3;
+    guint page_size, block_size, frame_size;
+
+    ring = g_new0(tpacket_ring, 1);
+    ring->snaplen = snaplen;
+    ring->fanout_mode = params->fanout_mode;
+    ring->fanout_group = params->fanout_group;
+
+    /*
+     * Don't bind it to a protocol yet, so nothing's captured until the
+     * filter is in place.
+     */
+    ring->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (ring->fd == -1) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Can't open a packet socket: %s", g_strerror(errno));
+        g_free(ring);
+        return NULL;
+    }
+
+    ring->ifindex = if_nametoindex(iface);
+    if (ring->ifindex == 0) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "%s isn't a network interface", iface);
+        goto fail;
+    }
+
+    memset(&ifr, 0, sizeof ifr);
+    g_strlcpy(ifr.ifr_name, iface, sizeof ifr.ifr_name);
+    if (ioctl(ring->fd, SIOCGIFHWADDR, &ifr) == -1) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Can't get the hardware type of %s: %s", iface,
+                   g_strerror(errno));
+        goto fail;
+    }
+    switch (ifr.ifr_hwaddr.sa_family) {
+
+    case ARPHRD_ETHER:
+    case ARPHRD_LOOPBACK:
+        ring->linktype = DLT_EN10MB;
+        break;
+
+    default:
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "%s has hardware type %u, not Ethernet", iface,
+                   ifr.ifr_hwaddr.sa_family);
+        goto fail;
+    }
+
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &version,
+                   sizeof version) == -1) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Can't use TPACKET_V3 on %s: %s", iface, g_strerror(errno));
+        goto fail;
+    }
+
+    /*
+     * The kernel truncates packets that don't fit in a block, so make
+     * sure the blocks are big enough for the snapshot length.  Frames
+     * mean nothing to TPACKET_V3, but the kernel still checks that the
+     * blocks hold a whole number of them.
+     */
+    page_size = (guint)sysconf(_SC_PAGESIZE);
+    block_size = MAX(params->block_size,
+                     (guint)snaplen + TPACKET_ALIGN(TPACKET3_HDRLEN) + page_size);
+    block_size = (block_size + page_size - 1) / page_size * page_size;
+    frame_size = TPACKET_ALIGN(TPACKET3_HDRLEN + ETH_HLEN);
+
+    memset(&req, 0, sizeof req);
+    req.tp_block_size = block_size;
+    req.tp_block_nr = params->block_count;
+    req.tp_frame_size = frame_size;
+    req.tp_frame_nr = block_size / frame_size * params->block_count;
+    req.tp_retire_blk_tov = params->timeout;
+    if (setsockopt(ring->fd, SOL_PACKET, PACKET_RX_RING, &req,
+                   sizeof req) == -1) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Can't set up a ring of %u blocks of %u bytes on %s: %s",
+                   params->block_count, block_size, iface, g_strerror(errno));
+        goto fail;
+    }
+    ring->block_size = block_size;
+    ring->block_count = params->block_count;
+
+    ring->map_size = (size_t)block_size * params->block_count;
+    ring->map = (guint8 *)mmap(NULL, ring->map_size, PROT_READ|PROT_WRITE,
+                               MAP_SHARED, ring->fd, 0);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Can't map the ring for %s: %s", iface, g_strerror(errno));
+        goto fail;
+    }
+
+    if (promisc) {
+        memset(&mr, 0, sizeof mr);
+        mr.mr_ifindex = ring->ifindex;
+        mr.mr_type = PACKET_MR_PROMISC;
+        if (setsockopt(ring->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr,
+                       sizeof mr) == -1) {
+            g_snprintf(errmsg, (gulong) errmsg_len,
+                       "Can't put %s into promiscuous mode: %s", iface,
+                       g_strerror(errno));
+            goto fail;
+        }
+    }
+    return ring;
+
+fail:
+    tpacket_ring_close(ring);
+    return NULL;
+}
+
+int
+tpacket_ring_linktype(tpacket_ring *ring)
+{
+    return ring->linktype;
+}
+
+int
+tpacket_ring_fd(tpacket_ring *ring)
+{
+    return ring->fd;
+}
+
+static gboolean
+attach_filter(tpacket_ring *ring, struct sock_fprog *prog)
+{
+    return setsockopt(ring->fd, SOL_SOCKET, SO_ATTACH_FILTER, prog,
+                      sizeof *prog) == 0;
+}
+
+/*
+ * A socket can only join a fanout group once it's bound, and until it
+ * has joined it gets every packet, which the other rings of the group
+ * get as well; so it drops everything until then.
+ */
+static gboolean
+join_fanout(tpacket_ring *ring, struct sockaddr_ll *sll)
+{
+    struct sock_filter drop;
+    struct sock_fprog prog;
+    int fanout;
+
+    drop.code = BPF_RET|BPF_K;
+    drop.jt = 0;
+    drop.jf = 0;
+    drop.k = 0;
+    prog.len = 1;
+    prog.filter = &drop;
+    if (!attach_filter(ring, &prog) ||
+        bind(ring->fd, (struct sockaddr *)sll, sizeof *sll) == -1)
+        return FALSE;
+
+    switch (ring->fanout_mode) {
+
+    case TPACKET_FANOUT_HASH:
+        /* Reassemble IP fragments first, so they hash with their flow */
+        fanout = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+        break;
+
+    case TPACKET_FANOUT_CPU:
+        fanout = PACKET_FANOUT_CPU;
+        break;
+
+    case TPACKET_FANOUT_LB:
+        fanout = PACKET_FANOUT_LB;
+        break;
+
+    default:
+        return TRUE;
+    }
+    fanout = ring->fanout_group | (fanout << 16);
+    return setsockopt(ring->fd, SOL_PACKET, PACKET_FANOUT, &fanout,
+                      sizeof fanout) == 0;
+}
+
+gboolean
+tpacket_ring_set_filter(tpacket_ring *ring, struct bpf_program *fcode)
+{
+    struct sock_filter truncate;
+    struct sock_fprog prog;
+    struct sockaddr_ll sll;
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ring->ifindex;
+    if (ring->fanout_mode != TPACKET_FANOUT_NONE && !join_fanout(ring, &sll))
+        return FALSE;
+
+    if (fcode != NULL) {
+        /* The kernel's filters are libpcap's instructions. */
+        prog.len = (unsigned short)fcode->bf_len;
+        prog.filter = (struct sock_filter *)(void *)fcode->bf_insns;
+    } else {
+        /* Accept the packet, up to the snapshot length */
+        truncate.code = BPF_RET|BPF_K;
+        truncate.jt = 0;
+        truncate.jf = 0;
+        truncate.k = (guint32)ring->snaplen;
+        prog.len = 1;
+        prog.filter = &truncate;
+    }
+    if (!attach_filter(ring, &prog))
+        return FALSE;
+
+    if (ring->fanout_mode != TPACKET_FANOUT_NONE)
+        return TRUE;
+    return bind(ring->fd, (struct sockaddr *)&sll, sizeof sll) == 0;
+}
+
+gboolean
+tpacket_ring_next_block(tpacket_ring *ring)
+{
+    struct tpacket_block_desc *block;
+
+    if (ring->in_block)
+        return TRUE;
+    block = current_block(ring);
+    if (!(block_status(block) & TP_STATUS_USER))
+        return FALSE;
+    ring->in_block = TRUE;
+    ring->remaining = block->hdr.bh1.num_pkts;
+    ring->next = (struct tpacket3_hdr *)(void *)
+        ((guint8 *)block + block->hdr.bh1.offset_to_first_pkt);
+    return TRUE;
+}
+
+gboolean
+tpacket_ring_next_packet(tpacket_ring *ring, tpacket_packet *packet)
+{
+    struct tpacket3_hdr *hdr;
+    guint16 tpid;
+
+    if (!ring->in_block || ring->remaining == 0)
+        return FALSE;
+
+    hdr = ring->next;
+    packet->ts_sec = hdr->tp_sec;
+    packet->ts_nsec = hdr->tp_nsec;
+    packet->caplen = hdr->tp_snaplen;
+    packet->len = hdr->tp_len;
+    packet->data = (const guint8 *)hdr + hdr->tp_mac;
+
+    /*
+     * The kernel takes the VLAN tag out of the packets of devices that
+     * strip it in hardware; put it back, as libpcap does.
+     */
+    packet->has_vlan = (hdr->tp_status & TP_STATUS_VLAN_VALID) &&
+                       packet->caplen >= 2 * ETH_ALEN;
+    if (packet->has_vlan) {
+        tpid = ETH_P_8021Q;
+#ifdef TP_STATUS_VLAN_TPID_VALID
+        if (hdr->tp_status & TP_STATUS_VLAN_TPID_VALID)
+            tpid = hdr->hv1.tp_vlan_tpid;
+#endif
+        packet->vlan_tag[0] = tpid >> 8;
+        packet->vlan_tag[1] = tpid & 0xff;
+        packet->vlan_tag[2] = hdr->hv1.tp_vlan_tci >> 8;
+        packet->vlan_tag[3] = hdr->hv1.tp_vlan_tci & 0xff;
+    }
+
+    ring->next = (struct tpacket3_hdr *)(void *)
+        ((guint8 *)hdr + hdr->tp_next_offset);
+    ring->remaining--;
+    return TRUE;
+}
+
+gboolean
+tpacket_ring_block_lost(tpacket_ring *ring)
+{
+    return ring->in_block &&
+           (block_status(current_block(ring)) & TP_STATUS_LOSING);
+}
+
+void
+tpacket_ring_release_block(tpacket_ring *ring)
+{
+    if (!ring->in_block)
+        return;
+    g_atomic_int_set((gint *)&current_block(ring)->hdr.bh1.block_status,
+                     TP_STATUS_KERNEL);
+    ring->in_block = FALSE;
+    ring->current = (ring->current + 1) % ring->block_count;
+}
+
+gboolean
+tpacket_ring_stats(tpacket_ring *ring, guint64 *received, guint64 *dropped)
+{
+    struct tpacket_stats_v3 stats;
+    socklen_t len = sizeof stats;
+
+    if (getsockopt(ring->fd, SOL_PACKET, PACKET_STATISTICS, &stats,
+                   &len) == -1)
+        return FALSE;
+
+    /* tp_packets includes the drops. */
+    ring->received += stats.tp_packets;
+    ring->dropped += stats.tp_drops;
+    *received = ring->received;
+    *dropped = ring->dropped;
+    return TRUE;
+}
+
+void
+tpacket_ring_close(tpacket_ring *ring)
+{
+    if (ring->map != NULL)
+        munmap(ring->map, ring->map_size);
+    close(ring->fd);
+    g_free(ring);
+}
+
+#endif /* HAVE_LIBPCAP && HAVE_TPACKET3 */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,143 @@
+/* capture-tpacket.h
+ * Declarations of routines for capturing from a Linux TPACKET_V3 ring
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CAPTURE_TPACKET_H__
+#define __CAPTURE_TPACKET_H__
+
+#ifdef HAVE_TPACKET3
+
+#include <glib.h>
+
+#include <wsutil/wspcap.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A memory-mapped ring of blocks that the kernel fills with the packets
+ * that arrive on an interface, handing a block over when it's full or
+ * when it has waited for more packets for long enough.  Reading a block
+ * at a time, rather than a packet at a time, lets the packets of a
+ * block be written out together.
+ *
+ * Only Ethernet (and loopback) interfaces can be captured on this way;
+ * the caller should use libpcap for anything else.
+ */
+typedef struct _tpacket_ring tpacket_ring;
+
+/*
+ * How the kernel spreads the packets of an interface over the rings of
+ * a fanout group, so that each ring gets some of them.
+ */
+typedef enum {
+    TPACKET_FANOUT_NONE,    /* the ring gets all the packets */
+    TPACKET_FANOUT_HASH,    /* by a hash of the flow, so each flow stays on one ring */
+    TPACKET_FANOUT_CPU,     /* by the CPU the packet arrived on */
+    TPACKET_FANOUT_LB       /* round robin */
+} tpacket_fanout_mode;
+
+/* Sizes of the ring, and the fanout group it's in, if any */
+typedef struct _tpacket_ring_params {
+    guint               block_size;     /* bytes in a block; a multiple of the page size */
+    guint               block_count;    /* blocks in the ring */
+    guint               timeout;        /* ms to wait for a block to fill before handing it over */
+    tpacket_fanout_mode fanout_mode;
+    guint16             fanout_group;   /* unique on the system to the rings of the group */
+} tpacket_ring_params;
+
+#define TPACKET_DEFAULT_BLOCK_SIZE  (1024 * 1024)
+#define TPACKET_DEFAULT_BLOCK_COUNT 32
+#define TPACKET_DEFAULT_TIMEOUT     100
+
+/* A packet in a block */
+typedef struct _tpacket_packet {
+    guint32        ts_sec;
+    guint32        ts_nsec;
+    guint32        caplen;      /* bytes of data, not counting any VLAN tag */
+    guint32        len;         /* bytes on the wire, not counting any VLAN tag */
+    const guint8  *data;
+    gboolean       has_vlan;    /* the kernel took a VLAN tag out of the packet */
+    guint8         vlan_tag[4]; /* the tag, to go after the MAC addresses */
+} tpacket_packet;
+
+/*
+ * Set up a ring on an interface.  The ring doesn't capture anything
+ * until tpacket_ring_set_filter() has been called.
+ *
+ * @return The ring, or NULL with errmsg filled in; the caller should
+ * then try libpcap.
+ */
+extern tpacket_ring *tpacket_ring_open(const char *iface,
+    const tpacket_ring_params *params, int snaplen, gboolean promisc,
+    char *errmsg, size_t errmsg_len);
+
+/* The DLT_ value of the packets */
+extern int tpacket_ring_linktype(tpacket_ring *ring);
+
+/* The descriptor to poll or select on for a block to be handed over */
+extern int tpacket_ring_fd(tpacket_ring *ring);
+
+/*
+ * Attach a filter, compiled for a pcap_t with the snapshot length the
+ * ring was opened with, or, if fcode is NULL, one that only truncates
+ * packets to that length, and start capturing, in the ring's fanout
+ * group if it's in one.
+ *
+ * @return TRUE on success, FALSE with errno set otherwise.
+ */
+extern gboolean tpacket_ring_set_filter(tpacket_ring *ring,
+    struct bpf_program *fcode);
+
+/*
+ * Start reading the next block, if the kernel has handed it over to us;
+ * if we're already reading a block, carry on with it.
+ *
+ * @return TRUE if there's a block to read, FALSE if we have to wait for
+ * one to be handed over.
+ */
+extern gboolean tpacket_ring_next_block(tpacket_ring *ring);
+
+/*
+ * Get the next packet of the block we're reading.
+ *
+ * @return TRUE with *packet filled in, or FALSE if there are no more
+ * packets in the block, which should then be released.
+ */
+extern gboolean tpacket_ring_next_packet(tpacket_ring *ring,
+    tpacket_packet *packet);
+
+/*
+ * Return TRUE if the kernel had to drop packets while it was filling the
+ * current block, because the ring was full.
+ */
+extern gboolean tpacket_ring_block_lost(tpacket_ring *ring);
+
+/* Hand the current block back to the kernel. */
+extern void tpacket_ring_release_block(tpacket_ring *ring);
+
+/*
+ * Get the packets that have passed the filter, and how many of those
+ * were dropped for lack of room in the ring, since the ring was opened.
+ *
+ * @return TRUE on success, FALSE with errno set otherwise.
+ */
+extern gboolean tpacket_ring_stats(tpacket_ring *ring, guint64 *received,
+    guint64 *dropped);
+
+extern void tpacket_ring_close(tpacket_ring *ring);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* HAVE_TPACKET3 */
+
+#endif /* __CAPTURE_TPACKET_H__ */
@@ -19,6 +19,7 @@
 #include <glib.h>
 
 #include <epan/epan.h>
+#include <epan/epan_dissect.h>
 #include <epan/timestamp.h>
 #include <epan/prefs.h>
 #include <epan/dfilter/dfilter.h>
@@ -32,13 +33,19 @@
 
 #include <wiretap/wtap.h>
 
+#include "ui/failure_message.h"
 #include "ui/util.h"
 
+/* Number of times each filter is applied to each frame by --benchmark */
+#define BENCHMARK_ITERATIONS	100
+
 static void failure_warning_message(const char *msg_format, va_list ap);
 static void open_failure_message(const char *filename, int err,
 	gboolean for_writing);
 static void read_failure_message(const char *filename, int err);
 static void write_failure_message(const char *filename, int err);
+static int run_benchmark(const char *cf_name, dfilter_t *df_unoptimized,
+	dfilter_t *df);
 
 int
 main(int argc, char **argv)
@@ -46,7 +53,12 @@ main(int argc, char **argv)
 	char		*init_progfile_dir_error;
 	char		*text;
 	dfilter_t	*df;
+	dfilter_t	*df_unoptimized = NULL;
 	gchar		*err_msg;
+	gboolean	show_optimization = FALSE;
+	const char	*benchmark_file = NULL;
+	int		first_arg = 1;
+	int		ret = 0;
 
 	/*
 	 * Get credential information for later use.
@@ -91,35 +103,186 @@ main(int argc, char **argv)
 	line that its preferences have changed. */
 	prefs_apply_all();
 
+	for (;;) {
+		/* Show the code with and without optimization? */
+		if (argc > first_arg && strcmp(argv[first_arg], "--optimize") == 0) {
+			show_optimization = TRUE;
+			first_arg++;
+		}
+		/* Time the filter with and without optimization? */
+		else if (argc > first_arg + 1 && strcmp(argv[first_arg], "--benchmark") == 0) {
+			benchmark_file = argv[first_arg + 1];
+			first_arg += 2;
+		}
+		else
+			break;
+	}
+
 	/* Check for filter on command line */
-	if (argc <= 1) {
-		fprintf(stderr, "Usage: dftest <filter>\n");
+	if (argc <= first_arg) {
+		fprintf(stderr, "Usage: dftest [--optimize] [--benchmark <capture file>] <filter>\n");
 		exit(1);
 	}
 
 	/* Get filter text */
-	text = get_args_as_string(argc, argv, 1);
+	text = get_args_as_string(argc, argv, first_arg);
 
 	printf("Filter: \"%s\"\n", text);
 
 	/* Compile it */
-	if (!dfilter_compile(text, &df, &err_msg)) {
+	if ((show_optimization || benchmark_file) &&
+	    !dfilter_compile_unoptimized(text, &df_unoptimized, &err_msg, DF_ALLOW_FILE_SETS)) {
 		fprintf(stderr, "dftest: %s\n", err_msg);
 		g_free(err_msg);
 		epan_cleanup();
 		exit(2);
 	}
+	if (!dfilter_compile_flags(text, &df, &err_msg, DF_ALLOW_FILE_SETS)) {
+		fprintf(stderr, "dftest: %s\n", err_msg);
+		g_free(err_msg);
+		dfilter_free(df_unoptimized);
+		epan_cleanup();
+		exit(2);
+	}
 
 	printf("\n");
 
 	if (df == NULL)
 		printf("Filter is empty\n");
+	else if (show_optimization) {
+		printf("Unoptimized:\n");
+		dfilter_dump(df_unoptimized);
+		printf("\nOptimized:\n");
+		dfilter_dump(df);
+	}
 	else
 		dfilter_dump(df);
 
+	if (df != NULL && benchmark_file != NULL)
+		ret = run_benchmark(benchmark_file, df_unoptimized, df);
+
+	dfilter_free(df_unoptimized);
 	dfilter_free(df);
 	epan_cleanup();
-	exit(0);
+	exit(ret);
+}
+
+static const nstime_t *
+dftest_get_frame_ts(struct packet_provider_data *prov _U_, guint32 frame_num _U_)
+{
+	static nstime_t empty;
+
+	return &empty;
+}
+
+/*
+ * Dissect each frame of a capture file once, then time applying the
+ * filter to the resulting tree, compiled with and without optimization.
+ * Dissection isn't timed, so this measures only the filter engine.
+ */
+static int
+run_benchmark(const char *cf_name, dfilter_t *df_unoptimized, dfilter_t *df)
+{
+	static const struct packet_provider_funcs funcs = {
+		dftest_get_frame_ts,
+		NULL,
+		NULL,
+		NULL
+	};
+	wtap		*wth;
+	epan_t		*session;
+	epan_dissect_t	*edt;
+	wtap_rec	*rec;
+	frame_data	fdata;
+	gint64		data_offset;
+	int		err;
+	gchar		*err_info = NULL;
+	guint32		framenum = 0, matched = 0, mismatched = 0;
+	guint32		prefiltered = 0, misprefiltered = 0;
+	gboolean	rejected;
+	gint64		start, unoptimized_usecs = 0, optimized_usecs = 0;
+	gboolean	passed_unoptimized = FALSE, passed = FALSE;
+	int		i;
+
+	wth = wtap_open_offline(cf_name, WTAP_TYPE_AUTO, &err, &err_info, FALSE);
+	if (wth == NULL) {
+		cfile_open_failure_message("dftest", cf_name, err, err_info);
+		return 2;
+	}
+
+	session = epan_new(NULL, &funcs);
+	edt = epan_dissect_new(session, TRUE, FALSE);
+
+	while (wtap_read(wth, &err, &err_info, &data_offset)) {
+		rec = wtap_get_rec(wth);
+		if (rec->rec_type != REC_TYPE_PACKET)
+			continue;
+
+		frame_data_init(&fdata, ++framenum, rec, data_offset, 0);
+		rejected = !dfilter_prefilter_data(df, wtap_get_buf_ptr(wth),
+			rec->rec_header.packet_header.caplen);
+		epan_dissect_prime_with_dfilter(edt, df_unoptimized);
+		epan_dissect_prime_with_dfilter(edt, df);
+		epan_dissect_run(edt, wtap_file_type_subtype(wth), rec,
+		    tvb_new_real_data(wtap_get_buf_ptr(wth),
+			rec->rec_header.packet_header.caplen,
+			rec->rec_header.packet_header.caplen),
+		    &fdata, NULL);
+
+		start = g_get_monotonic_time();
+		for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+			passed_unoptimized = dfilter_apply_edt(df_unoptimized, edt);
+		unoptimized_usecs += g_get_monotonic_time() - start;
+
+		start = g_get_monotonic_time();
+		for (i = 0; i < BENCHMARK_ITERATIONS; i++)
+			passed = dfilter_apply_edt(df, edt);
+		optimized_usecs += g_get_monotonic_time() - start;
+
+		if (passed)
+			matched++;
+		if (passed != passed_unoptimized)
+			mismatched++;
+		if (rejected) {
+			prefiltered++;
+			if (passed)
+				misprefiltered++;
+		}
+
+		epan_dissect_reset(edt);
+		frame_data_destroy(&fdata);
+	}
+
+	epan_dissect_free(edt);
+	epan_free(session);
+	wtap_close(wth);
+
+	if (err != 0) {
+		cfile_read_failure_message("dftest", cf_name, err, err_info);
+		return 2;
+	}
+
+	printf("\nBenchmark: %u frames, %u matched, %d applications each\n",
+		framenum, matched, BENCHMARK_ITERATIONS);
+	if (framenum != 0) {
+		printf("Unoptimized: %.1f ns per frame\n",
+			unoptimized_usecs * 1000.0 / framenum / BENCHMARK_ITERATIONS);
+		printf("Optimized:   %.1f ns per frame\n",
+			optimized_usecs * 1000.0 / framenum / BENCHMARK_ITERATIONS);
+	}
+	if (dfilter_has_prefilter(df))
+		printf("Prefilter:   %u frames rejected\n", prefiltered);
+	if (mismatched != 0) {
+		fprintf(stderr, "dftest: the optimized filter gave a different result for %u frames\n",
+			mismatched);
+		return 2;
+	}
+	if (misprefiltered != 0) {
+		fprintf(stderr, "dftest: the prefilter rejected %u frames that the filter matched\n",
+			misprefiltered);
+		return 2;
+	}
+	return 0;
 }
 
 /*
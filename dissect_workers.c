@@ -0,0 +1,163 @@
+/* dissect_workers.c
+ * Dissect parts of a capture file in worker processes and print their
+ * output in order
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include <wsutil/file_util.h>
+#include <wsutil/tempfile.h>
+
+#include "dissect_workers.h"
+
+typedef struct {
+  pid_t pid;
+  int   out_fd;     /* the worker's standard output, already unlinked */
+} dissect_worker_t;
+
+/*
+ * Fork a worker, with its standard output going to a new temporary
+ * file.  The file is removed straight away, so nothing is left behind
+ * if we're killed; the descriptor keeps it around until it's copied.
+ */
+static gboolean
+worker_start(dissect_worker_t *w, guint worker, dissect_worker_func func,
+    gpointer data, int *err)
+{
+  char     *path;
+  gboolean  ok;
+
+  w->out_fd = create_tempfile(&path, "wireshark_worker", NULL);
+  if (w->out_fd == -1) {
+    *err = errno;
+    return FALSE;
+  }
+  ws_unlink(path);
+
+  w->pid = fork();
+  if (w->pid == -1) {
+    *err = errno;
+    ws_close(w->out_fd);
+    return FALSE;
+  }
+  if (w->pid == 0) {
+    /* We're the worker. */
+    if (dup2(w->out_fd, 1) == -1)
+      _exit(2);
+    ok = (*func)(worker, data);
+    if (fflush(stdout) == EOF || ferror(stdout))
+      ok = FALSE;
+    /* Leave everything else, such as wiretap's temporary files, to
+       the process we were forked from. */
+    _exit(ok ? 0 : 2);
+  }
+  return TRUE;
+}
+
+static gboolean
+worker_wait(dissect_worker_t *w)
+{
+  int status;
+
+  while (waitpid(w->pid, &status, 0) == -1) {
+    if (errno != EINTR)
+      return FALSE;
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static gboolean
+copy_output(int fd, int *err)
+{
+  char    buf[65536];
+  ssize_t n;
+
+  if (ws_lseek64(fd, 0, SEEK_SET) == -1) {
+    *err = errno;
+    return FALSE;
+  }
+  while ((n = ws_read(fd, buf, sizeof buf)) > 0) {
+    if (fwrite(buf, 1, n, stdout) != (size_t)n) {
+      *err = errno;
+      return FALSE;
+    }
+  }
+  if (n == -1) {
+    *err = errno;
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean
+dissect_workers_run(guint num_workers, dissect_worker_func func,
+    gpointer data, int *err)
+{
+  dissect_worker_t *workers;
+  guint             started, i;
+  gboolean          ok = TRUE;
+  gboolean          worker_ok;
+
+  g_assert(num_workers > 0 && num_workers <= DISSECT_WORKERS_MAX);
+  *err = 0;
+
+  /* Don't have the workers inherit, and write again, anything that's
+     buffered. */
+  fflush(stdout);
+  fflush(stderr);
+
+  workers = g_new(dissect_worker_t, num_workers);
+  for (started = 0; started < num_workers; started++) {
+    if (!worker_start(&workers[started], started, func, data, err)) {
+      ok = FALSE;
+      break;
+    }
+  }
+
+  for (i = 0; i < started; i++) {
+    if (ok) {
+      worker_ok = worker_wait(&workers[i]);
+      /* A worker that failed has reported why; what it printed up to
+         then is still wanted. */
+      if (!copy_output(workers[i].out_fd, err) || !worker_ok)
+        ok = FALSE;
+    } else {
+      /* Something before this worker failed, so its output won't be
+         used. */
+      kill(workers[i].pid, SIGTERM);
+      worker_wait(&workers[i]);
+    }
+    ws_close(workers[i].out_fd);
+  }
+  g_free(workers);
+  return ok;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
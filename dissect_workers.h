@@ -0,0 +1,88 @@
+/* dissect_workers.h
+ * Dissect parts of a capture file in worker processes and print their
+ * output in order
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __DISSECT_WORKERS_H__
+#define __DISSECT_WORKERS_H__
+
+#include <glib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * epan isn't reentrant - the wmem scopes, the conversation and
+ * reassembly tables and the per-frame protocol data are all global - so
+ * packets can't be dissected on several threads of one process.  They
+ * can be dissected in several processes, though: each worker is forked
+ * from the caller, so it starts with a copy of everything the caller has
+ * set up, including, after the first pass of a two-pass analysis, the
+ * state that pass built, and nothing it does affects the others.
+ *
+ * Each worker's standard output goes to a temporary file of its own,
+ * and the caller copies those files to its standard output in worker
+ * order, so what the workers print comes out as if one process had
+ * printed it all.  If a worker fails, the output of those after it is
+ * dropped, as a single process would have stopped there.  Anything the
+ * output depends on that the caller knows and the workers don't, such
+ * as the packets before a worker's part of the file, is up to the
+ * caller to hand over in data.
+ *
+ * Only available on UN*X.
+ */
+
+/** Maximum number of workers. */
+#define DISSECT_WORKERS_MAX 256
+
+/**
+ * The work of one worker.  Called in a process of its own, with the
+ * standard output going to the worker's temporary file; anything it
+ * writes to the standard error goes straight there.
+ *
+ * @param worker the worker's number, from 0
+ * @param data the data passed to dissect_workers_run()
+ * @return TRUE on success, FALSE if the worker failed, after reporting why
+ */
+typedef gboolean (*dissect_worker_func)(guint worker, gpointer data);
+
+/**
+ * Run num_workers workers, and copy their output to the standard output
+ * in order, each worker's as soon as it and those before it have
+ * finished.  No threads other than the caller's may be running.
+ *
+ * @param num_workers the number of workers, at most DISSECT_WORKERS_MAX
+ * @param func what each worker does
+ * @param data passed to func
+ * @param err set to an errno value if a worker couldn't be started or
+ * its output couldn't be copied, or to 0 if a worker failed
+ * @return TRUE if every worker succeeded and its output was copied
+ */
+gboolean dissect_workers_run(guint num_workers, dissect_worker_func func,
+    gpointer data, int *err);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* dissect_workers.h */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
@@ -37,6 +37,10 @@
 #include <sys/utsname.h>
 #endif
 
+#ifdef HAVE_TPACKET3
+#include <sys/uio.h>
+#endif
+
 #include <signal.h>
 #include <errno.h>
 
@@ -59,6 +63,7 @@
 #include "caputils/capture_ifinfo.h"
 #include "caputils/capture-pcap-util.h"
 #include "caputils/capture-pcap-util-int.h"
+#include "caputils/capture-tpacket.h"
 #ifdef _WIN32
 #include "caputils/capture-wpcap.h"
 #endif /* _WIN32 */
@@ -90,6 +95,7 @@
 #include "wsutil/str_util.h"
 #include "wsutil/inet_addr.h"
 #include "wsutil/time_util.h"
+#include "wsutil/cwstream.h"
 
 #include "caputils/ws80211_utils.h"
 
@@ -194,6 +200,9 @@ static void cap_pipe_close(int pipe_fd, gboolean from_socket);
  * XXX - with TPACKET_V1 and TPACKET_V2, it currently uses select()
  * internally, and, with TPACKET_V3, once that's supported, it'll
  * support timeouts, at least as I understand the way the code works.
+ *
+ * With --tpacket we read a TPACKET_V3 ring ourselves, and select on
+ * its socket.
  */
 #define MUST_DO_SELECT
 #endif
@@ -249,6 +258,10 @@ typedef struct _capture_src {
     int                          snaplen;
     int                          linktype;
     gboolean                     ts_nsec;                /**< TRUE if we're using nanosecond precision. */
+#ifdef HAVE_TPACKET3
+    tpacket_ring                *tpacket;                /**< TPACKET_V3 ring, if we're reading one rather than using pcap_h */
+    struct _tpacket_output      *queue_output;           /**< file of its own, with --fanout=output:files */
+#endif
                                                          /**< capture pipe (unix only "input file") */
     gboolean                     from_cap_pipe;          /**< TRUE if we are capturing data from a capture pipe */
     gboolean                     from_cap_socket;        /**< TRUE if we're capturing from socket */
@@ -288,6 +301,7 @@ typedef struct _saved_idb {
     guint interface_id; /* capture_src->interface_id for the associated SHB */
     guint8 *idb;        /* If non-NULL, IDB read from capture_src. This is an interface specified on the command line otherwise. */
     guint idb_len;
+    guint64 ts_units;   /* Units of the time stamps of its EPBs per second, from if_tsresol in the IDB, if read from capture_src */
 } saved_idb_t;
 
 /*
@@ -327,6 +341,9 @@ typedef struct _pcap_queue_element {
         struct pcapng_block_header_s  bh;
     } u;
     u_char             *pd;
+#ifdef HAVE_TPACKET3
+    gint64              arrival;    /**< when it was dequeued, with --fanout=output:merge */
+#endif
 } pcap_queue_element;
 
 /*
@@ -387,6 +404,40 @@ static capture_options global_capture_opts;
 static gboolean quiet = FALSE;
 static gboolean use_threads = FALSE;
 static guint64 start_time;
+static gboolean async_write = FALSE;
+static ws_cwstream_stats write_stats;
+static ws_cwstream_options async_write_options = { FALSE, &write_stats };
+#ifdef HAVE_TPACKET3
+static gboolean use_tpacket = FALSE;
+static tpacket_ring_params tpacket_params = {
+    TPACKET_DEFAULT_BLOCK_SIZE,
+    TPACKET_DEFAULT_BLOCK_COUNT,
+    TPACKET_DEFAULT_TIMEOUT,
+    TPACKET_FANOUT_NONE,
+    0
+};
+
+/*
+ * With --fanout, the interface is captured on through several rings in a
+ * fanout group, each read by a thread of its own, as if each were an
+ * interface of its own, a "queue".
+ */
+typedef enum {
+    FANOUT_OUTPUT_SHARED,       /* the packets are written as they're queued */
+    FANOUT_OUTPUT_MERGE,        /* ... in time stamp order */
+    FANOUT_OUTPUT_FILES         /* each queue's thread writes a file of its own */
+} fanout_output_t;
+
+typedef struct _tpacket_output tpacket_output;
+
+#define FANOUT_MAX_QUEUES 64
+
+static gboolean use_fanout = FALSE;
+static guint fanout_queues = 0;
+static fanout_output_t fanout_output = FANOUT_OUTPUT_SHARED;
+static GQueue *fanout_merge_queues;     /* held back packets, per queue */
+static gint fanout_packets_written;     /* with output:files, not yet reported */
+#endif
 
 static void capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                                          const u_char *pd);
@@ -394,6 +445,13 @@ static void capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_p
                                          const u_char *pd);
 static void capture_loop_write_pcapng_cb(capture_src *pcap_src, const struct pcapng_block_header_s *bh, u_char *pd);
 static void capture_loop_queue_pcapng_cb(capture_src *pcap_src, const struct pcapng_block_header_s *bh, u_char *pd);
+#ifdef HAVE_TPACKET3
+static void capture_loop_dispatch_tpacket(loop_data *ld, char *errmsg, int errmsg_len, capture_src *pcap_src);
+static gboolean capture_loop_open_queue_files(capture_options *capture_opts, char *errmsg, int errmsg_len);
+static int capture_loop_queue_files_written(void);
+static gboolean capture_loop_close_queue_files(int *err_close);
+static void capture_loop_discard_queue_files(void);
+#endif
 static void capture_loop_get_errmsg(char *errmsg, size_t errmsglen,
                                     char *secondary_errmsg,
                                     size_t secondary_errmsglen,
@@ -404,12 +462,19 @@ static void WS_NORETURN exit_main(int err);
 
 static void report_new_capture_file(const char *filename);
 static void report_packet_count(unsigned int packet_count);
+static void report_write_stalls(void);
 static void report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, gchar *name);
 static void report_capture_error(const char *error_msg, const char *secondary_error_msg);
 static void report_cfilter_error(capture_options *capture_opts, guint i, const char *errmsg);
 
 #define MSG_MAX_LENGTH 4096
 
+/* Long options that only dumpcap has */
+#define LONGOPT_COMPRESS (65536+1)
+#define LONGOPT_TPACKET  (65536+2)
+#define LONGOPT_FANOUT   (65536+3)
+#define LONGOPT_ASYNC_WRITE (65536+4)
+
 static void
 print_usage(FILE *output)
 {
@@ -477,12 +542,34 @@ print_usage(FILE *output)
     fprintf(output, "  --capture-comment <comment>\n");
     fprintf(output, "                           add a capture comment to the output file\n");
     fprintf(output, "                           (only for pcapng)\n");
+    fprintf(output, "  --compress <type>        compress the output file(s) with zstd or lz4\n");
+    fprintf(output, "  --async-write[=direct]   write the output file(s) in large buffers, on a\n");
+    fprintf(output, "                           thread of their own; direct: bypass the page cache\n");
     fprintf(output, "\n");
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -N <packet_limit>        maximum number of packets buffered within dumpcap\n");
     fprintf(output, "  -C <byte_limit>          maximum number of bytes used for buffering packets\n");
     fprintf(output, "                           within dumpcap\n");
     fprintf(output, "  -t                       use a separate thread per interface\n");
+#ifdef HAVE_TPACKET3
+    fprintf(output, "  --tpacket[=<param>:<value>]\n");
+    fprintf(output, "                           capture from a TPACKET_V3 ring; params are\n");
+    fprintf(output, "                           blocksize:NUM - size of a block in KiB (def: %u)\n",
+            TPACKET_DEFAULT_BLOCK_SIZE / 1024);
+    fprintf(output, "                           blocks:NUM - blocks in the ring (def: %u)\n",
+            TPACKET_DEFAULT_BLOCK_COUNT);
+    fprintf(output, "                           timeout:NUM - ms to wait for a block to fill (def: %u)\n",
+            TPACKET_DEFAULT_TIMEOUT);
+    fprintf(output, "  --fanout <param>:<value>[,<param>:<value>]...\n");
+    fprintf(output, "                           spread the packets over several TPACKET_V3 rings,\n");
+    fprintf(output, "                           each read by a thread of its own; params are\n");
+    fprintf(output, "                           queues:NUM - number of rings (2-%d)\n",
+            FANOUT_MAX_QUEUES);
+    fprintf(output, "                           mode:hash|cpu|lb - how to spread them (def: hash)\n");
+    fprintf(output, "                           output:shared|merge|files - write them as they come,\n");
+    fprintf(output, "                           in time stamp order, or to a file per ring\n");
+    fprintf(output, "                           (def: shared)\n");
+#endif
     fprintf(output, "  -q                       don't report packet capture counts\n");
     fprintf(output, "  -v                       print version information and exit\n");
     fprintf(output, "  -h                       display this help and exit\n");
@@ -2045,6 +2132,46 @@ pcapng_read_shb(capture_src *pcap_src,
     return 0;
 }
 
+/*
+ * Get the units of the time stamps of an interface's packets, per second,
+ * from the if_tsresol option of its IDB.
+ */
+static guint64
+pcapng_idb_ts_units(const guint8 *idb, guint idb_len)
+{
+    const guint8 *opt, *end;
+    struct pcapng_option_header oh;
+    guint8        resol;
+    guint64       units;
+
+    if (idb_len < sizeof(pcapng_block_header_t) + sizeof(pcapng_interface_description_block_t) + sizeof(guint32))
+        return 1000000;
+    opt = idb + sizeof(pcapng_block_header_t) + sizeof(pcapng_interface_description_block_t);
+    end = idb + idb_len - sizeof(guint32);
+    while ((size_t)(end - opt) >= sizeof oh) {
+        memcpy(&oh, opt, sizeof oh);
+        opt += sizeof oh;
+        if (oh.type == 0 || oh.value_length > (size_t)(end - opt))  /* opt_endofopt, or a bad option */
+            break;
+        if (oh.type == 9 && oh.value_length == 1) {                 /* if_tsresol */
+            resol = *opt;
+            if (resol & 0x80) {
+                if ((resol & 0x7f) < 64)
+                    return G_GUINT64_CONSTANT(1) << (resol & 0x7f);
+            } else if (resol <= 19) {
+                for (units = 1; resol != 0; resol--)
+                    units *= 10;
+                return units;
+            }
+            break;
+        }
+        opt += (oh.value_length + 3) & ~3;
+        if (opt > end)
+            break;
+    }
+    return 1000000;
+}
+
 /*
  * Save IDB blocks for playback whenever we change output files.
  * Rewrite EPB and ISB interface IDs.
@@ -2103,6 +2230,7 @@ pcapng_adjust_block(capture_src *pcap_src, const struct pcapng_block_header_s *b
         idb_source.interface_id = pcap_src->interface_id;
         idb_source.idb_len = bh->block_total_length;
         idb_source.idb = (guint8 *) g_memdup(pd, idb_source.idb_len);
+        idb_source.ts_units = pcapng_idb_ts_units(pd, idb_source.idb_len);
         g_array_append_val(global_ld.saved_idbs, idb_source);
         guint32 iface_id = global_ld.saved_idbs->len - 1;
         g_array_append_val(pcap_src->cap_pipe_info.pcapng.src_iface_to_global, iface_id);
@@ -2654,6 +2782,246 @@ pcapng_pipe_dispatch(loop_data *ld, capture_src *pcap_src, char *errmsg, int err
     return -1;
 }
 
+#ifdef HAVE_TPACKET3
+/*
+ * Set one of the sizes of the TPACKET_V3 ring from a --tpacket argument:
+ * "blocksize:NUM" in KiB, "blocks:NUM" or "timeout:NUM" in milliseconds.
+ */
+static gboolean
+set_tpacket_param(const char *arg)
+{
+    const char *value;
+    guint32     num;
+
+    value = strchr(arg, ':');
+    if (value == NULL || !ws_strtou32(value + 1, NULL, &num) || num == 0)
+        return FALSE;
+
+    if (g_str_has_prefix(arg, "blocksize:")) {
+        if (num > G_MAXUINT / 1024)
+            return FALSE;
+        tpacket_params.block_size = num * 1024;
+    } else if (g_str_has_prefix(arg, "blocks:")) {
+        tpacket_params.block_count = num;
+    } else if (g_str_has_prefix(arg, "timeout:")) {
+        tpacket_params.timeout = num;
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Set one of the --fanout parameters: "queues:NUM", "mode:hash", "mode:cpu"
+ * or "mode:lb", or "output:shared", "output:merge" or "output:files".
+ */
+static gboolean
+set_fanout_param(const char *arg)
+{
+    guint32 num;
+
+    if (g_str_has_prefix(arg, "queues:")) {
+        if (!ws_strtou32(arg + strlen("queues:"), NULL, &num) ||
+            num < 2 || num > FANOUT_MAX_QUEUES)
+            return FALSE;
+        fanout_queues = num;
+    } else if (strcmp(arg, "mode:hash") == 0) {
+        tpacket_params.fanout_mode = TPACKET_FANOUT_HASH;
+    } else if (strcmp(arg, "mode:cpu") == 0) {
+        tpacket_params.fanout_mode = TPACKET_FANOUT_CPU;
+    } else if (strcmp(arg, "mode:lb") == 0) {
+        tpacket_params.fanout_mode = TPACKET_FANOUT_LB;
+    } else if (strcmp(arg, "output:shared") == 0) {
+        fanout_output = FANOUT_OUTPUT_SHARED;
+    } else if (strcmp(arg, "output:merge") == 0) {
+        fanout_output = FANOUT_OUTPUT_MERGE;
+    } else if (strcmp(arg, "output:files") == 0) {
+        fanout_output = FANOUT_OUTPUT_FILES;
+    } else {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Set the --fanout parameters in a comma-separated list of them, such as
+ * "queues:4,mode:cpu".
+ */
+static gboolean
+set_fanout_params(const char *arg)
+{
+    gchar  **params;
+    guint    i;
+    gboolean ok = TRUE;
+
+    params = g_strsplit(arg, ",", -1);
+    if (params[0] == NULL)
+        ok = FALSE;
+    for (i = 0; ok && params[i] != NULL; i++)
+        ok = set_fanout_param(params[i]);
+    g_strfreev(params);
+    return ok;
+}
+
+/*
+ * Make a copy of an interface's options for one of its --fanout queues,
+ * with strings of its own and a reference to the extcap arguments, to be
+ * freed with it by capture_opts_del_iface().  The interface is a local one that hasn't
+ * been opened yet, so there's no extcap process or pipe to share.
+ */
+static void
+copy_fanout_interface_opts(interface_options *queue_opts,
+                           const interface_options *interface_opts, guint queue)
+{
+    *queue_opts = *interface_opts;
+    queue_opts->name = g_strdup(interface_opts->name);
+    queue_opts->descr = g_strdup_printf("%s queue %u", interface_opts->display_name, queue);
+    queue_opts->display_name = g_strdup(queue_opts->descr);
+    queue_opts->cfilter = g_strdup(interface_opts->cfilter);
+    queue_opts->extcap = g_strdup(interface_opts->extcap);
+    queue_opts->extcap_fifo = g_strdup(interface_opts->extcap_fifo);
+    if (interface_opts->extcap_args != NULL)
+        g_hash_table_ref(queue_opts->extcap_args);
+    queue_opts->extcap_control_in = g_strdup(interface_opts->extcap_control_in);
+    queue_opts->extcap_control_out = g_strdup(interface_opts->extcap_control_out);
+#ifdef HAVE_PCAP_REMOTE
+    queue_opts->remote_host = g_strdup(interface_opts->remote_host);
+    queue_opts->remote_port = g_strdup(interface_opts->remote_port);
+    queue_opts->auth_username = g_strdup(interface_opts->auth_username);
+    queue_opts->auth_password = g_strdup(interface_opts->auth_password);
+#endif
+    queue_opts->timestamp_type = g_strdup(interface_opts->timestamp_type);
+}
+
+/*
+ * For --fanout, check that the other options allow it, and replace the
+ * interface with one for each queue.
+ */
+static gboolean
+add_fanout_queues(capture_options *capture_opts)
+{
+    interface_options *interface_opts;
+    interface_options  queue_opts;
+    guint              i;
+
+    if (fanout_queues == 0) {
+        cmdarg_err("--fanout needs the number of queues, given with queues:NUM.");
+        return FALSE;
+    }
+    if (capture_opts->ifaces->len != 1) {
+        cmdarg_err("--fanout can only be used when capturing on one interface.");
+        return FALSE;
+    }
+    interface_opts = &g_array_index(capture_opts->ifaces, interface_options, 0);
+    if (interface_opts->extcap != NULL
+#ifdef HAVE_PCAP_REMOTE
+        || interface_opts->src_type == CAPTURE_IFREMOTE
+#endif
+        ) {
+        cmdarg_err("--fanout can only be used when capturing on a local interface.");
+        return FALSE;
+    }
+    if (fanout_output == FANOUT_OUTPUT_FILES) {
+        if (capture_opts->save_file == NULL || strcmp(capture_opts->save_file, "-") == 0 ||
+            capture_child) {
+            cmdarg_err("--fanout output:files needs the name of a capture file given with -w.");
+            return FALSE;
+        }
+        if (capture_opts->multi_files_on || capture_opts->has_autostop_filesize) {
+            cmdarg_err("--fanout output:files can't be used with a ring buffer or a file size limit.");
+            return FALSE;
+        }
+    } else {
+        /* Each queue is an interface of the capture file */
+        capture_opts->use_pcapng = TRUE;
+    }
+
+    use_threads = TRUE;
+    if (tpacket_params.fanout_mode == TPACKET_FANOUT_NONE)
+        tpacket_params.fanout_mode = TPACKET_FANOUT_HASH;
+    tpacket_params.fanout_group = (guint16)getpid();
+
+    for (i = 1; i < fanout_queues; i++) {
+        /* Appending may have moved the original */
+        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, 0);
+        copy_fanout_interface_opts(&queue_opts, interface_opts, i);
+        g_array_append_val(capture_opts->ifaces, queue_opts);
+    }
+    interface_opts = &g_array_index(capture_opts->ifaces, interface_options, 0);
+    g_free(interface_opts->descr);
+    interface_opts->descr = g_strdup_printf("%s queue 0", interface_opts->display_name);
+    g_free(interface_opts->display_name);
+    interface_opts->display_name = g_strdup(interface_opts->descr);
+    return TRUE;
+}
+
+/*
+ * Set up a TPACKET_V3 ring on an interface, if we can, with a dead pcap_t
+ * alongside it for compiling the capture filter and for the snapshot
+ * length.  If we can't, the interface is opened with libpcap as usual.
+ */
+static gboolean
+capture_loop_open_tpacket(interface_options *interface_opts, capture_src *pcap_src)
+{
+    char errmsg[MSG_MAX_LENGTH+1];
+    int  snaplen;
+
+    /* Only libpcap can do these for us */
+    if (interface_opts->monitor_mode || interface_opts->timestamp_type != NULL ||
+        (interface_opts->linktype != -1 && interface_opts->linktype != DLT_EN10MB)
+#ifdef HAVE_PCAP_REMOTE
+        || interface_opts->src_type == CAPTURE_IFREMOTE
+#endif
+        ) {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_MESSAGE,
+              "Not using a TPACKET_V3 ring for %s, as libpcap has to set it up.",
+              interface_opts->name);
+        return FALSE;
+    }
+
+    if (interface_opts->has_snaplen)
+        snaplen = interface_opts->snaplen;
+    else
+        snaplen = WTAP_MAX_PACKET_SIZE_STANDARD;
+
+    pcap_src->tpacket = tpacket_ring_open(interface_opts->name, &tpacket_params,
+                                          snaplen, interface_opts->promisc_mode,
+                                          errmsg, sizeof errmsg);
+    if (pcap_src->tpacket == NULL) {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_MESSAGE,
+              "%s; not using a TPACKET_V3 ring.", errmsg);
+        return FALSE;
+    }
+    pcap_src->linktype = tpacket_ring_linktype(pcap_src->tpacket);
+    pcap_src->pcap_h = pcap_open_dead(pcap_src->linktype, snaplen);
+    if (pcap_src->pcap_h == NULL) {
+        tpacket_ring_close(pcap_src->tpacket);
+        pcap_src->tpacket = NULL;
+        return FALSE;
+    }
+    /* The kernel gives us nanosecond time stamps */
+    pcap_src->ts_nsec = TRUE;
+    g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG,
+          "capture_loop_open_tpacket: %u blocks of %u bytes on %s",
+          tpacket_params.block_count, tpacket_params.block_size, interface_opts->name);
+    return TRUE;
+}
+
+/* Get the statistics of a TPACKET_V3 ring, as pcap_stats() would. */
+static gboolean
+capture_loop_tpacket_stats(capture_src *pcap_src, struct pcap_stat *stats)
+{
+    guint64 received, dropped;
+
+    if (!tpacket_ring_stats(pcap_src->tpacket, &received, &dropped))
+        return FALSE;
+    stats->ps_recv = (u_int)received;
+    stats->ps_drop = (u_int)dropped;
+    stats->ps_ifdrop = 0;
+    return TRUE;
+}
+#endif /* HAVE_TPACKET3 */
+
 /** Open the capture input file (pcap or capture pipe).
  *  Returns TRUE if it succeeds, FALSE otherwise. */
 static gboolean
@@ -2770,10 +3138,23 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
         g_array_append_val(ld->pcaps, pcap_src);
 
         g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_open_input : %s", interface_opts->name);
-        pcap_src->pcap_h = open_capture_device(capture_opts, interface_opts,
-            CAP_READ_TIMEOUT, &open_err, &open_err_str);
-
-        if (pcap_src->pcap_h != NULL) {
+#ifdef HAVE_TPACKET3
+        if (use_tpacket && capture_loop_open_tpacket(interface_opts, pcap_src)) {
+            /* we've set up a ring on "iface" */
+            open_err_str[0] = '\0';
+        } else if (use_fanout) {
+            /* With libpcap, each queue would get all the packets */
+            g_snprintf(errmsg, (gulong) errmsg_len,
+                       "The packets of %s can't be spread over %u queues.",
+                       interface_opts->name, fanout_queues);
+            g_snprintf(secondary_errmsg, (gulong) secondary_errmsg_len,
+                       "That needs a TPACKET_V3 ring on an Ethernet interface, "
+                       "without monitor mode or a time stamp type.");
+            return FALSE;
+        } else
+#endif
+        if ((pcap_src->pcap_h = open_capture_device(capture_opts, interface_opts,
+                 CAP_READ_TIMEOUT, &open_err, &open_err_str)) != NULL) {
             /* we've opened "iface" as a network device */
 
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
@@ -2870,6 +3251,11 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
 
 /* XXX - will this work for tshark? */
 #ifdef MUST_DO_SELECT
+#ifdef HAVE_TPACKET3
+        if (pcap_src->tpacket != NULL) {
+            pcap_src->pcap_fd = tpacket_ring_fd(pcap_src->tpacket);
+        } else
+#endif
         if (!pcap_src->from_cap_pipe) {
 #ifdef HAVE_PCAP_GET_SELECTABLE_FD
             pcap_src->pcap_fd = pcap_get_selectable_fd(pcap_src->pcap_h);
@@ -2945,6 +3331,12 @@ static void capture_loop_close_input(loop_data *ld)
                 pcap_src->cap_pipe_info.pcapng.src_iface_to_global = NULL;
             }
         } else {
+#ifdef HAVE_TPACKET3
+            if (pcap_src->tpacket != NULL) {
+                tpacket_ring_close(pcap_src->tpacket);
+                pcap_src->tpacket = NULL;
+            }
+#endif
             /* Capture device.  If open, close the pcap_t. */
             if (pcap_src->pcap_h != NULL) {
                 g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_close_input: closing %p", (void *)pcap_src->pcap_h);
@@ -2965,15 +3357,16 @@ static void capture_loop_close_input(loop_data *ld)
 
 /* init the capture filter */
 static initfilter_status_t
-capture_loop_init_filter(pcap_t *pcap_h, gboolean from_cap_pipe,
+capture_loop_init_filter(capture_src *pcap_src,
                          const gchar * name, const gchar * cfilter)
 {
+    pcap_t            *pcap_h = pcap_src->pcap_h;
     struct bpf_program fcode;
 
     g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_DEBUG, "capture_loop_init_filter: %s", cfilter);
 
     /* capture filters only work on real interfaces */
-    if (cfilter && !from_cap_pipe) {
+    if (cfilter && !pcap_src->from_cap_pipe) {
         /* A capture filter was specified; set it up. */
         if (!compile_capture_filter(name, pcap_h, &fcode, cfilter)) {
             /* Treat this specially - our caller might try to compile this
@@ -2981,6 +3374,17 @@ capture_loop_init_filter(pcap_t *pcap_h, gboolean from_cap_pipe,
                the display and capture filter syntaxes are different. */
             return INITFILTER_BAD_FILTER;
         }
+#ifdef HAVE_TPACKET3
+        /* The kernel runs the filter for a ring; pcap_h is only a dead one */
+        if (pcap_src->tpacket != NULL) {
+            if (!tpacket_ring_set_filter(pcap_src->tpacket, &fcode)) {
+#ifdef HAVE_PCAP_FREECODE
+                pcap_freecode(&fcode);
+#endif
+                return INITFILTER_OTHER_ERROR;
+            }
+        } else
+#endif
         if (pcap_setfilter(pcap_h, &fcode) < 0) {
 #ifdef HAVE_PCAP_FREECODE
             pcap_freecode(&fcode);
@@ -3108,6 +3512,27 @@ capture_loop_init_pcapng_output(capture_options *capture_opts, loop_data *ld)
     return successful;
 }
 
+/*
+ * Make the standard I/O stream to write a capture file through, for its
+ * file descriptor: one that compresses what's written, or, with
+ * --async-write, one that writes it on a thread of its own, or a plain
+ * one.
+ */
+static FILE *
+capture_loop_fdopen_output(int fd, const ws_cwstream_options *write_options)
+{
+    ws_cwstream_type compress_type;
+
+    if (global_capture_opts.compress_type) {
+        /* Checked when the option was given */
+        ws_cwstream_name_to_type(global_capture_opts.compress_type, &compress_type);
+        return ws_cwstream_fdopen_stdio(fd, compress_type, write_options);
+    }
+    if (write_options != NULL)
+        return ws_cwstream_fdopen_stdio(fd, WS_CWSTREAM_NONE, write_options);
+    return ws_fdopen(fd, "wb");
+}
+
 /* set up to write to the already-opened capture output file/files */
 static gboolean
 capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *errmsg, int errmsg_len)
@@ -3128,7 +3553,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
     if (capture_opts->multi_files_on) {
         ld->pdh = ringbuf_init_libpcap_fdopen(&err);
     } else {
-        ld->pdh = ws_fdopen(ld->save_file_fd, "wb");
+        ld->pdh = capture_loop_fdopen_output(ld->save_file_fd,
+                                             async_write ? &async_write_options : NULL);
         if (ld->pdh == NULL) {
             err = errno;
         }
@@ -3199,6 +3625,17 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
                     guint64 isb_ifrecv, isb_ifdrop;
                     struct pcap_stat stats;
 
+#ifdef HAVE_TPACKET3
+                    if (pcap_src->tpacket != NULL) {
+                        if (capture_loop_tpacket_stats(pcap_src, &stats)) {
+                            isb_ifrecv = pcap_src->received;
+                            isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
+                        } else {
+                            isb_ifrecv = G_MAXUINT64;
+                            isb_ifdrop = G_MAXUINT64;
+                        }
+                    } else
+#endif
                     if (pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
                         isb_ifrecv = pcap_src->received;
                         isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
@@ -3287,6 +3724,13 @@ capture_loop_dispatch(loop_data *ld,
             }
         }
     }
+#ifdef HAVE_TPACKET3
+    else if (pcap_src->tpacket != NULL)
+    {
+        /* dispatch from a TPACKET_V3 ring */
+        capture_loop_dispatch_tpacket(ld, errmsg, errmsg_len, pcap_src);
+    }
+#endif
     else
     {
         /* dispatch from pcap */
@@ -3495,7 +3939,9 @@ capture_loop_open_output(capture_options *capture_opts, int *save_file_fd,
                 /* ringbuffer is enabled */
                 *save_file_fd = ringbuf_init(capfile_name,
                                              (capture_opts->has_ring_num_files) ? capture_opts->ring_num_files : 0,
-                                             capture_opts->group_read_access);
+                                             capture_opts->group_read_access,
+                                             capture_opts->compress_type,
+                                             async_write ? &async_write_options : NULL);
 
                 /* we need the ringbuf name */
                 if (*save_file_fd != -1) {
@@ -3705,12 +4151,105 @@ pcap_read_handler(void* arg)
     return (NULL);
 }
 
-/* Try to pop an item off the packet queue and if it exists, write it */
-static gboolean
+/* Write a packet or block taken off the packet queue, and free it */
+static void
+capture_loop_write_queue_element(pcap_queue_element *queue_element)
+{
+    if (queue_element->pcap_src->from_pcapng) {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+              "Dequeued a block of type 0x%08x of length %d captured on interface %d.",
+              queue_element->u.bh.block_type, queue_element->u.bh.block_total_length,
+              queue_element->pcap_src->interface_id);
+
+        capture_loop_write_pcapng_cb(queue_element->pcap_src,
+                                    &queue_element->u.bh,
+                                    queue_element->pd);
+    } else {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
+            "Dequeued a packet of length %d captured on interface %d.",
+            queue_element->u.phdr.caplen, queue_element->pcap_src->interface_id);
+
+        capture_loop_write_packet_cb((u_char *) queue_element->pcap_src,
+                                    &queue_element->u.phdr,
+                                    queue_element->pd);
+    }
+    g_free(queue_element->pd);
+    g_free(queue_element);
+}
+
+#ifdef HAVE_TPACKET3
+/*
+ * With --fanout=output:merge, the packets of the queues are held back so
+ * that they can be written in time stamp order.  The earliest of them is
+ * written once every queue has a packet waiting, as nothing earlier can
+ * come from any queue after that, or once it's waited long enough for
+ * every ring to have handed over the block it was filling when the packet
+ * arrived, or once the capture is stopping.
+ *
+ * Returns the number of packets written.
+ */
+static int
+capture_loop_merge_queue_element(pcap_queue_element *queue_element)
+{
+    pcap_queue_element *head, *earliest;
+    GQueue             *earliest_queue;
+    gint64              now = g_get_monotonic_time();
+    gint64              wait = ((gint64)tpacket_params.timeout * 2 + 100) * 1000;
+    gboolean            all_waiting;
+    int                 written = 0;
+    guint               i;
+
+    if (queue_element != NULL) {
+        queue_element->arrival = now;
+        g_queue_push_tail(&fanout_merge_queues[queue_element->pcap_src->interface_id],
+                          queue_element);
+    }
+
+    for (;;) {
+        earliest = NULL;
+        earliest_queue = NULL;
+        all_waiting = TRUE;
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            head = (pcap_queue_element *)g_queue_peek_head(&fanout_merge_queues[i]);
+            if (head == NULL) {
+                all_waiting = FALSE;
+                continue;
+            }
+            if (earliest == NULL ||
+                head->u.phdr.ts.tv_sec < earliest->u.phdr.ts.tv_sec ||
+                (head->u.phdr.ts.tv_sec == earliest->u.phdr.ts.tv_sec &&
+                 head->u.phdr.ts.tv_usec < earliest->u.phdr.ts.tv_usec)) {
+                earliest = head;
+                earliest_queue = &fanout_merge_queues[i];
+            }
+        }
+        if (earliest == NULL)
+            break;
+        if (!all_waiting && global_ld.go && now - earliest->arrival < wait)
+            break;
+        g_queue_pop_head(earliest_queue);
+        capture_loop_write_queue_element(earliest);
+        written++;
+    }
+    return written;
+}
+#endif
+
+/*
+ * Try to pop an item off the packet queue and if it exists, write it.
+ * Returns the number of items written.
+ */
+static int
 capture_loop_dequeue_packet(void) {
     pcap_queue_element *queue_element;
 
     g_async_queue_lock(pcap_queue);
+#ifdef HAVE_TPACKET3
+    /* Once the capture threads are done, don't wait for more */
+    if (fanout_merge_queues != NULL && !global_ld.go)
+        queue_element = (pcap_queue_element *)g_async_queue_try_pop_unlocked(pcap_queue);
+    else
+#endif
     queue_element = (pcap_queue_element *)g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
     if (queue_element) {
         if (queue_element->pcap_src->from_pcapng) {
@@ -3721,30 +4260,15 @@ capture_loop_dequeue_packet(void) {
         pcap_queue_packets -= 1;
     }
     g_async_queue_unlock(pcap_queue);
+#ifdef HAVE_TPACKET3
+    if (fanout_merge_queues != NULL)
+        return capture_loop_merge_queue_element(queue_element);
+#endif
     if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
-            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                  "Dequeued a block of type 0x%08x of length %d captured on interface %d.",
-                  queue_element->u.bh.block_type, queue_element->u.bh.block_total_length,
-                  queue_element->pcap_src->interface_id);
-
-            capture_loop_write_pcapng_cb(queue_element->pcap_src,
-                                        &queue_element->u.bh,
-                                        queue_element->pd);
-        } else {
-            g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_INFO,
-                "Dequeued a packet of length %d captured on interface %d.",
-                queue_element->u.phdr.caplen, queue_element->pcap_src->interface_id);
-
-            capture_loop_write_packet_cb((u_char *) queue_element->pcap_src,
-                                        &queue_element->u.phdr,
-                                        queue_element->pd);
-        }
-        g_free(queue_element->pd);
-        g_free(queue_element);
-        return TRUE;
+        capture_loop_write_queue_element(queue_element);
+        return 1;
     }
-    return FALSE;
+    return 0;
 }
 
 /* Do the low-level work of a capture.
@@ -3807,7 +4331,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
          * is NULL. This might be a bug in WPCap. Therefore we provide an empty
          * string.
          */
-        switch (capture_loop_init_filter(pcap_src->pcap_h, pcap_src->from_cap_pipe,
+        switch (capture_loop_init_filter(pcap_src,
                                          interface_opts->name,
                                          interface_opts->cfilter?interface_opts->cfilter:"")) {
 
@@ -3830,6 +4354,14 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
     /* If we're supposed to write to a capture file, open it for output
        (temporary/specified name/ringbuffer) */
+#ifdef HAVE_TPACKET3
+    if (fanout_output == FANOUT_OUTPUT_FILES) {
+        /* Each queue's thread writes a file of its own */
+        if (!capture_loop_open_queue_files(capture_opts, errmsg, sizeof(errmsg))) {
+            goto error;
+        }
+    } else
+#endif
     if (capture_opts->saving_to_file) {
         if (!capture_loop_open_output(capture_opts, &global_ld.save_file_fd,
                                       errmsg, sizeof(errmsg))) {
@@ -3895,6 +4427,13 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         pcap_queue = g_async_queue_new();
         pcap_queue_bytes = 0;
         pcap_queue_packets = 0;
+#ifdef HAVE_TPACKET3
+        if (fanout_output == FANOUT_OUTPUT_MERGE) {
+            fanout_merge_queues = g_new(GQueue, global_ld.pcaps->len);
+            for (i = 0; i < global_ld.pcaps->len; i++)
+                g_queue_init(&fanout_merge_queues[i]);
+        }
+#endif
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
             /* XXX - Add an interface name here? */
@@ -3904,13 +4443,11 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-
-            if (dequeued) {
-                inpkts = 1;
-            } else {
-                inpkts = 0;
-            }
+            inpkts = capture_loop_dequeue_packet();
+#ifdef HAVE_TPACKET3
+            if (fanout_output == FANOUT_OUTPUT_FILES)
+                inpkts = capture_loop_queue_files_written();
+#endif
         } else {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, 0);
             inpkts = capture_loop_dispatch(&global_ld, errmsg,
@@ -3980,7 +4517,8 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             /* Let the parent process know. */
             if (global_ld.inpkts_to_sync_pipe) {
                 /* do sync here */
-                fflush(global_ld.pdh);
+                if (global_ld.pdh != NULL)
+                    fflush(global_ld.pdh);
 
                 /* Send our parent a message saying we've written out
                    "global_ld.inpkts_to_sync_pipe" packets to the capture file. */
@@ -4025,15 +4563,21 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
                   pcap_src->interface_id);
         }
         while (1) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-            if (!dequeued) {
+            int dequeued = capture_loop_dequeue_packet();
+            if (dequeued == 0) {
                 break;
             }
-            global_ld.inpkts_to_sync_pipe += 1;
+            global_ld.inpkts_to_sync_pipe += dequeued;
             if (capture_opts->output_to_pipe) {
                 fflush(global_ld.pdh);
             }
         }
+#ifdef HAVE_TPACKET3
+        if (fanout_output == FANOUT_OUTPUT_FILES)
+            global_ld.inpkts_to_sync_pipe += capture_loop_queue_files_written();
+        g_free(fanout_merge_queues);
+        fanout_merge_queues = NULL;
+#endif
     }
 
 
@@ -4094,6 +4638,12 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         write_ok = FALSE;
     }
 
+#ifdef HAVE_TPACKET3
+    if (fanout_output == FANOUT_OUTPUT_FILES) {
+        /* close the queues' files */
+        close_ok = capture_loop_close_queue_files(&err_close);
+    } else
+#endif
     if (capture_opts->saving_to_file) {
         /* close the output file */
         close_ok = capture_loop_close_output(capture_opts, &global_ld, &err_close);
@@ -4127,6 +4677,8 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
      */
 
     report_capture_count(TRUE);
+    if (async_write)
+        report_write_stalls();
 
     /* get packet drop statistics from pcap */
     for (i = 0; i < capture_opts->ifaces->len; i++) {
@@ -4144,7 +4696,13 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
              * platforms; initialize it to 0 to handle that.
              */
             stats->ps_ifdrop = 0;
+#ifdef HAVE_TPACKET3
+            if (pcap_src->tpacket != NULL ?
+                capture_loop_tpacket_stats(pcap_src, stats) :
+                pcap_stats(pcap_src->pcap_h, stats) >= 0) {
+#else
             if (pcap_stats(pcap_src->pcap_h, stats) >= 0) {
+#endif
                 *stats_known = TRUE;
                 /* Let the parent process know. */
                 pcap_dropped += stats->ps_drop;
@@ -4167,6 +4725,14 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     return write_ok && close_ok;
 
 error:
+#ifdef HAVE_TPACKET3
+    if (fanout_output == FANOUT_OUTPUT_FILES) {
+        /* Get rid of the queues' files; the capture file itself was never
+           created, and a file of that name might not be ours. */
+        capture_loop_discard_queue_files();
+        g_free(capture_opts->save_file);
+    } else
+#endif
     if (capture_opts->multi_files_on) {
         /* cleanup ringbuffer */
         ringbuf_error_cleanup();
@@ -4302,6 +4868,51 @@ capture_loop_wrote_one_packet(capture_src *pcap_src) {
     }
 }
 
+/*
+ * Count a packet, from an EPB or SPB we've written, in the ring buffer's
+ * manifest.  The interface ID of an EPB has been mapped to that of its
+ * saved IDB by now.
+ */
+static void
+capture_loop_add_pcapng_to_manifest(const struct pcapng_block_header_s *bh, const u_char *pd)
+{
+    guint32  fields[4];   /* interface ID, time stamp (high and low), captured length */
+    guint64  units = 1000000;
+    guint64  ts64, rem;
+    nstime_t ts;
+
+    if (bh->block_type == BLOCK_TYPE_SPB) {
+        guint32 len, caplen;
+
+        /* SPBs have neither an interface ID nor a time stamp */
+        if (bh->block_total_length < sizeof *bh + 2 * sizeof(guint32))
+            return;
+        memcpy(&len, pd + sizeof *bh, sizeof len);
+        caplen = bh->block_total_length - (guint32)(sizeof *bh + 2 * sizeof(guint32));
+        ringbuf_add_packet(0, NULL, MIN(len, caplen));
+        return;
+    }
+    if (bh->block_type != BLOCK_TYPE_EPB)
+        return;
+    if (bh->block_total_length < sizeof *bh + sizeof fields)
+        return;
+    memcpy(fields, pd + sizeof *bh, sizeof fields);
+    if (fields[0] < global_ld.saved_idbs->len) {
+        saved_idb_t *idb_source = &g_array_index(global_ld.saved_idbs, saved_idb_t, fields[0]);
+
+        if (idb_source->ts_units != 0)
+            units = idb_source->ts_units;
+    }
+    ts64 = ((guint64)fields[1] << 32) | fields[2];
+    rem = ts64 % units;
+    ts.secs = (time_t)(ts64 / units);
+    if (units <= 1000000000)
+        ts.nsecs = (int)(rem * 1000000000 / units);
+    else
+        ts.nsecs = (int)((double)rem * 1000000000.0 / (double)units);
+    ringbuf_add_packet(fields[0], &ts, fields[3]);
+}
+
 /* one pcapng block was captured, process it */
 static void
 capture_loop_write_pcapng_cb(capture_src *pcap_src, const struct pcapng_block_header_s *bh, u_char *pd)
@@ -4359,6 +4970,8 @@ capture_loop_write_pcapng_cb(capture_src *pcap_src, const struct pcapng_block_he
                   "Wrote a pcapng block type %u of length %d captured on interface %u.",
                    bh->block_type, bh->block_total_length, pcap_src->interface_id);
 #endif
+            if (global_capture_opts.multi_files_on)
+                capture_loop_add_pcapng_to_manifest(bh, pd);
             capture_loop_wrote_one_packet(pcap_src);
         }
     }
@@ -4415,6 +5028,13 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                   "Wrote a pcap packet of length %d captured on interface %u.",
                    phdr->caplen, pcap_src->interface_id);
 #endif
+            if (global_capture_opts.multi_files_on) {
+                nstime_t ts;
+
+                ts.secs = phdr->ts.tv_sec;
+                ts.nsecs = (int)(pcap_src->ts_nsec ? phdr->ts.tv_usec : phdr->ts.tv_usec * 1000);
+                ringbuf_add_packet(pcap_src->interface_id, &ts, phdr->caplen);
+            }
             capture_loop_wrote_one_packet(pcap_src);
         }
     }
@@ -4542,6 +5162,591 @@ capture_loop_queue_pcapng_cb(capture_src *pcap_src, const struct pcapng_block_he
           pcap_queue_bytes, pcap_queue_packets);
 }
 
+#ifdef HAVE_TPACKET3
+/*
+ * Without threads, the packets of a block from a TPACKET_V3 ring are
+ * written straight from the ring, with their record headers, by writev(),
+ * in batches small enough for Linux's limit of 1024 iovecs a call.
+ */
+#define TPACKET_IOVECS_PER_PACKET 6 /* header, data before VLAN tag, tag, rest of data, padding, trailer */
+#define TPACKET_BATCH_PACKETS     128
+
+typedef struct {
+    struct pcapng_block_header_s bh;
+    guint32                      interface_id;
+    guint32                      timestamp_high;
+    guint32                      timestamp_low;
+    guint32                      captured_len;
+    guint32                      packet_len;
+} tpacket_epb_hdr;
+
+typedef struct {
+    int              n_packets;
+    int              n_iov;
+    union {
+        tpacket_epb_hdr     epb;
+        struct pcaprec_hdr  rec;
+    }                hdrs[TPACKET_BATCH_PACKETS];
+    guint32          trailers[TPACKET_BATCH_PACKETS];
+    guint8           vlan_tags[TPACKET_BATCH_PACKETS][4];
+    struct iovec     iov[TPACKET_BATCH_PACKETS * TPACKET_IOVECS_PER_PACKET];
+} tpacket_batch;
+
+static tpacket_batch tpacket_out;
+
+/*
+ * With --fanout=output:files, each queue's thread writes the packets of
+ * its ring to a file of its own, which has only the queue's interface.
+ */
+struct _tpacket_output {
+    FILE            *pdh;
+    int              fd;
+    guint64          bytes_written;
+    gchar           *filename;
+    ws_cwstream_options write_options;   /* with --async-write */
+    ws_cwstream_stats   write_stats;
+    tpacket_batch    batch;
+};
+
+/*
+ * Return TRUE if counting one more written packet would have
+ * capture_loop_wrote_one_packet() stop the capture or switch files, so
+ * that the packets before it have to be in the file first.
+ */
+static gboolean
+capture_loop_packet_limit_reached(void)
+{
+    if (global_capture_opts.has_autostop_packets &&
+        global_ld.packets_captured + 1 >= global_capture_opts.autostop_packets)
+        return TRUE;
+    if (global_capture_opts.has_file_packets &&
+        global_ld.packets_written + 1 >= global_capture_opts.file_packets)
+        return TRUE;
+    if (global_capture_opts.has_autostop_filesize &&
+        global_capture_opts.autostop_filesize > 0 &&
+        global_ld.bytes_written / 1000 >= global_capture_opts.autostop_filesize)
+        return TRUE;
+    return FALSE;
+}
+
+/* Add a packet, with its record header, to a batch */
+static void
+tpacket_batch_add(tpacket_batch *batch, guint32 interface_id,
+                  const tpacket_packet *packet, guint64 *bytes_written)
+{
+    static const guint8 padding[4] = { 0, 0, 0, 0 };
+    struct iovec  *iov = &batch->iov[batch->n_iov];
+    guint32        tag_len = packet->has_vlan ? 4 : 0;
+    guint32        caplen = packet->caplen + tag_len;
+    guint32        pad_len = 0;
+    guint32        total;
+    guint64        timestamp;
+    int            n = 0;
+
+    if (global_capture_opts.use_pcapng) {
+        tpacket_epb_hdr *epb = &batch->hdrs[batch->n_packets].epb;
+
+        pad_len = (4 - (caplen & 3)) & 3;
+        total = (guint32)sizeof *epb + caplen + pad_len + (guint32)sizeof(guint32);
+        timestamp = (guint64)packet->ts_sec * 1000000000 + packet->ts_nsec;
+        epb->bh.block_type = BLOCK_TYPE_EPB;
+        epb->bh.block_total_length = total;
+        epb->interface_id = interface_id;
+        epb->timestamp_high = (guint32)(timestamp >> 32);
+        epb->timestamp_low = (guint32)timestamp;
+        epb->captured_len = caplen;
+        epb->packet_len = packet->len + tag_len;
+        iov[n].iov_base = epb;
+        iov[n++].iov_len = sizeof *epb;
+    } else {
+        struct pcaprec_hdr *rec = &batch->hdrs[batch->n_packets].rec;
+
+        /* The file header says the time stamps are in nanoseconds */
+        total = (guint32)sizeof *rec + caplen;
+        rec->ts_sec = packet->ts_sec;
+        rec->ts_usec = packet->ts_nsec;
+        rec->incl_len = caplen;
+        rec->orig_len = packet->len + tag_len;
+        iov[n].iov_base = rec;
+        iov[n++].iov_len = sizeof *rec;
+    }
+
+    if (packet->has_vlan) {
+        /* The tag goes after the destination and source addresses */
+        memcpy(batch->vlan_tags[batch->n_packets], packet->vlan_tag, 4);
+        iov[n].iov_base = (void *)packet->data;
+        iov[n++].iov_len = 12;
+        iov[n].iov_base = batch->vlan_tags[batch->n_packets];
+        iov[n++].iov_len = 4;
+        iov[n].iov_base = (void *)(packet->data + 12);
+        iov[n++].iov_len = packet->caplen - 12;
+    } else {
+        iov[n].iov_base = (void *)packet->data;
+        iov[n++].iov_len = packet->caplen;
+    }
+
+    if (global_capture_opts.use_pcapng) {
+        if (pad_len != 0) {
+            iov[n].iov_base = (void *)padding;
+            iov[n++].iov_len = pad_len;
+        }
+        batch->trailers[batch->n_packets] = total;
+        iov[n].iov_base = &batch->trailers[batch->n_packets];
+        iov[n++].iov_len = sizeof(guint32);
+    }
+
+    batch->n_iov += n;
+    batch->n_packets++;
+    *bytes_written += total;
+}
+
+/*
+ * Write out a batch to a file, through pdh if we're compressing, else
+ * straight to its descriptor fd.  If this fails, set "ld->go" to FALSE,
+ * to stop the capture, and set "ld->err" to the error.
+ */
+static gboolean
+tpacket_batch_flush(tpacket_batch *batch, FILE *pdh, int fd,
+                    capture_src *pcap_src)
+{
+    struct iovec  *iov = batch->iov;
+    int            n_iov = batch->n_iov;
+    ssize_t        written;
+    int            i;
+    gboolean       successful = TRUE;
+
+    if (global_capture_opts.compress_type != NULL || async_write) {
+        /* The compressing or writing stream owns the file descriptor */
+        for (i = 0; i < n_iov; i++) {
+            if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, pdh) != iov[i].iov_len) {
+                global_ld.err = ferror(pdh) ? errno : 0;
+                successful = FALSE;
+                break;
+            }
+        }
+    } else if (n_iov != 0) {
+        /* Anything written through the FILE * goes before the packets */
+        if (fflush(pdh) == EOF) {
+            global_ld.err = errno;
+            successful = FALSE;
+            n_iov = 0;
+        }
+        while (n_iov > 0) {
+            written = writev(fd, iov, n_iov);
+            if (written == -1) {
+                if (errno == EINTR)
+                    continue;
+                global_ld.err = errno;
+                successful = FALSE;
+                break;
+            }
+            /* Skip what was written */
+            while (n_iov > 0 && (size_t)written >= iov->iov_len) {
+                written -= iov->iov_len;
+                iov++;
+                n_iov--;
+            }
+            if (n_iov > 0) {
+                iov->iov_base = (char *)iov->iov_base + written;
+                iov->iov_len -= written;
+            }
+        }
+    }
+    if (!successful) {
+        global_ld.go = FALSE;
+        pcap_src->dropped += batch->n_packets;
+    }
+    batch->n_packets = 0;
+    batch->n_iov = 0;
+    return successful;
+}
+
+/*
+ * Write an ISB with the drops so far, after a block the kernel had to
+ * drop packets while filling, so that a reader can tell where in the
+ * capture they were lost.
+ */
+static void
+capture_loop_write_tpacket_isb(capture_src *pcap_src, FILE *pdh,
+                               guint32 interface_id, guint64 *bytes_written)
+{
+    struct pcap_stat stats;
+    int              err;
+
+    if (!capture_loop_tpacket_stats(pcap_src, &stats))
+        return;
+    if (!pcapng_write_interface_statistics_block(pdh,
+                                                 interface_id,
+                                                 bytes_written,
+                                                 "Packets dropped by the kernel; counters provided by dumpcap",
+                                                 start_time,
+                                                 create_timestamp(),
+                                                 pcap_src->received,
+                                                 stats.ps_drop + pcap_src->dropped + pcap_src->flushed,
+                                                 &err)) {
+        global_ld.go = FALSE;
+        global_ld.err = err;
+    }
+}
+
+/* Write the packets of the block we're reading from a TPACKET_V3 ring */
+static void
+capture_loop_write_tpacket_block(capture_src *pcap_src)
+{
+    tpacket_packet packet;
+
+    while (tpacket_ring_next_packet(pcap_src->tpacket, &packet)) {
+        /* As in capture_loop_write_packet_cb() */
+        if (!global_ld.go) {
+            pcap_src->flushed++;
+            continue;
+        }
+        if (global_ld.pdh == NULL)
+            continue;
+
+        if (tpacket_out.n_packets == TPACKET_BATCH_PACKETS &&
+            !tpacket_batch_flush(&tpacket_out, global_ld.pdh,
+                                 global_ld.save_file_fd, pcap_src)) {
+            pcap_src->dropped++;
+            continue;
+        }
+        tpacket_batch_add(&tpacket_out, pcap_src->interface_id, &packet,
+                          &global_ld.bytes_written);
+        if (global_capture_opts.multi_files_on) {
+            nstime_t ts;
+
+            ts.secs = packet.ts_sec;
+            ts.nsecs = (int)packet.ts_nsec;
+            ringbuf_add_packet(pcap_src->interface_id, &ts,
+                               packet.caplen + (packet.has_vlan ? 4 : 0));
+        }
+        if (capture_loop_packet_limit_reached() &&
+            !tpacket_batch_flush(&tpacket_out, global_ld.pdh,
+                                 global_ld.save_file_fd, pcap_src))
+            continue;
+        capture_loop_wrote_one_packet(pcap_src);
+    }
+    if (global_ld.pdh != NULL &&
+        tpacket_batch_flush(&tpacket_out, global_ld.pdh,
+                            global_ld.save_file_fd, pcap_src) &&
+        global_ld.go && global_capture_opts.use_pcapng &&
+        tpacket_ring_block_lost(pcap_src->tpacket))
+        capture_loop_write_tpacket_isb(pcap_src, global_ld.pdh,
+                                       pcap_src->interface_id,
+                                       &global_ld.bytes_written);
+}
+
+/*
+ * With --fanout=output:files, write the packets of the block we're
+ * reading from a queue's ring to the queue's own file.  The threads
+ * don't wait for each other, so a limit on the number of packets only
+ * stops the capture once all of them have counted their packets.
+ */
+static void
+capture_loop_write_tpacket_queue_block(capture_src *pcap_src)
+{
+    tpacket_output *out = pcap_src->queue_output;
+    tpacket_packet  packet;
+    gint            written = 0;
+    gint            captured;
+
+    while (tpacket_ring_next_packet(pcap_src->tpacket, &packet)) {
+        if (!global_ld.go) {
+            pcap_src->flushed++;
+            continue;
+        }
+
+        if (out->batch.n_packets == TPACKET_BATCH_PACKETS &&
+            !tpacket_batch_flush(&out->batch, out->pdh, out->fd, pcap_src)) {
+            pcap_src->dropped++;
+            continue;
+        }
+        tpacket_batch_add(&out->batch, 0, &packet, &out->bytes_written);
+        pcap_src->received++;
+        written++;
+        captured = g_atomic_int_add(&global_ld.packets_captured, 1) + 1;
+        if (global_capture_opts.has_autostop_packets &&
+            captured >= global_capture_opts.autostop_packets)
+            global_ld.go = FALSE;
+    }
+    if (tpacket_batch_flush(&out->batch, out->pdh, out->fd, pcap_src) &&
+        global_ld.go && global_capture_opts.use_pcapng &&
+        tpacket_ring_block_lost(pcap_src->tpacket))
+        capture_loop_write_tpacket_isb(pcap_src, out->pdh, 0,
+                                       &out->bytes_written);
+    g_atomic_int_add(&fanout_packets_written, written);
+}
+
+/*
+ * Queue the packets of the block we're reading from a TPACKET_V3 ring
+ * for the writer thread.  It owns the output file, so drops are only
+ * reported at the end of the capture.
+ */
+static void
+capture_loop_queue_tpacket_block(capture_src *pcap_src)
+{
+    tpacket_packet     packet;
+    struct pcap_pkthdr phdr;
+    guint8            *tagged = NULL;
+
+    while (tpacket_ring_next_packet(pcap_src->tpacket, &packet)) {
+        /* The file says the time stamps are in nanoseconds */
+        phdr.ts.tv_sec = packet.ts_sec;
+        phdr.ts.tv_usec = packet.ts_nsec;
+        phdr.caplen = packet.caplen;
+        phdr.len = packet.len;
+        if (packet.has_vlan) {
+            tagged = (guint8 *)g_realloc(tagged, packet.caplen + 4);
+            memcpy(tagged, packet.data, 12);
+            memcpy(tagged + 12, packet.vlan_tag, 4);
+            memcpy(tagged + 16, packet.data + 12, packet.caplen - 12);
+            phdr.caplen += 4;
+            phdr.len += 4;
+            capture_loop_queue_packet_cb((u_char *)pcap_src, &phdr, tagged);
+        } else {
+            capture_loop_queue_packet_cb((u_char *)pcap_src, &phdr, packet.data);
+        }
+    }
+    g_free(tagged);
+}
+
+/*
+ * Wait for the kernel to hand over a block of a TPACKET_V3 ring, if it
+ * hasn't already, and process all its packets.
+ */
+static void
+capture_loop_dispatch_tpacket(loop_data *ld, char *errmsg, int errmsg_len,
+                              capture_src *pcap_src)
+{
+    int sel_ret;
+
+    if (!tpacket_ring_next_block(pcap_src->tpacket)) {
+        sel_ret = cap_pipe_select(tpacket_ring_fd(pcap_src->tpacket));
+        if (sel_ret < 0 && errno != EINTR) {
+            g_snprintf(errmsg, errmsg_len,
+                       "Unexpected error from select: %s", g_strerror(errno));
+            report_capture_error(errmsg, please_report);
+            ld->go = FALSE;
+        }
+        if (sel_ret <= 0 || !tpacket_ring_next_block(pcap_src->tpacket))
+            return;
+    }
+
+    if (pcap_src->queue_output != NULL) {
+        capture_loop_write_tpacket_queue_block(pcap_src);
+    } else if (use_threads) {
+        capture_loop_queue_tpacket_block(pcap_src);
+    } else {
+        capture_loop_write_tpacket_block(pcap_src);
+    }
+    tpacket_ring_release_block(pcap_src->tpacket);
+}
+
+/* Write the header of a queue's file, with the queue as its only interface */
+static gboolean
+capture_loop_write_queue_file_header(capture_options *capture_opts,
+                                     interface_options *interface_opts,
+                                     capture_src *pcap_src, tpacket_output *out,
+                                     int *err)
+{
+    GString  *os_info_str;
+    GString  *cpu_info_str;
+    char     *appname;
+    gboolean  successful;
+
+    pcap_src->snaplen = pcap_snapshot(pcap_src->pcap_h);
+    if (!capture_opts->use_pcapng)
+        return libpcap_write_file_header(out->pdh, pcap_src->linktype, pcap_src->snaplen,
+                                         pcap_src->ts_nsec, &out->bytes_written, err);
+
+    os_info_str = g_string_new("");
+    get_os_version_info(os_info_str);
+    cpu_info_str = g_string_new("");
+    get_cpu_info(cpu_info_str);
+    appname = g_strdup_printf("Dumpcap (Wireshark) %s", get_ws_vcs_version_info());
+    successful = pcapng_write_session_header_block(out->pdh,
+                                                   (const char *)capture_opts->capture_comment,   /* Comment */
+                                                   cpu_info_str->str,           /* HW */
+                                                   os_info_str->str,            /* OS */
+                                                   appname,
+                                                   -1,                          /* section_length */
+                                                   &out->bytes_written,
+                                                   err) &&
+                 pcapng_write_interface_description_block(out->pdh,
+                                                          NULL,                       /* OPT_COMMENT       1 */
+                                                          interface_opts->name,       /* IDB_NAME          2 */
+                                                          interface_opts->descr,      /* IDB_DESCRIPTION   3 */
+                                                          interface_opts->cfilter,    /* IDB_FILTER       11 */
+                                                          os_info_str->str,           /* IDB_OS           12 */
+                                                          pcap_src->linktype,
+                                                          pcap_src->snaplen,
+                                                          &out->bytes_written,
+                                                          0,                          /* IDB_IF_SPEED      8 */
+                                                          pcap_src->ts_nsec ? 9 : 6,  /* IDB_TSRESOL       9 */
+                                                          err);
+    g_free(appname);
+    g_string_free(cpu_info_str, TRUE);
+    g_string_free(os_info_str, TRUE);
+    return successful;
+}
+
+/*
+ * With --fanout=output:files, create a file for each queue, named after
+ * the capture file with "_q<queue>" added before its extension, and
+ * write its header.
+ */
+static gboolean
+capture_loop_open_queue_files(capture_options *capture_opts, char *errmsg, int errmsg_len)
+{
+    const char        *base, *ext;
+    gchar             *stem;
+    capture_src       *pcap_src;
+    interface_options *interface_opts;
+    tpacket_output    *out;
+    guint              i;
+    int                err;
+
+    base = strrchr(capture_opts->save_file, G_DIR_SEPARATOR);
+    base = base != NULL ? base + 1 : capture_opts->save_file;
+    ext = strrchr(base, '.');
+    if (ext == NULL || ext == base)
+        ext = base + strlen(base);
+    stem = g_strndup(capture_opts->save_file, ext - capture_opts->save_file);
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+
+        out = g_new0(tpacket_output, 1);
+        out->filename = g_strdup_printf("%s_q%u%s", stem, i, ext);
+        out->fd = ws_open(out->filename, O_WRONLY|O_BINARY|O_TRUNC|O_CREAT,
+                          (capture_opts->group_read_access) ? 0640 : 0600);
+        if (out->fd == -1) {
+            err = errno;
+            g_free(out->filename);
+            g_free(out);
+            goto fail;
+        }
+        pcap_src->queue_output = out;
+
+        /* Each queue's thread counts for its own stream */
+        out->write_options = async_write_options;
+        out->write_options.stats = &out->write_stats;
+        out->pdh = capture_loop_fdopen_output(out->fd,
+                                              async_write ? &out->write_options : NULL);
+        if (out->pdh == NULL) {
+            err = errno;
+            goto fail;
+        }
+        err = 0;
+        if (!capture_loop_write_queue_file_header(capture_opts, interface_opts,
+                                                  pcap_src, out, &err) ||
+            fflush(out->pdh) == EOF) {
+            if (err == 0)
+                err = errno;
+            goto fail;
+        }
+        report_new_capture_file(out->filename);
+    }
+    g_free(stem);
+    return TRUE;
+
+fail:
+    g_snprintf(errmsg, errmsg_len,
+               "The file to which the capture of queue %u would be"
+               " saved (\"%s_q%u%s\") could not be opened: %s.",
+               i, stem, i, ext, g_strerror(err));
+    g_free(stem);
+    return FALSE;
+}
+
+/* Take the count of the packets the queues' threads have written since we last did */
+static int
+capture_loop_queue_files_written(void)
+{
+    int written = g_atomic_int_get(&fanout_packets_written);
+
+    g_atomic_int_add(&fanout_packets_written, -written);
+    return written;
+}
+
+/* Write the final statistics of each queue to its file, and close it */
+static gboolean
+capture_loop_close_queue_files(int *err_close)
+{
+    capture_src      *pcap_src;
+    tpacket_output   *out;
+    struct pcap_stat  stats;
+    guint64           isb_ifrecv, isb_ifdrop;
+    guint64           end_time = create_timestamp();
+    gboolean          successful = TRUE;
+    guint             i;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        out = pcap_src->queue_output;
+        if (out == NULL)
+            continue;
+
+        if (global_capture_opts.use_pcapng) {
+            if (capture_loop_tpacket_stats(pcap_src, &stats)) {
+                isb_ifrecv = pcap_src->received;
+                isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
+            } else {
+                isb_ifrecv = G_MAXUINT64;
+                isb_ifdrop = G_MAXUINT64;
+            }
+            pcapng_write_interface_statistics_block(out->pdh,
+                                                    0,
+                                                    &out->bytes_written,
+                                                    "Counters provided by dumpcap",
+                                                    start_time,
+                                                    end_time,
+                                                    isb_ifrecv,
+                                                    isb_ifdrop,
+                                                    err_close);
+        }
+        if (fclose(out->pdh) == EOF && successful) {
+            *err_close = errno;
+            successful = FALSE;
+        }
+        write_stats.bytes += out->write_stats.bytes;
+        write_stats.frames += out->write_stats.frames;
+        write_stats.stalls += out->write_stats.stalls;
+        write_stats.stall_usec += out->write_stats.stall_usec;
+        g_free(out->filename);
+        g_free(out);
+        pcap_src->queue_output = NULL;
+    }
+    return successful;
+}
+
+/* Close and remove the queues' files, as we couldn't start the capture */
+static void
+capture_loop_discard_queue_files(void)
+{
+    capture_src    *pcap_src;
+    tpacket_output *out;
+    guint           i;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        out = pcap_src->queue_output;
+        if (out == NULL)
+            continue;
+
+        if (out->pdh != NULL)
+            fclose(out->pdh);
+        else
+            ws_close(out->fd);
+        ws_unlink(out->filename);
+        g_free(out->filename);
+        g_free(out);
+        pcap_src->queue_output = NULL;
+    }
+}
+#endif /* HAVE_TPACKET3 */
+
 static int
 set_80211_channel(const char *iface, const char *opt)
 {
@@ -4623,6 +5828,12 @@ real_main(int argc, char *argv[])
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
         LONGOPT_CAPTURE_COMMON
+        {"compress", required_argument, NULL, LONGOPT_COMPRESS},
+        {"async-write", optional_argument, NULL, LONGOPT_ASYNC_WRITE},
+#ifdef HAVE_TPACKET3
+        {"tpacket", optional_argument, NULL, LONGOPT_TPACKET},
+        {"fanout", required_argument, NULL, LONGOPT_FANOUT},
+#endif
         {0, 0, 0, 0 }
     };
 
@@ -5038,6 +6249,59 @@ real_main(int argc, char *argv[])
 #endif
             break;
 
+        case LONGOPT_COMPRESS:   /* Compress the output file(s) */
+        {
+            ws_cwstream_type compress_type;
+
+            if (!ws_cwstream_name_to_type(optarg, &compress_type)) {
+                cmdarg_err("\"%s\" isn't a valid compression type; use zstd or lz4.", optarg);
+                exit_main(1);
+            }
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+            if (!ws_cwstream_type_supported(compress_type)) {
+                cmdarg_err("This version of dumpcap can't write %s compressed files.", optarg);
+                exit_main(1);
+            }
+#else
+            /* The capture loop writes through standard I/O streams */
+            cmdarg_err("This version of dumpcap can't write compressed files.");
+            exit_main(1);
+#endif
+            g_free(global_capture_opts.compress_type);
+            global_capture_opts.compress_type = g_strdup(optarg);
+            break;
+        }
+        case LONGOPT_ASYNC_WRITE:   /* Write the output file(s) on a thread */
+            if (optarg != NULL && strcmp(optarg, "direct") != 0) {
+                cmdarg_err("Invalid --async-write argument \"%s\"; use direct.", optarg);
+                exit_main(1);
+            }
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+            async_write = TRUE;
+            async_write_options.direct_io = (optarg != NULL);
+#else
+            /* The capture loop writes through standard I/O streams */
+            cmdarg_err("This version of dumpcap can't write files on a thread of their own.");
+            exit_main(1);
+#endif
+            break;
+#ifdef HAVE_TPACKET3
+        case LONGOPT_TPACKET:    /* Capture from a TPACKET_V3 ring */
+            use_tpacket = TRUE;
+            if (optarg != NULL && !set_tpacket_param(optarg)) {
+                cmdarg_err("Invalid or unknown --tpacket argument \"%s\"", optarg);
+                exit_main(1);
+            }
+            break;
+        case LONGOPT_FANOUT:     /* Spread the packets over several rings */
+            use_tpacket = TRUE;
+            use_fanout = TRUE;
+            if (!set_fanout_params(optarg)) {
+                cmdarg_err("Invalid or unknown --fanout argument \"%s\"", optarg);
+                exit_main(1);
+            }
+            break;
+#endif
         case 'q':        /* Quiet */
             quiet = TRUE;
             break;
@@ -5368,6 +6632,11 @@ real_main(int argc, char *argv[])
     }
 #endif
 
+#ifdef HAVE_TPACKET3
+    if (use_fanout && !add_fanout_queues(&global_capture_opts))
+        exit_main(1);
+#endif
+
     /* We're supposed to do a capture.  Process the ring buffer arguments. */
     capture_opts_trim_ring_num_files(&global_capture_opts);
 
@@ -5616,6 +6885,27 @@ report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32
 }
 
 
+/*
+ * With --async-write, report how often the capture had to wait for the
+ * thread writing the file, i.e. for the disk, to catch up.
+ */
+static void
+report_write_stalls(void)
+{
+    if (capture_child) {
+        g_log(LOG_DOMAIN_CAPTURE_CHILD, G_LOG_LEVEL_MESSAGE,
+            "Output written in %" G_GUINT64_FORMAT " buffers; waited for the disk %" G_GUINT64_FORMAT " times, for %.3f s",
+            write_stats.frames, write_stats.stalls, write_stats.stall_usec / 1000000.0);
+    } else if (!quiet) {
+        fprintf(stderr,
+            "Output written in %" G_GUINT64_FORMAT " buffers; waited for the disk %" G_GUINT64_FORMAT " times, for %.3f s\n",
+            write_stats.frames, write_stats.stalls, write_stats.stall_usec / 1000000.0);
+        /* stderr could be line buffered */
+        fflush(stderr);
+    }
+}
+
+
 /************************************************************************************************/
 /* signal_pipe handling */
 
@@ -68,7 +68,6 @@
 #include <wsutil/cmdarg_err.h>
 #include <wsutil/filesystem.h>
 #include <wsutil/file_util.h>
-#include <wsutil/wsgcrypt.h>
 #include <wsutil/plugins.h>
 #include <wsutil/privileges.h>
 #include <wsutil/report_message.h>
@@ -82,6 +81,7 @@
 
 #include "ui/failure_message.h"
 
+#include "frame_dedup.h"
 #include "ringbuffer.h" /* For RINGBUFFER_MAX_NUM_FILES */
 
 #define INVALID_OPTION 1
@@ -102,20 +102,18 @@ struct select_item {
 /*
  * Duplicate frame detection
  */
-typedef struct _fd_hash_t {
-    guint8     digest[16];
-    guint32    len;
-    nstime_t   frame_time;
-} fd_hash_t;
-
 #define DEFAULT_DUP_DEPTH       5   /* Used with -d */
-#define MAX_DUP_DEPTH     1000000   /* the maximum window (and actual size of fd_hash[]) for de-duplication */
+#define MAX_DUP_DEPTH   100000000   /* the maximum window for de-duplication */
 
-static fd_hash_t fd_hash[MAX_DUP_DEPTH];
-static int       dup_window    = DEFAULT_DUP_DEPTH;
-static int       cur_dup_entry = 0;
+typedef struct {
+    guint32 offset;
+    guint32 len;
+} ignored_field_t;
 
-static guint32   ignored_bytes  = 0;  /* Used with -I */
+static frame_dedup_t *dedup          = NULL;
+static int            dup_window     = DEFAULT_DUP_DEPTH;
+static guint32        ignored_bytes  = 0;  /* Used with -I */
+static GArray        *ignored_fields = NULL; /* ignored_field_t, used with --ignore-field */
 
 #define ONE_BILLION 1000000000
 
@@ -159,6 +157,7 @@ static int                    out_file_type_subtype     = WTAP_FILE_TYPE_SUBTYPE
 #else
 static int                    out_file_type_subtype     = WTAP_FILE_TYPE_SUBTYPE_PCAP; /* default to pcap     */
 #endif
+static wtap_compression_type  out_compression_type      = WTAP_UNCOMPRESSED;
 static int                    out_frame_type            = -2; /* Leave frame type alone */
 static int                    verbose                   = 0;  /* Not so verbose         */
 static struct time_adjustment time_adj                  = {NSTIME_INIT_ZERO, 0}; /* no adjustment */
@@ -583,165 +582,24 @@ remove_vlan_info(const wtap_packet_header *phdr, guint8* fd, guint32* len) {
     }
 }
 
-static gboolean
-is_duplicate(guint8* fd, guint32 len) {
-    int i;
+/*
+ * Bytes at the start of a frame to leave out when checking for duplicates,
+ * other than those ignored with -I.
+ */
+static guint32
+dup_skip_bytes(const guint8 *fd, guint32 len)
+{
     const struct ieee80211_radiotap_header* tap_header;
-
-    /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
-    guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
-
-    if (len <= ignored_bytes) {
-        offset = 0;
-    }
+    guint32 offset;
 
     /* Get the size of radiotap header and use that as offset (-p option) */
     if (skip_radiotap == TRUE) {
         tap_header = (const struct ieee80211_radiotap_header*)fd;
         offset = pletoh16(&tap_header->it_len);
-        if (offset >= len)
-            offset = 0;
-    }
-
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
-
-    /* Look for duplicates */
-    for (i = 0; i < dup_window; i++) {
-        if (i == cur_dup_entry)
-            continue;
-
-        if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-            && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
-}
-
-static gboolean
-is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
-    int i;
-
-    /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
-    guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
-
-    if (len <= ignored_bytes) {
-        offset = 0;
-    }
-
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
-    fd_hash[cur_dup_entry].frame_time.secs = current->secs;
-    fd_hash[cur_dup_entry].frame_time.nsecs = current->nsecs;
-
-    /*
-     * Look for relative time related duplicates.
-     * This is hopefully a reasonably efficient mechanism for
-     * finding duplicates by rel time in the fd_hash[] cache.
-     * We check starting from the most recently added hash
-     * entries and work backwards towards older packets.
-     * This approach allows the dup test to be terminated
-     * when the relative time of a cached entry is found to
-     * be beyond the dup time window.
-     *
-     * Of course this assumes that the input trace file is
-     * "well-formed" in the sense that the packet timestamps are
-     * in strict chronologically increasing order (which is NOT
-     * always the case!!).
-     *
-     * The fd_hash[] table was deliberately created large (1,000,000).
-     * Looking for time related duplicates in large trace files with
-     * non-fractional dup time window values can potentially take
-     * a long time to complete.
-     */
-
-    for (i = cur_dup_entry - 1;; i--) {
-        nstime_t delta;
-        int cmp;
-
-        if (i < 0)
-            i = dup_window - 1;
-
-        if (i == cur_dup_entry) {
-            /*
-             * We've decremented back to where we started.
-             * Check no more!
-             */
-            break;
-        }
-
-        if (nstime_is_unset(&(fd_hash[i].frame_time))) {
-            /*
-             * We've decremented to an unused fd_hash[] entry.
-             * Check no more!
-             */
-            break;
-        }
-
-        nstime_delta(&delta, current, &fd_hash[i].frame_time);
-
-        if (delta.secs < 0 || delta.nsecs < 0) {
-            /*
-             * A negative delta implies that the current packet
-             * has an absolute timestamp less than the cached packet
-             * that it is being compared to.  This is NOT a normal
-             * situation since trace files usually have packets in
-             * chronological order (oldest to newest).
-             *
-             * There are several possible ways to deal with this:
-             * 1. 'continue' dup checking with the next cached frame.
-             * 2. 'break' from looking for a duplicate of the current frame.
-             * 3. Take the absolute value of the delta and see if that
-             * falls within the specifed dup time window.
-             *
-             * Currently this code does option 1.  But it would pretty
-             * easy to add yet-another-editcap-option to select one of
-             * the other behaviors for dealing with out-of-sequence
-             * packets.
-             */
-            continue;
-        }
-
-        cmp = nstime_cmp(&delta, &relative_time_window);
-
-        if (cmp > 0) {
-            /*
-             * The delta time indicates that we are now looking at
-             * cached packets beyond the specified dup time window.
-             * Check no more!
-             */
-            break;
-        } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-                   && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
-        }
+        if (offset < len)
+            return offset;
     }
-
-    return FALSE;
+    return 0;
 }
 
 static void
@@ -766,11 +624,16 @@ print_usage(FILE *output)
     fprintf(output, "  -D <dup window>        remove packet if duplicate; configurable <dup window>.\n");
     fprintf(output, "                         Valid <dup window> values are 0 to %d.\n", MAX_DUP_DEPTH);
     fprintf(output, "                         NOTE: A <dup window> of 0 with -v (verbose option) is\n");
-    fprintf(output, "                         useful to print MD5 hashes.\n");
+    fprintf(output, "                         useful to print hashes.\n");
     fprintf(output, "  -w <dup time window>   remove packet if duplicate packet is found EQUAL TO OR\n");
     fprintf(output, "                         LESS THAN <dup time window> prior to current packet.\n");
     fprintf(output, "                         A <dup time window> is specified in relative seconds\n");
     fprintf(output, "                         (e.g. 0.000001).\n");
+    fprintf(output, "  --ignore-field <offset>:<length>\n");
+    fprintf(output, "                         ignore <length> bytes at <offset> in the frame when\n");
+    fprintf(output, "                         checking for duplicates, e.g. 22:1 for the TTL and\n");
+    fprintf(output, "                         24:2 for the header checksum in Ether/IPv4. May be\n");
+    fprintf(output, "                         used several times.\n");
     fprintf(output, "           NOTE: The use of the 'Duplicate packet removal' options with\n");
     fprintf(output, "           other editcap options except -v may not always work as expected.\n");
     fprintf(output, "           Specifically the -r, -t or -S options will very likely NOT have the\n");
@@ -811,7 +674,7 @@ print_usage(FILE *output)
     fprintf(output, "                         the pseudo-random number generator. This allows one to\n");
     fprintf(output, "                         repeat a particular sequence of errors.\n");
     fprintf(output, "  -I <bytes to ignore>   ignore the specified number of bytes at the beginning\n");
-    fprintf(output, "                         of the frame during MD5 hash calculation, unless the\n");
+    fprintf(output, "                         of the frame during hash calculation, unless the\n");
     fprintf(output, "                         frame is too short, then the full frame is used.\n");
     fprintf(output, "                         Useful to remove duplicated packets taken on\n");
     fprintf(output, "                         several routers (different mac addresses for\n");
@@ -833,6 +696,8 @@ print_usage(FILE *output)
     fprintf(output, "  -F <capture type>      set the output file type; default is pcap.\n");
 #endif
     fprintf(output, "                         An empty \"-F\" option will list the file types.\n");
+    fprintf(output, "  --compress <type>      compress the output file(s) with gzip, zstd or lz4;\n");
+    fprintf(output, "                         \"--compress help\" lists the types available.\n");
     fprintf(output, "  -T <encap type>        set the output file encapsulation type; default is the\n");
     fprintf(output, "                         same as the input file. An empty \"-T\" option will\n");
     fprintf(output, "                         list the encapsulation types.\n");
@@ -842,7 +707,7 @@ print_usage(FILE *output)
     fprintf(output, "  -v                     verbose output.\n");
     fprintf(output, "                         If -v is used with any of the 'Duplicate Packet\n");
     fprintf(output, "                         Removal' options (-d, -D or -w) then Packet lengths\n");
-    fprintf(output, "                         and MD5 hashes are printed to standard-error.\n");
+    fprintf(output, "                         and hashes are printed to standard-error.\n");
 }
 
 struct string_elem {
@@ -892,6 +757,17 @@ list_capture_types(FILE *stream) {
     g_free(captypes);
 }
 
+static void
+list_output_compression_types(FILE *stream) {
+    GSList *compression_type_names, *name;
+
+    fprintf(stream, "editcap: The available output compression types for the \"--compress\" flag are:\n");
+    compression_type_names = wtap_get_all_output_compression_type_names_list();
+    for (name = compression_type_names; name != NULL; name = g_slist_next(name))
+        fprintf(stream, "    %s\n", (const char *)name->data);
+    g_slist_free(compression_type_names);
+}
+
 static void
 list_encap_types(FILE *stream) {
     int i;
@@ -973,10 +849,10 @@ editcap_dump_open(const char *filename, const wtap_dump_params *params,
 
   if (strcmp(filename, "-") == 0) {
     /* Write to the standard output. */
-    pdh = wtap_dump_open_stdout(out_file_type_subtype, WTAP_UNCOMPRESSED,
+    pdh = wtap_dump_open_stdout(out_file_type_subtype, out_compression_type,
                                 params, write_err);
   } else {
-    pdh = wtap_dump_open(filename, out_file_type_subtype, WTAP_UNCOMPRESSED,
+    pdh = wtap_dump_open(filename, out_file_type_subtype, out_compression_type,
                          params, write_err);
   }
   return pdh;
@@ -997,6 +873,8 @@ real_main(int argc, char *argv[])
         {"skip-radiotap-header", no_argument, NULL, 0x8101},
         {"seed", required_argument, NULL, 0x8102},
         {"inject-secrets", required_argument, NULL, 0x8103},
+        {"compress", required_argument, NULL, 0x8104},
+        {"ignore-field", required_argument, NULL, 0x8105},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'V'},
         {0, 0, 0, 0 }
@@ -1137,6 +1015,37 @@ real_main(int argc, char *argv[])
             break;
         }
 
+        case 0x8104: /* --compress */
+            if (strcmp("help", optarg) == 0) {
+                list_output_compression_types(stdout);
+                goto clean_exit;
+            }
+            out_compression_type = wtap_name_to_compression_type(optarg);
+            if (out_compression_type == WTAP_UNKNOWN_COMPRESSION) {
+                fprintf(stderr, "editcap: \"%s\" isn't a valid output compression type\n\n",
+                        optarg);
+                list_output_compression_types(stderr);
+                ret = INVALID_OPTION;
+                goto clean_exit;
+            }
+            break;
+
+        case 0x8105: /* --ignore-field */
+        {
+            ignored_field_t field;
+
+            if (sscanf(optarg, "%u:%u", &field.offset, &field.len) != 2) {
+                fprintf(stderr, "editcap: \"%s\" isn't a valid <offset>:<length>\n",
+                        optarg);
+                ret = INVALID_OPTION;
+                goto clean_exit;
+            }
+            if (!ignored_fields)
+                ignored_fields = g_array_new(FALSE, FALSE, sizeof(ignored_field_t));
+            g_array_append_val(ignored_fields, field);
+            break;
+        }
+
         case 'a':
         {
             guint frame_number;
@@ -1352,7 +1261,6 @@ real_main(int argc, char *argv[])
         case 'w':
             dup_detect = FALSE;
             dup_detect_by_time = TRUE;
-            dup_window = MAX_DUP_DEPTH;
             if (!set_rel_time(optarg)) {
                 ret = INVALID_OPTION;
                 goto clean_exit;
@@ -1530,10 +1438,16 @@ real_main(int argc, char *argv[])
         max_packet_number = G_MAXUINT;
 
     if (dup_detect || dup_detect_by_time) {
-        for (i = 0; i < dup_window; i++) {
-            memset(&fd_hash[i].digest, 0, 16);
-            fd_hash[i].len = 0;
-            nstime_set_unset(&fd_hash[i].frame_time);
+        if (dup_detect)
+            dedup = frame_dedup_new_frames(dup_window);
+        else
+            dedup = frame_dedup_new_time(&relative_time_window);
+        frame_dedup_ignore_prefix(dedup, ignored_bytes);
+        if (ignored_fields) {
+            for (i = 0; i < (int)ignored_fields->len; i++) {
+                ignored_field_t *field = &g_array_index(ignored_fields, ignored_field_t, i);
+                frame_dedup_ignore_bytes(dedup, field->offset, field->len);
+            }
         }
     }
 
@@ -1802,70 +1716,29 @@ real_main(int argc, char *argv[])
                     rec = &temp_rec;
                 }
 
-                /* suppress duplicates by packet window */
-                if (dup_detect) {
-                    if (is_duplicate(buf, rec->rec_header.packet_header.caplen)) {
+                /* suppress duplicates by packet or time window */
+                if (dup_detect ||
+                    (dup_detect_by_time && (rec->presence_flags & WTAP_HAS_TS))) {
+                    guint32 dup_len = rec->rec_header.packet_header.caplen;
+                    guint64 dup_hash;
+
+                    if (frame_dedup_check(dedup, buf, dup_len,
+                                          dup_skip_bytes(buf, dup_len),
+                                          &rec->ts, &dup_hash)) {
                         if (verbose) {
-                            fprintf(stderr, "Skipped: %u, Len: %u, MD5 Hash: ",
-                                    count,
-                                    rec->rec_header.packet_header.caplen);
-                            for (i = 0; i < 16; i++)
-                                fprintf(stderr, "%02x",
-                                        (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-                            fprintf(stderr, "\n");
+                            fprintf(stderr, "Skipped: %u, Len: %u, Hash: %016" G_GINT64_MODIFIER "x\n",
+                                    count, dup_len, dup_hash);
                         }
                         duplicate_count++;
                         count++;
                         continue;
                     } else {
                         if (verbose) {
-                            fprintf(stderr, "Packet: %u, Len: %u, MD5 Hash: ",
-                                    count,
-                                    rec->rec_header.packet_header.caplen);
-                            for (i = 0; i < 16; i++)
-                                fprintf(stderr, "%02x",
-                                        (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-                            fprintf(stderr, "\n");
+                            fprintf(stderr, "Packet: %u, Len: %u, Hash: %016" G_GINT64_MODIFIER "x\n",
+                                    count, dup_len, dup_hash);
                         }
                     }
                 } /* suppression of duplicates */
-
-                if (rec->presence_flags & WTAP_HAS_TS) {
-                    /* suppress duplicates by time window */
-                    if (dup_detect_by_time) {
-                        nstime_t current;
-
-                        current.secs  = rec->ts.secs;
-                        current.nsecs = rec->ts.nsecs;
-
-                        if (is_duplicate_rel_time(buf,
-                                                  rec->rec_header.packet_header.caplen,
-                                                  &current)) {
-                            if (verbose) {
-                                fprintf(stderr, "Skipped: %u, Len: %u, MD5 Hash: ",
-                                        count,
-                                        rec->rec_header.packet_header.caplen);
-                                for (i = 0; i < 16; i++)
-                                    fprintf(stderr, "%02x",
-                                            (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-                                fprintf(stderr, "\n");
-                            }
-                            duplicate_count++;
-                            count++;
-                            continue;
-                        } else {
-                            if (verbose) {
-                                fprintf(stderr, "Packet: %u, Len: %u, MD5 Hash: ",
-                                        count,
-                                        rec->rec_header.packet_header.caplen);
-                                for (i = 0; i < 16; i++)
-                                    fprintf(stderr, "%02x",
-                                            (unsigned char)fd_hash[cur_dup_entry].digest[i]);
-                                fprintf(stderr, "\n");
-                            }
-                        }
-                    }
-                } /* suppress duplicates by time window */
             }
 
             /* Random error mutation */
@@ -2038,6 +1911,9 @@ real_main(int argc, char *argv[])
     }
 
 clean_exit:
+    frame_dedup_free(dedup);
+    if (ignored_fields)
+        g_array_free(ignored_fields, TRUE);
     if (dsb_filenames) {
         g_array_free(dsb_types, TRUE);
         g_ptr_array_free(dsb_filenames, TRUE);
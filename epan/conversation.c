@@ -15,6 +15,7 @@
 #include "packet.h"
 #include "to_str.h"
 #include "conversation.h"
+#include "flow_table.h"
 
 /* define DEBUG_CONVERSATION for pretty debug printing */
 /* #define DEBUG_CONVERSATION */
@@ -45,31 +46,60 @@ struct conversation_key {
 /*
  * Hash table for conversations with no wildcards.
  */
-static wmem_map_t *conversation_hashtable_exact = NULL;
+static flow_table_t *conversation_hashtable_exact = NULL;
 
 /*
  * Hash table for conversations with one wildcard address.
  */
-static wmem_map_t *conversation_hashtable_no_addr2 = NULL;
+static flow_table_t *conversation_hashtable_no_addr2 = NULL;
 
 /*
  * Hash table for conversations with one wildcard port.
  */
-static wmem_map_t *conversation_hashtable_no_port2 = NULL;
+static flow_table_t *conversation_hashtable_no_port2 = NULL;
 
 /*
  * Hash table for conversations with one wildcard address and port.
  */
-static wmem_map_t *conversation_hashtable_no_addr2_or_port2 = NULL;
+static flow_table_t *conversation_hashtable_no_addr2_or_port2 = NULL;
 
 
 static guint32 new_index;
 
+/*
+ * The number of conversations that haven't been retired.
+ */
+static guint n_conversations;
+
 /*
  * Placeholder for address-less conversations.
  */
 static address null_address_ = ADDRESS_INIT_NONE;
 
+/*
+ * Lists of the conversations that can be retired, least recently active
+ * first; see conversation_set_retire_timeouts().
+ */
+typedef struct {
+	conversation_t *head;
+	conversation_t *tail;
+} conversation_idle_list_t;
+
+static guint retire_idle_secs;
+static guint retire_closed_secs;
+static conversation_idle_list_t open_conversations;
+static conversation_idle_list_t closed_conversations;
+
+/*
+ * The latest time stamp of the frames dissected so far, or unset.
+ */
+static nstime_t retire_now;
+
+/*
+ * Routines to call for protocols' data in retired conversations.
+ */
+static wmem_map_t *retire_routines = NULL;
+
 
 /*
  * Creates a new conversation with known endpoints based on a conversation
@@ -169,7 +199,8 @@ conversation_create_from_template(conversation_t *conversation, const address *a
 
 /*
  * Compute the hash value for two given address/port pairs if the match
- * is to be exact.
+ * is to be exact.  The conversation hash tables hash keys themselves;
+ * see flow_table.c.
  */
 /* http://eternallyconfuzzled.com/tuts/algorithms/jsw_tut_hashing.aspx#existing
  * One-at-a-Time hash
@@ -201,285 +232,153 @@ conversation_hash_exact(gconstpointer v)
 	return hash_val;
 }
 
-/*
- * Compare two conversation keys for an exact match.
+/**
+ * Create a new hash tables for conversations.
  */
-static gint
-conversation_match_exact(gconstpointer v, gconstpointer w)
+void
+conversation_init(void)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
-	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second port 2 values the same, the first and second address
-	 * 1 values the same, and the first and second address 2 values
-	 * the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    v1->port2 == v2->port2 &&
-	    addresses_equal(&v1->addr1, &v2->addr1) &&
-	    addresses_equal(&v1->addr2, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
-
 	/*
-	 * Is the first port 2 the same as the second port 1, the first
-	 * port 1 the same as the second port 2, the first address 2
-	 * the same as the second address 1, and the first address 1
-	 * the same as the second address 2?
-	 */
-	if (v1->port2 == v2->port1 &&
-	    v1->port1 == v2->port2 &&
-	    addresses_equal(&v1->addr2, &v2->addr1) &&
-	    addresses_equal(&v1->addr1, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in opposite directions.
-		 */
-		return 1;
-	}
-
-	/*
-	 * The addresses or the ports don't match.
+	 * Free up any space allocated for conversation protocol data
+	 * areas.
+	 *
+	 * We can free the space, as the structures it contains are
+	 * pointed to by conversation data structures that were freed
+	 * above.
 	 */
-	return 0;
-}
-
-/*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard address 2.
- */
-static guint
-conversation_hash_no_addr2(gconstpointer v)
-{
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
-	address tmp_addr;
-
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
-
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	tmp_addr.data = &key->port2;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	hash_val += ( hash_val << 3 );
-	hash_val ^= ( hash_val >> 11 );
-	hash_val += ( hash_val << 15 );
+	conversation_hashtable_exact =
+	    flow_table_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+	      FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+	conversation_hashtable_no_addr2 =
+	    flow_table_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+	      FLOW_TABLE_PORT2);
+	conversation_hashtable_no_port2 =
+	    flow_table_new_autoreset(wmem_epan_scope(), wmem_file_scope(),
+	      FLOW_TABLE_ADDR2);
+	conversation_hashtable_no_addr2_or_port2 =
+	    flow_table_new_autoreset(wmem_epan_scope(), wmem_file_scope(), 0);
 
-	return hash_val;
+	nstime_set_unset(&retire_now);
 }
 
-/*
- * Compare two conversation keys, except for the address 2 value.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
+/**
+ * Initialize some variables every time a file is loaded or re-loaded.
  */
-static gint
-conversation_match_no_addr2(gconstpointer v, gconstpointer w)
+void conversation_epan_reset(void)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
 	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second port 2 valuess the same, and the first and second
-	 * address 1 values the same?
+	 * Start the conversation indices over at 0.
 	 */
-	if (v1->port1 == v2->port1 &&
-	    v1->port2 == v2->port2 &&
-	    addresses_equal(&v1->addr1, &v2->addr1)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
+	new_index = 0;
+	n_conversations = 0;
 
 	/*
-	 * The addresses or the ports don't match.
+	 * The conversations on the lists were freed with the file.
 	 */
-	return 0;
+	open_conversations.head = open_conversations.tail = NULL;
+	closed_conversations.head = closed_conversations.tail = NULL;
+	nstime_set_unset(&retire_now);
 }
 
 /*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard port 2.
+ * Get the hash table for conversations with the given wildcard options.
  */
-static guint
-conversation_hash_no_port2(gconstpointer v)
+static flow_table_t *
+conversation_hashtable_for_options(const guint options)
 {
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
-	address tmp_addr;
-
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
-
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
-
-	hash_val = add_address_to_hash(hash_val, &key->addr2);
-
-	hash_val += ( hash_val << 3 );
-	hash_val ^= ( hash_val >> 11 );
-	hash_val += ( hash_val << 15 );
-
-	return hash_val;
+	if (options & NO_ADDR2) {
+		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
+			return conversation_hashtable_no_addr2_or_port2;
+		} else {
+			return conversation_hashtable_no_addr2;
+		}
+	} else {
+		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
+			return conversation_hashtable_no_port2;
+		} else {
+			return conversation_hashtable_exact;
+		}
+	}
 }
 
-/*
- * Compare two conversation keys, except for the port 2 value.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
- */
-static gint
-conversation_match_no_port2(gconstpointer v, gconstpointer w)
+static inline gboolean
+conversation_retiring(void)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
-
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
-
-	/*
-	 * Are the first and second port 1 values the same, the first and
-	 * second address 1 values the same, and the first and second
-	 * address 2 values the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    addresses_equal(&v1->addr1, &v2->addr1) &&
-	    addresses_equal(&v1->addr2, &v2->addr2)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
-	}
-
-	/*
-	 * The addresses or the ports don't match.
-	 */
-	return 0;
+	return retire_idle_secs != 0 || retire_closed_secs != 0;
 }
 
-/*
- * Compute the hash value for two given address/port pairs if the match
- * has a wildcard address 2 and port 2.
- */
-static guint
-conversation_hash_no_addr2_or_port2(gconstpointer v)
+static void
+conversation_idle_list_remove(conversation_idle_list_t *list, conversation_t *conv)
 {
-	const conversation_key_t key = (const conversation_key_t)v;
-	guint hash_val;
-	address tmp_addr;
-
-	hash_val = 0;
-	tmp_addr.len  = 4;
-
-	hash_val = add_address_to_hash(hash_val, &key->addr1);
+	if (conv->idle_prev != NULL)
+		conv->idle_prev->idle_next = conv->idle_next;
+	else
+		list->head = conv->idle_next;
+	if (conv->idle_next != NULL)
+		conv->idle_next->idle_prev = conv->idle_prev;
+	else
+		list->tail = conv->idle_prev;
+	conv->idle_prev = conv->idle_next = NULL;
+}
 
-	tmp_addr.data = &key->port1;
-	hash_val = add_address_to_hash(hash_val, &tmp_addr);
+static void
+conversation_idle_list_append(conversation_idle_list_t *list, conversation_t *conv)
+{
+	conv->idle_prev = list->tail;
+	conv->idle_next = NULL;
+	if (list->tail != NULL)
+		list->tail->idle_next = conv;
+	else
+		list->head = conv;
+	list->tail = conv;
+}
 
-	hash_val += ( hash_val << 3 );
-	hash_val ^= ( hash_val >> 11 );
-	hash_val += ( hash_val << 15 );
+static conversation_idle_list_t *
+conversation_idle_list_for(const conversation_t *conv)
+{
+	return conv->closed ? &closed_conversations : &open_conversations;
+}
 
-	return hash_val;
+static gboolean
+conversation_on_idle_list(const conversation_t *conv)
+{
+	return conv->idle_prev != NULL || conversation_idle_list_for(conv)->head == conv;
 }
 
 /*
- * Compare the address 1 and port 1 in the two conversation keys.
- * We don't check both directions of the conversation - the routine
- * doing the hash lookup has to do two searches, as the hash key
- * will be different for the two directions.
+ * Note that a frame of the current time has been seen in a conversation,
+ * by moving it to the end of its list.  Templates aren't retired, as
+ * they're there for connections yet to come.
  */
-static gint
-conversation_match_no_addr2_or_port2(gconstpointer v, gconstpointer w)
+static void
+conversation_touch(conversation_t *conv)
 {
-	const conversation_key_t v1 = (const conversation_key_t)v;
-	const conversation_key_t v2 = (const conversation_key_t)w;
+	conversation_idle_list_t *list;
 
-	if (v1->etype != v2->etype)
-		return 0;	/* different types of port */
+	if (!conversation_retiring() || nstime_is_unset(&retire_now) ||
+	    (conv->options & CONVERSATION_TEMPLATE) || conv->retired)
+		return;
 
-	/*
-	 * Are the first and second port 1 values the same and the first
-	 * and second address 1 values the same?
-	 */
-	if (v1->port1 == v2->port1 &&
-	    addresses_equal(&v1->addr1, &v2->addr1)) {
-		/*
-		 * Yes.  It's the same conversation, and the two
-		 * address/port pairs are going in the same direction.
-		 */
-		return 1;
+	list = conversation_idle_list_for(conv);
+	if (list->tail != conv) {
+		if (conversation_on_idle_list(conv))
+			conversation_idle_list_remove(list, conv);
+		conversation_idle_list_append(list, conv);
 	}
-
-	/*
-	 * The addresses or the ports don't match.
-	 */
-	return 0;
+	conv->last_time = retire_now;
 }
 
-/**
- * Create a new hash tables for conversations.
- */
-void
-conversation_init(void)
-{
-	/*
-	 * Free up any space allocated for conversation protocol data
-	 * areas.
-	 *
-	 * We can free the space, as the structures it contains are
-	 * pointed to by conversation data structures that were freed
-	 * above.
-	 */
-	conversation_hashtable_exact =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_exact,
-	      conversation_match_exact);
-	conversation_hashtable_no_addr2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2,
-	      conversation_match_no_addr2);
-	conversation_hashtable_no_port2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_port2,
-	      conversation_match_no_port2);
-	conversation_hashtable_no_addr2_or_port2 =
-	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2_or_port2,
-	      conversation_match_no_addr2_or_port2);
-
-}
-
-/**
- * Initialize some variables every time a file is loaded or re-loaded.
+/*
+ * Get the hash table key for a conversation.
  */
-void conversation_epan_reset(void)
+static void
+conversation_flow_key(flow_key_t *key, const conversation_t *conv)
 {
-	/*
-	 * Start the conversation indices over at 0.
-	 */
-	new_index = 0;
+	flow_address_init(&key->addr1, &conv->key_ptr->addr1);
+	flow_address_init(&key->addr2, &conv->key_ptr->addr2);
+	key->etype = conv->key_ptr->etype;
+	key->port1 = conv->key_ptr->port1;
+	key->port2 = conv->key_ptr->port2;
 }
 
 /*
@@ -489,17 +388,19 @@ void conversation_epan_reset(void)
  * Mostly adapted from the old conversation_new().
  */
 static void
-conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
+conversation_insert_into_hashtable(flow_table_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *chain_tail, *cur, *prev;
+	flow_key_t key;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
+	conversation_flow_key(&key, conv);
+	chain_head = (conversation_t *)flow_table_lookup(hashtable, &key);
 
 	if (NULL==chain_head) {
 		/* New entry */
 		conv->next = NULL;
 		conv->last = conv;
-		wmem_map_insert(hashtable, conv->key_ptr, conv);
+		flow_table_insert(hashtable, &key, conv);
 		DPRINT(("created a new conversation chain"));
 	}
 	else {
@@ -528,7 +429,7 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 				conv->next = chain_head;
 				conv->last = chain_tail;
 				chain_head->last = NULL;
-				wmem_map_insert(hashtable, conv->key_ptr, conv);
+				flow_table_insert(hashtable, &key, conv);
 			}
 			else {
 				/* Inserting into the middle of the chain */
@@ -545,20 +446,20 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
  * taking into account ordering and hash chains and all that good stuff.
  */
 static void
-conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
+conversation_remove_from_hashtable(flow_table_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *cur, *prev;
+	flow_key_t key;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
+	conversation_flow_key(&key, conv);
+	chain_head = (conversation_t *)flow_table_lookup(hashtable, &key);
 
 	if (conv == chain_head) {
 		/* We are currently the front of the chain */
 		if (NULL == conv->next) {
 			/* We are the only conversation in the chain, no need to
-			 * update next pointer, but do not call
-			 * wmem_map_remove() either because the conv data
-			 * will be re-inserted. */
-			wmem_map_steal(hashtable, conv->key_ptr);
+			 * update next pointer. */
+			flow_table_remove(hashtable, &key);
 		}
 		else {
 			/* Update the head of the chain */
@@ -570,7 +471,10 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 			else
 				chain_head->latest_found = conv->latest_found;
 
-			wmem_map_insert(hashtable, chain_head->key_ptr, chain_head);
+			/* Replace the entry with one keyed by the new head's
+			 * key rather than ours, which may be changed or freed. */
+			conversation_flow_key(&key, chain_head);
+			flow_table_insert(hashtable, &key, chain_head);
 		}
 	}
 	else {
@@ -616,7 +520,7 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	DISSECTOR_ASSERT(!(options | CONVERSATION_TEMPLATE) || ((options | (NO_ADDR2 | NO_PORT2 | NO_PORT2_FORCE))) &&
 				"A conversation template may not be constructed without wildcard options");
 */
-	wmem_map_t* hashtable;
+	flow_table_t* hashtable;
 	conversation_t *conversation=NULL;
 	conversation_key_t new_key;
 
@@ -708,19 +612,7 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	}
 #endif
 
-	if (options & NO_ADDR2) {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_addr2_or_port2;
-		} else {
-			hashtable = conversation_hashtable_no_addr2;
-		}
-	} else {
-		if (options & (NO_PORT2|NO_PORT2_FORCE)) {
-			hashtable = conversation_hashtable_no_port2;
-		} else {
-			hashtable = conversation_hashtable_exact;
-		}
-	}
+	hashtable = conversation_hashtable_for_options(options);
 
 	new_key = wmem_new(wmem_file_scope(), struct conversation_key);
 	if (addr1 != NULL) {
@@ -751,11 +643,14 @@ conversation_new(const guint32 setup_frame, const address *addr1, const address
 	conversation->key_ptr = new_key;
 
 	new_index++;
+	n_conversations++;
 
 	DINDENT();
 	conversation_insert_into_hashtable(hashtable, conversation);
 	DENDENT();
 
+	conversation_touch(conversation);
+
 	return conversation;
 }
 
@@ -778,9 +673,11 @@ conversation_set_port2(conversation_t *conv, const guint32 port)
 	DPRINT(("called for port=%d", port));
 
 	/*
-	 * If the port 2 value is not wildcarded, don't set it.
+	 * If the port 2 value is not wildcarded, don't set it, and don't
+	 * put a retired conversation back in the tables.
 	 */
-	if ((!(conv->options & NO_PORT2)) || (conv->options & NO_PORT2_FORCE))
+	if ((!(conv->options & NO_PORT2)) || (conv->options & NO_PORT2_FORCE) ||
+	    conv->retired)
 		return;
 
 	DINDENT();
@@ -815,9 +712,10 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
 	wmem_free(NULL, addr_str);
 
 	/*
-	 * If the address 2 value is not wildcarded, don't set it.
+	 * If the address 2 value is not wildcarded, don't set it, and don't
+	 * put a retired conversation back in the tables.
 	 */
-	if (!(conv->options & NO_ADDR2))
+	if (!(conv->options & NO_ADDR2) || conv->retired)
 		return;
 
 	DINDENT();
@@ -841,33 +739,22 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
  * {addr1, port1, addr2, port2} and set up before frame_num.
  */
 static conversation_t *
-conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, const address *addr1, const address *addr2,
+conversation_lookup_hashtable(flow_table_t *hashtable, const guint32 frame_num,
+    const flow_address_t *addr1, const flow_address_t *addr2,
     const endpoint_type etype, const guint32 port1, const guint32 port2)
 {
 	conversation_t* convo=NULL;
 	conversation_t* match=NULL;
 	conversation_t* chain_head=NULL;
-	struct conversation_key key;
+	flow_key_t key;
 
-	/*
-	 * We don't make a copy of the address data, we just copy the
-	 * pointer to it, as "key" disappears when we return.
-	 */
-	if (addr1 != NULL) {
-		key.addr1 = *addr1;
-	} else {
-		clear_address(&key.addr1);
-	}
-	if (addr2 != NULL) {
-		key.addr2 = *addr2;
-	} else {
-		clear_address(&key.addr2);
-	}
+	key.addr1 = *addr1;
+	key.addr2 = *addr2;
 	key.etype = etype;
 	key.port1 = port1;
 	key.port2 = port2;
 
-	chain_head = (conversation_t *)wmem_map_lookup(hashtable, &key);
+	chain_head = (conversation_t *)flow_table_lookup(hashtable, &key);
 
 	if (chain_head && (chain_head->setup_frame <= frame_num)) {
 		match = chain_head;
@@ -885,8 +772,10 @@ conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, co
 		}
 	}
 
-	if (match)
+	if (match) {
 		chain_head->latest_found = match;
+		conversation_touch(match);
+	}
 
 	return match;
 }
@@ -933,6 +822,13 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
     const guint32 port_a, const guint32 port_b, const guint options)
 {
 	conversation_t *conversation;
+	flow_address_t flow_a, flow_b;
+
+	/*
+	 * Hash the addresses once, for all of the lookups below.
+	 */
+	flow_address_init(&flow_a, addr_a);
+	flow_address_init(&flow_b, addr_b);
 
 	/*
 	 * First try an exact match, if we have two addresses and ports.
@@ -947,7 +843,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		    address_to_str(wmem_packet_scope(), addr_b), port_b));
 		conversation =
 		    conversation_lookup_hashtable(conversation_hashtable_exact,
-			frame_num, addr_a, addr_b, etype,
+			frame_num, &flow_a, &flow_b, etype,
 			port_a, port_b);
 		/* Didn't work, try the other direction */
 		if (conversation == NULL) {
@@ -956,7 +852,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    address_to_str(wmem_packet_scope(), addr_a), port_a));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_exact,
-				frame_num, addr_b, addr_a, etype,
+				frame_num, &flow_b, &flow_a, etype,
 				port_b, port_a);
 		}
 		if ((conversation == NULL) && (addr_a->type == AT_FC)) {
@@ -968,7 +864,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    address_to_str(wmem_packet_scope(), addr_a), port_b));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_exact,
-				frame_num, addr_b, addr_a, etype,
+				frame_num, &flow_b, &flow_a, etype,
 				port_a, port_b);
 		}
 		DPRINT(("exact match %sfound",conversation?"":"not "));
@@ -995,7 +891,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		    port_b));
 		conversation =
 		    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
-			frame_num, addr_a, addr_b, etype, port_a, port_b);
+			frame_num, &flow_a, &flow_b, etype, port_a, port_b);
 		if ((conversation == NULL) && (addr_a->type == AT_FC)) {
 			/* In Fibre channel, OXID & RXID are never swapped as
 			 * TCP/UDP ports are in TCP/IP.
@@ -1005,7 +901,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    port_b));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
-				frame_num, addr_b, addr_a, etype,
+				frame_num, &flow_b, &flow_a, etype,
 				port_a, port_b);
 		}
 		if (conversation != NULL) {
@@ -1052,7 +948,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    port_a));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_addr2,
-				frame_num, addr_b, addr_a, etype, port_b, port_a);
+				frame_num, &flow_b, &flow_a, etype, port_b, port_a);
 			if (conversation != NULL) {
 				/*
 				 * If this is for a connection-oriented
@@ -1098,7 +994,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 		    address_to_str(wmem_packet_scope(), addr_b)));
 		conversation =
 		    conversation_lookup_hashtable(conversation_hashtable_no_port2,
-			frame_num, addr_a, addr_b, etype, port_a, port_b);
+			frame_num, &flow_a, &flow_b, etype, port_a, port_b);
 		if ((conversation == NULL) && (addr_a->type == AT_FC)) {
 			/* In Fibre channel, OXID & RXID are never swapped as
 			 * TCP/UDP ports are in TCP/IP
@@ -1108,7 +1004,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    address_to_str(wmem_packet_scope(), addr_a)));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_port2,
-				frame_num, addr_b, addr_a, etype, port_a, port_b);
+				frame_num, &flow_b, &flow_a, etype, port_a, port_b);
 		}
 		if (conversation != NULL) {
 			/*
@@ -1154,7 +1050,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    address_to_str(wmem_packet_scope(), addr_a)));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_port2,
-				frame_num, addr_b, addr_a, etype, port_b, port_a);
+				frame_num, &flow_b, &flow_a, etype, port_b, port_a);
 			if (conversation != NULL) {
 				/*
 				 * If this is for a connection-oriented
@@ -1194,7 +1090,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 	    address_to_str(wmem_packet_scope(), addr_a), port_a));
 	conversation =
 	    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
-		frame_num, addr_a, addr_b, etype, port_a, port_b);
+		frame_num, &flow_a, &flow_b, etype, port_a, port_b);
 	if (conversation != NULL) {
 		/*
 		 * If this is for a connection-oriented protocol:
@@ -1249,13 +1145,13 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 			    address_to_str(wmem_packet_scope(), addr_b), port_a));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
-				frame_num, addr_b, addr_a, etype, port_a, port_b);
+				frame_num, &flow_b, &flow_a, etype, port_a, port_b);
 		} else {
 			DPRINT(("trying wildcarded match: %s:%d -> *:*",
 			    address_to_str(wmem_packet_scope(), addr_b), port_b));
 			conversation =
 			    conversation_lookup_hashtable(conversation_hashtable_no_addr2_or_port2,
-				frame_num, addr_b, addr_a, etype, port_b, port_a);
+				frame_num, &flow_b, &flow_a, etype, port_b, port_a);
 		}
 		if (conversation != NULL) {
 			/*
@@ -1324,6 +1220,113 @@ conversation_delete_proto_data(conversation_t *conv, const int proto)
 		wmem_tree_remove32(conv->data_list, proto);
 }
 
+void
+conversation_register_retire_routine(const int proto, conversation_retire_func func)
+{
+	if (retire_routines == NULL)
+		retire_routines = wmem_map_new(wmem_epan_scope(), g_direct_hash, g_direct_equal);
+	wmem_map_insert(retire_routines, GINT_TO_POINTER(proto), (void *)func);
+}
+
+static void
+conversation_retire_proto_data(gpointer key, gpointer value, gpointer userdata)
+{
+	conversation_t *conv = (conversation_t *)userdata;
+	conversation_retire_func func = (conversation_retire_func)value;
+	void *proto_data;
+
+	proto_data = wmem_tree_lookup32(conv->data_list, GPOINTER_TO_UINT(key));
+	if (proto_data != NULL && (*func)(conv, proto_data))
+		wmem_tree_remove32(conv->data_list, GPOINTER_TO_UINT(key));
+}
+
+/*
+ * Remove a conversation from its hash table and list, and hand the data
+ * of protocols with retire routines to those routines.  The conversation
+ * itself, and data that isn't freed, are left for the end of the file;
+ * see conversation_set_retire_timeouts().
+ */
+static void
+conversation_retire(conversation_t *conv)
+{
+	DPRINT(("retiring conversation %u set up in frame #%u (last_frame=%u)",
+			conv->conv_index, conv->setup_frame, conv->last_frame));
+
+	conversation_idle_list_remove(conversation_idle_list_for(conv), conv);
+	conversation_remove_from_hashtable(conversation_hashtable_for_options(conv->options), conv);
+
+	conv->retired = TRUE;
+	n_conversations--;
+
+	if (conv->data_list != NULL && retire_routines != NULL)
+		wmem_map_foreach(retire_routines, conversation_retire_proto_data, conv);
+}
+
+static void
+conversation_retire_list(conversation_idle_list_t *list, const guint secs)
+{
+	nstime_t idle;
+
+	while (list->head != NULL) {
+		nstime_delta(&idle, &retire_now, &list->head->last_time);
+		if (idle.secs < (time_t)secs)
+			break;
+		conversation_retire(list->head);
+	}
+}
+
+void
+conversation_set_retire_timeouts(guint idle_secs, guint closed_secs)
+{
+	retire_idle_secs = idle_secs;
+	retire_closed_secs = closed_secs;
+}
+
+guint
+conversation_count(void)
+{
+	return n_conversations;
+}
+
+void
+conversation_set_closed(conversation_t *conv)
+{
+	/*
+	 * Without a timeout of its own, a closed conversation is
+	 * retired when it's been idle as long as any other.
+	 */
+	if (retire_closed_secs == 0 || conv->closed)
+		return;
+
+	if (conversation_on_idle_list(conv)) {
+		conversation_idle_list_remove(&open_conversations, conv);
+		conv->closed = TRUE;
+		conversation_idle_list_append(&closed_conversations, conv);
+	} else {
+		conv->closed = TRUE;
+	}
+}
+
+void
+conversation_retire_idle(const packet_info *pinfo)
+{
+	if (!conversation_retiring() || !(pinfo->presence_flags & PINFO_HAS_TS))
+		return;
+
+	/*
+	 * Time stamps can go backwards a little, such as when a capture
+	 * comes from several interfaces; go by the latest, so that the
+	 * lists stay in order.
+	 */
+	if (nstime_is_unset(&retire_now) || nstime_cmp(&pinfo->abs_ts, &retire_now) > 0)
+		retire_now = pinfo->abs_ts;
+
+	if (retire_idle_secs != 0)
+		conversation_retire_list(&open_conversations, retire_idle_secs);
+	if (retire_closed_secs != 0)
+		conversation_retire_list(&closed_conversations, retire_closed_secs);
+}
+
 void
 conversation_set_dissector_from_frame_number(conversation_t *conversation,
 	const guint32 starting_frame_num, const dissector_handle_t handle)
@@ -1563,30 +1566,47 @@ guint32 conversation_get_endpoint_by_id(struct _packet_info *pinfo, endpoint_typ
 	return pinfo->conv_endpoint->port1;
 }
 
-wmem_map_t *
+conversation_hashtable_t *
 get_conversation_hashtable_exact(void)
 {
 	return conversation_hashtable_exact;
 }
 
-wmem_map_t *
+conversation_hashtable_t *
 get_conversation_hashtable_no_addr2(void)
 {
 	return conversation_hashtable_no_addr2;
 }
 
-wmem_map_t *
+conversation_hashtable_t *
 get_conversation_hashtable_no_port2(void)
 {
 	return conversation_hashtable_no_port2;
 }
 
-wmem_map_t *
+conversation_hashtable_t *
 get_conversation_hashtable_no_addr2_or_port2(void)
 {
 	return conversation_hashtable_no_addr2_or_port2;
 }
 
+static void
+conversation_hashtable_add_key(gpointer data, gpointer user_data)
+{
+	wmem_list_append((wmem_list_t *)user_data, ((conversation_t *)data)->key_ptr);
+}
+
+wmem_list_t *
+conversation_hashtable_get_keys(wmem_allocator_t *allocator, conversation_hashtable_t *hashtable)
+{
+	wmem_list_t *keys;
+
+	keys = wmem_list_new(allocator);
+	flow_table_foreach(hashtable, conversation_hashtable_add_key, keys);
+
+	return keys;
+}
+
 address*
 conversation_key_addr1(const conversation_key_t key)
 {
@@ -100,6 +100,11 @@ typedef struct conversation {
 								/** tree containing protocol dissector client associated with conversation */
 	guint	options;			/** wildcard flags */
 	conversation_key_t key_ptr;	/** pointer to the key for this conversation */
+	struct conversation *idle_prev;	/** previous, less recently active, conversation when retiring idle ones */
+	struct conversation *idle_next;	/** next, more recently active, conversation when retiring idle ones */
+	nstime_t last_time;		/** time stamp of the latest frame in this conversation when retiring idle ones */
+	gboolean closed;		/** TRUE if conversation_set_closed() has been called */
+	gboolean retired;		/** TRUE if it's been retired, and is no longer in the hash tables */
 } conversation_t;
 
 
@@ -199,6 +204,70 @@ WS_DLL_PUBLIC void conversation_add_proto_data(conversation_t *conv, const int p
 WS_DLL_PUBLIC void *conversation_get_proto_data(const conversation_t *conv, const int proto);
 WS_DLL_PUBLIC void conversation_delete_proto_data(conversation_t *conv, const int proto);
 
+/**
+ * Function called for a protocol's data in a conversation that's being
+ * retired; it can add up what it has to say about the conversation, and
+ * free the data.  It returns TRUE if it freed the data, which is then
+ * removed from the conversation, or FALSE to leave it in place.
+ */
+typedef gboolean (*conversation_retire_func)(conversation_t *conv, void *proto_data);
+
+/**
+ * Register the routine to call for the protocol's data in conversations
+ * that are retired; see conversation_set_retire_timeouts().  Data of a
+ * protocol with no such routine is left in place until the end of the
+ * file, as there's no telling what else refers to it; so far only TCP
+ * has one.
+ */
+WS_DLL_PUBLIC void conversation_register_retire_routine(const int proto,
+    conversation_retire_func func);
+
+/**
+ * Retire conversations that have seen no frames for idle_secs seconds, and
+ * ones that conversation_set_closed() has been called for that have seen
+ * none for closed_secs seconds, going by the time stamps of the frames
+ * dissected.  0 means never.
+ *
+ * A retired conversation is removed from the hash tables, so they, and
+ * the time it takes to look up a conversation, stay proportional to the
+ * number of active conversations, and the routines registered with
+ * conversation_register_retire_routine() are called to free their
+ * protocols' data.  That's the bulk of what's kept for a TCP connection.
+ *
+ * The rest is not freed until the end of the file, so memory use still
+ * grows with the total number of conversations, if more slowly: the
+ * conversation_t, with its key and dissector table, a few hundred bytes
+ * in all, as dissectors may still hold pointers to it, such as DCE/RPC's
+ * tables of binds and calls keyed by conversation; and the data of
+ * protocols without a retire routine.  A retired conversation is marked
+ * as such; nothing finds it any more, and it isn't put back in the hash
+ * tables if its port 2 or address 2 is set.
+ *
+ * This is only for programs that dissect each frame once, in order, and
+ * never go back to an earlier one, such as TShark doing a single pass;
+ * a frame of a retired conversation that's seen again starts a new one.
+ */
+WS_DLL_PUBLIC void conversation_set_retire_timeouts(guint idle_secs, guint closed_secs);
+
+/**
+ * The number of conversations that have been created for the current
+ * file and haven't been retired.
+ */
+WS_DLL_PUBLIC guint conversation_count(void);
+
+/**
+ * Note that the connection a conversation is for has been closed, such as
+ * by a TCP FIN in each direction, or a TCP RST, so that it can be retired
+ * sooner than other idle ones.
+ */
+WS_DLL_PUBLIC void conversation_set_closed(conversation_t *conv);
+
+/**
+ * Retire the conversations that have been idle for too long as of the
+ * frame that's about to be dissected; called before dissecting each frame.
+ */
+WS_DLL_PUBLIC void conversation_retire_idle(const packet_info *pinfo);
+
 WS_DLL_PUBLIC void conversation_set_dissector(conversation_t *conversation,
     const dissector_handle_t handle);
 
@@ -243,17 +312,25 @@ void conversation_set_port2(conversation_t *conv, const guint32 port);
 WS_DLL_PUBLIC
 void conversation_set_addr2(conversation_t *conv, const address *addr);
 
+/* The hash tables the conversations are kept in, for showing them */
+typedef struct _flow_table conversation_hashtable_t;
+
+WS_DLL_PUBLIC
+conversation_hashtable_t *get_conversation_hashtable_exact(void);
+
 WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_exact(void);
+conversation_hashtable_t *get_conversation_hashtable_no_addr2(void);
 
 WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_no_addr2(void);
+conversation_hashtable_t * get_conversation_hashtable_no_port2(void);
 
 WS_DLL_PUBLIC
-wmem_map_t * get_conversation_hashtable_no_port2(void);
+conversation_hashtable_t *get_conversation_hashtable_no_addr2_or_port2(void);
 
+/* Get the keys of the conversations in a hash table, in a list
+   allocated with the given allocator */
 WS_DLL_PUBLIC
-wmem_map_t *get_conversation_hashtable_no_addr2_or_port2(void);
+wmem_list_t *conversation_hashtable_get_keys(wmem_allocator_t *allocator, conversation_hashtable_t *hashtable);
 
 /* Temporary function to handle port_type to endpoint_type conversion
    For now it's a 1-1 mapping, but the intention is to remove
@@ -0,0 +1,194 @@
+/* conversation_test.c
+ * Standalone program to test retiring idle conversations.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include <wiretap/wtap.h>
+#include <epan/epan.h>
+#include <epan/packet.h>
+#include <epan/conversation.h>
+
+/* Not real protocols; conversation data is keyed by any int. */
+#define TEST_PROTO_RETIRED  100001
+#define TEST_PROTO_KEPT     100002
+
+#define TEST_PORT_B         80
+
+static const guint8 test_addr_a[] = { 10, 0, 0, 1 };
+static const guint8 test_addr_b[] = { 192, 168, 0, 1 };
+
+static guint test_retired_data;
+
+static gboolean
+test_retire_routine(conversation_t *conv _U_, void *proto_data)
+{
+    g_assert_cmpuint(GPOINTER_TO_UINT(proto_data), !=, 0);
+    test_retired_data++;
+    return TRUE;
+}
+
+/* Start dissecting a frame of the given time, retiring idle conversations. */
+static void
+test_frame(packet_info *pinfo, guint32 frame, time_t secs)
+{
+    memset(pinfo, 0, sizeof *pinfo);
+    pinfo->num = frame;
+    pinfo->presence_flags = PINFO_HAS_TS;
+    pinfo->abs_ts.secs = secs;
+    conversation_retire_idle(pinfo);
+}
+
+static conversation_t *
+test_find_flow(guint32 frame, guint32 port_a)
+{
+    address addr_a, addr_b;
+
+    set_address(&addr_a, AT_IPv4, 4, test_addr_a);
+    set_address(&addr_b, AT_IPv4, 4, test_addr_b);
+    return find_conversation(frame, &addr_a, &addr_b, ENDPOINT_TCP,
+                             port_a, TEST_PORT_B, 0);
+}
+
+static conversation_t *
+test_new_flow(guint32 frame, guint32 port_a)
+{
+    address addr_a, addr_b;
+    conversation_t *conv;
+
+    set_address(&addr_a, AT_IPv4, 4, test_addr_a);
+    set_address(&addr_b, AT_IPv4, 4, test_addr_b);
+    conv = conversation_new(frame, &addr_a, &addr_b, ENDPOINT_TCP,
+                            port_a, TEST_PORT_B, 0);
+    conversation_add_proto_data(conv, TEST_PROTO_RETIRED, GUINT_TO_POINTER(frame));
+    conversation_add_proto_data(conv, TEST_PROTO_KEPT, GUINT_TO_POINTER(frame));
+    return conv;
+}
+
+/*
+ * A long run of short flows, a new one each second, each seeing a frame
+ * a second later, leaves only the ones from the last idle period.
+ */
+static void
+conversation_test_retire_idle(void)
+{
+    static const struct packet_provider_funcs funcs = { NULL, NULL, NULL, NULL };
+    const guint n_flows = 100000, idle_secs = 10;
+    epan_t *session;
+    packet_info pinfo;
+    conversation_t *first = NULL, *conv;
+    guint i, max_count = 0;
+
+    session = epan_new(NULL, &funcs);
+    conversation_set_retire_timeouts(idle_secs, 0);
+    test_retired_data = 0;
+
+    for (i = 0; i < n_flows; i++) {
+        test_frame(&pinfo, 2 * i + 1, i);
+        conv = test_new_flow(pinfo.num, 1024 + i);
+        if (first == NULL)
+            first = conv;
+
+        test_frame(&pinfo, 2 * i + 2, i + 1);
+        g_assert_true(test_find_flow(pinfo.num, 1024 + i) == conv);
+
+        max_count = MAX(max_count, conversation_count());
+    }
+    g_assert_cmpuint(max_count, <=, idle_secs + 2);
+    g_assert_cmpuint(test_retired_data, ==, n_flows - conversation_count());
+
+    /* The retired flows can't be found; the latest can. */
+    g_assert_null(test_find_flow(2 * n_flows + 1, 1024));
+    g_assert_nonnull(test_find_flow(2 * n_flows + 1, 1024 + n_flows - 1));
+
+    /* Data with a retire routine is gone; other data is left alone. */
+    g_assert_true(first->retired);
+    g_assert_null(conversation_get_proto_data(first, TEST_PROTO_RETIRED));
+    g_assert_cmpuint(GPOINTER_TO_UINT(conversation_get_proto_data(first, TEST_PROTO_KEPT)), ==, 1);
+
+    conversation_set_retire_timeouts(0, 0);
+    epan_free(session);
+}
+
+/*
+ * Closed conversations go after their own, shorter, timeout, and a
+ * frame of a retired one starts a new one.
+ */
+static void
+conversation_test_retire_closed(void)
+{
+    static const struct packet_provider_funcs funcs = { NULL, NULL, NULL, NULL };
+    epan_t *session;
+    packet_info pinfo;
+    conversation_t *open_conv, *closed_conv, *conv;
+
+    session = epan_new(NULL, &funcs);
+    conversation_set_retire_timeouts(60, 5);
+
+    test_frame(&pinfo, 1, 0);
+    open_conv = test_new_flow(pinfo.num, 1024);
+    closed_conv = test_new_flow(pinfo.num, 1025);
+    conversation_set_closed(closed_conv);
+    g_assert_cmpuint(conversation_count(), ==, 2);
+
+    test_frame(&pinfo, 2, 10);
+    g_assert_cmpuint(conversation_count(), ==, 1);
+    g_assert_true(test_find_flow(pinfo.num, 1024) == open_conv);
+    g_assert_null(test_find_flow(pinfo.num, 1025));
+
+    conv = test_new_flow(pinfo.num, 1025);
+    g_assert_true(conv != closed_conv);
+    g_assert_true(test_find_flow(pinfo.num, 1025) == conv);
+    g_assert_cmpuint(conversation_count(), ==, 2);
+
+    test_frame(&pinfo, 3, 100);
+    g_assert_cmpuint(conversation_count(), ==, 0);
+
+    conversation_set_retire_timeouts(0, 0);
+    epan_free(session);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/conversation/retire/idle",   conversation_test_retire_idle);
+    g_test_add_func("/conversation/retire/closed", conversation_test_retire_closed);
+
+    wtap_init(FALSE);
+    if (!epan_init(NULL, NULL, FALSE))
+        return 2;
+    conversation_register_retire_routine(TEST_PROTO_RETIRED, test_retire_routine);
+
+    result = g_test_run();
+
+    epan_cleanup();
+    wtap_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -11,6 +11,7 @@
 
 #include "dfilter.h"
 #include "syntax-tree.h"
+#include "prefilter.h"
 
 #include <epan/proto.h>
 #include <stdio.h>
@@ -27,6 +28,7 @@ struct epan_dfilter {
 	int		*interesting_fields;
 	int		num_interesting_fields;
 	GPtrArray	*deprecated;
+	df_prefilter_t	*prefilter;
 };
 
 typedef struct {
@@ -42,6 +44,9 @@ typedef struct {
 	int		next_const_id;
 	int		next_register;
 	int		first_constant; /* first register used as a constant */
+	gboolean	specialize;	/* generate FIELD_TEST where possible */
+	gboolean	allow_file_sets; /* DF_ALLOW_FILE_SETS */
+	GPtrArray	*set_files;	/* names of files set elements were read from */
 } dfwork_t;
 
 /*
@@ -15,6 +15,7 @@
 #include "syntax-tree.h"
 #include "gencode.h"
 #include "semcheck.h"
+#include "optimize.h"
 #include "dfvm.h"
 #include <epan/epan_dissect.h>
 #include "dfilter.h"
@@ -132,6 +133,7 @@ dfilter_free(dfilter_t *df)
 	}
 
 	g_free(df->interesting_fields);
+	df_prefilter_free(df->prefilter);
 
 	/* Clear registers with constant values (as set by dfvm_init_const).
 	 * Other registers were cleared on RETURN by free_register_overhead. */
@@ -188,6 +190,10 @@ dfwork_free(dfwork_t *dfw)
 		free_insns(dfw->consts);
 	}
 
+	if (dfw->set_files) {
+		g_ptr_array_free(dfw->set_files, TRUE);
+	}
+
 	/*
 	 * We don't free the error message string; our caller will return
 	 * it to its caller.
@@ -195,8 +201,9 @@ dfwork_free(dfwork_t *dfw)
 	g_free(dfw);
 }
 
-gboolean
-dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
+static gboolean
+dfilter_compile_real(const gchar *text, dfilter_t **dfp, gchar **err_msg,
+    gboolean optimize, guint flags)
 {
 	gchar		*expanded_text;
 	int		token;
@@ -210,6 +217,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 	guint		i;
 	/* XXX, GHashTable */
 	GPtrArray	*deprecated;
+	df_prefilter_t	*prefilter = NULL;
 
 	g_assert(dfp);
 
@@ -236,6 +244,7 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 	in_buffer = df__scan_string(expanded_text, scanner);
 
 	dfw = dfwork_new();
+	dfw->allow_file_sets = (flags & DF_ALLOW_FILE_SETS) != 0;
 
 	state.dfw = dfw;
 	state.quoted_string = NULL;
@@ -333,13 +342,25 @@ dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
 			goto FAILURE;
 		}
 
+		/* Simplify and reorder tests */
+		if (optimize)
+			dfw_optimize(dfw);
+
+		/* Find conditions on the frame's bytes to check before
+		 * dissecting it; code generation takes over constants and
+		 * slices from the tree, so do this first. */
+		if (optimize)
+			prefilter = df_prefilter_new(dfw->st_root);
+
 		/* Create bytecode */
+		dfw->specialize = optimize;
 		dfw_gencode(dfw);
 
 		/* Tuck away the bytecode in the dfilter_t */
 		dfilter = dfilter_new();
 		dfilter->insns = dfw->insns;
 		dfilter->consts = dfw->consts;
+		dfilter->prefilter = prefilter;
 		dfw->insns = NULL;
 		dfw->consts = NULL;
 		dfilter->interesting_fields = dfw_interesting_fields(dfw,
@@ -396,6 +417,26 @@ FAILURE:
 	return FALSE;
 }
 
+gboolean
+dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg)
+{
+	return dfilter_compile_real(text, dfp, err_msg, TRUE, 0);
+}
+
+gboolean
+dfilter_compile_flags(const gchar *text, dfilter_t **dfp, gchar **err_msg,
+    guint flags)
+{
+	return dfilter_compile_real(text, dfp, err_msg, TRUE, flags);
+}
+
+gboolean
+dfilter_compile_unoptimized(const gchar *text, dfilter_t **dfp, gchar **err_msg,
+    guint flags)
+{
+	return dfilter_compile_real(text, dfp, err_msg, FALSE, flags);
+}
+
 
 gboolean
 dfilter_apply(dfilter_t *df, proto_tree *tree)
@@ -426,6 +467,20 @@ dfilter_has_interesting_fields(const dfilter_t *df)
 	return (df->num_interesting_fields > 0);
 }
 
+gboolean
+dfilter_has_prefilter(const dfilter_t *df)
+{
+	return df->prefilter != NULL;
+}
+
+gboolean
+dfilter_prefilter_data(const dfilter_t *df, const guint8 *data, guint len)
+{
+	if (df->prefilter == NULL)
+		return TRUE;
+	return df_prefilter_apply(df->prefilter, data, len);
+}
+
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df) {
 	if (df->deprecated && df->deprecated->len > 0) {
@@ -442,6 +497,12 @@ dfilter_dump(dfilter_t *df)
 
 	dfvm_dump(stdout, df);
 
+	if (df->prefilter) {
+		ws_debug_printf("\nPrefilter: ");
+		df_prefilter_dump(stdout, df->prefilter);
+		ws_debug_printf("\n");
+	}
+
 	if (df->deprecated && df->deprecated->len) {
 		ws_debug_printf("\nDeprecated tokens: ");
 		for (i = 0; i < df->deprecated->len; i++) {
@@ -49,6 +49,26 @@ WS_DLL_PUBLIC
 gboolean
 dfilter_compile(const gchar *text, dfilter_t **dfp, gchar **err_msg);
 
+/* Flags for dfilter_compile_flags() */
+#define DF_ALLOW_FILE_SETS	0x01	/* "field in @file" may read the set
+					 * elements in a file; only for filters
+					 * given by the user running the program */
+
+/* As dfilter_compile(), but allowing what the flags say. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_compile_flags(const gchar *text, dfilter_t **dfp, gchar **err_msg,
+    guint flags);
+
+/* As dfilter_compile_flags(), but without simplifying or reordering the
+ * tests in the filter before generating code for it, and without
+ * specialized comparisons of fields against constants; for comparing
+ * the code with and without those optimizations. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_compile_unoptimized(const gchar *text, dfilter_t **dfp, gchar **err_msg,
+    guint flags);
+
 /* Frees all memory used by dfilter, and frees
  * the dfilter itself. */
 WS_DLL_PUBLIC
@@ -72,6 +92,20 @@ dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree);
 gboolean
 dfilter_has_interesting_fields(const dfilter_t *df);
 
+/* Check if dfilter has conditions on the raw bytes of a frame, from
+ * "frame contains ..." or "frame[...] == ..." tests that must match for
+ * the filter to match. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_has_prefilter(const dfilter_t *df);
+
+/* Check the raw bytes of a frame against those conditions, before
+ * dissecting it.  Returns FALSE if the filter can't match the frame,
+ * TRUE if it might. */
+WS_DLL_PUBLIC
+gboolean
+dfilter_prefilter_data(const dfilter_t *df, const guint8 *data, guint len);
+
 WS_DLL_PUBLIC
 GPtrArray *
 dfilter_deprecated_tokens(dfilter_t *df);
@@ -0,0 +1,450 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfset.h"
+#include "syntax-tree.h"
+#include <ftypes/ftypes-int.h>
+
+typedef enum {
+	DFSET_UINT,
+	DFSET_SINT,
+	DFSET_UINT64,
+	DFSET_SINT64,
+	DFSET_IPV4,
+	DFSET_STRING,
+	DFSET_BYTES,
+	DFSET_IPV6
+} dfset_kind_t;
+
+typedef struct {
+	guint64		lower;
+	guint64		upper;
+} dfset_range_t;
+
+typedef struct {
+	const guint8	*data;
+	gsize		len;
+} dfset_key_t;
+
+struct _dfset {
+	dfset_kind_t	kind;
+
+	/*
+	 * The elements as given, in pairs of (value, NULL) or (lower, upper),
+	 * for fields whose values can't be looked up in the table, e.g. an
+	 * IPv4 address with a netmask.
+	 */
+	GPtrArray	*elements;
+
+	/* Integers and IPv4 addresses. */
+	dfset_range_t	*ranges;
+	guint		num_ranges;
+
+	/* Strings, byte strings and IPv6 addresses. */
+	GHashTable	*table;
+};
+
+#define SIGN_BIT	G_GUINT64_CONSTANT(0x8000000000000000)
+
+static gboolean
+kind_for_ftype(ftenum_t ftype, dfset_kind_t *kind)
+{
+	switch (ftype) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_IPXNET:
+		case FT_FRAMENUM:
+			*kind = DFSET_UINT;
+			return TRUE;
+
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+			*kind = DFSET_SINT;
+			return TRUE;
+
+		case FT_UINT40:
+		case FT_UINT48:
+		case FT_UINT56:
+		case FT_UINT64:
+			*kind = DFSET_UINT64;
+			return TRUE;
+
+		case FT_INT40:
+		case FT_INT48:
+		case FT_INT56:
+		case FT_INT64:
+			*kind = DFSET_SINT64;
+			return TRUE;
+
+		case FT_IPv4:
+			*kind = DFSET_IPV4;
+			return TRUE;
+
+		case FT_STRING:
+		case FT_STRINGZ:
+		case FT_UINT_STRING:
+		case FT_STRINGZPAD:
+			*kind = DFSET_STRING;
+			return TRUE;
+
+		case FT_BYTES:
+		case FT_UINT_BYTES:
+		case FT_AX25:
+		case FT_VINES:
+		case FT_ETHER:
+		case FT_OID:
+		case FT_REL_OID:
+		case FT_SYSTEM_ID:
+		case FT_FCWWN:
+			*kind = DFSET_BYTES;
+			return TRUE;
+
+		case FT_IPv6:
+			*kind = DFSET_IPV6;
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/*
+ * Map an integer onto an unsigned 64-bit key that sorts the same way,
+ * so all integer types can share one table layout.
+ */
+static guint64
+integer_key(dfset_kind_t kind, const fvalue_t *fv)
+{
+	switch (kind) {
+		case DFSET_UINT:
+			return fv->value.uinteger;
+		case DFSET_SINT:
+			return (guint64)(gint64)fv->value.sinteger ^ SIGN_BIT;
+		case DFSET_UINT64:
+			return fv->value.uinteger64;
+		case DFSET_SINT64:
+			return (guint64)fv->value.sinteger64 ^ SIGN_BIT;
+		case DFSET_IPV4:
+			return fv->value.ipv4.addr;
+		default:
+			g_assert_not_reached();
+			return 0;
+	}
+}
+
+static gboolean
+key_for_value(dfset_kind_t kind, const fvalue_t *fv, dfset_key_t *key)
+{
+	switch (kind) {
+		case DFSET_STRING:
+			key->data = (const guint8 *)fv->value.string;
+			key->len = strlen(fv->value.string);
+			return TRUE;
+		case DFSET_BYTES:
+			key->data = fv->value.bytes->data;
+			key->len = fv->value.bytes->len;
+			return TRUE;
+		case DFSET_IPV6:
+			/* Only whole addresses can be compared byte for byte. */
+			if (fv->value.ipv6.prefix < 128)
+				return FALSE;
+			key->data = fv->value.ipv6.addr.bytes;
+			key->len = sizeof fv->value.ipv6.addr.bytes;
+			return TRUE;
+		default:
+			g_assert_not_reached();
+			return FALSE;
+	}
+}
+
+static guint
+key_hash(gconstpointer k)
+{
+	const dfset_key_t	*key = (const dfset_key_t *)k;
+	guint			hash = 5381;
+	gsize			i;
+
+	for (i = 0; i < key->len; i++)
+		hash = (hash << 5) + hash + key->data[i];
+	return hash;
+}
+
+static gboolean
+key_equal(gconstpointer a, gconstpointer b)
+{
+	const dfset_key_t	*key_a = (const dfset_key_t *)a;
+	const dfset_key_t	*key_b = (const dfset_key_t *)b;
+
+	return key_a->len == key_b->len &&
+	    memcmp(key_a->data, key_b->data, key_a->len) == 0;
+}
+
+static int
+range_cmp(const void *a, const void *b)
+{
+	const dfset_range_t	*ra = (const dfset_range_t *)a;
+	const dfset_range_t	*rb = (const dfset_range_t *)b;
+
+	if (ra->lower != rb->lower)
+		return ra->lower < rb->lower ? -1 : 1;
+	return 0;
+}
+
+/* Sort the ranges and merge the ones that overlap or touch. */
+static void
+merge_ranges(dfset_t *set)
+{
+	guint	i, n;
+
+	if (set->num_ranges == 0)
+		return;
+
+	qsort(set->ranges, set->num_ranges, sizeof(dfset_range_t), range_cmp);
+
+	n = 0;
+	for (i = 1; i < set->num_ranges; i++) {
+		dfset_range_t *last = &set->ranges[n];
+
+		if (last->upper == G_MAXUINT64 || set->ranges[i].lower <= last->upper + 1) {
+			if (set->ranges[i].upper > last->upper)
+				last->upper = set->ranges[i].upper;
+		}
+		else {
+			set->ranges[++n] = set->ranges[i];
+		}
+	}
+	set->num_ranges = n + 1;
+}
+
+static gboolean
+add_element(dfset_t *set, fvalue_t *lower, fvalue_t *upper)
+{
+	dfset_kind_t	kind;
+	dfset_range_t	*range;
+	dfset_key_t	key, *new_key;
+
+	/* semcheck has converted the values to the type of the field. */
+	if (!kind_for_ftype(fvalue_type_ftenum(lower), &kind) || kind != set->kind)
+		return FALSE;
+	if (upper && (!kind_for_ftype(fvalue_type_ftenum(upper), &kind) || kind != set->kind))
+		return FALSE;
+
+	switch (set->kind) {
+		case DFSET_IPV4:
+			if (upper) {
+				/* A range between two networks isn't simple. */
+				if (lower->value.ipv4.nmask != G_MAXUINT32 ||
+				    upper->value.ipv4.nmask != G_MAXUINT32)
+					return FALSE;
+			}
+			else {
+				/* A network is the range of its addresses. */
+				range = &set->ranges[set->num_ranges++];
+				range->lower = lower->value.ipv4.addr & lower->value.ipv4.nmask;
+				range->upper = range->lower | (~lower->value.ipv4.nmask & G_MAXUINT32);
+				return TRUE;
+			}
+			/* FALL THROUGH */
+
+		case DFSET_UINT:
+		case DFSET_SINT:
+		case DFSET_UINT64:
+		case DFSET_SINT64:
+			range = &set->ranges[set->num_ranges++];
+			range->lower = integer_key(set->kind, lower);
+			range->upper = upper ? integer_key(set->kind, upper) : range->lower;
+			if (range->lower > range->upper) {
+				/* Empty */
+				set->num_ranges--;
+			}
+			return TRUE;
+
+		case DFSET_STRING:
+		case DFSET_BYTES:
+		case DFSET_IPV6:
+			if (upper || !key_for_value(set->kind, lower, &key))
+				return FALSE;
+			new_key = g_new(dfset_key_t, 1);
+			*new_key = key;
+			g_hash_table_add(set->table, new_key);
+			return TRUE;
+	}
+	g_assert_not_reached();
+	return FALSE;
+}
+
+dfset_t *
+dfset_new(header_field_info *hfinfo, GSList *nodelist)
+{
+	dfset_t			*set;
+	dfset_kind_t		kind, other_kind;
+	header_field_info	*same_name;
+	GSList			*l;
+	guint			num_elements;
+
+	if (!kind_for_ftype(hfinfo->type, &kind))
+		return NULL;
+
+	/* Fields with the same name have to be compared the same way. */
+	for (same_name = hfinfo->same_name_next; same_name;
+	    same_name = same_name->same_name_next) {
+		if (!kind_for_ftype(same_name->type, &other_kind) || other_kind != kind)
+			return NULL;
+	}
+
+	num_elements = g_slist_length(nodelist) / 2;
+
+	set = g_new0(dfset_t, 1);
+	set->kind = kind;
+	set->elements = g_ptr_array_sized_new(num_elements * 2);
+	switch (kind) {
+		case DFSET_STRING:
+		case DFSET_BYTES:
+		case DFSET_IPV6:
+			set->table = g_hash_table_new_full(key_hash, key_equal, g_free, NULL);
+			break;
+		default:
+			set->ranges = g_new(dfset_range_t, num_elements);
+			break;
+	}
+
+	for (l = nodelist; l; l = g_slist_next(g_slist_next(l))) {
+		stnode_t *lower = (stnode_t *)l->data;
+		stnode_t *upper = (stnode_t *)l->next->data;
+
+		if (!add_element(set, (fvalue_t *)stnode_data(lower),
+		    upper ? (fvalue_t *)stnode_data(upper) : NULL)) {
+			/* The values still belong to the nodes. */
+			g_ptr_array_free(set->elements, TRUE);
+			set->elements = NULL;
+			dfset_free(set);
+			return NULL;
+		}
+		g_ptr_array_add(set->elements, stnode_data(lower));
+		g_ptr_array_add(set->elements, upper ? stnode_data(upper) : NULL);
+	}
+	merge_ranges(set);
+
+	return set;
+}
+
+/* Compare the value with each element, for values that can't be looked up. */
+static gboolean
+contains_slow(const dfset_t *set, const fvalue_t *fv)
+{
+	guint	i;
+
+	for (i = 0; i < set->elements->len; i += 2) {
+		const fvalue_t *lower = (const fvalue_t *)g_ptr_array_index(set->elements, i);
+		const fvalue_t *upper = (const fvalue_t *)g_ptr_array_index(set->elements, i + 1);
+
+		if (upper) {
+			if (fvalue_ge(fv, lower) && fvalue_le(fv, upper))
+				return TRUE;
+		}
+		else if (fvalue_eq(fv, lower))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+gboolean
+dfset_contains(const dfset_t *set, const fvalue_t *fv)
+{
+	guint64		k;
+	guint		lo, hi, mid;
+	dfset_key_t	key;
+
+	switch (set->kind) {
+		case DFSET_IPV4:
+			if (fv->value.ipv4.nmask != G_MAXUINT32)
+				return contains_slow(set, fv);
+			/* FALL THROUGH */
+
+		case DFSET_UINT:
+		case DFSET_SINT:
+		case DFSET_UINT64:
+		case DFSET_SINT64:
+			k = integer_key(set->kind, fv);
+			/* Find the last range starting at or below k. */
+			lo = 0;
+			hi = set->num_ranges;
+			while (lo < hi) {
+				mid = lo + (hi - lo) / 2;
+				if (set->ranges[mid].lower <= k)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return lo > 0 && k <= set->ranges[lo - 1].upper;
+
+		case DFSET_STRING:
+		case DFSET_BYTES:
+		case DFSET_IPV6:
+			if (!key_for_value(set->kind, fv, &key))
+				return contains_slow(set, fv);
+			return g_hash_table_contains(set->table, &key);
+	}
+	g_assert_not_reached();
+	return FALSE;
+}
+
+void
+dfset_dump(FILE *f, const dfset_t *set)
+{
+	if (set->table) {
+		fprintf(f, "{%u values, hashed}", g_hash_table_size(set->table));
+	}
+	else {
+		fprintf(f, "{%u values in %u ranges, sorted}",
+			set->elements->len / 2, set->num_ranges);
+	}
+}
+
+void
+dfset_free(dfset_t *set)
+{
+	guint	i;
+
+	if (set->elements) {
+		for (i = 0; i < set->elements->len; i++) {
+			fvalue_t *fv = (fvalue_t *)g_ptr_array_index(set->elements, i);
+
+			if (fv)
+				FVALUE_FREE(fv);
+		}
+		g_ptr_array_free(set->elements, TRUE);
+	}
+	if (set->table)
+		g_hash_table_destroy(set->table);
+	g_free(set->ranges);
+	g_free(set);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
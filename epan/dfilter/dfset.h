@@ -0,0 +1,50 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef DFSET_H
+#define DFSET_H
+
+#include <stdio.h>
+
+#include <epan/proto.h>
+
+/*
+ * A lookup table for the constant elements of a set in a membership
+ * test, "field in {...}": sorted, merged ranges searched with a binary
+ * search for integers and IPv4 addresses, and a hash table for strings,
+ * byte strings and IPv6 addresses.
+ */
+typedef struct _dfset dfset_t;
+
+/* Sets with fewer elements than this are tested element by element. */
+#define DFSET_MIN_ELEMENTS	8
+
+/*
+ * Build a lookup table for the elements in nodelist, the data of an
+ * STTYPE_SET node whose elements are all STTYPE_FVALUE, to be compared
+ * with the field hfinfo, which must be the first field with its name.
+ *
+ * Returns NULL, without changing nodelist, if the field's type or the
+ * set's elements don't allow it; otherwise the table takes over the
+ * elements' values, and the nodes themselves can be freed.
+ */
+dfset_t *
+dfset_new(header_field_info *hfinfo, GSList *nodelist);
+
+/* Is the value of a field in the set? */
+gboolean
+dfset_contains(const dfset_t *set, const fvalue_t *fv);
+
+/* Print a one-line description of the table, for dfvm_dump(). */
+void
+dfset_dump(FILE *f, const dfset_t *set);
+
+void
+dfset_free(dfset_t *set);
+
+#endif
@@ -36,6 +36,9 @@ dfvm_value_free(dfvm_value_t *v)
 		case DRANGE:
 			drange_free(v->value.drange);
 			break;
+		case SET_TABLE:
+			dfset_free(v->value.set);
+			break;
 		default:
 			/* nothing */
 			;
@@ -83,6 +86,7 @@ dfvm_dump(FILE *f, dfilter_t *df)
 	dfvm_value_t	*arg3;
 	dfvm_value_t	*arg4;
 	char		*value_str;
+	char		*value_str2;
 	GSList		*range_list;
 	drange_node	*range_item;
 
@@ -119,6 +123,8 @@ dfvm_dump(FILE *f, dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case FIELD_TEST:
+			case FIELD_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -259,6 +265,34 @@ dfvm_dump(FILE *f, dfilter_t *df)
 					arg3->value.numeric);
 				break;
 
+			case FIELD_TEST:
+				value_str = fvalue_to_string_repr(NULL, arg3->value.fvalue,
+					FTREPR_DFILTER, BASE_NONE);
+				if (arg4) {
+					value_str2 = fvalue_to_string_repr(NULL, arg4->value.fvalue,
+						FTREPR_DFILTER, BASE_NONE);
+					fprintf(f, "%05d FIELD_TEST\t%s %s {%s..%s}\n",
+						id, arg1->value.hfinfo->abbrev,
+						arg2->value.field_test->name,
+						value_str, value_str2);
+					wmem_free(NULL, value_str2);
+				}
+				else {
+					fprintf(f, "%05d FIELD_TEST\t%s %s %s\n",
+						id, arg1->value.hfinfo->abbrev,
+						arg2->value.field_test->name,
+						value_str);
+				}
+				wmem_free(NULL, value_str);
+				break;
+
+			case FIELD_IN_SET:
+				fprintf(f, "%05d FIELD_IN_SET\t%s in ",
+					id, arg1->value.hfinfo->abbrev);
+				dfset_dump(f, arg2->value.set);
+				fprintf(f, "\n");
+				break;
+
 			case NOT:
 				fprintf(f, "%05d NOT\n", id);
 				break;
@@ -400,6 +434,261 @@ any_in_range(dfilter_t *df, int reg1, int reg2, int reg3)
 	return FALSE;
 }
 
+/*
+ * Specialized comparisons for FIELD_TEST.  These do what the ftype's
+ * cmp_* functions do, without the indirection.
+ */
+#define DEFINE_INTEGER_FIELD_TESTS(kind, member) \
+static gboolean \
+kind##_eq(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member == a->value.member; \
+} \
+static gboolean \
+kind##_ne(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member != a->value.member; \
+} \
+static gboolean \
+kind##_gt(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member > a->value.member; \
+} \
+static gboolean \
+kind##_ge(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member >= a->value.member; \
+} \
+static gboolean \
+kind##_lt(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member < a->value.member; \
+} \
+static gboolean \
+kind##_le(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return f->value.member <= a->value.member; \
+} \
+static gboolean \
+kind##_bitwise_and(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_) \
+{ \
+	return (f->value.member & a->value.member) != 0; \
+} \
+static gboolean \
+kind##_in_range(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b) \
+{ \
+	return f->value.member >= a->value.member && \
+	    f->value.member <= b->value.member; \
+} \
+static const dfvm_field_test_t kind##_field_tests[] = { \
+	{ "==", kind##_eq }, \
+	{ "!=", kind##_ne }, \
+	{ ">", kind##_gt }, \
+	{ ">=", kind##_ge }, \
+	{ "<", kind##_lt }, \
+	{ "<=", kind##_le }, \
+	{ "&", kind##_bitwise_and }, \
+	{ "in", kind##_in_range } \
+};
+
+DEFINE_INTEGER_FIELD_TESTS(uint, uinteger)
+DEFINE_INTEGER_FIELD_TESTS(sint, sinteger)
+DEFINE_INTEGER_FIELD_TESTS(uint64, uinteger64)
+DEFINE_INTEGER_FIELD_TESTS(sint64, sinteger64)
+
+/* IPv4 addresses compare under the shorter of the two netmasks. */
+#define IPV4_MASKED(f, a) \
+	guint32 nmask = MIN((f)->value.ipv4.nmask, (a)->value.ipv4.nmask); \
+	guint32 addr_f = (f)->value.ipv4.addr & nmask; \
+	guint32 addr_a = (a)->value.ipv4.addr & nmask
+
+static gboolean
+ipv4_eq(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f == addr_a;
+}
+
+static gboolean
+ipv4_ne(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f != addr_a;
+}
+
+static gboolean
+ipv4_gt(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f > addr_a;
+}
+
+static gboolean
+ipv4_ge(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f >= addr_a;
+}
+
+static gboolean
+ipv4_lt(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f < addr_a;
+}
+
+static gboolean
+ipv4_le(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	IPV4_MASKED(f, a);
+	return addr_f <= addr_a;
+}
+
+static gboolean
+ipv4_bitwise_and(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b _U_)
+{
+	return ((f->value.ipv4.addr & f->value.ipv4.nmask) &
+	    (a->value.ipv4.addr & a->value.ipv4.nmask)) != 0;
+}
+
+static gboolean
+ipv4_in_range(const fvalue_t *f, const fvalue_t *a, const fvalue_t *b)
+{
+	return ipv4_ge(f, a, NULL) && ipv4_le(f, b, NULL);
+}
+
+static const dfvm_field_test_t ipv4_field_tests[] = {
+	{ "==", ipv4_eq },
+	{ "!=", ipv4_ne },
+	{ ">", ipv4_gt },
+	{ ">=", ipv4_ge },
+	{ "<", ipv4_lt },
+	{ "<=", ipv4_le },
+	{ "&", ipv4_bitwise_and },
+	{ "in", ipv4_in_range }
+};
+
+static const dfvm_field_test_t *
+field_tests_for_ftype(ftenum_t ftype)
+{
+	switch (ftype) {
+		case FT_CHAR:
+		case FT_UINT8:
+		case FT_UINT16:
+		case FT_UINT24:
+		case FT_UINT32:
+		case FT_IPXNET:
+		case FT_FRAMENUM:
+			return uint_field_tests;
+
+		case FT_INT8:
+		case FT_INT16:
+		case FT_INT24:
+		case FT_INT32:
+			return sint_field_tests;
+
+		case FT_UINT40:
+		case FT_UINT48:
+		case FT_UINT56:
+		case FT_UINT64:
+			return uint64_field_tests;
+
+		case FT_INT40:
+		case FT_INT48:
+		case FT_INT56:
+		case FT_INT64:
+			return sint64_field_tests;
+
+		case FT_IPv4:
+			return ipv4_field_tests;
+
+		default:
+			return NULL;
+	}
+}
+
+const dfvm_field_test_t *
+dfvm_field_test_lookup(header_field_info *hfinfo, dfvm_opcode_t op)
+{
+	const dfvm_field_test_t	*tests;
+	int			index;
+
+	switch (op) {
+		case ANY_EQ:		index = 0; break;
+		case ANY_NE:		index = 1; break;
+		case ANY_GT:		index = 2; break;
+		case ANY_GE:		index = 3; break;
+		case ANY_LT:		index = 4; break;
+		case ANY_LE:		index = 5; break;
+		case ANY_BITWISE_AND:	index = 6; break;
+		case ANY_IN_RANGE:	index = 7; break;
+		default:
+			return NULL;
+	}
+
+	/*
+	 * The constant has been converted to the type of the first field
+	 * with this name; other fields with the same name have to be of
+	 * the same family of types for the comparison to mean the same.
+	 */
+	tests = field_tests_for_ftype(hfinfo->type);
+	if (tests == NULL)
+		return NULL;
+	for (hfinfo = hfinfo->same_name_next; hfinfo; hfinfo = hfinfo->same_name_next) {
+		if (field_tests_for_ftype(hfinfo->type) != tests)
+			return NULL;
+	}
+	return &tests[index];
+}
+
+/* Compares each occurrence of a field in the proto_tree against constants,
+ * without loading the values into a register first. */
+static gboolean
+field_test(proto_tree *tree, header_field_info *hfinfo, DFVMFieldTestFunc func,
+    const fvalue_t *arg1, const fvalue_t *arg2)
+{
+	GPtrArray	*finfos;
+	guint		i;
+
+	while (hfinfo) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		if (finfos) {
+			for (i = 0; i < finfos->len; i++) {
+				field_info *finfo = (field_info *)g_ptr_array_index(finfos, i);
+
+				if (func(&finfo->value, arg1, arg2)) {
+					return TRUE;
+				}
+			}
+		}
+		hfinfo = hfinfo->same_name_next;
+	}
+	return FALSE;
+}
+
+/* Looks up each occurrence of a field in the proto_tree in a set. */
+static gboolean
+field_in_set(proto_tree *tree, header_field_info *hfinfo, const dfset_t *set)
+{
+	GPtrArray	*finfos;
+	guint		i;
+
+	while (hfinfo) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		if (finfos) {
+			for (i = 0; i < finfos->len; i++) {
+				field_info *finfo = (field_info *)g_ptr_array_index(finfos, i);
+
+				if (dfset_contains(set, &finfo->value)) {
+					return TRUE;
+				}
+			}
+		}
+		hfinfo = hfinfo->same_name_next;
+	}
+	return FALSE;
+}
+
 
 static void
 free_owned_register(gpointer data, gpointer user_data _U_)
@@ -579,6 +868,20 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						arg3->value.numeric);
 				break;
 
+			case FIELD_TEST:
+				arg3 = insn->arg3;
+				arg4 = insn->arg4;
+				accum = field_test(tree, arg1->value.hfinfo,
+						arg2->value.field_test->func,
+						arg3->value.fvalue,
+						arg4 ? arg4->value.fvalue : NULL);
+				break;
+
+			case FIELD_IN_SET:
+				accum = field_in_set(tree, arg1->value.hfinfo,
+						arg2->value.set);
+				break;
+
 			case NOT:
 				accum = !accum;
 				break;
@@ -654,6 +957,8 @@ dfvm_init_const(dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case FIELD_TEST:
+			case FIELD_IN_SET:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
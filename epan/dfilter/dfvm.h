@@ -14,6 +14,7 @@
 #include "syntax-tree.h"
 #include "drange.h"
 #include "dfunctions.h"
+#include "dfset.h"
 
 typedef enum {
 	EMPTY,
@@ -23,9 +24,23 @@ typedef enum {
 	REGISTER,
 	INTEGER,
 	DRANGE,
-	FUNCTION_DEF
+	FUNCTION_DEF,
+	FIELD_TEST_FUNC,
+	SET_TABLE
 } dfvm_value_type_t;
 
+/*
+ * A comparison specialized for one family of field types, applied
+ * directly to the value of a field_info; arg2 is only used for ranges.
+ */
+typedef gboolean (*DFVMFieldTestFunc)(const fvalue_t *field,
+    const fvalue_t *arg1, const fvalue_t *arg2);
+
+typedef struct {
+	const char		*name;
+	DFVMFieldTestFunc	func;
+} dfvm_field_test_t;
+
 typedef struct {
 	dfvm_value_type_t	type;
 
@@ -35,6 +50,8 @@ typedef struct {
 		drange_t		*drange;
 		header_field_info	*hfinfo;
         df_func_def_t   *funcdef;
+		const dfvm_field_test_t	*field_test;
+		dfset_t			*set;
 	} value;
 
 } dfvm_value_t;
@@ -60,7 +77,9 @@ typedef enum {
 	ANY_MATCHES,
 	MK_RANGE,
 	CALL_FUNCTION,
-	ANY_IN_RANGE
+	ANY_IN_RANGE,
+	FIELD_TEST,
+	FIELD_IN_SET
 
 } dfvm_opcode_t;
 
@@ -85,6 +104,15 @@ dfvm_value_new(dfvm_value_type_t type);
 void
 dfvm_dump(FILE *f, dfilter_t *df);
 
+/*
+ * Get the specialized comparison to use for a FIELD_TEST instruction
+ * equivalent to op (ANY_EQ through ANY_BITWISE_AND, or ANY_IN_RANGE)
+ * applied to a field and a constant, or NULL if there isn't one for that
+ * field's type; hfinfo must be the first field with its name.
+ */
+const dfvm_field_test_t *
+dfvm_field_test_lookup(header_field_info *hfinfo, dfvm_opcode_t op);
+
 gboolean
 dfvm_apply(dfilter_t *df, proto_tree *tree);
 
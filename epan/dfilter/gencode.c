@@ -252,11 +252,81 @@ gen_relation_regs(dfwork_t *dfw, dfvm_opcode_t op, int reg1, int reg2)
 	dfw_append_insn(dfw, insn);
 }
 
+/* Returns the specialized comparison for op between a field and one or
+ * two constants, or NULL if the generic instructions have to be used. */
+static const dfvm_field_test_t *
+field_test_lookup(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_field)
+{
+	header_field_info	*hfinfo;
+
+	if (!dfw->specialize || stnode_type_id(st_field) != STTYPE_FIELD)
+		return NULL;
+
+	/* Rewind to find the first field of this name. */
+	hfinfo = (header_field_info*)stnode_data(st_field);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	return dfvm_field_test_lookup(hfinfo, op);
+}
+
+/**
+ * Adds a FIELD_TEST instruction, comparing a field directly against one
+ * constant, or two for a range.  This takes the place of a READ_TREE,
+ * one or two PUT_FVALUEs and an ANY_* instruction.
+ */
+static void
+gen_field_test(dfwork_t *dfw, const dfvm_field_test_t *test,
+		stnode_t *st_field, stnode_t *st_val1, stnode_t *st_val2)
+{
+	dfvm_insn_t		*insn;
+	dfvm_value_t		*val;
+	header_field_info	*hfinfo;
+
+	hfinfo = (header_field_info*)stnode_data(st_field);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+
+	insn = dfvm_insn_new(FIELD_TEST);
+	val = dfvm_value_new(HFINFO);
+	val->value.hfinfo = hfinfo;
+	insn->arg1 = val;
+	val = dfvm_value_new(FIELD_TEST_FUNC);
+	val->value.field_test = test;
+	insn->arg2 = val;
+	val = dfvm_value_new(FVALUE);
+	val->value.fvalue = (fvalue_t *)stnode_data(st_val1);
+	insn->arg3 = val;
+	if (st_val2) {
+		val = dfvm_value_new(FVALUE);
+		val->value.fvalue = (fvalue_t *)stnode_data(st_val2);
+		insn->arg4 = val;
+	}
+	dfw_append_insn(dfw, insn);
+
+	/* Record the FIELD_ID in hash of interesting fields. */
+	while (hfinfo) {
+		g_hash_table_insert(dfw->interesting_fields,
+			GINT_TO_POINTER(hfinfo->id),
+			GUINT_TO_POINTER(TRUE));
+		hfinfo = hfinfo->same_name_next;
+	}
+}
+
 static void
 gen_relation(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_arg1, stnode_t *st_arg2)
 {
 	dfvm_value_t	*jmp1 = NULL, *jmp2 = NULL;
 	int		reg1 = -1, reg2 = -1;
+	const dfvm_field_test_t	*test;
+
+	/* A field compared with a constant can be done in one go */
+	if (stnode_type_id(st_arg2) == STTYPE_FVALUE &&
+	    (test = field_test_lookup(dfw, op, st_arg1)) != NULL) {
+		gen_field_test(dfw, test, st_arg1, st_arg2, NULL);
+		return;
+	}
 
 	/* Create code for the LHS and RHS of the relation */
 	reg1 = gen_entity(dfw, st_arg1, &jmp1);
@@ -287,6 +357,62 @@ fixup_jumps(gpointer data, gpointer user_data)
 	}
 }
 
+/* Returns a lookup table for the set, or NULL if it's too small to be
+ * worth it or can't have one. */
+static dfset_t *
+gen_set_table(dfwork_t *dfw, stnode_t *st_field, stnode_t *st_set)
+{
+	header_field_info	*hfinfo;
+	GSList			*nodelist, *l;
+
+	if (!dfw->specialize || stnode_type_id(st_field) != STTYPE_FIELD)
+		return NULL;
+
+	nodelist = (GSList*)stnode_data(st_set);
+	if (g_slist_length(nodelist) / 2 < DFSET_MIN_ELEMENTS)
+		return NULL;
+	for (l = nodelist; l; l = g_slist_next(l)) {
+		if (l->data && stnode_type_id((stnode_t*)l->data) != STTYPE_FVALUE)
+			return NULL;
+	}
+
+	hfinfo = (header_field_info*)stnode_data(st_field);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	return dfset_new(hfinfo, nodelist);
+}
+
+static void
+gen_field_in_set(dfwork_t *dfw, stnode_t *st_field, dfset_t *set)
+{
+	dfvm_insn_t		*insn;
+	dfvm_value_t		*val;
+	header_field_info	*hfinfo;
+
+	hfinfo = (header_field_info*)stnode_data(st_field);
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+
+	insn = dfvm_insn_new(FIELD_IN_SET);
+	val = dfvm_value_new(HFINFO);
+	val->value.hfinfo = hfinfo;
+	insn->arg1 = val;
+	val = dfvm_value_new(SET_TABLE);
+	val->value.set = set;
+	insn->arg2 = val;
+	dfw_append_insn(dfw, insn);
+
+	/* Record the FIELD_ID in hash of interesting fields. */
+	while (hfinfo) {
+		g_hash_table_insert(dfw->interesting_fields,
+			GINT_TO_POINTER(hfinfo->id),
+			GUINT_TO_POINTER(TRUE));
+		hfinfo = hfinfo->same_name_next;
+	}
+}
+
 /* Generate the code for the in operator.  It behaves much like an OR-ed
  * series of == tests, but without the redundant existence checks. */
 static void
@@ -299,9 +425,35 @@ gen_relation_in(dfwork_t *dfw, stnode_t *st_arg1, stnode_t *st_arg2)
 	stnode_t	*node1, *node2;
 	GSList		*nodelist;
 	GSList		*jumplist = NULL;
+	const dfvm_field_test_t	*test_eq, *test_in_range;
+	gboolean	specialize;
+	dfset_t		*set;
+
+	/* Look the field up in a table if the set is a large one of
+	 * constants. */
+	set = gen_set_table(dfw, st_arg1, st_arg2);
+	if (set) {
+		gen_field_in_set(dfw, st_arg1, set);
+		nodelist = (GSList*)stnode_data(st_arg2);
+		set_nodelist_free(nodelist);
+		return;
+	}
+
+	/* If the LHS is a field and the set is all constants, compare the
+	 * field against each element directly. */
+	test_eq = field_test_lookup(dfw, ANY_EQ, st_arg1);
+	test_in_range = field_test_lookup(dfw, ANY_IN_RANGE, st_arg1);
+	specialize = test_eq && test_in_range;
+	for (nodelist = (GSList*)stnode_data(st_arg2); specialize && nodelist;
+	    nodelist = g_slist_next(nodelist)) {
+		node1 = (stnode_t*)nodelist->data;
+		if (node1 && stnode_type_id(node1) != STTYPE_FVALUE)
+			specialize = FALSE;
+	}
 
 	/* Create code for the LHS of the relation */
-	reg1 = gen_entity(dfw, st_arg1, &jmp1);
+	if (!specialize)
+		reg1 = gen_entity(dfw, st_arg1, &jmp1);
 
 	/* Create code for the set on the RHS of the relation */
 	nodelist = (GSList*)stnode_data(st_arg2);
@@ -311,7 +463,10 @@ gen_relation_in(dfwork_t *dfw, stnode_t *st_arg1, stnode_t *st_arg2)
 		node2 = (stnode_t*)nodelist->data;
 		nodelist = g_slist_next(nodelist);
 
-		if (node2) {
+		if (specialize) {
+			gen_field_test(dfw, node2 ? test_in_range : test_eq,
+			    st_arg1, node1, node2);
+		} else if (node2) {
 			/* Range element: add lower/upper bound test. */
 			reg2 = gen_entity(dfw, node1, &jmp2);
 			reg3 = gen_entity(dfw, node2, &jmp3);
@@ -0,0 +1,477 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "dfilter-int.h"
+#include "optimize.h"
+#include "syntax-tree.h"
+#include "sttype-range.h"
+#include "sttype-test.h"
+#include "sttype-set.h"
+#include "sttype-function.h"
+#include "dfset.h"
+#include <epan/proto.h>
+#include <ftypes/ftypes-int.h>
+
+/*
+ * Rewrites a checked syntax tree into an equivalent one that is cheaper
+ * to evaluate, before code is generated for it:
+ *
+ *  - "not not X" becomes "X";
+ *  - a set with a single value, "X in {A}", becomes "X == A", and values
+ *    that appear more than once in a set are removed;
+ *  - in a chain of "and"s, or of "or"s, terms that appear more than once
+ *    are removed, and the remaining terms are put in order of estimated
+ *    cost, so that cheap tests such as field existence checks and integer
+ *    comparisons are evaluated before "contains", "matches", slices and
+ *    function calls, and the expensive ones are short-circuited away
+ *    whenever possible.
+ *
+ * None of the tests has side effects, so the order in which they are
+ * evaluated doesn't change the result.
+ */
+
+/* Estimated costs, in arbitrary units. */
+#define COST_EXISTS	1
+#define COST_FIELD	1	/* loading a field */
+#define COST_COMPARE	2	/* an ordinary relation, per value */
+#define COST_SLICE	2
+#define COST_FUNCTION	4
+#define COST_CONTAINS	8
+#define COST_MATCHES	32
+
+static int
+entity_cost(stnode_t *node)
+{
+	GSList	*params;
+	int	cost;
+
+	switch (stnode_type_id(node)) {
+		case STTYPE_FIELD:
+			return COST_FIELD;
+
+		case STTYPE_RANGE:
+			return COST_SLICE + entity_cost(sttype_range_entity(node));
+
+		case STTYPE_FUNCTION:
+			cost = COST_FUNCTION;
+			for (params = sttype_function_params(node); params;
+			    params = g_slist_next(params)) {
+				cost += entity_cost((stnode_t *)params->data);
+			}
+			return cost;
+
+		default:
+			/* Constants are loaded before the filter is run. */
+			return 0;
+	}
+}
+
+static int
+test_cost(stnode_t *node)
+{
+	test_op_t	op;
+	stnode_t	*val1, *val2;
+	int		cost;
+
+	sttype_test_get(node, &op, &val1, &val2);
+
+	switch (op) {
+		case TEST_OP_EXISTS:
+			return COST_EXISTS;
+
+		case TEST_OP_NOT:
+			return test_cost(val1);
+
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			return test_cost(val1) + test_cost(val2);
+
+		case TEST_OP_CONTAINS:
+			return COST_CONTAINS + entity_cost(val1) + entity_cost(val2);
+
+		case TEST_OP_MATCHES:
+			return COST_MATCHES + entity_cost(val1) + entity_cost(val2);
+
+		case TEST_OP_IN:
+			/*
+			 * One comparison per element of the set, unless it's
+			 * large enough to be looked up in a table.
+			 */
+			cost = g_slist_length((GSList *)stnode_data(val2)) / 2;
+			if (cost >= DFSET_MIN_ELEMENTS)
+				cost = 2;
+			return COST_COMPARE * cost + entity_cost(val1);
+
+		case TEST_OP_EQ:
+		case TEST_OP_NE:
+		case TEST_OP_GT:
+		case TEST_OP_GE:
+		case TEST_OP_LT:
+		case TEST_OP_LE:
+		case TEST_OP_BITWISE_AND:
+			return COST_COMPARE + entity_cost(val1) + entity_cost(val2);
+
+		case TEST_OP_UNINITIALIZED:
+			break;
+	}
+	g_assert_not_reached();
+	return 0;
+}
+
+/*
+ * Build a string that is the same for two subtrees only if they are
+ * the same test, or NULL if the subtree contains something that we
+ * don't bother to compare (slices, function calls, sets).  This is only
+ * used to find duplicates, so it doesn't need to be readable.
+ */
+static gboolean
+append_signature(GString *sig, stnode_t *node)
+{
+	test_op_t	op;
+	stnode_t	*val1, *val2;
+	fvalue_t	*fv;
+	char		*repr;
+
+	switch (stnode_type_id(node)) {
+		case STTYPE_FIELD:
+			g_string_append_printf(sig, "F(%s)",
+			    ((header_field_info *)stnode_data(node))->abbrev);
+			return TRUE;
+
+		case STTYPE_FVALUE:
+			fv = (fvalue_t *)stnode_data(node);
+			/* Distinct floating-point values can print the same. */
+			if (fvalue_type_ftenum(fv) == FT_FLOAT ||
+			    fvalue_type_ftenum(fv) == FT_DOUBLE)
+				return FALSE;
+			repr = fvalue_to_string_repr(NULL, fv, FTREPR_DFILTER, BASE_NONE);
+			if (repr == NULL)
+				return FALSE;
+			g_string_append_printf(sig, "V(%s:%s)",
+			    fvalue_type_name(fv), repr);
+			wmem_free(NULL, repr);
+			return TRUE;
+
+		case STTYPE_TEST:
+			sttype_test_get(node, &op, &val1, &val2);
+			if (op == TEST_OP_IN)
+				return FALSE;
+			g_string_append_printf(sig, "T%d(", op);
+			if (val1 && !append_signature(sig, val1))
+				return FALSE;
+			g_string_append_c(sig, ',');
+			if (val2 && !append_signature(sig, val2))
+				return FALSE;
+			g_string_append_c(sig, ')');
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+static gchar *
+signature(stnode_t *node)
+{
+	GString	*sig = g_string_new(NULL);
+
+	if (!append_signature(sig, node)) {
+		g_string_free(sig, TRUE);
+		return NULL;
+	}
+	return g_string_free(sig, FALSE);
+}
+
+/*
+ * Free a test or value dropped from the tree.  Constants are normally
+ * handed over to the generated code, so they aren't freed with their
+ * nodes; free them here.  Only nodes that have a signature are dropped,
+ * so there are no sets, slices or function calls to deal with.
+ */
+static void
+discard_node(stnode_t *node)
+{
+	stnode_t	*val1, *val2;
+
+	switch (stnode_type_id(node)) {
+		case STTYPE_FVALUE:
+			FVALUE_FREE((fvalue_t *)stnode_data(node));
+			break;
+
+		case STTYPE_TEST:
+			sttype_test_get(node, NULL, &val1, &val2);
+			sttype_test_set2_args(node, NULL, NULL);
+			if (val1)
+				discard_node(val1);
+			if (val2)
+				discard_node(val2);
+			break;
+
+		default:
+			break;
+	}
+	stnode_free(node);
+}
+
+/*
+ * Turn node into its only remaining operand, which must already have been
+ * detached from it.  The node is changed in place, so that whatever
+ * points to it now points to the operand.
+ */
+static void
+replace_with_operand(stnode_t *node, stnode_t *operand)
+{
+	stnode_t	tmp;
+
+	tmp = *node;
+	*node = *operand;
+	*operand = tmp;
+
+	/* This now frees the shell of the old node. */
+	stnode_free(operand);
+}
+
+static void
+optimize_set(stnode_t *node)
+{
+	test_op_t	op;
+	stnode_t	*val1, *set, *elem;
+	GSList		*nodelist, *l, *next;
+	GHashTable	*seen;
+	gchar		*sig;
+
+	sttype_test_get(node, &op, &val1, &set);
+	nodelist = (GSList *)stnode_data(set);
+
+	/*
+	 * Drop repeated single values; each element is two list items,
+	 * (value, NULL) or (lower, upper) for a range.
+	 */
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	l = nodelist;
+	while (l) {
+		next = g_slist_next(g_slist_next(l));
+		elem = (stnode_t *)l->data;
+		if (l->next->data == NULL && (sig = signature(elem)) != NULL) {
+			if (g_hash_table_contains(seen, sig)) {
+				g_free(sig);
+				nodelist = g_slist_delete_link(nodelist, l->next);
+				nodelist = g_slist_delete_link(nodelist, l);
+				discard_node(elem);
+			} else {
+				g_hash_table_insert(seen, sig, NULL);
+			}
+		}
+		l = next;
+	}
+	g_hash_table_destroy(seen);
+	set->data = nodelist;
+
+	/* "X in {A}" is "X == A". */
+	if (g_slist_length(nodelist) == 2 && nodelist->next->data == NULL) {
+		elem = (stnode_t *)nodelist->data;
+		g_slist_free(nodelist);
+		stnode_free(set);
+		sttype_test_set2(node, TEST_OP_EQ, val1, elem);
+	}
+}
+
+typedef struct {
+	stnode_t	*node;
+	int		cost;
+	int		index;	/* original position, to keep the sort stable */
+} term_t;
+
+static int
+term_cmp(gconstpointer a, gconstpointer b)
+{
+	const term_t	*ta = (const term_t *)a;
+	const term_t	*tb = (const term_t *)b;
+
+	if (ta->cost != tb->cost)
+		return ta->cost < tb->cost ? -1 : 1;
+	return ta->index < tb->index ? -1 : (ta->index > tb->index);
+}
+
+/*
+ * Collect the terms of a chain of the same operator, "A op B op C ...",
+ * which the grammar builds as a tree, and the nodes for the operators.
+ */
+static void
+collect_chain(stnode_t *node, test_op_t chain_op, GArray *terms, GPtrArray *ops)
+{
+	test_op_t	op;
+	stnode_t	*val1, *val2;
+	term_t		term;
+
+	/*
+	 * Brackets only matter to the parser (and to the warning about
+	 * mixing "and" and "or" without them), so they don't stop us.
+	 */
+	sttype_test_get(node, &op, &val1, &val2);
+	if (op == chain_op) {
+		g_ptr_array_add(ops, node);
+		collect_chain(val1, chain_op, terms, ops);
+		collect_chain(val2, chain_op, terms, ops);
+		return;
+	}
+
+	term.node = node;
+	term.cost = test_cost(node);
+	term.index = terms->len;
+	g_array_append_val(terms, term);
+}
+
+static void optimize_test(stnode_t *node);
+
+static void
+optimize_chain(stnode_t *node, test_op_t chain_op)
+{
+	GArray		*terms;
+	GPtrArray	*ops;
+	GHashTable	*seen;
+	term_t		*term;
+	stnode_t	*op_node;
+	gchar		*sig;
+	guint		i, n;
+
+	terms = g_array_new(FALSE, FALSE, sizeof(term_t));
+	ops = g_ptr_array_new();
+
+	collect_chain(node, chain_op, terms, ops);
+
+	/* Optimize the terms first, as that can change their costs. */
+	for (i = 0; i < terms->len; i++) {
+		term = &g_array_index(terms, term_t, i);
+		optimize_test(term->node);
+		term->cost = test_cost(term->node);
+	}
+
+	/* "X and X" is "X", as is "X or X". */
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	for (i = 0; i < terms->len; ) {
+		term = &g_array_index(terms, term_t, i);
+		sig = signature(term->node);
+		if (sig == NULL) {
+			i++;
+			continue;
+		}
+		if (g_hash_table_contains(seen, sig)) {
+			g_free(sig);
+			discard_node(term->node);
+			g_array_remove_index(terms, i);
+			continue;
+		}
+		g_hash_table_insert(seen, sig, NULL);
+		i++;
+	}
+	g_hash_table_destroy(seen);
+
+	g_array_sort(terms, term_cmp);
+
+	/*
+	 * Detach everything from the operator nodes, then rebuild the
+	 * chain, left to right, in the new order:
+	 *
+	 *   ((T0 op T1) op T2) ... op Tn-1
+	 *
+	 * using as many of the operator nodes as needed, starting with
+	 * the root, which has to stay where it is.
+	 */
+	for (i = 0; i < ops->len; i++)
+		sttype_test_set2_args((stnode_t *)g_ptr_array_index(ops, i), NULL, NULL);
+
+	n = terms->len;
+	if (n == 1) {
+		replace_with_operand(node, g_array_index(terms, term_t, 0).node);
+		for (i = 1; i < ops->len; i++)
+			stnode_free((stnode_t *)g_ptr_array_index(ops, i));
+	} else {
+		for (i = 0; i < n - 1; i++) {
+			op_node = (stnode_t *)g_ptr_array_index(ops, i);
+			if (i < n - 2) {
+				sttype_test_set2_args(op_node,
+				    (stnode_t *)g_ptr_array_index(ops, i + 1),
+				    g_array_index(terms, term_t, n - 1 - i).node);
+			} else {
+				sttype_test_set2_args(op_node,
+				    g_array_index(terms, term_t, 0).node,
+				    g_array_index(terms, term_t, 1).node);
+			}
+		}
+		for (i = n - 1; i < ops->len; i++)
+			stnode_free((stnode_t *)g_ptr_array_index(ops, i));
+	}
+
+	g_ptr_array_free(ops, TRUE);
+	g_array_free(terms, TRUE);
+}
+
+static void
+optimize_test(stnode_t *node)
+{
+	test_op_t	op, op1;
+	stnode_t	*val1, *val2, *inner;
+
+	sttype_test_get(node, &op, &val1, &val2);
+
+	switch (op) {
+		case TEST_OP_NOT:
+			sttype_test_get(val1, &op1, &inner, NULL);
+			if (op1 == TEST_OP_NOT) {
+				/* "not not X" is "X". */
+				sttype_test_set2_args(val1, NULL, NULL);
+				stnode_free(val1);
+				sttype_test_set2_args(node, NULL, NULL);
+				replace_with_operand(node, inner);
+				optimize_test(node);
+			} else {
+				optimize_test(val1);
+			}
+			break;
+
+		case TEST_OP_AND:
+		case TEST_OP_OR:
+			optimize_chain(node, op);
+			break;
+
+		case TEST_OP_IN:
+			optimize_set(node);
+			break;
+
+		default:
+			break;
+	}
+}
+
+void
+dfw_optimize(dfwork_t *dfw)
+{
+	if (dfw->st_root == NULL)
+		return;
+
+	if (stnode_type_id(dfw->st_root) == STTYPE_TEST)
+		optimize_test(dfw->st_root);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
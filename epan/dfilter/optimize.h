@@ -0,0 +1,16 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+/* Rewrite the checked syntax tree into a cheaper, equivalent one. */
+void
+dfw_optimize(dfwork_t *dfw);
+
+#endif
@@ -0,0 +1,436 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "prefilter.h"
+#include "sttype-range.h"
+#include "sttype-test.h"
+#include <epan/proto.h>
+#include <epan/tvbuff.h>
+#include <ftypes/ftypes-int.h>
+#include <wsutil/ws_mempbrk.h>
+
+/*
+ * The conditions are a tree of "and"s and "or"s of byte tests:
+ *
+ *  - "frame contains X", and "frame[...] contains X" with a single
+ *    slice, need X somewhere in the frame;
+ *  - "frame[i:n] == X", with a single slice of n bytes, needs X at
+ *    offset i (counted from the end if negative), which also means that
+ *    the frame is long enough to have it.
+ *
+ * "A and B" needs whatever A or B needs; "A or B" needs what A needs or
+ * what B needs, so it's dropped if either needs nothing.  Nothing is
+ * taken from under a "not", or from any other test.
+ *
+ * "frame" is the only field whose value is the raw bytes of the frame,
+ * so these are the only tests that can be answered without dissecting.
+ */
+
+typedef enum {
+	PF_CONTAINS,	/* the bytes are somewhere in the frame */
+	PF_BYTES_AT,	/* the bytes are at offset */
+	PF_AND,
+	PF_OR
+} pf_op_t;
+
+struct _df_prefilter {
+	pf_op_t		op;
+	guint8		*bytes;
+	guint		len;
+	gint		offset;
+	GPtrArray	*terms;		/* for PF_AND and PF_OR */
+	/*
+	 * For a PF_OR of PF_CONTAINS terms, the first bytes of the terms,
+	 * so that all of them are looked for in one scan of the frame.
+	 */
+	ws_mempbrk_pattern *first_bytes;
+};
+
+static df_prefilter_t *
+pf_new_bytes(pf_op_t op, guint8 *bytes, guint len, gint offset)
+{
+	df_prefilter_t	*pf = g_new0(df_prefilter_t, 1);
+
+	pf->op = op;
+	pf->bytes = bytes;
+	pf->len = len;
+	pf->offset = offset;
+	return pf;
+}
+
+void
+df_prefilter_free(df_prefilter_t *pf)
+{
+	guint	i;
+
+	if (!pf)
+		return;
+
+	if (pf->terms) {
+		for (i = 0; i < pf->terms->len; i++)
+			df_prefilter_free((df_prefilter_t *)g_ptr_array_index(pf->terms, i));
+		g_ptr_array_free(pf->terms, TRUE);
+	}
+	g_free(pf->first_bytes);
+	g_free(pf->bytes);
+	g_free(pf);
+}
+
+static void
+pf_add_term(df_prefilter_t *pf, df_prefilter_t *term)
+{
+	guint	i;
+
+	/* Keep chains of the same operator flat. */
+	if (term->op == pf->op) {
+		for (i = 0; i < term->terms->len; i++)
+			g_ptr_array_add(pf->terms, g_ptr_array_index(term->terms, i));
+		g_ptr_array_free(term->terms, TRUE);
+		g_free(term);
+		return;
+	}
+	g_ptr_array_add(pf->terms, term);
+}
+
+static df_prefilter_t *
+pf_combine(pf_op_t op, df_prefilter_t *a, df_prefilter_t *b)
+{
+	df_prefilter_t	*pf;
+
+	if (op == PF_AND) {
+		if (a == NULL)
+			return b;
+		if (b == NULL)
+			return a;
+	}
+	else if (a == NULL || b == NULL) {
+		df_prefilter_free(a);
+		df_prefilter_free(b);
+		return NULL;
+	}
+
+	pf = g_new0(df_prefilter_t, 1);
+	pf->op = op;
+	pf->terms = g_ptr_array_new();
+	pf_add_term(pf, a);
+	pf_add_term(pf, b);
+	return pf;
+}
+
+static gboolean
+is_frame(stnode_t *node)
+{
+	header_field_info	*hfinfo;
+
+	if (stnode_type_id(node) != STTYPE_FIELD)
+		return FALSE;
+	hfinfo = (header_field_info *)stnode_data(node);
+	return hfinfo->type == FT_PROTOCOL && strcmp(hfinfo->abbrev, "frame") == 0;
+}
+
+/*
+ * Is this one slice of the frame?  Several slices are joined together,
+ * which gives bytes that needn't be next to each other in the frame.
+ */
+static gboolean
+is_frame_slice(stnode_t *node)
+{
+	return stnode_type_id(node) == STTYPE_RANGE &&
+	    is_frame(sttype_range_entity(node)) &&
+	    g_slist_length(sttype_range_drange(node)->range_list) == 1;
+}
+
+/*
+ * Copy the bytes of a constant compared with the frame or a slice of it.
+ * Returns NULL if it isn't a constant or has no bytes.
+ */
+static guint8 *
+constant_bytes(stnode_t *node, guint *len)
+{
+	fvalue_t	*fv;
+	tvbuff_t	*tvb;
+
+	if (stnode_type_id(node) != STTYPE_FVALUE)
+		return NULL;
+
+	fv = (fvalue_t *)stnode_data(node);
+	switch (fvalue_type_ftenum(fv)) {
+		case FT_PROTOCOL:
+			tvb = (tvbuff_t *)fvalue_get(fv);
+			if (tvb == NULL)
+				return NULL;
+			*len = tvb_captured_length(tvb);
+			if (*len == 0)
+				return NULL;
+			return (guint8 *)tvb_memdup(NULL, tvb, 0, *len);
+
+		case FT_BYTES:
+			*len = fvalue_length(fv);
+			if (*len == 0)
+				return NULL;
+			return (guint8 *)g_memdup(fvalue_get(fv), *len);
+
+		default:
+			return NULL;
+	}
+}
+
+static df_prefilter_t *
+extract_test(stnode_t *node)
+{
+	test_op_t	op;
+	stnode_t	*val1, *val2;
+	drange_t	*dr;
+	drange_node	*rn;
+	guint8		*bytes;
+	guint		len;
+
+	sttype_test_get(node, &op, &val1, &val2);
+
+	switch (op) {
+		case TEST_OP_AND:
+			return pf_combine(PF_AND, extract_test(val1), extract_test(val2));
+
+		case TEST_OP_OR:
+			return pf_combine(PF_OR, extract_test(val1), extract_test(val2));
+
+		case TEST_OP_CONTAINS:
+			if (!is_frame(val1) && !is_frame_slice(val1))
+				return NULL;
+			if ((bytes = constant_bytes(val2, &len)) == NULL)
+				return NULL;
+			return pf_new_bytes(PF_CONTAINS, bytes, len, 0);
+
+		case TEST_OP_EQ:
+			if (!is_frame_slice(val1))
+				return NULL;
+			dr = sttype_range_drange(val1);
+			rn = (drange_node *)dr->range_list->data;
+			if (drange_node_get_ending(rn) != DRANGE_NODE_END_T_LENGTH)
+				return NULL;
+			if ((bytes = constant_bytes(val2, &len)) == NULL)
+				return NULL;
+			if (drange_node_get_length(rn) != (gint)len) {
+				/* Comparing slices of different lengths;
+				 * leave that to the filter. */
+				g_free(bytes);
+				return NULL;
+			}
+			return pf_new_bytes(PF_BYTES_AT, bytes, len,
+			    drange_node_get_start_offset(rn));
+
+		default:
+			return NULL;
+	}
+}
+
+static int
+term_cmp(gconstpointer a, gconstpointer b)
+{
+	const df_prefilter_t *ta = *(const df_prefilter_t * const *)a;
+	const df_prefilter_t *tb = *(const df_prefilter_t * const *)b;
+
+	/* Comparing bytes at an offset is cheaper than a search. */
+	return (ta->op != PF_BYTES_AT) - (tb->op != PF_BYTES_AT);
+}
+
+/*
+ * Put the cheap tests first and, for an "or" of searches whose first
+ * bytes ws_mempbrk can look for, set up to do them in one scan.
+ */
+static void
+finish(df_prefilter_t *pf)
+{
+	GString		*needles;
+	df_prefilter_t	*term;
+	gboolean	scan = TRUE;
+	guint		i;
+
+	if (!pf->terms)
+		return;
+
+	for (i = 0; i < pf->terms->len; i++) {
+		term = (df_prefilter_t *)g_ptr_array_index(pf->terms, i);
+		finish(term);
+		/* ws_mempbrk takes the needles as a C string. */
+		if (term->op != PF_CONTAINS || term->bytes[0] == 0 ||
+		    term->bytes[0] >= 0x80)
+			scan = FALSE;
+	}
+	g_ptr_array_sort(pf->terms, term_cmp);
+
+	if (pf->op != PF_OR || !scan)
+		return;
+
+	needles = g_string_new(NULL);
+	for (i = 0; i < pf->terms->len; i++) {
+		term = (df_prefilter_t *)g_ptr_array_index(pf->terms, i);
+		if (!strchr(needles->str, term->bytes[0]))
+			g_string_append_c(needles, term->bytes[0]);
+	}
+	pf->first_bytes = g_new0(ws_mempbrk_pattern, 1);
+	ws_mempbrk_compile(pf->first_bytes, needles->str);
+	g_string_free(needles, TRUE);
+}
+
+df_prefilter_t *
+df_prefilter_new(stnode_t *root)
+{
+	df_prefilter_t	*pf;
+
+	if (root == NULL || stnode_type_id(root) != STTYPE_TEST)
+		return NULL;
+
+	pf = extract_test(root);
+	if (pf)
+		finish(pf);
+	return pf;
+}
+
+/* memmem(), finding candidates for the first byte with memchr(). */
+static gboolean
+find_bytes(const guint8 *data, guint len, const guint8 *bytes, guint bytes_len)
+{
+	const guint8	*p, *last;
+
+	if (bytes_len > len)
+		return FALSE;
+
+	p = data;
+	last = data + (len - bytes_len);
+	while (p <= last) {
+		p = (const guint8 *)memchr(p, bytes[0], last - p + 1);
+		if (p == NULL)
+			return FALSE;
+		if (memcmp(p + 1, bytes + 1, bytes_len - 1) == 0)
+			return TRUE;
+		p++;
+	}
+	return FALSE;
+}
+
+static gboolean
+find_any(const df_prefilter_t *pf, const guint8 *data, guint len)
+{
+	const guint8	*p, *end;
+	df_prefilter_t	*term;
+	guchar		found;
+	guint		i;
+
+	p = data;
+	end = data + len;
+	while ((p = ws_mempbrk_exec(p, end - p, pf->first_bytes, &found)) != NULL) {
+		for (i = 0; i < pf->terms->len; i++) {
+			term = (df_prefilter_t *)g_ptr_array_index(pf->terms, i);
+			if (term->bytes[0] == found &&
+			    term->len <= (guint)(end - p) &&
+			    memcmp(p, term->bytes, term->len) == 0)
+				return TRUE;
+		}
+		p++;
+	}
+	return FALSE;
+}
+
+gboolean
+df_prefilter_apply(const df_prefilter_t *pf, const guint8 *data, guint len)
+{
+	guint	offset, i;
+
+	switch (pf->op) {
+		case PF_CONTAINS:
+			return find_bytes(data, len, pf->bytes, pf->len);
+
+		case PF_BYTES_AT:
+			/* The same bounds as slicing the frame. */
+			if (pf->offset < 0) {
+				if ((guint)-(gint64)pf->offset > len)
+					return FALSE;
+				offset = len + pf->offset;
+			}
+			else {
+				offset = (guint)pf->offset;
+			}
+			if (offset > len || pf->len > len - offset)
+				return FALSE;
+			return memcmp(data + offset, pf->bytes, pf->len) == 0;
+
+		case PF_AND:
+			for (i = 0; i < pf->terms->len; i++) {
+				if (!df_prefilter_apply((df_prefilter_t *)g_ptr_array_index(pf->terms, i), data, len))
+					return FALSE;
+			}
+			return TRUE;
+
+		case PF_OR:
+			if (pf->first_bytes)
+				return find_any(pf, data, len);
+			for (i = 0; i < pf->terms->len; i++) {
+				if (df_prefilter_apply((df_prefilter_t *)g_ptr_array_index(pf->terms, i), data, len))
+					return TRUE;
+			}
+			return FALSE;
+	}
+	g_assert_not_reached();
+	return TRUE;
+}
+
+static void
+dump_bytes(FILE *f, const df_prefilter_t *pf)
+{
+	guint	i;
+
+	for (i = 0; i < pf->len; i++)
+		fprintf(f, "%s%02x", i ? ":" : "", pf->bytes[i]);
+}
+
+void
+df_prefilter_dump(FILE *f, const df_prefilter_t *pf)
+{
+	guint	i;
+
+	switch (pf->op) {
+		case PF_CONTAINS:
+			fprintf(f, "frame contains ");
+			dump_bytes(f, pf);
+			break;
+
+		case PF_BYTES_AT:
+			fprintf(f, "frame[%d:%u] == ", pf->offset, pf->len);
+			dump_bytes(f, pf);
+			break;
+
+		case PF_AND:
+		case PF_OR:
+			fprintf(f, "(");
+			for (i = 0; i < pf->terms->len; i++) {
+				if (i > 0)
+					fprintf(f, pf->op == PF_AND ? " and " : " or ");
+				df_prefilter_dump(f, (df_prefilter_t *)g_ptr_array_index(pf->terms, i));
+			}
+			fprintf(f, ")");
+			break;
+	}
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -0,0 +1,47 @@
+/*
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 2001 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stdio.h>
+
+#include "syntax-tree.h"
+
+/*
+ * Conditions on the raw bytes of a frame that must all hold for a filter
+ * to match the frame, such as "the frame contains these bytes" or "the
+ * frame has these bytes at this offset", taken from the "frame contains"
+ * and "frame[...] == ..." tests in the filter.  They can be checked
+ * before the frame is dissected.
+ */
+typedef struct _df_prefilter df_prefilter_t;
+
+/*
+ * Extract the conditions from a checked syntax tree.  Returns NULL if
+ * the filter doesn't imply any.
+ */
+df_prefilter_t *
+df_prefilter_new(stnode_t *root);
+
+/*
+ * Could a frame with these bytes match the filter?  A FALSE result means
+ * that it can't; a TRUE result means only that dissection is needed to
+ * tell.
+ */
+gboolean
+df_prefilter_apply(const df_prefilter_t *pf, const guint8 *data, guint len);
+
+/* Print the conditions as a filter expression, for dfilter_dump(). */
+void
+df_prefilter_dump(FILE *f, const df_prefilter_t *pf);
+
+void
+df_prefilter_free(df_prefilter_t *pf);
+
+#endif
@@ -619,6 +619,11 @@ dfilter_fvalue_from_charconst_string(dfwork_t *dfw, ftenum_t ftype, char *s, gbo
 	return (fvalue);
 }
 
+static void
+check_set_element(dfwork_t *dfw, FtypeCanFunc can_func,
+		gboolean allow_partial_value, stnode_t *st_arg1,
+		stnode_t *st_set, stnode_t *node, stnode_t *node_right);
+
 /* If the LHS of a relation test is a FIELD, run some checks
  * and possibly some modifications of syntax tree nodes. */
 static void
@@ -768,6 +773,7 @@ check_relation_LHS_FIELD(dfwork_t *dfw, const char *relation_string,
 	}
 	else if (type2 == STTYPE_SET) {
 		GSList *nodelist;
+		guint set_file;
 		/* A set should only ever appear on RHS of 'in' operation */
 		if (strcmp(relation_string, "in") != 0) {
 			g_assert_not_reached();
@@ -777,6 +783,7 @@ check_relation_LHS_FIELD(dfwork_t *dfw, const char *relation_string,
 		 * value and NULL. Both will be replaced by a lower and upper
 		 * value if the element is a range. */
 		nodelist = (GSList*)stnode_data(st_arg2);
+		set_file = (guint)stnode_value(st_arg2);
 		while (nodelist) {
 			stnode_t *node = (stnode_t*)nodelist->data;
 			/* Don't let a range on the RHS affect the LHS field. */
@@ -789,23 +796,31 @@ check_relation_LHS_FIELD(dfwork_t *dfw, const char *relation_string,
 			nodelist = g_slist_next(nodelist);
 			g_assert(nodelist);
 			stnode_t *node_right = (stnode_t *)nodelist->data;
-			if (node_right) {
-				/* range type, check if comparison is possible. */
-				if (!ftype_can_ge(ftype1)) {
-					dfilter_fail(dfw, "%s (type=%s) cannot participate in '%s' comparison.",
-							hfinfo1->abbrev, ftype_pretty_name(ftype1),
-							">=");
-					THROW(TypeError);
-				}
-				check_relation_LHS_FIELD(dfw, ">=", ftype_can_ge,
-						allow_partial_value, st_arg2, st_arg1, node);
-				check_relation_LHS_FIELD(dfw, "<=", ftype_can_le,
-						allow_partial_value, st_arg2, st_arg1, node_right);
-			} else {
-				check_relation_LHS_FIELD(dfw, "==", can_func,
-						allow_partial_value, st_arg2, st_arg1, node);
-			}
 			nodelist = g_slist_next(nodelist);
+
+			if (set_file == 0) {
+				check_set_element(dfw, can_func, allow_partial_value,
+						st_arg1, st_arg2, node, node_right);
+				continue;
+			}
+
+			/* Say where in the file a bad element is, but not what
+			 * it is, so that a filter can't be used to show what's
+			 * in a file. */
+			gint32 line = stnode_value(node);
+			TRY {
+				check_set_element(dfw, can_func, allow_partial_value,
+						st_arg1, st_arg2, node, node_right);
+			}
+			CATCH(TypeError) {
+				g_free(dfw->error_message);
+				dfw->error_message = NULL;
+				dfilter_fail(dfw, "Line %d of \"%s\" isn't a valid set element for %s.",
+						line, (const char *)g_ptr_array_index(dfw->set_files, set_file - 1),
+						hfinfo1->abbrev);
+				RETHROW;
+			}
+			ENDTRY;
 		}
 	}
 	else {
@@ -813,6 +828,33 @@ check_relation_LHS_FIELD(dfwork_t *dfw, const char *relation_string,
 	}
 }
 
+/* Check one element of a set, a value or a range ("lower..upper"),
+ * against the field tested for membership in the set. */
+static void
+check_set_element(dfwork_t *dfw, FtypeCanFunc can_func,
+		gboolean allow_partial_value, stnode_t *st_arg1,
+		stnode_t *st_set, stnode_t *node, stnode_t *node_right)
+{
+	header_field_info	*hfinfo1 = (header_field_info*)stnode_data(st_arg1);
+
+	if (node_right) {
+		/* range type, check if comparison is possible. */
+		if (!ftype_can_ge(hfinfo1->type)) {
+			dfilter_fail(dfw, "%s (type=%s) cannot participate in '%s' comparison.",
+					hfinfo1->abbrev, ftype_pretty_name(hfinfo1->type),
+					">=");
+			THROW(TypeError);
+		}
+		check_relation_LHS_FIELD(dfw, ">=", ftype_can_ge,
+				allow_partial_value, st_set, st_arg1, node);
+		check_relation_LHS_FIELD(dfw, "<=", ftype_can_le,
+				allow_partial_value, st_set, st_arg1, node_right);
+	} else {
+		check_relation_LHS_FIELD(dfw, "==", can_func,
+				allow_partial_value, st_set, st_arg1, node);
+	}
+}
+
 static void
 check_relation_LHS_STRING(dfwork_t *dfw, const char* relation_string,
 		FtypeCanFunc can_func, gboolean allow_partial_value _U_,
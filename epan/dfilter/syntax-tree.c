@@ -79,6 +79,7 @@ stnode_new(sttype_id_t type_id, gpointer data)
 	node->magic = STNODE_MAGIC;
 	node->deprecated_token = NULL;
 	node->inside_brackets = FALSE;
+	node->value = 0;
 
 	if (type_id == STTYPE_UNINITIALIZED) {
 		node->type = NULL;
@@ -106,6 +107,12 @@ stnode_set_bracket(stnode_t *node, gboolean bracket)
 	node->inside_brackets = bracket;
 }
 
+void
+stnode_set_value(stnode_t *node, gint32 value)
+{
+	node->value = value;
+}
+
 stnode_t*
 stnode_dup(const stnode_t *org)
 {
@@ -81,6 +81,9 @@ stnode_new(sttype_id_t type_id, gpointer data);
 void
 stnode_set_bracket(stnode_t *node, gboolean bracket);
 
+void
+stnode_set_value(stnode_t *node, gint32 value);
+
 stnode_t*
 stnode_dup(const stnode_t *org);
 
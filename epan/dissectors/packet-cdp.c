@@ -1466,6 +1466,7 @@ proto_register_cdp(void)
     expert_module_t* expert_cdp;
 
     proto_cdp = proto_register_protocol("Cisco Discovery Protocol", "CDP", "cdp");
+    proto_set_stateless(proto_cdp);
 
     proto_register_field_array(proto_cdp, hf, array_length(hf));
     proto_register_subtree_array(ett, array_length(ett));
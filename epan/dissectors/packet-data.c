@@ -149,6 +149,7 @@ proto_register_data(void)
 		"Data",		/* short name */
 		"data"		/* abbrev */
 		);
+	proto_set_stateless(proto_data);
 
 	data_handle = register_dissector("data", dissect_data, proto_data);
 
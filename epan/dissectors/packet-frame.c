@@ -30,6 +30,8 @@
 #include <wsutil/wsgcrypt.h>
 #include <wsutil/str_util.h>
 #include <epan/proto_data.h>
+#include <epan/reassemble.h>
+#include <epan/stats_tree.h>
 #include <wmem/wmem.h>
 
 #include "packet-frame.h"
@@ -92,8 +94,10 @@ static gint ett_comments = -1;
 static expert_field ei_comments_text = EI_INIT;
 static expert_field ei_arrive_time_out_of_range = EI_INIT;
 static expert_field ei_incomplete = EI_INIT;
+static expert_field ei_reassembly_evicted = EI_INIT;
 
 static int frame_tap = -1;
+static int reassembly_tap = -1;
 
 static dissector_handle_t docsis_handle;
 static dissector_handle_t sysdig_handle;
@@ -105,6 +109,23 @@ static gboolean generate_md5_hash   = FALSE;
 static gboolean generate_epoch_time = TRUE;
 static gboolean generate_bits_field = TRUE;
 static gboolean disable_packet_size_limited_in_summary = FALSE;
+static gboolean report_evicted_reassemblies = TRUE;
+
+/*
+ * Reassemblies abandoned while first dissecting a frame, kept for when
+ * the frame is dissected again.
+ */
+typedef struct {
+	guint count;
+	reassembly_eviction_t *evictions;
+} frame_evictions_t;
+
+static const value_string reassembly_eviction_reasons[] = {
+	{ REASSEMBLY_EVICTED_MEMORY, "memory limit reached" },
+	{ REASSEMBLY_EVICTED_FRAMES, "no fragments for too many frames" },
+	{ REASSEMBLY_EVICTED_TIME,   "no fragments for too long" },
+	{ 0, NULL }
+};
 
 static const value_string p2p_dirs[] = {
 	{ P2P_DIR_UNKNOWN, "Unknown" },
@@ -199,6 +220,96 @@ call_frame_end_routine(gpointer routine)
 	(*func)();
 }
 
+/*
+ * Report the reassemblies that were abandoned while this frame was first
+ * dissected, and tap them.
+ */
+static void
+report_evicted_reassemblies_in_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *fh_tree)
+{
+	frame_evictions_t *frame_evictions;
+	const reassembly_eviction_t *ev;
+	const char *frames;
+	guint i;
+
+	if (!pinfo->fd->flags.visited) {
+		const reassembly_eviction_t *evictions;
+		guint count;
+
+		/* Also abandon what's over the limits in tables that
+		   weren't looked up in this frame. */
+		reassembly_tables_enforce_limits(pinfo);
+		evictions = reassembly_get_evictions(pinfo, &count);
+		if (count == 0)
+			return;
+		frame_evictions = wmem_new(wmem_file_scope(), frame_evictions_t);
+		frame_evictions->count = count;
+		frame_evictions->evictions = (reassembly_eviction_t *)wmem_memdup(wmem_file_scope(),
+		    evictions, count * sizeof(reassembly_eviction_t));
+		p_add_proto_data(wmem_file_scope(), pinfo, proto_frame, 0, frame_evictions);
+	} else {
+		frame_evictions = (frame_evictions_t *)p_get_proto_data(wmem_file_scope(), pinfo, proto_frame, 0);
+		if (!frame_evictions)
+			return;
+	}
+
+	for (i = 0; i < frame_evictions->count; i++) {
+		ev = &frame_evictions->evictions[i];
+
+		if (report_evicted_reassemblies) {
+			if (ev->first_frame == ev->last_frame)
+				frames = wmem_strdup_printf(wmem_packet_scope(), "frame %u", ev->first_frame);
+			else
+				frames = wmem_strdup_printf(wmem_packet_scope(), "frames %u-%u", ev->first_frame, ev->last_frame);
+			proto_tree_add_expert_format(fh_tree, pinfo, &ei_reassembly_evicted, tvb, 0, 0,
+			    "%s reassembly of %u fragment%s (%u byte%s) from %s abandoned: %s",
+			    ev->proto ? ev->proto : "Unknown",
+			    ev->fragments, plurality(ev->fragments, "", "s"),
+			    ev->bytes, plurality(ev->bytes, "", "s"), frames,
+			    val_to_str_const(ev->reason, reassembly_eviction_reasons, "unknown reason"));
+		}
+		tap_queue_packet(reassembly_tap, pinfo, ev);
+	}
+}
+
+static const gchar *st_str_evictions = "Abandoned Reassemblies";
+static const gchar *st_str_eviction_protos = "By Protocol";
+static const gchar *st_str_eviction_reasons = "By Reason";
+static const gchar *st_str_eviction_fragments = "Fragments Freed";
+static const gchar *st_str_eviction_bytes = "Bytes Freed";
+
+static int st_node_evictions = -1;
+static int st_node_eviction_protos = -1;
+static int st_node_eviction_reasons = -1;
+
+static void
+reassembly_stats_tree_init(stats_tree *st)
+{
+	st_node_evictions = stats_tree_create_node(st, st_str_evictions, 0, TRUE);
+	st_node_eviction_protos = stats_tree_create_pivot(st, st_str_eviction_protos,
+	    st_node_evictions);
+	st_node_eviction_reasons = stats_tree_create_pivot(st, st_str_eviction_reasons,
+	    st_node_evictions);
+	stats_tree_create_node(st, st_str_eviction_fragments, 0, FALSE);
+	stats_tree_create_node(st, st_str_eviction_bytes, 0, FALSE);
+}
+
+static int
+reassembly_stats_tree_packet(stats_tree *st, packet_info *pinfo _U_,
+    epan_dissect_t *edt _U_, const void *p)
+{
+	const reassembly_eviction_t *ev = (const reassembly_eviction_t *)p;
+
+	tick_stat_node(st, st_str_evictions, 0, FALSE);
+	stats_tree_tick_pivot(st, st_node_eviction_protos,
+	    ev->proto ? ev->proto : "Unknown");
+	stats_tree_tick_pivot(st, st_node_eviction_reasons,
+	    val_to_str_const(ev->reason, reassembly_eviction_reasons, "Unknown"));
+	increase_stat_node(st, st_str_eviction_fragments, 0, FALSE, ev->fragments);
+	increase_stat_node(st, st_str_eviction_bytes, 0, FALSE, ev->bytes);
+	return 1;
+}
+
 static int
 dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void* data)
 {
@@ -728,6 +839,8 @@ dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void*
 		PROTO_ITEM_SET_GENERATED(item);
 	}
 
+	report_evicted_reassemblies_in_frame(tvb, pinfo, fh_tree);
+
 	tap_queue_packet(frame_tap, pinfo, NULL);
 
 
@@ -968,7 +1081,8 @@ proto_register_frame(void)
 	static ei_register_info ei[] = {
 		{ &ei_comments_text, { "frame.comment.expert", PI_COMMENTS_GROUP, PI_COMMENT, "Formatted comment", EXPFILL }},
 		{ &ei_arrive_time_out_of_range, { "frame.time_invalid", PI_SEQUENCE, PI_NOTE, "Arrival Time: Fractional second out of range (0-1000000000)", EXPFILL }},
-		{ &ei_incomplete, { "frame.incomplete", PI_UNDECODED, PI_NOTE, "Incomplete dissector", EXPFILL }}
+		{ &ei_incomplete, { "frame.incomplete", PI_UNDECODED, PI_NOTE, "Incomplete dissector", EXPFILL }},
+		{ &ei_reassembly_evicted, { "frame.reassembly_evicted", PI_REASSEMBLE, PI_WARN, "Reassembly abandoned", EXPFILL }}
 	};
 
 	module_t *frame_module;
@@ -1034,8 +1148,13 @@ proto_register_frame(void)
 	    "Disable 'packet size limited during capture' message in summary",
 	    "Whether or not 'packet size limited during capture' message in shown in Info column.",
 	    &disable_packet_size_limited_in_summary);
+	prefs_register_bool_preference(frame_module, "report_evicted_reassemblies",
+	    "Report abandoned reassemblies",
+	    "Whether or not reassemblies abandoned because of reassembly memory or age limits should be reported as expert info on the frame in which they were abandoned.",
+	    &report_evicted_reassemblies);
 
 	frame_tap=register_tap("frame");
+	reassembly_tap=register_tap("reassembly");
 }
 
 void
@@ -1043,6 +1162,9 @@ proto_reg_handoff_frame(void)
 {
 	docsis_handle = find_dissector_add_dependency("docsis", proto_frame);
 	sysdig_handle = find_dissector_add_dependency("sysdig", proto_frame);
+
+	stats_tree_register("reassembly", "reassembly", "Abandoned Reassemblies", 0,
+	    reassembly_stats_tree_packet, reassembly_stats_tree_init, NULL);
 }
 
 /*
@@ -796,6 +796,7 @@ proto_register_json(void)
 	module_t *json_module;
 
 	proto_json = proto_register_protocol("JavaScript Object Notation", "JSON", "json");
+	proto_set_stateless(proto_json);
 	hfi_json = proto_registrar_get_nth(proto_json);
 
 	proto_register_fields(proto_json, hfi, array_length(hfi));
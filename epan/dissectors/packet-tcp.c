@@ -1344,6 +1344,7 @@ static gboolean mptcp_intersubflows_retransmission  = FALSE;
 #define TCP_S_BASE_SEQ_SET 0x01
 #define TCP_S_SAW_SYN      0x03
 #define TCP_S_SAW_SYNACK   0x05
+#define TCP_S_SAW_FIN      0x08
 
 
 /* Describe the fields sniffed and set in mptcp_meta_flow_t:static_flags */
@@ -1449,6 +1450,44 @@ init_tcp_conversation_data(packet_info *pinfo)
     return tcpd;
 }
 
+static void
+tcp_flow_free(tcp_flow_t *flow)
+{
+    tcp_unacked_t *ual, *next;
+
+    wmem_tree_destroy(flow->multisegment_pdus, FALSE, TRUE);
+    if (flow->tcp_analyze_seq_info) {
+        for (ual = flow->tcp_analyze_seq_info->segments; ual; ual = next) {
+            next = ual->next;
+            wmem_free(wmem_file_scope(), ual);
+        }
+        wmem_free(wmem_file_scope(), flow->tcp_analyze_seq_info);
+    }
+    if (flow->process_info) {
+        wmem_free(wmem_file_scope(), flow->process_info->username);
+        wmem_free(wmem_file_scope(), flow->process_info->command);
+        wmem_free(wmem_file_scope(), flow->process_info);
+    }
+}
+
+/* Free the data of a conversation that's been retired.  The subflows of
+ * an MPTCP connection refer to each other's data, so that's left alone.
+ */
+static gboolean
+tcp_conversation_retire(conversation_t *conv _U_, void *proto_data)
+{
+    struct tcp_analysis *tcpd = (struct tcp_analysis *)proto_data;
+
+    if (tcpd->mptcp_analysis)
+        return FALSE;
+
+    tcp_flow_free(&tcpd->flow1);
+    tcp_flow_free(&tcpd->flow2);
+    wmem_tree_destroy(tcpd->acked_table, FALSE, TRUE);
+    wmem_free(wmem_file_scope(), tcpd);
+    return TRUE;
+}
+
 /* setup meta as well */
 static void
 mptcp_init_subflow(tcp_flow_t *flow)
@@ -2997,8 +3036,12 @@ missing_segments(packet_info *pinfo, struct tcp_multisegment_pdu *msp, guint32 s
     }
 
     fd_head = fragment_get(&tcp_reassembly_table, pinfo, msp->first_frame, NULL);
-    /* msp implies existence of fragments, this should never be NULL. */
-    DISSECTOR_ASSERT(fd_head);
+    /* msp implies existence of fragments, unless the reassembly was
+     * abandoned because of reassembly_tables_set_limits(); there's nothing
+     * left to extend in that case. */
+    if (!fd_head) {
+        return FALSE;
+    }
 
     /* Find length of contiguous fragments. */
     guint32 max = 0;
@@ -6088,6 +6131,18 @@ dissect_tcp(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree, void* data _U_)
         tcph->th_stream = tcpd->stream;
     }
 
+    /* Once both sides have sent a FIN, or either a RST, the connection
+     * is over, and its conversation can be retired sooner.
+     */
+    if (tcpd && !pinfo->fd->flags.visited && !pinfo->flags.in_error_pkt) {
+        if (tcph->th_flags & TH_FIN)
+            tcpd->fwd->static_flags |= TCP_S_SAW_FIN;
+        if ((tcph->th_flags & TH_RST) ||
+            ((tcpd->fwd->static_flags & TCP_S_SAW_FIN) &&
+             (tcpd->rev->static_flags & TCP_S_SAW_FIN)))
+            conversation_set_closed(conv);
+    }
+
     /* Do we need to calculate timestamps relative to the tcp-stream? */
     if (tcp_calculate_ts) {
         tcppd = (struct tcp_per_packet_data_t *)p_get_proto_data(wmem_file_scope(), pinfo, proto_tcp, pinfo->curr_layer_num);
@@ -7736,6 +7791,7 @@ proto_register_tcp(void)
         &tcp_display_process_info);
 
     register_init_routine(tcp_init);
+    conversation_register_retire_routine(proto_tcp, tcp_conversation_retire);
     reassembly_table_register(&tcp_reassembly_table,
                           &addresses_ports_reassembly_table_functions);
 
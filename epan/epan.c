@@ -525,6 +525,13 @@ epan_dissect_fake_protocols(epan_dissect_t *edt, const gboolean fake_protocols)
 		proto_tree_set_fake_protocols(edt->tree, fake_protocols);
 }
 
+void
+epan_dissect_prune_protocols(epan_dissect_t *edt, const gboolean prune_protocols)
+{
+	if (edt && edt->tree)
+		proto_tree_set_prune_protocols(edt->tree, prune_protocols);
+}
+
 void
 epan_dissect_run(epan_dissect_t *edt, int file_type_subtype,
 	wtap_rec *rec, tvbuff_t *tvb, frame_data *fd,
@@ -192,6 +192,13 @@ WS_DLL_PUBLIC
 void
 epan_dissect_fake_protocols(epan_dissect_t *edt, const gboolean fake_protocols);
 
+/** Indicate whether we should skip stateless protocols that none of the
+ *  fields the tree is primed with can come from; this only applies to
+ *  trees that aren't visible, when no columns are filled in. */
+WS_DLL_PUBLIC
+void
+epan_dissect_prune_protocols(epan_dissect_t *edt, const gboolean prune_protocols);
+
 /** run a single packet dissection */
 WS_DLL_PUBLIC
 void
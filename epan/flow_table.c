@@ -0,0 +1,413 @@
+/* flow_table.c
+ * Routines for the hash tables that conversations are looked up in
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "flow_table.h"
+
+/*
+ * Addresses of up to this many bytes are copied into the table.
+ */
+#define FLOW_ADDR_INLINE_LEN	16
+
+/*
+ * Length kept for an address that's in the table by reference.
+ */
+#define FLOW_ADDR_REF		0xff
+
+#define FLOW_TABLE_INITIAL_CAPACITY	64
+
+typedef union {
+	guint8 bytes[FLOW_ADDR_INLINE_LEN];
+	const address *ref;
+} flow_addr_data_t;
+
+/*
+ * One slot of the table; 64 bytes on LP64 platforms, so that a slot
+ * fills a cache line.  Only the fields that are part of the table's keys
+ * are set.
+ */
+typedef struct {
+	void *value;		/* NULL if the slot is empty */
+	guint32 hash;
+	guint32 etype;
+	guint32 port1;
+	guint32 port2;
+	guint16 addr1_type;
+	guint16 addr2_type;
+	guint8 addr1_len;	/* FLOW_ADDR_REF if kept by reference */
+	guint8 addr2_len;
+	flow_addr_data_t addr1;
+	flow_addr_data_t addr2;
+} flow_slot_t;
+
+struct _flow_table {
+	flow_slot_t *slots;	/* NULL until the first insert */
+	guint capacity;		/* 0 or a power of 2 */
+	guint count;
+	guint fields;
+	wmem_allocator_t *master;
+	wmem_allocator_t *slave;
+	guint master_cb_id;
+	guint slave_cb_id;
+};
+
+/*
+ * How far the entry in slot i is from the slot its hash puts it in.
+ */
+#define FLOW_SLOT_DISTANCE(slot, i, mask) (((i) - ((slot)->hash & (mask))) & (mask))
+
+void
+flow_address_init(flow_address_t *fa, const address *addr)
+{
+	static const address none_address = ADDRESS_INIT_NONE;
+	const guint8 *data;
+	guint32 hash;
+	int i;
+
+	if (addr == NULL)
+		addr = &none_address;
+
+	/* FNV-1a */
+	hash = 2166136261U;
+	hash = (hash ^ (guint32)addr->type) * 16777619U;
+	hash = (hash ^ (guint32)addr->len) * 16777619U;
+	data = (const guint8 *)addr->data;
+	for (i = 0; i < addr->len; i++)
+		hash = (hash ^ data[i]) * 16777619U;
+
+	fa->addr = addr;
+	fa->hash = hash;
+}
+
+static inline guint32
+flow_hash_combine(guint32 hash, guint32 val)
+{
+	return hash ^ (val + 0x9e3779b9U + (hash << 6) + (hash >> 2));
+}
+
+static guint32
+flow_table_hash(const flow_table_t *table, const flow_key_t *key)
+{
+	guint32 hash;
+
+	hash = flow_hash_combine(key->addr1.hash, key->etype);
+	hash = flow_hash_combine(hash, key->port1);
+	if (table->fields & FLOW_TABLE_ADDR2)
+		hash = flow_hash_combine(hash, key->addr2.hash);
+	if (table->fields & FLOW_TABLE_PORT2)
+		hash = flow_hash_combine(hash, key->port2);
+
+	/*
+	 * MurmurHash3's finalizer, so that the low bits, which pick the
+	 * slot, depend on all of the key.
+	 */
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bU;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35U;
+	hash ^= hash >> 16;
+
+	return hash;
+}
+
+static inline void
+flow_slot_set_addr(guint16 *type, guint8 *len, flow_addr_data_t *data, const address *addr)
+{
+	if (addr->len >= 0 && addr->len <= FLOW_ADDR_INLINE_LEN &&
+	    (guint)addr->type <= G_MAXUINT16) {
+		*type = (guint16)addr->type;
+		*len = (guint8)addr->len;
+		if (addr->len != 0)
+			memcpy(data->bytes, addr->data, addr->len);
+	} else {
+		*type = 0;
+		*len = FLOW_ADDR_REF;
+		data->ref = addr;
+	}
+}
+
+static inline gboolean
+flow_slot_addr_equal(guint16 type, guint8 len, const flow_addr_data_t *data, const address *addr)
+{
+	if (len == FLOW_ADDR_REF)
+		return addresses_equal(data->ref, addr);
+
+	return type == (guint)addr->type && len == addr->len &&
+	    (len == 0 || memcmp(data->bytes, addr->data, len) == 0);
+}
+
+static void
+flow_slot_set(const flow_table_t *table, flow_slot_t *slot, guint32 hash,
+    const flow_key_t *key, void *value)
+{
+	memset(slot, 0, sizeof *slot);
+	slot->value = value;
+	slot->hash = hash;
+	slot->etype = key->etype;
+	slot->port1 = key->port1;
+	flow_slot_set_addr(&slot->addr1_type, &slot->addr1_len, &slot->addr1, key->addr1.addr);
+	if (table->fields & FLOW_TABLE_PORT2)
+		slot->port2 = key->port2;
+	if (table->fields & FLOW_TABLE_ADDR2)
+		flow_slot_set_addr(&slot->addr2_type, &slot->addr2_len, &slot->addr2, key->addr2.addr);
+}
+
+static inline gboolean
+flow_slot_matches(const flow_table_t *table, const flow_slot_t *slot, guint32 hash,
+    const flow_key_t *key)
+{
+	if (slot->hash != hash || slot->etype != key->etype || slot->port1 != key->port1)
+		return FALSE;
+	if ((table->fields & FLOW_TABLE_PORT2) && slot->port2 != key->port2)
+		return FALSE;
+	if (!flow_slot_addr_equal(slot->addr1_type, slot->addr1_len, &slot->addr1, key->addr1.addr))
+		return FALSE;
+	if ((table->fields & FLOW_TABLE_ADDR2) &&
+	    !flow_slot_addr_equal(slot->addr2_type, slot->addr2_len, &slot->addr2, key->addr2.addr))
+		return FALSE;
+	return TRUE;
+}
+
+static flow_slot_t *
+flow_table_find(const flow_table_t *table, guint32 hash, const flow_key_t *key)
+{
+	flow_slot_t *slot;
+	guint mask, i, dist;
+
+	if (table->slots == NULL)
+		return NULL;
+
+	mask = table->capacity - 1;
+	for (i = hash & mask, dist = 0; ; i = (i + 1) & mask, dist++) {
+		slot = &table->slots[i];
+		/*
+		 * An entry that's nearer its own slot than we'd be to ours
+		 * would have been displaced by us when we were inserted,
+		 * so we're not in the table.
+		 */
+		if (slot->value == NULL || FLOW_SLOT_DISTANCE(slot, i, mask) < dist)
+			return NULL;
+		if (flow_slot_matches(table, slot, hash, key))
+			return slot;
+	}
+}
+
+/*
+ * Put an entry that isn't in the table into it.  Clobbers the entry.
+ */
+static void
+flow_table_place(flow_table_t *table, flow_slot_t *entry)
+{
+	flow_slot_t *slot, tmp;
+	guint mask, i, dist, slot_dist;
+
+	mask = table->capacity - 1;
+	for (i = entry->hash & mask, dist = 0; ; i = (i + 1) & mask, dist++) {
+		slot = &table->slots[i];
+		if (slot->value == NULL) {
+			*slot = *entry;
+			return;
+		}
+		slot_dist = FLOW_SLOT_DISTANCE(slot, i, mask);
+		if (slot_dist < dist) {
+			/*
+			 * Take the slot from the entry that's nearer its own
+			 * slot, and go on to find a place for that one.
+			 */
+			tmp = *slot;
+			*slot = *entry;
+			*entry = tmp;
+			dist = slot_dist;
+		}
+	}
+}
+
+static void
+flow_table_grow(flow_table_t *table)
+{
+	flow_slot_t *old_slots, entry;
+	guint old_capacity, i;
+
+	old_slots = table->slots;
+	old_capacity = table->capacity;
+
+	table->capacity = old_capacity ? old_capacity * 2 : FLOW_TABLE_INITIAL_CAPACITY;
+	table->slots = g_new0(flow_slot_t, table->capacity);
+
+	for (i = 0; i < old_capacity; i++) {
+		if (old_slots[i].value != NULL) {
+			entry = old_slots[i];
+			flow_table_place(table, &entry);
+		}
+	}
+	g_free(old_slots);
+}
+
+static void
+flow_table_clear(flow_table_t *table)
+{
+	g_free(table->slots);
+	table->slots = NULL;
+	table->capacity = 0;
+	table->count = 0;
+}
+
+static gboolean
+flow_table_reset_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event,
+    void *user_data)
+{
+	flow_table_t *table = (flow_table_t *)user_data;
+
+	flow_table_clear(table);
+
+	if (event == WMEM_CB_DESTROY_EVENT) {
+		wmem_unregister_callback(table->master, table->master_cb_id);
+		wmem_free(table->master, table);
+	}
+
+	return TRUE;
+}
+
+static gboolean
+flow_table_destroy_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event _U_,
+    void *user_data)
+{
+	flow_table_t *table = (flow_table_t *)user_data;
+
+	flow_table_clear(table);
+	if (table->slave != NULL)
+		wmem_unregister_callback(table->slave, table->slave_cb_id);
+
+	return FALSE;
+}
+
+flow_table_t *
+flow_table_new(wmem_allocator_t *allocator, const guint fields)
+{
+	flow_table_t *table;
+
+	table = wmem_new0(allocator, flow_table_t);
+	table->fields = fields;
+	table->master = allocator;
+	table->master_cb_id = wmem_register_callback(allocator, flow_table_destroy_cb, table);
+
+	return table;
+}
+
+flow_table_t *
+flow_table_new_autoreset(wmem_allocator_t *master, wmem_allocator_t *slave, const guint fields)
+{
+	flow_table_t *table;
+
+	table = flow_table_new(master, fields);
+	table->slave = slave;
+	table->slave_cb_id = wmem_register_callback(slave, flow_table_reset_cb, table);
+
+	return table;
+}
+
+void *
+flow_table_lookup(const flow_table_t *table, const flow_key_t *key)
+{
+	flow_slot_t *slot;
+
+	slot = flow_table_find(table, flow_table_hash(table, key), key);
+	return slot ? slot->value : NULL;
+}
+
+void
+flow_table_insert(flow_table_t *table, const flow_key_t *key, void *value)
+{
+	flow_slot_t *slot, entry;
+	guint32 hash;
+
+	hash = flow_table_hash(table, key);
+	slot = flow_table_find(table, hash, key);
+	if (slot != NULL) {
+		/* Same key, so same hash and same place. */
+		flow_slot_set(table, slot, hash, key, value);
+		return;
+	}
+
+	/* Keep the table at most 7/8 full. */
+	if (table->count >= table->capacity - table->capacity / 8)
+		flow_table_grow(table);
+
+	flow_slot_set(table, &entry, hash, key, value);
+	flow_table_place(table, &entry);
+	table->count++;
+}
+
+void *
+flow_table_remove(flow_table_t *table, const flow_key_t *key)
+{
+	flow_slot_t *slot;
+	void *value;
+	guint mask, i, next;
+
+	slot = flow_table_find(table, flow_table_hash(table, key), key);
+	if (slot == NULL)
+		return NULL;
+
+	value = slot->value;
+
+	/*
+	 * Move the entries after it that aren't in their own slots back
+	 * by one, so that lookups never have to step over a hole.
+	 */
+	mask = table->capacity - 1;
+	i = (guint)(slot - table->slots);
+	for (;;) {
+		next = (i + 1) & mask;
+		if (table->slots[next].value == NULL ||
+		    FLOW_SLOT_DISTANCE(&table->slots[next], next, mask) == 0)
+			break;
+		table->slots[i] = table->slots[next];
+		i = next;
+	}
+	table->slots[i].value = NULL;
+	table->count--;
+
+	return value;
+}
+
+guint
+flow_table_count(const flow_table_t *table)
+{
+	return table->count;
+}
+
+void
+flow_table_foreach(const flow_table_t *table, GFunc func, gpointer user_data)
+{
+	guint i;
+
+	for (i = 0; i < table->capacity; i++) {
+		if (table->slots[i].value != NULL)
+			func(table->slots[i].value, user_data);
+	}
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
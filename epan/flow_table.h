@@ -0,0 +1,111 @@
+/* flow_table.h
+ * Definitions for the hash tables that conversations are looked up in
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FLOW_TABLE_H__
+#define __FLOW_TABLE_H__
+
+#include <glib.h>
+
+#include <epan/address.h>
+#include <epan/wmem/wmem.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A flow table maps {address 1, port 1, address 2, port 2, endpoint type}
+ * keys to values.  It's an open-addressing table using Robin Hood
+ * probing, with the keys kept in the table itself rather than in separately
+ * allocated entries: addresses of up to 16 bytes, such as IPv4 and IPv6
+ * addresses, are copied into the table, so looking a key up reads one or
+ * two cache lines and follows no pointers.  Longer addresses are kept by
+ * reference, and the address must stay valid as long as its key is in
+ * the table.
+ *
+ * A table can leave address 2, port 2 or both out of its keys, for
+ * wildcarded lookups; keys that differ only in what's left out are the
+ * same key.
+ *
+ * Each address's hash is computed once, by flow_address_init(), so a
+ * lookup that's tried in several tables, or in both directions, doesn't
+ * hash the same address again.
+ */
+#define FLOW_TABLE_ADDR2	0x01	/* Address 2 is part of the keys */
+#define FLOW_TABLE_PORT2	0x02	/* Port 2 is part of the keys */
+
+typedef struct _flow_table flow_table_t;
+
+/*
+ * An address and its hash.
+ */
+typedef struct {
+	const address *addr;
+	guint32 hash;
+} flow_address_t;
+
+typedef struct {
+	flow_address_t addr1;
+	flow_address_t addr2;
+	guint32 etype;
+	guint32 port1;
+	guint32 port2;
+} flow_key_t;
+
+/** Set up a flow_address_t for an address; a NULL address is taken to be
+ * an address of type AT_NONE. */
+void flow_address_init(flow_address_t *fa, const address *addr);
+
+/** Create a flow table that's freed with the given allocator, with the
+ * FLOW_TABLE_ fields in its keys. */
+flow_table_t *flow_table_new(wmem_allocator_t *allocator, const guint fields);
+
+/** Create a flow table that's freed with the master allocator and
+ * emptied whenever the slave allocator is freed, like
+ * wmem_map_new_autoreset(). */
+flow_table_t *flow_table_new_autoreset(wmem_allocator_t *master,
+    wmem_allocator_t *slave, const guint fields);
+
+/** Look up a key; returns NULL if it isn't in the table. */
+void *flow_table_lookup(const flow_table_t *table, const flow_key_t *key);
+
+/** Insert a key with a value, which mustn't be NULL.  If the key is
+ * already in the table, its value is replaced, and the table refers to
+ * the new key's addresses from then on. */
+void flow_table_insert(flow_table_t *table, const flow_key_t *key, void *value);
+
+/** Remove a key; returns its value, or NULL if it wasn't in the table. */
+void *flow_table_remove(flow_table_t *table, const flow_key_t *key);
+
+/** Number of keys in the table. */
+guint flow_table_count(const flow_table_t *table);
+
+/** Call a function for each value in the table, in no particular order.
+ * The table mustn't be changed while this is going on. */
+void flow_table_foreach(const flow_table_t *table, GFunc func, gpointer user_data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FLOW_TABLE_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -0,0 +1,460 @@
+/* flow_table_test.c
+ * Standalone program to test the flow tables that conversations are
+ * looked up in, and to time lookups in them.
+ *
+ * Run "flow_table_test --verbose" to see the timings, and add "-m perf"
+ * to time them with more flows.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include <epan/address.h>
+#include <epan/wmem/wmem.h>
+
+#include "flow_table.h"
+
+#define TEST_ETYPE      2
+#define TEST_PORT_A     1024
+#define TEST_PORT_B     80
+
+static wmem_allocator_t *test_scope;
+
+/*
+ * A set of flows between distinct IPv4 or IPv6 addresses, with the
+ * client ports going up from TEST_PORT_A.
+ */
+typedef struct {
+    guint n_flows;
+    guint8 *addr_data;
+    address *addr_a;
+    address *addr_b;
+} test_flows_t;
+
+static void
+test_flows_init(test_flows_t *flows, guint n_flows, gboolean ipv6)
+{
+    int len = ipv6 ? 16 : 4;
+    guint i;
+
+    flows->n_flows = n_flows;
+    flows->addr_data = g_new0(guint8, 2 * n_flows * len);
+    flows->addr_a = g_new(address, n_flows);
+    flows->addr_b = g_new(address, n_flows);
+
+    for (i = 0; i < n_flows; i++) {
+        guint8 *a = flows->addr_data + 2 * i * len;
+        guint8 *b = a + len;
+
+        /* 10.x.y.z <-> 192.168.x.y, or the IPv6 equivalents */
+        a[0] = 10;
+        a[len - 3] = (guint8)(i >> 16);
+        a[len - 2] = (guint8)(i >> 8);
+        a[len - 1] = (guint8)i;
+        b[0] = 192;
+        b[1] = 168;
+        b[len - 2] = (guint8)(i >> 8);
+        b[len - 1] = (guint8)(i % 251);
+
+        set_address(&flows->addr_a[i], ipv6 ? AT_IPv6 : AT_IPv4, len, a);
+        set_address(&flows->addr_b[i], ipv6 ? AT_IPv6 : AT_IPv4, len, b);
+    }
+}
+
+static void
+test_flows_free(test_flows_t *flows)
+{
+    g_free(flows->addr_data);
+    g_free(flows->addr_a);
+    g_free(flows->addr_b);
+}
+
+static void
+test_flow_key(flow_key_t *key, const address *addr1, const address *addr2,
+              guint32 port1, guint32 port2)
+{
+    flow_address_init(&key->addr1, addr1);
+    flow_address_init(&key->addr2, addr2);
+    key->etype = TEST_ETYPE;
+    key->port1 = port1;
+    key->port2 = port2;
+}
+
+static void
+flow_table_test_exact(void)
+{
+    flow_table_t *table;
+    test_flows_t flows;
+    flow_key_t key;
+    guint i;
+
+    table = flow_table_new(test_scope, FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+    test_flows_init(&flows, 1000, FALSE);
+
+    for (i = 0; i < flows.n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A + i, TEST_PORT_B);
+        flow_table_insert(table, &key, GUINT_TO_POINTER(i + 1));
+    }
+    g_assert_cmpuint(flow_table_count(table), ==, flows.n_flows);
+
+    for (i = 0; i < flows.n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A + i, TEST_PORT_B);
+        g_assert(flow_table_lookup(table, &key) == GUINT_TO_POINTER(i + 1));
+
+        /* Keys are directional. */
+        test_flow_key(&key, &flows.addr_b[i], &flows.addr_a[i], TEST_PORT_B, TEST_PORT_A + i);
+        g_assert(flow_table_lookup(table, &key) == NULL);
+
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A + i, TEST_PORT_B + 1);
+        g_assert(flow_table_lookup(table, &key) == NULL);
+
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A + i, TEST_PORT_B);
+        key.etype = TEST_ETYPE + 1;
+        g_assert(flow_table_lookup(table, &key) == NULL);
+    }
+
+    /* Inserting a key that's there replaces its value. */
+    test_flow_key(&key, &flows.addr_a[0], &flows.addr_b[0], TEST_PORT_A, TEST_PORT_B);
+    flow_table_insert(table, &key, GUINT_TO_POINTER(12345));
+    g_assert_cmpuint(flow_table_count(table), ==, flows.n_flows);
+    g_assert(flow_table_lookup(table, &key) == GUINT_TO_POINTER(12345));
+
+    test_flows_free(&flows);
+}
+
+static void
+flow_table_test_wildcards(void)
+{
+    flow_table_t *no_addr2, *no_port2, *no_addr2_or_port2;
+    guint8 data[3][4] = { { 10, 0, 0, 1 }, { 10, 0, 0, 2 }, { 10, 0, 0, 3 } };
+    address addr[3];
+    flow_key_t key;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        set_address(&addr[i], AT_IPv4, 4, data[i]);
+
+    no_addr2 = flow_table_new(test_scope, FLOW_TABLE_PORT2);
+    no_port2 = flow_table_new(test_scope, FLOW_TABLE_ADDR2);
+    no_addr2_or_port2 = flow_table_new(test_scope, 0);
+
+    test_flow_key(&key, &addr[0], NULL, TEST_PORT_A, TEST_PORT_B);
+    flow_table_insert(no_addr2, &key, GINT_TO_POINTER(1));
+    test_flow_key(&key, &addr[0], &addr[1], TEST_PORT_A, 0);
+    flow_table_insert(no_port2, &key, GINT_TO_POINTER(2));
+    test_flow_key(&key, &addr[0], NULL, TEST_PORT_A, 0);
+    flow_table_insert(no_addr2_or_port2, &key, GINT_TO_POINTER(3));
+
+    test_flow_key(&key, &addr[0], &addr[2], TEST_PORT_A, TEST_PORT_B);
+    g_assert(flow_table_lookup(no_addr2, &key) == GINT_TO_POINTER(1));
+    g_assert(flow_table_lookup(no_port2, &key) == NULL);
+    g_assert(flow_table_lookup(no_addr2_or_port2, &key) == GINT_TO_POINTER(3));
+
+    test_flow_key(&key, &addr[0], &addr[1], TEST_PORT_A, TEST_PORT_B + 1);
+    g_assert(flow_table_lookup(no_addr2, &key) == NULL);
+    g_assert(flow_table_lookup(no_port2, &key) == GINT_TO_POINTER(2));
+    g_assert(flow_table_lookup(no_addr2_or_port2, &key) == GINT_TO_POINTER(3));
+
+    test_flow_key(&key, &addr[1], &addr[0], TEST_PORT_A, TEST_PORT_B);
+    g_assert(flow_table_lookup(no_addr2, &key) == NULL);
+    g_assert(flow_table_lookup(no_port2, &key) == NULL);
+    g_assert(flow_table_lookup(no_addr2_or_port2, &key) == NULL);
+}
+
+static void
+flow_table_test_long_addresses(void)
+{
+    flow_table_t *table;
+    gchar name1[] = "a name longer than sixteen bytes";
+    gchar name2[] = "a name longer than sixteen bytes";
+    gchar name3[] = "another name longer than sixteen bytes";
+    address addr1, addr2, addr3, none;
+    flow_key_t key;
+
+    /* Addresses too long to copy into the table are kept by reference. */
+    set_address(&addr1, AT_STRINGZ, (int)sizeof name1, name1);
+    set_address(&addr2, AT_STRINGZ, (int)sizeof name2, name2);
+    set_address(&addr3, AT_STRINGZ, (int)sizeof name3, name3);
+    clear_address(&none);
+
+    table = flow_table_new(test_scope, FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+    test_flow_key(&key, &addr1, &none, TEST_PORT_A, TEST_PORT_B);
+    flow_table_insert(table, &key, GINT_TO_POINTER(1));
+
+    test_flow_key(&key, &addr2, NULL, TEST_PORT_A, TEST_PORT_B);
+    g_assert(flow_table_lookup(table, &key) == GINT_TO_POINTER(1));
+    test_flow_key(&key, &addr3, NULL, TEST_PORT_A, TEST_PORT_B);
+    g_assert(flow_table_lookup(table, &key) == NULL);
+
+    test_flow_key(&key, &addr2, NULL, TEST_PORT_A, TEST_PORT_B);
+    g_assert(flow_table_remove(table, &key) == GINT_TO_POINTER(1));
+    g_assert_cmpuint(flow_table_count(table), ==, 0);
+}
+
+static void
+flow_table_test_remove(void)
+{
+    flow_table_t *table;
+    test_flows_t flows;
+    flow_key_t key;
+    guint i;
+
+    /* Enough flows to grow the table several times. */
+    table = flow_table_new(test_scope, FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+    test_flows_init(&flows, 20000, TRUE);
+
+    for (i = 0; i < flows.n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A, TEST_PORT_B);
+        flow_table_insert(table, &key, GUINT_TO_POINTER(i + 1));
+    }
+    for (i = 0; i < flows.n_flows; i += 2) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A, TEST_PORT_B);
+        g_assert(flow_table_remove(table, &key) == GUINT_TO_POINTER(i + 1));
+        g_assert(flow_table_remove(table, &key) == NULL);
+    }
+    g_assert_cmpuint(flow_table_count(table), ==, flows.n_flows / 2);
+
+    for (i = 0; i < flows.n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A, TEST_PORT_B);
+        if (i % 2 == 0)
+            g_assert(flow_table_lookup(table, &key) == NULL);
+        else
+            g_assert(flow_table_lookup(table, &key) == GUINT_TO_POINTER(i + 1));
+    }
+
+    test_flows_free(&flows);
+}
+
+static void
+flow_table_test_count_value(gpointer data _U_, gpointer user_data)
+{
+    (*(guint *)user_data)++;
+}
+
+static void
+flow_table_test_autoreset(void)
+{
+    wmem_allocator_t *slave;
+    flow_table_t *table;
+    test_flows_t flows;
+    flow_key_t key;
+    guint i, n_values;
+
+    slave = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
+    table = flow_table_new_autoreset(test_scope, slave, FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+    test_flows_init(&flows, 100, FALSE);
+
+    for (i = 0; i < flows.n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A, TEST_PORT_B);
+        flow_table_insert(table, &key, GUINT_TO_POINTER(i + 1));
+    }
+    n_values = 0;
+    flow_table_foreach(table, flow_table_test_count_value, &n_values);
+    g_assert_cmpuint(n_values, ==, flows.n_flows);
+
+    wmem_free_all(slave);
+    g_assert_cmpuint(flow_table_count(table), ==, 0);
+    g_assert(flow_table_lookup(table, &key) == NULL);
+
+    flow_table_insert(table, &key, GINT_TO_POINTER(1));
+    g_assert(flow_table_lookup(table, &key) == GINT_TO_POINTER(1));
+
+    wmem_destroy_allocator(slave);
+    test_flows_free(&flows);
+}
+
+/*
+ * Keys as the conversation hash tables used to have them, in chained
+ * wmem_map_t's, to time lookups against.
+ */
+typedef struct {
+    address addr1;
+    address addr2;
+    guint32 port1;
+    guint32 port2;
+} chained_key_t;
+
+static guint
+chained_key_hash(gconstpointer v)
+{
+    const chained_key_t *key = (const chained_key_t *)v;
+    guint hash_val = 0;
+    address tmp_addr;
+
+    tmp_addr.len = 4;
+    hash_val = add_address_to_hash(hash_val, &key->addr1);
+    tmp_addr.data = &key->port1;
+    hash_val = add_address_to_hash(hash_val, &tmp_addr);
+    hash_val = add_address_to_hash(hash_val, &key->addr2);
+    tmp_addr.data = &key->port2;
+    hash_val = add_address_to_hash(hash_val, &tmp_addr);
+
+    hash_val += ( hash_val << 3 );
+    hash_val ^= ( hash_val >> 11 );
+    hash_val += ( hash_val << 15 );
+
+    return hash_val;
+}
+
+static gboolean
+chained_key_equal(gconstpointer v, gconstpointer w)
+{
+    const chained_key_t *v1 = (const chained_key_t *)v;
+    const chained_key_t *v2 = (const chained_key_t *)w;
+
+    return v1->port1 == v2->port1 && v1->port2 == v2->port2 &&
+        addresses_equal(&v1->addr1, &v2->addr1) &&
+        addresses_equal(&v1->addr2, &v2->addr2);
+}
+
+/*
+ * Time inserting the flows and then looking each one up the way
+ * find_conversation() does for a packet of an established connection
+ * going the other way from its first packet: a miss in one direction
+ * and a hit in the other.
+ */
+static void
+flow_table_test_perf_flows(const char *name, gboolean ipv6)
+{
+    wmem_allocator_t *allocator;
+    flow_table_t *table;
+    wmem_map_t *map;
+    chained_key_t *keys, lookup_key;
+    test_flows_t flows;
+    flow_address_t fa, fb;
+    flow_key_t key;
+    guint n_flows, i, found;
+    gdouble elapsed;
+
+    n_flows = g_test_perf() ? 2000000 : 200000;
+    test_flows_init(&flows, n_flows, ipv6);
+    allocator = wmem_allocator_new(WMEM_ALLOCATOR_BLOCK);
+
+    /* Flow table */
+    table = flow_table_new(allocator, FLOW_TABLE_ADDR2|FLOW_TABLE_PORT2);
+    g_test_timer_start();
+    for (i = 0; i < n_flows; i++) {
+        test_flow_key(&key, &flows.addr_a[i], &flows.addr_b[i], TEST_PORT_A + i, TEST_PORT_B);
+        flow_table_insert(table, &key, GUINT_TO_POINTER(i + 1));
+    }
+    elapsed = g_test_timer_elapsed();
+    g_test_minimized_result(elapsed, "%s flow table: %u inserts in %.3f s", name, n_flows, elapsed);
+
+    found = 0;
+    g_test_timer_start();
+    for (i = 0; i < n_flows; i++) {
+        flow_address_init(&fa, &flows.addr_b[i]);
+        flow_address_init(&fb, &flows.addr_a[i]);
+        key.addr1 = fa;
+        key.addr2 = fb;
+        key.etype = TEST_ETYPE;
+        key.port1 = TEST_PORT_B;
+        key.port2 = TEST_PORT_A + i;
+        if (flow_table_lookup(table, &key) == NULL) {
+            key.addr1 = fb;
+            key.addr2 = fa;
+            key.port1 = TEST_PORT_A + i;
+            key.port2 = TEST_PORT_B;
+            if (flow_table_lookup(table, &key) != NULL)
+                found++;
+        }
+    }
+    elapsed = g_test_timer_elapsed();
+    g_assert_cmpuint(found, ==, n_flows);
+    g_test_minimized_result(elapsed, "%s flow table: %u lookups in %.3f s", name, n_flows, elapsed);
+
+    /* Chained wmem_map_t */
+    map = wmem_map_new(allocator, chained_key_hash, chained_key_equal);
+    keys = g_new(chained_key_t, n_flows);
+    g_test_timer_start();
+    for (i = 0; i < n_flows; i++) {
+        copy_address_wmem(allocator, &keys[i].addr1, &flows.addr_a[i]);
+        copy_address_wmem(allocator, &keys[i].addr2, &flows.addr_b[i]);
+        keys[i].port1 = TEST_PORT_A + i;
+        keys[i].port2 = TEST_PORT_B;
+        wmem_map_insert(map, &keys[i], GUINT_TO_POINTER(i + 1));
+    }
+    elapsed = g_test_timer_elapsed();
+    g_test_minimized_result(elapsed, "%s wmem_map: %u inserts in %.3f s", name, n_flows, elapsed);
+
+    found = 0;
+    g_test_timer_start();
+    for (i = 0; i < n_flows; i++) {
+        lookup_key.addr1 = flows.addr_b[i];
+        lookup_key.addr2 = flows.addr_a[i];
+        lookup_key.port1 = TEST_PORT_B;
+        lookup_key.port2 = TEST_PORT_A + i;
+        if (wmem_map_lookup(map, &lookup_key) == NULL) {
+            lookup_key.addr1 = flows.addr_a[i];
+            lookup_key.addr2 = flows.addr_b[i];
+            lookup_key.port1 = TEST_PORT_A + i;
+            lookup_key.port2 = TEST_PORT_B;
+            if (wmem_map_lookup(map, &lookup_key) != NULL)
+                found++;
+        }
+    }
+    elapsed = g_test_timer_elapsed();
+    g_assert_cmpuint(found, ==, n_flows);
+    g_test_minimized_result(elapsed, "%s wmem_map: %u lookups in %.3f s", name, n_flows, elapsed);
+
+    g_free(keys);
+    wmem_destroy_allocator(allocator);
+    test_flows_free(&flows);
+}
+
+static void
+flow_table_test_perf_ipv4(void)
+{
+    flow_table_test_perf_flows("IPv4", FALSE);
+}
+
+static void
+flow_table_test_perf_ipv6(void)
+{
+    flow_table_test_perf_flows("IPv6", TRUE);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/flow_table/exact",          flow_table_test_exact);
+    g_test_add_func("/flow_table/wildcards",      flow_table_test_wildcards);
+    g_test_add_func("/flow_table/long_addresses", flow_table_test_long_addresses);
+    g_test_add_func("/flow_table/remove",         flow_table_test_remove);
+    g_test_add_func("/flow_table/autoreset",      flow_table_test_autoreset);
+    g_test_add_func("/flow_table/perf/ipv4",      flow_table_test_perf_ipv4);
+    g_test_add_func("/flow_table/perf/ipv6",      flow_table_test_perf_ipv6);
+
+    wmem_init();
+    test_scope = wmem_allocator_new(WMEM_ALLOCATOR_STRICT);
+    result = g_test_run();
+    wmem_destroy_allocator(test_scope);
+    wmem_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
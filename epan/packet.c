@@ -35,6 +35,7 @@
 #include <epan/reassemble.h>
 #include <epan/stream.h>
 #include <epan/expert.h>
+#include <epan/conversation.h>
 #include <epan/prefs.h>
 #include <epan/range.h>
 
@@ -569,6 +570,10 @@ dissect_record(epan_dissect_t *edt, int file_type_subtype,
 	frame_dissector_data.file_type_subtype = file_type_subtype;
 	frame_dissector_data.color_edt = edt; /* Used strictly for "coloring rules" */
 
+	/* Retire the conversations that have been idle too long, if asked to */
+	if (!fd->flags.visited)
+		conversation_retire_idle(&edt->pi);
+
 	TRY {
 		/* Add this tvbuffer into the data_src list */
 		add_new_data_source(&edt->pi, edt->tvb, record_type);
@@ -748,6 +753,16 @@ call_dissector_work(dissector_handle_t handle, tvbuff_t *tvb, packet_info *pinfo
 		return 0;
 	}
 
+	if (handle->protocol != NULL &&
+	    proto_tree_can_skip_protocol(tree, handle->protocol)) {
+		/*
+		 * Nothing wanted from this frame can come from this
+		 * protocol, or from anything it calls, and it keeps no
+		 * state; take the data without dissecting it.
+		 */
+		return tvb_captured_length(tvb);
+	}
+
 	saved_proto = pinfo->current_proto;
 	saved_can_desegment = pinfo->can_desegment;
 	saved_layers_len = wmem_list_count(pinfo->layers);
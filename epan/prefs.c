@@ -3225,6 +3225,14 @@ prefs_register_modules(void)
                                    10,
                                    &prefs.gui_fileopen_preview);
 
+    prefs_register_uint_preference(gui_module, "fileopen.index_size",
+                                   "Minimum size of capture files to index, in megabytes",
+                                   "Keep an index next to capture files of at least this many megabytes, "
+                                   "so that they can be opened again without being read through first; "
+                                   "0 means never",
+                                   10,
+                                   &prefs.gui_fileopen_index_size);
+
     prefs_register_bool_preference(gui_module, "ask_unsaved",
                                    "Ask to save unsaved capture files",
                                    "Ask to save unsaved capture files?",
@@ -4065,6 +4073,7 @@ pre_init_prefs(void)
     g_free(prefs.gui_fileopen_dir);
     prefs.gui_fileopen_dir           = g_strdup(get_persdatafile_dir());
     prefs.gui_fileopen_preview       = 3;
+    prefs.gui_fileopen_index_size    = 0;
     prefs.gui_ask_unsaved            = TRUE;
     prefs.gui_autocomplete_filter    = TRUE;
     prefs.gui_find_wrap              = TRUE;
@@ -164,6 +164,7 @@ typedef struct _e_prefs {
   guint        gui_fileopen_style;
   gchar       *gui_fileopen_dir;
   guint        gui_fileopen_preview;
+  guint        gui_fileopen_index_size;
   gboolean     gui_ask_unsaved;
   gboolean     gui_autocomplete_filter;
   gboolean     gui_find_wrap;
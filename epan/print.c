@@ -81,6 +81,7 @@ struct _output_fields {
     GPtrArray   **field_values;
     gchar         quote;
     gboolean      includes_col_fields;
+    GArray       *prime_hfids;  /* ids of the fields, to prime trees with */
 };
 
 static gchar *get_field_hex_value(GSList *src_list, field_info *fi);
@@ -2141,6 +2142,10 @@ void output_fields_free(output_fields_t* fields)
         g_ptr_array_free(fields->fields, TRUE);
     }
 
+    if (NULL != fields->prime_hfids) {
+        g_array_free(fields->prime_hfids, TRUE);
+    }
+
     g_free(fields);
 }
 
@@ -2149,6 +2154,7 @@ void output_fields_free(output_fields_t* fields)
 void output_fields_add(output_fields_t *fields, const gchar *field)
 {
     gchar *field_copy;
+    header_field_info *hfinfo;
 
     g_assert(fields);
     g_assert(field);
@@ -2163,9 +2169,29 @@ void output_fields_add(output_fields_t *fields, const gchar *field)
     g_ptr_array_add(fields->fields, field_copy);
 
     /* See if we have a column as a field entry */
-    if (!strncmp(field, COLUMN_FIELD_FILTER, strlen(COLUMN_FIELD_FILTER)))
+    if (!strncmp(field, COLUMN_FIELD_FILTER, strlen(COLUMN_FIELD_FILTER))) {
         fields->includes_col_fields = TRUE;
+        return;
+    }
 
+    /*
+     * Look up the field now rather than for every packet, noting every
+     * field with this name for output_fields_prime_edt().  Unknown
+     * fields are reported by output_fields_valid().
+     */
+    hfinfo = proto_registrar_get_byname(field);
+    if (!hfinfo)
+        return;
+
+    if (NULL == fields->prime_hfids) {
+        fields->prime_hfids = g_array_new(FALSE, FALSE, sizeof(int));
+    }
+    while (hfinfo->same_name_prev_id != -1) {
+        hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+    }
+    for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+        g_array_append_val(fields->prime_hfids, hfinfo->id);
+    }
 }
 
 static void
@@ -2329,6 +2355,18 @@ gboolean output_fields_has_cols(output_fields_t* fields)
     return fields->includes_col_fields;
 }
 
+void output_fields_prime_edt(output_fields_t* fields, epan_dissect_t *edt)
+{
+    g_assert(fields);
+
+    /* The fields were looked up by output_fields_add(). */
+    if (fields->prime_hfids == NULL) {
+        return;
+    }
+
+    epan_dissect_prime_with_hfid_array(edt, fields->prime_hfids);
+}
+
 void write_fields_preamble(output_fields_t* fields, FILE *fh)
 {
     gsize i;
@@ -63,12 +63,17 @@ typedef GSList* (*proto_node_children_grouper_func)(proto_node *node);
 
 WS_DLL_PUBLIC output_fields_t* output_fields_new(void);
 WS_DLL_PUBLIC void output_fields_free(output_fields_t* info);
+/** Add a field to be written.  Fields are looked up when they're added,
+ * so this must be called after the protocols have been registered. */
 WS_DLL_PUBLIC void output_fields_add(output_fields_t* info, const gchar* field);
 WS_DLL_PUBLIC GSList * output_fields_valid(output_fields_t* info);
 WS_DLL_PUBLIC gsize output_fields_num_fields(output_fields_t* info);
 WS_DLL_PUBLIC gboolean output_fields_set_option(output_fields_t* info, gchar* option);
 WS_DLL_PUBLIC void output_fields_list_options(FILE *fh);
 WS_DLL_PUBLIC gboolean output_fields_has_cols(output_fields_t* info);
+/** Prime the protocol tree with the fields to be written, so that they're
+ * kept in a tree that isn't visible; cheap enough to do for each packet. */
+WS_DLL_PUBLIC void output_fields_prime_edt(output_fields_t* info, epan_dissect_t *edt);
 
 /*
  * Higher-level packet-printing code.
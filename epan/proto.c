@@ -324,6 +324,7 @@ struct _protocol {
 	gboolean    is_enabled;         /* TRUE if protocol is enabled */
 	gboolean    enabled_by_default; /* TRUE if protocol is enabled by default */
 	gboolean    can_toggle;         /* TRUE if is_enabled can be changed */
+	gboolean    is_stateless;       /* TRUE if dissecting it leaves no state behind */
 	int         parent_proto_id;    /* Used to identify "pino"s (Protocol In Name Only).
                                        For dissectors that need a protocol name so they
                                        can be added to a dissector table, but use the
@@ -751,6 +752,10 @@ proto_tree_reset(proto_tree *tree)
 		g_hash_table_remove_all(tree_data->interesting_hfids);
 	}
 
+	/* The fields are primed again for the next frame. */
+	if (tree_data->wanted_protocols)
+		g_array_set_size(tree_data->wanted_protocols, 0);
+
 	/* Reset track of the number of children */
 	tree_data->count = 0;
 
@@ -775,6 +780,9 @@ proto_tree_free(proto_tree *tree)
 		g_hash_table_destroy(tree_data->interesting_hfids);
 	}
 
+	if (tree_data->wanted_protocols)
+		g_array_free(tree_data->wanted_protocols, TRUE);
+
 	g_slice_free(tree_data_t, tree_data);
 
 	g_slice_free(proto_tree, tree);
@@ -800,6 +808,62 @@ proto_tree_set_fake_protocols(proto_tree *tree, gboolean fake_protocols)
 	PTREE_DATA(tree)->fake_protocols = fake_protocols;
 }
 
+void
+proto_tree_set_prune_protocols(proto_tree *tree, gboolean prune_protocols)
+{
+	PTREE_DATA(tree)->prune_protocols = prune_protocols;
+}
+
+gboolean
+proto_tree_can_skip_protocol(proto_tree *tree, protocol_t *protocol)
+{
+	static int         hf_frame_protocols = -2;
+	tree_data_t       *tree_data;
+	header_field_info *hfinfo;
+	guint              i;
+
+	if (!tree)
+		return FALSE;
+
+	tree_data = PTREE_DATA(tree);
+	if (!tree_data->prune_protocols || tree_data->visible)
+		return FALSE;
+
+	/* Every protocol can set the columns. */
+	if (tree_data->pinfo == NULL || tree_data->pinfo->cinfo != NULL)
+		return FALSE;
+
+	if (proto_is_pino(protocol))
+		protocol = find_protocol_by_id(protocol->parent_proto_id);
+	if (!protocol->is_stateless)
+		return FALSE;
+
+	/* Are any of the protocol's fields wanted? */
+	PROTO_REGISTRAR_GET_NTH(protocol->proto_id, hfinfo);
+	if (hfinfo->ref_type != HF_REF_TYPE_NONE)
+		return FALSE;
+
+	/* frame.protocols lists all the protocols in the frame. */
+	if (hf_frame_protocols == -2)
+		hf_frame_protocols = proto_registrar_get_id_byname("frame.protocols");
+	if (hf_frame_protocols >= 0) {
+		PROTO_REGISTRAR_GET_NTH(hf_frame_protocols, hfinfo);
+		if (hfinfo->ref_type != HF_REF_TYPE_NONE)
+			return FALSE;
+	}
+
+	/* Could a protocol whose fields are wanted still be called by this
+	 * one? Not if all of them have already been dissected. */
+	if (tree_data->wanted_protocols) {
+		for (i = 0; i < tree_data->wanted_protocols->len; i++) {
+			if (!wmem_list_find(tree_data->pinfo->layers,
+			    GINT_TO_POINTER(g_array_index(tree_data->wanted_protocols, int, i))))
+				return FALSE;
+		}
+	}
+	return TRUE;
+}
+
 /* Assume dissector set only its protocol fields.
    This function is called by dissectors and allows the speeding up of filtering
    in wireshark; if this function returns FALSE it is safe to reset tree to NULL
@@ -6477,6 +6541,10 @@ proto_tree_create_root(packet_info *pinfo)
 	/* Make sure that we fake protocols (if possible) */
 	pnode->tree_data->fake_protocols = TRUE;
 
+	/* Dissect every protocol unless asked not to */
+	pnode->tree_data->prune_protocols = FALSE;
+	pnode->tree_data->wanted_protocols = NULL;
+
 	/* Keep track of the number of children */
 	pnode->tree_data->count = 0;
 
@@ -6484,10 +6552,27 @@ proto_tree_create_root(packet_info *pinfo)
 }
 
 
+/* Record the protocol of a wanted field, for proto_tree_can_skip_protocol(). */
+static void
+proto_tree_add_wanted_protocol(proto_tree *tree, int proto_id)
+{
+	tree_data_t *tree_data = PTREE_DATA(tree);
+	guint        i;
+
+	if (tree_data->wanted_protocols == NULL)
+		tree_data->wanted_protocols = g_array_new(FALSE, FALSE, sizeof(int));
+
+	for (i = 0; i < tree_data->wanted_protocols->len; i++) {
+		if (g_array_index(tree_data->wanted_protocols, int, i) == proto_id)
+			return;
+	}
+	g_array_append_val(tree_data->wanted_protocols, proto_id);
+}
+
 /* "prime" a proto_tree with a single hfid that a dfilter
  * is interested in. */
 void
-proto_tree_prime_with_hfid(proto_tree *tree _U_, const gint hfid)
+proto_tree_prime_with_hfid(proto_tree *tree, const gint hfid)
 {
 	header_field_info *hfinfo;
 
@@ -6510,6 +6595,10 @@ proto_tree_prime_with_hfid(proto_tree *tree _U_, const gint hfid)
 		if (parent_hfinfo->ref_type != HF_REF_TYPE_DIRECT)
 			parent_hfinfo->ref_type = HF_REF_TYPE_INDIRECT;
 	}
+
+	if (tree && PTREE_DATA(tree)->prune_protocols)
+		proto_tree_add_wanted_protocol(tree,
+		    hfinfo->parent != -1 ? hfinfo->parent : hfid);
 }
 
 proto_tree *
@@ -6731,6 +6820,7 @@ proto_register_protocol(const char *name, const char *short_name,
 	protocol->is_enabled = TRUE; /* protocol is enabled by default */
 	protocol->enabled_by_default = TRUE; /* see previous comment */
 	protocol->can_toggle = TRUE;
+	protocol->is_stateless = FALSE;
 	protocol->parent_proto_id = -1;
 	protocol->heur_list = NULL;
 
@@ -6789,6 +6879,7 @@ proto_register_protocol_in_name_only(const char *name, const char *short_name, c
 	protocol->is_enabled = TRUE;
 	protocol->enabled_by_default = TRUE;
 	protocol->can_toggle = TRUE;
+	protocol->is_stateless = FALSE;
 
 	protocol->parent_proto_id = parent_proto;
 	protocol->heur_list = NULL;
@@ -7219,6 +7310,16 @@ proto_set_cant_toggle(const int proto_id)
 	protocol->can_toggle = FALSE;
 }
 
+void
+proto_set_stateless(const int proto_id)
+{
+	protocol_t *protocol;
+
+	protocol = find_protocol_by_id(proto_id);
+	DISSECTOR_ASSERT(proto_is_pino(protocol) == FALSE);
+	protocol->is_stateless = TRUE;
+}
+
 static int
 proto_register_field_common(protocol_t *proto, header_field_info *hfi, const int parent)
 {
@@ -765,6 +765,8 @@ typedef struct {
     gboolean     fake_protocols;
     gint         count;
     struct _packet_info *pinfo;
+    gboolean     prune_protocols;
+    GArray      *wanted_protocols; /* protocols of the primed fields, if pruning */
 } tree_data_t;
 
 /** Each proto_tree, proto_item is one of these. */
@@ -1027,8 +1029,26 @@ proto_tree_set_visible(proto_tree *tree, gboolean visible);
 extern void
 proto_tree_set_fake_protocols(proto_tree *tree, gboolean fake_protocols);
 
+/** Skip stateless protocols that nothing primed in the tree can come from.
+ @param tree the tree to be set
+ @param prune_protocols TRUE if we should skip them */
+extern void
+proto_tree_set_prune_protocols(proto_tree *tree, gboolean prune_protocols);
+
+/** Can the dissector for a protocol be skipped?  That's the case if the
+ tree is pruning protocols and isn't visible, no columns are being filled
+ in, the protocol is stateless and none of its fields are wanted, and the
+ protocols of all the wanted fields are already in this frame's layers,
+ so that nothing wanted can come from the protocol or anything it calls.
+ @param tree the tree that is being built
+ @param protocol the protocol whose dissector is about to be called
+ @return TRUE if the call can be skipped */
+extern gboolean
+proto_tree_can_skip_protocol(proto_tree *tree, protocol_t *protocol);
+
 /** Mark a field/protocol ID as "interesting".
- @param tree the tree to be set (currently ignored)
+ @param tree the tree to be set (used to track the wanted protocols when
+ it is pruning protocols)
  @param hfid the interesting field id
  @todo what *does* interesting mean? */
 extern void
@@ -2431,6 +2451,14 @@ WS_DLL_PUBLIC void proto_reenable_all(void);
  @param proto_id protocol id (0-indexed) */
 WS_DLL_PUBLIC void proto_set_cant_toggle(const int proto_id);
 
+/** Declare that a protocol is stateless: its dissector, and any dissector
+ it hands data to, keeps no state across frames (conversations, reassembly,
+ per-frame data used by later frames), so that a frame dissected without
+ it dissects the same way later.  A stateless protocol can be skipped when
+ none of the fields being looked for can come from it.
+ @param proto_id protocol id (0-indexed) */
+WS_DLL_PUBLIC void proto_set_stateless(const int proto_id);
+
 /** Checks for existence any protocol or field within a tree.
  @param tree "Protocols" are assumed to be a child of the [empty] root node.
  @param id hfindex of protocol or field
@@ -397,6 +397,307 @@ free_fragments(gpointer data, gpointer user_data _U_)
 	g_slice_free(fragment_item, fd_head);
 }
 
+/*
+ * Limits on the reassemblies in progress in each table; see
+ * reassembly_tables_set_limits().  0 means no limit.
+ */
+static guint32 reassembly_max_bytes = 0;
+static guint32 reassembly_max_frames = 0;
+static guint32 reassembly_max_secs = 0;
+
+/*
+ * The tables that have reassemblies in progress being kept track of.
+ */
+static GSList *limited_tables = NULL;
+
+/*
+ * Reassemblies abandoned while dissecting frame evictions_frame.
+ */
+static GArray *evictions = NULL;
+static guint32 evictions_frame = 0;
+
+/*
+ * What's kept about a reassembly in progress when there are limits.
+ */
+typedef struct {
+	GList link;			/* in the table's LRU queue; data points to us */
+	fragment_head *fd_head;
+	gpointer key;			/* fd_head's key in the fragment table */
+	const char *proto;
+	guint32 first_frame;
+	guint32 last_frame;
+	nstime_t last_time;
+	guint32 bytes;
+} reassembly_in_progress_t;
+
+struct _reassembly_in_progress {
+	GHashTable *heads;		/* fragment_head * -> reassembly_in_progress_t * */
+	GQueue lru;			/* least recently added to first */
+	guint64 bytes;			/* sum of the reassemblies' bytes */
+};
+
+/*
+ * Rough cost of a fragment beyond its data.
+ */
+#define IN_PROGRESS_FRAGMENT_OVERHEAD	((guint32)sizeof(fragment_item))
+
+/*
+ * Note that a reassembly was added to or looked up in this frame.
+ */
+static void
+in_progress_touch(struct _reassembly_in_progress *ip,
+		  reassembly_in_progress_t *rec, const packet_info *pinfo)
+{
+	g_queue_unlink(&ip->lru, &rec->link);
+	rec->last_frame = pinfo->num;
+	rec->last_time = pinfo->abs_ts;
+	g_queue_push_tail_link(&ip->lru, &rec->link);
+}
+
+static void
+in_progress_free(reassembly_table *table)
+{
+	struct _reassembly_in_progress *ip = table->in_progress;
+	GList *link;
+
+	if (ip == NULL)
+		return;
+
+	while ((link = g_queue_pop_head_link(&ip->lru)) != NULL)
+		g_slice_free(reassembly_in_progress_t, link->data);
+	g_hash_table_destroy(ip->heads);
+	g_free(ip);
+	table->in_progress = NULL;
+	limited_tables = g_slist_remove(limited_tables, table);
+}
+
+/*
+ * Start keeping track of a reassembly in progress, or note that it was
+ * just added to; returns NULL if there are no limits.
+ */
+static reassembly_in_progress_t *
+in_progress_track(reassembly_table *table, fragment_head *fd_head,
+		  gpointer key, const packet_info *pinfo)
+{
+	struct _reassembly_in_progress *ip;
+	reassembly_in_progress_t *rec;
+
+	if (reassembly_max_bytes == 0 && reassembly_max_frames == 0 &&
+	    reassembly_max_secs == 0)
+		return NULL;
+
+	ip = table->in_progress;
+	if (ip == NULL) {
+		ip = g_new0(struct _reassembly_in_progress, 1);
+		ip->heads = g_hash_table_new(g_direct_hash, g_direct_equal);
+		g_queue_init(&ip->lru);
+		table->in_progress = ip;
+		limited_tables = g_slist_prepend(limited_tables, table);
+	}
+
+	rec = (reassembly_in_progress_t *)g_hash_table_lookup(ip->heads, fd_head);
+	if (rec == NULL) {
+		rec = g_slice_new0(reassembly_in_progress_t);
+		rec->link.data = rec;
+		rec->fd_head = fd_head;
+		rec->key = key;
+		rec->proto = pinfo->current_proto;
+		rec->first_frame = pinfo->num;
+		rec->last_frame = pinfo->num;
+		rec->last_time = pinfo->abs_ts;
+		g_hash_table_insert(ip->heads, fd_head, rec);
+		g_queue_push_tail_link(&ip->lru, &rec->link);
+	} else {
+		in_progress_touch(ip, rec, pinfo);
+	}
+
+	return rec;
+}
+
+/*
+ * Stop keeping track of a reassembly, because it's complete or has been
+ * removed from the fragment table.
+ */
+static void
+in_progress_forget(reassembly_table *table, fragment_head *fd_head)
+{
+	struct _reassembly_in_progress *ip = table->in_progress;
+	reassembly_in_progress_t *rec;
+
+	if (ip == NULL)
+		return;
+
+	rec = (reassembly_in_progress_t *)g_hash_table_lookup(ip->heads, fd_head);
+	if (rec == NULL)
+		return;
+
+	g_queue_unlink(&ip->lru, &rec->link);
+	g_hash_table_remove(ip->heads, fd_head);
+	ip->bytes -= rec->bytes;
+	g_slice_free(reassembly_in_progress_t, rec);
+}
+
+/*
+ * Account for a fragment having been added to a reassembly.
+ */
+static void
+in_progress_add(reassembly_table *table, fragment_head *fd_head,
+		gpointer key, const packet_info *pinfo,
+		const guint32 frag_data_len)
+{
+	reassembly_in_progress_t *rec;
+
+	if (fd_head->flags & FD_DEFRAGMENTED) {
+		in_progress_forget(table, fd_head);
+		return;
+	}
+
+	rec = in_progress_track(table, fd_head, key, pinfo);
+	if (rec != NULL) {
+		rec->bytes += frag_data_len + IN_PROGRESS_FRAGMENT_OVERHEAD;
+		table->in_progress->bytes += frag_data_len + IN_PROGRESS_FRAGMENT_OVERHEAD;
+	}
+}
+
+/*
+ * Free the fragments of a reassembly and its head, returning the
+ * reassembled data, if any.
+ */
+static tvbuff_t *
+free_fd_head(fragment_head *fd_head)
+{
+	fragment_item *fd;
+	tvbuff_t *fd_tvb_data;
+
+	fd_tvb_data=fd_head->tvb_data;
+	/* loop over all partial fragments and free any tvbuffs */
+	for(fd=fd_head->next;fd;){
+		fragment_item *tmp_fd;
+		tmp_fd=fd->next;
+
+		if (fd->tvb_data && !(fd->flags & FD_SUBSET_TVB))
+			tvb_free(fd->tvb_data);
+		g_slice_free(fragment_item, fd);
+		fd=tmp_fd;
+	}
+	g_slice_free(fragment_head, fd_head);
+
+	return fd_tvb_data;
+}
+
+/*
+ * Abandon a reassembly in progress, noting that it was abandoned.
+ */
+static void
+in_progress_evict(reassembly_table *table, reassembly_in_progress_t *rec,
+		  const packet_info *pinfo, reassembly_eviction_reason reason)
+{
+	reassembly_eviction_t eviction;
+	fragment_head *fd_head = rec->fd_head;
+	gpointer key = rec->key;
+	fragment_item *fd;
+	tvbuff_t *fd_tvb_data;
+
+	eviction.proto = rec->proto;
+	eviction.first_frame = rec->first_frame;
+	eviction.last_frame = rec->last_frame;
+	eviction.fragments = 0;
+	eviction.bytes = 0;
+	eviction.reason = reason;
+	for (fd = fd_head->next; fd != NULL; fd = fd->next) {
+		eviction.fragments++;
+		eviction.bytes += fd->len;
+	}
+
+	if (evictions == NULL)
+		evictions = g_array_new(FALSE, FALSE, sizeof(reassembly_eviction_t));
+	if (evictions_frame != pinfo->num) {
+		g_array_set_size(evictions, 0);
+		evictions_frame = pinfo->num;
+	}
+	g_array_append_val(evictions, eviction);
+
+	in_progress_forget(table, fd_head);
+	fd_tvb_data = free_fd_head(fd_head);
+	if (fd_tvb_data)
+		tvb_free(fd_tvb_data);
+	g_hash_table_remove(table->fragment_table, key);
+}
+
+/*
+ * Abandon the reassemblies that are over the limits, least recently
+ * added to first.
+ */
+static void
+in_progress_enforce_limits(reassembly_table *table, const packet_info *pinfo)
+{
+	struct _reassembly_in_progress *ip = table->in_progress;
+	reassembly_in_progress_t *rec;
+	reassembly_eviction_reason reason;
+	GList *link;
+
+	if (ip == NULL)
+		return;
+
+	while ((link = g_queue_peek_head_link(&ip->lru)) != NULL) {
+		rec = (reassembly_in_progress_t *)link->data;
+
+		/*
+		 * The dissector may still have a pointer to anything it
+		 * looked up in this frame, and everything after this one
+		 * in the queue was looked up in this frame.
+		 */
+		if (rec->last_frame == pinfo->num)
+			break;
+
+		if (reassembly_max_bytes != 0 && ip->bytes > reassembly_max_bytes)
+			reason = REASSEMBLY_EVICTED_MEMORY;
+		else if (reassembly_max_frames != 0 &&
+		    pinfo->num - rec->last_frame > reassembly_max_frames)
+			reason = REASSEMBLY_EVICTED_FRAMES;
+		else if (reassembly_max_secs != 0 &&
+		    pinfo->abs_ts.secs - rec->last_time.secs > (time_t)reassembly_max_secs)
+			reason = REASSEMBLY_EVICTED_TIME;
+		else
+			break;
+
+		in_progress_evict(table, rec, pinfo, reason);
+	}
+}
+
+void
+reassembly_tables_set_limits(const guint32 max_bytes, const guint32 max_frames,
+			     const guint32 max_secs)
+{
+	reassembly_max_bytes = max_bytes;
+	reassembly_max_frames = max_frames;
+	reassembly_max_secs = max_secs;
+}
+
+void
+reassembly_tables_enforce_limits(const packet_info *pinfo)
+{
+	GSList *l;
+
+	if (pinfo->fd->flags.visited)
+		return;
+
+	for (l = limited_tables; l != NULL; l = l->next)
+		in_progress_enforce_limits((reassembly_table *)l->data, pinfo);
+}
+
+const reassembly_eviction_t *
+reassembly_get_evictions(const packet_info *pinfo, guint *count)
+{
+	if (evictions == NULL || evictions_frame != pinfo->num) {
+		*count = 0;
+		return NULL;
+	}
+
+	*count = evictions->len;
+	return (const reassembly_eviction_t *)(void *)evictions->data;
+}
+
 typedef struct register_reassembly_table {
 	reassembly_table *table;
 	const reassembly_table_functions *funcs;
@@ -435,6 +736,7 @@ reassembly_table_init(reassembly_table *table,
 		table->persistent_key_func = funcs->persistent_key_func;
 	if (table->free_temporary_key_func == NULL)
 		table->free_temporary_key_func = funcs->free_temporary_key_func;
+	in_progress_free(table);
 	if (table->fragment_table != NULL) {
 		/*
 		 * The fragment hash table exists.
@@ -488,6 +790,7 @@ reassembly_table_destroy(reassembly_table *table)
 	table->temporary_key_func = NULL;
 	table->persistent_key_func = NULL;
 	table->free_temporary_key_func = NULL;
+	in_progress_free(table);
 	if (table->fragment_table != NULL) {
 		/*
 		 * The fragment hash table exists.
@@ -543,6 +846,15 @@ lookup_fd_head(reassembly_table *table, const packet_info *pinfo,
 	gpointer key;
 	gpointer value;
 
+	/*
+	 * If there are limits on the reassemblies in progress, enforce
+	 * them before looking, and note that this one has been looked up
+	 * in this frame, so it isn't abandoned while the dissector is
+	 * using it.
+	 */
+	if (table->in_progress != NULL && !pinfo->fd->flags.visited)
+		in_progress_enforce_limits(table, pinfo);
+
 	/* Create key to search hash with */
 	key = table->temporary_key_func(pinfo, id, data);
 
@@ -555,6 +867,15 @@ lookup_fd_head(reassembly_table *table, const packet_info *pinfo,
 	/* Free the key */
 	table->free_temporary_key_func(key);
 
+	if (value != NULL && table->in_progress != NULL &&
+	    !pinfo->fd->flags.visited) {
+		reassembly_in_progress_t *rec;
+
+		rec = (reassembly_in_progress_t *)g_hash_table_lookup(table->in_progress->heads, value);
+		if (rec != NULL)
+			in_progress_touch(table->in_progress, rec, pinfo);
+	}
+
 	return (fragment_head *)value;
 }
 
@@ -573,6 +894,7 @@ insert_fd_head(reassembly_table *table, fragment_head *fd_head,
 	 */
 	key = table->persistent_key_func(pinfo, id, data);
 	g_hash_table_insert(table->fragment_table, key, fd_head);
+	in_progress_track(table, fd_head, key, pinfo);
 	return key;
 }
 
@@ -593,7 +915,6 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		const guint32 id, const void *data)
 {
 	fragment_head *fd_head;
-	fragment_item *fd;
 	tvbuff_t *fd_tvb_data=NULL;
 	gpointer key;
 
@@ -603,18 +924,8 @@ fragment_delete(reassembly_table *table, const packet_info *pinfo,
 		return NULL;
 	}
 
-	fd_tvb_data=fd_head->tvb_data;
-	/* loop over all partial fragments and free any tvbuffs */
-	for(fd=fd_head->next;fd;){
-		fragment_item *tmp_fd;
-		tmp_fd=fd->next;
-
-		if (fd->tvb_data && !(fd->flags & FD_SUBSET_TVB))
-			tvb_free(fd->tvb_data);
-		g_slice_free(fragment_item, fd);
-		fd=tmp_fd;
-	}
-	g_slice_free(fragment_head, fd_head);
+	in_progress_forget(table, fd_head);
+	fd_tvb_data = free_fd_head(fd_head);
 	g_hash_table_remove(table->fragment_table, key);
 
 	return fd_tvb_data;
@@ -854,6 +1165,9 @@ fragment_set_partial_reassembly(reassembly_table *table,
 static void
 fragment_unhash(reassembly_table *table, gpointer key)
 {
+	if (table->in_progress != NULL)
+		in_progress_forget(table, (fragment_head *)g_hash_table_lookup(table->fragment_table, key));
+
 	/*
 	 * Remove the entry from the fragment table.
 	 */
@@ -968,6 +1282,76 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	fd_i->next = fd;
 }
 
+/*
+ * Whether a reassembled packet can be made out of the fragments' own
+ * tvbuffs, as a composite tvbuff, rather than by copying them.  That
+ * can't be done if some of the fragments refer to the data of an earlier
+ * reassembly of the packet, which is freed along with the current frame.
+ */
+static gboolean
+fragments_can_be_shared(const fragment_head *fd_head)
+{
+	const fragment_item *fd_i;
+
+	for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next) {
+		if (fd_i->flags & FD_SUBSET_TVB)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Append the part of a fragment's tvbuff from offset for len bytes to
+ * the composite tvbuff of a reassembled packet.
+ */
+static void
+fragment_share_data(tvbuff_t *comp_tvb, GPtrArray *pieces,
+		    tvbuff_t *frag_tvb, const guint32 offset, const guint32 len)
+{
+	tvbuff_t *piece;
+
+	if (offset == 0 && len == tvb_captured_length(frag_tvb))
+		piece = frag_tvb;
+	else
+		piece = tvb_new_subset_length(frag_tvb, offset, len);
+	tvb_composite_append(comp_tvb, piece);
+	g_ptr_array_add(pieces, piece);
+}
+
+/*
+ * Compare len bytes of a fragment with the reassembled data from offset
+ * on, where the reassembled data so far are the pieces, which are end
+ * bytes long.
+ */
+static gboolean
+fragment_shared_data_equal(GPtrArray *pieces, const guint32 end,
+			   const guint32 offset, tvbuff_t *frag_tvb,
+			   const guint32 len)
+{
+	tvbuff_t *piece;
+	guint32 start = end, piece_offset, pos, cmp_len;
+	guint i = pieces->len;
+
+	/* Overlaps are nearly always with the last piece or two. */
+	do {
+		i--;
+		piece = (tvbuff_t *)g_ptr_array_index(pieces, i);
+		start -= tvb_captured_length(piece);
+	} while (start > offset);
+
+	piece_offset = offset - start;
+	for (pos = 0; pos < len; pos += cmp_len) {
+		piece = (tvbuff_t *)g_ptr_array_index(pieces, i);
+		cmp_len = MIN(len - pos, tvb_captured_length(piece) - piece_offset);
+		if (tvb_memeql(piece, piece_offset,
+		    tvb_get_ptr(frag_tvb, pos, cmp_len), cmp_len))
+			return FALSE;
+		piece_offset = 0;
+		i++;
+	}
+	return TRUE;
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -998,7 +1382,9 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	fragment_item *fd_i;
 	guint32 max, dfpos, fraglen;
 	tvbuff_t *old_tvb_data;
-	guint8 *data;
+	guint8 *data = NULL;
+	GPtrArray *pieces = NULL;
+	gboolean shared;
 
 	/* create new fd describing this fragment */
 	fd = g_slice_new(fragment_item);
@@ -1184,13 +1570,24 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 */
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(fd_head->datalen);
-	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	if (fd_head->datalen != 0 && fragments_can_be_shared(fd_head)) {
+		/*
+		 * Make the reassembled packet out of the fragments'
+		 * data rather than copying it; the composite tvbuff
+		 * takes the fragments' tvbuffs over.
+		 */
+		fd_head->tvb_data = tvb_new_composite();
+		pieces = g_ptr_array_new();
+	} else {
+		data = (guint8 *) g_malloc(fd_head->datalen);
+		fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
+		tvb_set_free_cb(fd_head->tvb_data, g_free);
+	}
 
 	/* add all data fragments */
 	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
 		if (fd_i->len) {
+			shared = FALSE;
 			/*
 			 * The loop above that calculates max also
 			 * ensures that the only gaps that exist here
@@ -1270,7 +1667,10 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 
 						fd_i->flags    |= FD_OVERLAP;
 						fd_head->flags |= FD_OVERLAP;
-						if ( memcmp(data + fd_i->offset,
+						if (pieces ?
+						    !fragment_shared_data_equal(pieces, dfpos, fd_i->offset,
+								fd_i->tvb_data, cmp_len) :
+						    memcmp(data + fd_i->offset,
 								tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
 								cmp_len)
 								 ) {
@@ -1283,6 +1683,15 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 						 * XXX - can this happen?
 						 */
 						fd_head->error = "fraglen < dfpos - offset";
+					} else if (pieces) {
+						if (fraglen > dfpos - fd_i->offset) {
+							fragment_share_data(fd_head->tvb_data, pieces,
+								fd_i->tvb_data, dfpos-fd_i->offset,
+								fraglen-(dfpos-fd_i->offset));
+							tvb_composite_own(fd_head->tvb_data, fd_i->tvb_data);
+							shared = TRUE;
+						}
+						dfpos=MAX(dfpos, (fd_i->offset + fraglen));
 					} else {
 						memcpy(data+dfpos,
 							tvb_get_ptr(fd_i->tvb_data, (dfpos-fd_i->offset), fraglen-(dfpos-fd_i->offset)),
@@ -1299,13 +1708,32 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 
 			if (fd_i->flags & FD_SUBSET_TVB)
 				fd_i->flags &= ~FD_SUBSET_TVB;
-			else if (fd_i->tvb_data)
+			else if (fd_i->tvb_data && !shared)
 				tvb_free(fd_i->tvb_data);
 
 			fd_i->tvb_data=NULL;
 		}
 	}
 
+	if (pieces) {
+		if (dfpos < fd_head->datalen) {
+			/*
+			 * Something went wrong above, and the fragments
+			 * don't cover the reassembled packet; fill in the
+			 * rest with zeroes.
+			 */
+			tvbuff_t *fill_tvb;
+
+			data = (guint8 *) g_malloc0(fd_head->datalen - dfpos);
+			fill_tvb = tvb_new_real_data(data, fd_head->datalen - dfpos, fd_head->datalen - dfpos);
+			tvb_set_free_cb(fill_tvb, g_free);
+			tvb_composite_append(fd_head->tvb_data, fill_tvb);
+			tvb_composite_own(fd_head->tvb_data, fill_tvb);
+		}
+		tvb_composite_finalize(fd_head->tvb_data);
+		g_ptr_array_free(pieces, TRUE);
+	}
+
 	if (old_tvb_data)
 		tvb_add_to_chain(tvb, old_tvb_data);
 	/* mark this packet as defragmented.
@@ -1332,6 +1760,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	fragment_head *fd_head;
 	fragment_item *fd_item;
 	gboolean already_added;
+	gpointer orig_key = NULL;
 
 
 	/*
@@ -1343,7 +1772,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 	 */
 	DISSECTOR_ASSERT(tvb_bytes_exist(tvb, offset, frag_data_len));
 
-	fd_head = lookup_fd_head(table, pinfo, id, data, NULL);
+	fd_head = lookup_fd_head(table, pinfo, id, data, &orig_key);
 
 #if 0
 	/* debug output of associated fragments. */
@@ -1495,7 +1924,7 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Insert it into the hash table.
 		 */
-		insert_fd_head(table, fd_head, pinfo, id, data);
+		orig_key = insert_fd_head(table, fd_head, pinfo, id, data);
 	}
 
 	if (fragment_add_work(fd_head, tvb, offset, pinfo, frag_offset,
@@ -1503,11 +1932,13 @@ fragment_add_common(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Reassembly is complete.
 		 */
+		in_progress_forget(table, fd_head);
 		return fd_head;
 	} else {
 		/*
 		 * Reassembly isn't complete.
 		 */
+		in_progress_add(table, fd_head, orig_key, pinfo, frag_data_len);
 		return NULL;
 	}
 }
@@ -1605,6 +2036,7 @@ fragment_add_check(reassembly_table *table, tvbuff_t *tvb, const int offset,
 		/*
 		 * Reassembly isn't complete.
 		 */
+		in_progress_add(table, fd_head, orig_key, pinfo, frag_data_len);
 		return NULL;
 	}
 }
@@ -1616,7 +2048,8 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 	fragment_item *last_fd = NULL;
 	guint32  dfpos = 0, size = 0;
 	tvbuff_t *old_tvb_data = NULL;
-	guint8 *data;
+	guint8 *data = NULL;
+	gboolean shared;
 
 	for(fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if(!last_fd || last_fd->offset!=fd_i->offset){
@@ -1627,9 +2060,19 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 
 	/* store old data in case the fd_i->data pointers refer to it */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(size);
-	fd_head->tvb_data = tvb_new_real_data(data, size, size);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	shared = size != 0 && fragments_can_be_shared(fd_head);
+	if (shared) {
+		/*
+		 * Make the reassembled packet out of the fragments'
+		 * data rather than copying it; the composite tvbuff
+		 * takes the in-sequence fragments' tvbuffs over.
+		 */
+		fd_head->tvb_data = tvb_new_composite();
+	} else {
+		data = (guint8 *) g_malloc(size);
+		fd_head->tvb_data = tvb_new_real_data(data, size, size);
+		tvb_set_free_cb(fd_head->tvb_data, g_free);
+	}
 	fd_head->len = size;		/* record size for caller	*/
 
 	/* add all data fragments */
@@ -1638,7 +2081,11 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		if (fd_i->len) {
 			if(!last_fd || last_fd->offset != fd_i->offset) {
 				/* First fragment or in-sequence fragment */
-				memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
+				if (shared) {
+					tvb_composite_append(fd_head->tvb_data, fd_i->tvb_data);
+					tvb_composite_own(fd_head->tvb_data, fd_i->tvb_data);
+				} else
+					memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
 				dfpos += fd_i->len;
 			} else {
 				/* duplicate/retransmission/overlap */
@@ -1654,13 +2101,22 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		last_fd=fd_i;
 	}
 
+	if (shared)
+		tvb_composite_finalize(fd_head->tvb_data);
+
 	/* we have defragmented the pdu, now free all fragments*/
+	last_fd=NULL;
 	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if (fd_i->flags & FD_SUBSET_TVB)
 			fd_i->flags &= ~FD_SUBSET_TVB;
-		else if (fd_i->tvb_data)
+		else if (fd_i->tvb_data &&
+			 /* in-sequence fragments with data are the composite
+			  * tvbuff's; empty ones weren't added to it */
+			 !(shared && fd_i->len &&
+			   (!last_fd || last_fd->offset != fd_i->offset)))
 			tvb_free(fd_i->tvb_data);
 		fd_i->tvb_data=NULL;
+		last_fd=fd_i;
 	}
 	if (old_tvb_data)
 		tvb_free(old_tvb_data);
@@ -2019,11 +2475,13 @@ fragment_add_seq_common(reassembly_table *table, tvbuff_t *tvb,
 		/*
 		 * Reassembly is complete.
 		 */
+		in_progress_forget(table, fd_head);
 		return fd_head;
 	} else {
 		/*
 		 * Reassembly isn't complete.
 		 */
+		in_progress_add(table, fd_head, orig_key, pinfo, frag_data_len);
 		return NULL;
 	}
 }
@@ -2858,6 +3316,10 @@ static void
 reassembly_table_init_reg_tables(void)
 {
 	g_list_foreach(reassembly_table_list, reassembly_table_init_reg_table, NULL);
+
+	if (evictions != NULL)
+		g_array_set_size(evictions, 0);
+	evictions_frame = 0;
 }
 
 static void
@@ -2892,6 +3354,11 @@ reassembly_table_cleanup(void)
 {
 	g_list_foreach(reassembly_table_list, reassembly_table_free, NULL);
 	g_list_free(reassembly_table_list);
+
+	if (evictions != NULL) {
+		g_array_free(evictions, TRUE);
+		evictions = NULL;
+	}
 }
 
 /*
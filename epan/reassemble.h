@@ -130,6 +130,7 @@ typedef struct {
 	fragment_temporary_key temporary_key_func;
 	fragment_persistent_key persistent_key_func;
 	GDestroyNotify free_temporary_key_func;		/* temporary key destruction function */
+	struct _reassembly_in_progress *in_progress;	/* reassemblies subject to reassembly_tables_set_limits() */
 } reassembly_table;
 
 /*
@@ -175,6 +176,68 @@ reassembly_table_init(reassembly_table *table,
 WS_DLL_PUBLIC void
 reassembly_table_destroy(reassembly_table *table);
 
+/*
+ * Limit the memory used by, and the age of, the reassemblies that are in
+ * progress in each reassembly table, so that fragments that will never be
+ * reassembled, such as those of a datagram some of whose fragments were
+ * lost, don't pile up during a long capture.
+ *
+ * max_bytes is the most fragment data, plus a per-fragment overhead, that
+ * a table's reassemblies in progress may hold; max_frames and max_secs
+ * are how many frames may be dissected, and how many seconds may pass
+ * going by the frames' time stamps, without a reassembly getting another
+ * fragment.  0 means no limit.  When a limit is exceeded, the reassemblies
+ * that least recently got a fragment are abandoned and their fragments
+ * freed, during the first pass through the frames.  A reassembly that got
+ * a fragment in the frame being dissected is never abandoned.
+ *
+ * The limits of a table are enforced whenever it's looked up, and, for a
+ * table that's no longer being looked up, by
+ * reassembly_tables_enforce_limits(), which the frame dissector calls at
+ * the end of each frame.
+ *
+ * Only reassemblies started after the limits are set are subject to them;
+ * completed reassemblies are kept, as they're needed when frames are
+ * dissected again.
+ */
+WS_DLL_PUBLIC void
+reassembly_tables_set_limits(const guint32 max_bytes, const guint32 max_frames,
+			     const guint32 max_secs);
+
+/*
+ * Enforce the limits set with reassembly_tables_set_limits() in all the
+ * tables that have reassemblies in progress, as of the frame being
+ * dissected for the first time.
+ */
+WS_DLL_PUBLIC void
+reassembly_tables_enforce_limits(const packet_info *pinfo);
+
+typedef enum {
+	REASSEMBLY_EVICTED_MEMORY,	/* the table was over max_bytes */
+	REASSEMBLY_EVICTED_FRAMES,	/* no fragment for over max_frames frames */
+	REASSEMBLY_EVICTED_TIME		/* no fragment for over max_secs seconds */
+} reassembly_eviction_reason;
+
+/*
+ * A reassembly that was abandoned because of reassembly_tables_set_limits().
+ */
+typedef struct {
+	const char *proto;		/* protocol that started the reassembly */
+	guint32 first_frame;		/* frame in which it was started */
+	guint32 last_frame;		/* last frame that added a fragment to it */
+	guint32 fragments;		/* number of fragments that were freed */
+	guint32 bytes;			/* bytes of fragment data that were freed */
+	reassembly_eviction_reason reason;
+} reassembly_eviction_t;
+
+/*
+ * Get the reassemblies that were abandoned while dissecting the current
+ * frame, in all tables; sets *count to the number of them.  The array is
+ * only valid until the next frame is dissected.
+ */
+WS_DLL_PUBLIC const reassembly_eviction_t *
+reassembly_get_evictions(const packet_info *pinfo, guint *count);
+
 /*
  * This function adds a new fragment to the reassembly table
  * If this is the first fragment seen for this datagram, a new entry
@@ -307,6 +307,45 @@ test_simple_fragment_add_seq(void)
 #endif
 }
 
+/* An empty fragment in the middle of a sequence adds nothing to the
+ * reassembled data, and is freed with the others.
+ */
+static void
+test_fragment_add_seq_empty_fragment(void)
+{
+    fragment_head *fd_head;
+
+    printf("Starting test test_fragment_add_seq_empty_fragment\n");
+
+    pinfo.num = 1;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                             0, 50, TRUE, 0);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 60, &pinfo, 12, NULL,
+                             1, 0, TRUE, 0);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add_seq(&test_reassembly_table, tvb, 60, &pinfo, 12, NULL,
+                             2, 40, FALSE, 0);
+    ASSERT_NE_POINTER(NULL,fd_head);
+
+    ASSERT_EQ(90,fd_head->len);
+    ASSERT_EQ(2,fd_head->datalen);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_BLOCKSEQUENCE|FD_DATALEN_SET,fd_head->flags);
+    ASSERT_EQ(90,tvb_captured_length(fd_head->tvb_data));
+
+    ASSERT_EQ(1,fd_head->next->next->offset);  /* seqno */
+    ASSERT_EQ(0,fd_head->next->next->len);     /* segment length */
+    ASSERT_EQ(0,fd_head->next->next->flags);
+    ASSERT_EQ_POINTER(NULL,fd_head->next->next->tvb_data);
+    ASSERT_EQ_POINTER(NULL,fd_head->next->next->next->tvb_data);
+
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,90));
+}
+
 /* XXX ought to have some tests for overlapping fragments */
 
 /* This tests the functionality of fragment_set_partial_reassembly for
@@ -1511,6 +1550,225 @@ test_missing_data_fragment_add_seq_next_3(void)
 #endif
 
 
+/**********************************************************************************
+ *
+ * reassembly_tables_set_limits
+ *
+ *********************************************************************************/
+
+/* Reassemblies that haven't had a fragment for too many frames are
+ * abandoned, and ones that have are kept.
+ */
+static void
+test_reassembly_limits_frames(void)
+{
+    fragment_head *fd_head;
+    const reassembly_eviction_t *ev;
+    guint count;
+
+    printf("Starting test test_reassembly_limits_frames\n");
+
+    reassembly_tables_set_limits(0, 2, 0);
+
+    pinfo.num = 1;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 10, &pinfo, 10, NULL,
+                                   0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 60, &pinfo, 10, NULL,
+                                   1, 20, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 5, &pinfo, 11, NULL,
+                                   0, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 4;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 5, &pinfo, 11, NULL,
+                                   1, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+
+    ev = reassembly_get_evictions(&pinfo, &count);
+    ASSERT_EQ(1,count);
+    ASSERT_EQ(1,ev[0].first_frame);
+    ASSERT_EQ(1,ev[0].last_frame);
+    ASSERT_EQ(2,ev[0].fragments);
+    ASSERT_EQ(70,ev[0].bytes);
+    ASSERT_EQ(REASSEMBLY_EVICTED_FRAMES,ev[0].reason);
+
+    /* datagram 10 starts over */
+    pinfo.num = 5;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 60, &pinfo, 10, NULL,
+                                   1, 20, FALSE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    ASSERT_EQ(2,g_hash_table_size(test_reassembly_table.fragment_table));
+    ev = reassembly_get_evictions(&pinfo, &count);
+    ASSERT_EQ(0,count);
+
+    /* completing datagram 11 takes it out of the fragment table */
+    pinfo.num = 6;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 5, &pinfo, 11, NULL,
+                                   2, 40, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ASSERT_EQ(3,g_hash_table_size(test_reassembly_table.reassembled_table));
+
+    /* and it's still there when the frames are revisited */
+    pinfo.fd->flags.visited = TRUE;
+    pinfo.num = 2;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 5, &pinfo, 11, NULL,
+                                   0, 40, TRUE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(6,fd_head->reassembled_in);
+
+    reassembly_tables_set_limits(0, 0, 0);
+}
+
+/* The reassemblies that least recently had a fragment are abandoned when
+ * a table is over its memory budget, but not one that's being added to.
+ */
+static void
+test_reassembly_limits_memory(void)
+{
+    fragment_head *fd_head;
+    const reassembly_eviction_t *ev;
+    guint count;
+
+    printf("Starting test test_reassembly_limits_memory\n");
+
+    reassembly_tables_set_limits(1, 0, 0);
+
+    pinfo.num = 1;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 10, &pinfo, 20, NULL,
+                                   0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+
+    pinfo.num = 2;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 10, &pinfo, 21, NULL,
+                                   0, 60, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+
+    ev = reassembly_get_evictions(&pinfo, &count);
+    ASSERT_EQ(1,count);
+    ASSERT_EQ(1,ev[0].first_frame);
+    ASSERT_EQ(50,ev[0].bytes);
+    ASSERT_EQ(REASSEMBLY_EVICTED_MEMORY,ev[0].reason);
+
+    /* a second fragment in the same frame doesn't abandon the first */
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 70, &pinfo, 21, NULL,
+                                   1, 60, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(120,fd_head->len);
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.fragment_table));
+
+    reassembly_tables_set_limits(0, 0, 0);
+}
+
+/* The limits of a table that isn't being looked up any more are enforced
+ * at the end of each frame.
+ */
+static void
+test_reassembly_limits_idle_table(void)
+{
+    fragment_head *fd_head;
+    const reassembly_eviction_t *ev;
+    guint count;
+
+    printf("Starting test test_reassembly_limits_idle_table\n");
+
+    reassembly_tables_set_limits(0, 2, 0);
+
+    pinfo.num = 1;
+    fd_head=fragment_add_seq_check(&test_reassembly_table, tvb, 10, &pinfo, 30, NULL,
+                                   0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    reassembly_tables_enforce_limits(&pinfo);
+    ASSERT_EQ(1,g_hash_table_size(test_reassembly_table.fragment_table));
+    ev = reassembly_get_evictions(&pinfo, &count);
+    ASSERT_EQ(0,count);
+
+    pinfo.num = 4;
+    reassembly_tables_enforce_limits(&pinfo);
+    ASSERT_EQ(0,g_hash_table_size(test_reassembly_table.fragment_table));
+    ev = reassembly_get_evictions(&pinfo, &count);
+    ASSERT_EQ(1,count);
+    ASSERT_EQ(1,ev[0].first_frame);
+    ASSERT_EQ(1,ev[0].fragments);
+    ASSERT_EQ(REASSEMBLY_EVICTED_FRAMES,ev[0].reason);
+
+    reassembly_tables_set_limits(0, 0, 0);
+}
+
+
+/**********************************************************************************
+ *
+ * fragment_add
+ *
+ *********************************************************************************/
+
+/* The reassembled data are made out of the fragments' own data, and
+ * overlaps are still checked against them.
+ */
+static void
+test_fragment_add_overlap(void)
+{
+    fragment_head *fd_head;
+
+    printf("Starting test test_fragment_add_overlap\n");
+
+    pinfo.num = 1;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                         0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    /* overlaps the first fragment's last 20 bytes, with the same data */
+    pinfo.num = 2;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 40, &pinfo, 12, NULL,
+                         30, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 3;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 80, &pinfo, 12, NULL,
+                         70, 30, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET|FD_OVERLAP,fd_head->flags);
+    ASSERT_EQ(100,fd_head->datalen);
+    ASSERT_EQ(100,tvb_captured_length(fd_head->tvb_data));
+    ASSERT_EQ(0,fd_head->next->flags);
+    ASSERT_EQ(FD_OVERLAP,fd_head->next->next->flags);
+    ASSERT_EQ(0,fd_head->next->next->next->flags);
+
+    /* searching across fragments */
+    ASSERT_EQ(65,tvb_find_guint8(fd_head->tvb_data,0,-1,75));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,100));
+
+    /* the same, with different data in the overlap */
+    pinfo.num = 4;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 13, NULL,
+                         0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 5;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 41, &pinfo, 13, NULL,
+                         30, 40, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 6;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 80, &pinfo, 13, NULL,
+                         70, 30, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET|FD_OVERLAP|FD_OVERLAPCONFLICT,fd_head->flags);
+    ASSERT_EQ(FD_OVERLAP|FD_OVERLAPCONFLICT,fd_head->next->next->flags);
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+61,20));
+}
+
+
 /**********************************************************************************
  *
  * main
@@ -1525,6 +1783,7 @@ main(int argc _U_, char **argv _U_)
     unsigned int i;
     static void (*tests[])(void) = {
         test_simple_fragment_add_seq,              /* frag table only   */
+        test_fragment_add_seq_empty_fragment,
         test_fragment_add_seq_partial_reassembly,
         test_fragment_add_seq_duplicate_first,
         test_fragment_add_seq_duplicate_middle,
@@ -1535,6 +1794,10 @@ main(int argc _U_, char **argv _U_)
         test_fragment_add_seq_802_11_0,
         test_fragment_add_seq_802_11_1,
         test_simple_fragment_add_seq_next,
+        test_reassembly_limits_frames,
+        test_reassembly_limits_memory,
+        test_reassembly_limits_idle_table,
+        test_fragment_add_overlap,
 #if 0
         test_missing_data_fragment_add_seq_next,
         test_missing_data_fragment_add_seq_next_2,
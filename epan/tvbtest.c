@@ -485,6 +485,112 @@ run_tests(void)
 	tvb_free_chain(tvb_parent);  /* should free all tvb's and associated data */
 }
 
+/* A composite that owns its members, as reassembly makes */
+static void
+run_owning_composite_tests(void)
+{
+	tvbuff_t	*tvb_comp;
+	tvbuff_t	*tvb_real[2];
+	guint8		*real[2];
+	guint8		expected[24];
+	gint		found;
+	int		i, j;
+
+	for (i = 0; i < 2; i++) {
+		real[i] = g_new(guint8, 16);
+		for (j = 0; j < 16; j++) {
+			real[i][j] = 16 * i + j;
+		}
+		tvb_real[i] = tvb_new_real_data(real[i], 16, 16);
+		tvb_set_free_cb(tvb_real[i], g_free);
+	}
+	memcpy(expected, real[0], 16);
+	memcpy(&expected[16], &real[1][4], 8);
+
+	printf("Making Owning Composite\n");
+	tvb_comp = tvb_new_composite();
+	tvb_composite_append(tvb_comp, tvb_real[0]);
+	tvb_composite_append(tvb_comp, tvb_new_subset_length(tvb_real[1], 4, 8));
+	tvb_composite_own(tvb_comp, tvb_real[0]);
+	tvb_composite_own(tvb_comp, tvb_real[1]);
+	tvb_composite_finalize(tvb_comp);
+
+	/* Searching mustn't need the composite to be flattened first */
+	found = tvb_find_guint8(tvb_comp, 0, -1, expected[18]);
+	if (found != 18) {
+		printf("13: Failed TVB=Owning Composite Found=%d "
+				"Bad find across members\n", found);
+		failed = TRUE;
+	}
+	found = tvb_find_guint8(tvb_comp, 17, 3, expected[22]);
+	if (found != -1) {
+		printf("14: Failed TVB=Owning Composite Found=%d "
+				"Bad find with limit\n", found);
+		failed = TRUE;
+	}
+
+	test(tvb_comp, "Owning Composite", expected, 24, 24);
+
+	tvb_free(tvb_comp);  /* should free its members and their data */
+}
+
+/* A composite of many members, read forwards, backwards and at random */
+static void
+run_many_members_composite_tests(void)
+{
+	tvbuff_t	*tvb_comp;
+	tvbuff_t	*tvb_real;
+	guint8		*real;
+	guint		i, offset;
+	guint8		val;
+
+	real = g_new(guint8, 3000);
+	for (i = 0; i < 3000; i++) {
+		real[i] = (guint8) (i * 7);
+	}
+	tvb_real = tvb_new_real_data(real, 3000, 3000);
+	tvb_set_free_cb(tvb_real, g_free);
+
+	printf("Making Composite of 1000 members\n");
+	tvb_comp = tvb_new_composite();
+	for (i = 0; i < 1000; i++) {
+		tvb_composite_append(tvb_comp, tvb_new_subset_length(tvb_real, 3 * i, 3));
+	}
+	tvb_composite_own(tvb_comp, tvb_real);
+	tvb_composite_finalize(tvb_comp);
+
+	for (i = 0; i < 3000; i++) {
+		val = tvb_get_guint8(tvb_comp, i);
+		if (val != real[i]) {
+			printf("15: Failed TVB=Many Members Offset=%u "
+					"Bad forward read\n", i);
+			failed = TRUE;
+			break;
+		}
+	}
+	for (i = 3000; i > 0; i--) {
+		val = tvb_get_guint8(tvb_comp, i - 1);
+		if (val != real[i - 1]) {
+			printf("16: Failed TVB=Many Members Offset=%u "
+					"Bad backward read\n", i - 1);
+			failed = TRUE;
+			break;
+		}
+	}
+	for (i = 0, offset = 0; i < 3000; i++) {
+		offset = (offset + 1231) % 3000;
+		val = tvb_get_guint8(tvb_comp, offset);
+		if (val != real[offset]) {
+			printf("17: Failed TVB=Many Members Offset=%u "
+					"Bad random read\n", offset);
+			failed = TRUE;
+			break;
+		}
+	}
+
+	tvb_free(tvb_comp);
+}
+
 /* Note: valgrind can be used to check for tvbuff memory leaks */
 int
 main(void)
@@ -495,6 +601,8 @@ main(void)
 
 	except_init();
 	run_tests();
+	run_owning_composite_tests();
+	run_many_members_composite_tests();
 	except_deinit();
 	exit(failed?1:0);
 }
@@ -204,6 +204,12 @@ extern void tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member);
 /** Create an empty composite tvbuff. */
 WS_DLL_PUBLIC tvbuff_t *tvb_new_composite(void);
 
+/** Make a composite tvbuff free a tvbuff, and the tvbuffs chained to it,
+ * when the composite tvbuff is freed; the members can then be that tvbuff
+ * or subsets of it.  A composite tvbuff that owns tvbuffs isn't chained
+ * to its first member when it's finalized. */
+WS_DLL_PUBLIC void tvb_composite_own(tvbuff_t *tvb, tvbuff_t *owned);
+
 /** Mark a composite tvbuff as initialized. No further appends or prepends
  * occur, data access can finally happen after this finalization. */
 WS_DLL_PUBLIC void tvb_composite_finalize(tvbuff_t *tvb);
@@ -16,14 +16,22 @@
 #include "proto.h"	/* XXX - only used for DISSECTOR_ASSERT, probably a new header file? */
 
 typedef struct {
-	GSList		*tvbs;
+	GQueue		tvbs;
 
-	/* Used for quick testing to see if this
-	 * is the tvbuff that a COMPOSITE is
-	 * interested in. */
+	/* Set up when the tvbuff is finalized, for finding
+	 * the member that an offset falls in with a binary
+	 * search. */
+	tvbuff_t	**members;
+	guint		num_members;
 	guint		*start_offsets;
 	guint		*end_offsets;
 
+	/* The member that was last accessed */
+	guint		last_member;
+
+	/* Tvbuffs freed along with this tvbuff */
+	GSList		*owned;
+
 } tvb_comp_t;
 
 struct tvb_composite {
@@ -37,9 +45,11 @@ composite_free(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
+	GSList *slist;
 
-	g_slist_free(composite->tvbs);
+	g_queue_clear(&composite->tvbs);
 
+	g_free(composite->members);
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
 	if (tvb->real_data) {
@@ -48,6 +58,10 @@ composite_free(tvbuff_t *tvb)
 		 */
 		g_free((gpointer)tvb->real_data);
 	}
+
+	for (slist = composite->owned; slist != NULL; slist = slist->next)
+		tvb_free((tvbuff_t *)slist->data);
+	g_slist_free(composite->owned);
 }
 
 static guint
@@ -56,37 +70,65 @@ composite_offset(const tvbuff_t *tvb _U_, const guint counter)
 	return counter;
 }
 
+/*
+ * Find the member that abs_offset falls in; returns num_members if
+ * abs_offset is at or past the end of the tvbuff.
+ */
+static guint
+composite_find_member(tvb_comp_t *composite, const guint abs_offset)
+{
+	guint low = 0, high = composite->num_members, mid;
+
+	/* Dissectors mostly read on from where they last read, so try the
+	 * last member accessed and the one after it first. */
+	mid = composite->last_member;
+	if (abs_offset >= composite->start_offsets[mid]) {
+		if (abs_offset <= composite->end_offsets[mid])
+			return mid;
+		if (mid + 1 < high && abs_offset <= composite->end_offsets[mid + 1]) {
+			composite->last_member = mid + 1;
+			return mid + 1;
+		}
+		low = mid + 1;
+	} else
+		high = mid;
+
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (abs_offset > composite->end_offsets[mid])
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < composite->num_members)
+		composite->last_member = low;
+	return low;
+}
+
 static const guint8*
 composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return "";
 	}
 
+	member_tvb = composite->members[i];
 	member_offset = abs_offset - composite->start_offsets[i];
 
 	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
@@ -113,63 +155,100 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	guint8 *target = (guint8 *) _target;
 
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset, member_length;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
-	/* Maybe the range specified by offset/length
-	 * is contiguous inside one of the member tvbuffs */
-	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	composite = &composite_tvb->composite;
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return target;
 	}
 
+	/* Copy the part that's in this member tvb, then go on to the
+	 * following members until we have copied all data.
+	 */
 	member_offset = abs_offset - composite->start_offsets[i];
+	while (abs_length > 0) {
+		DISSECTOR_ASSERT(i < composite->num_members);
+		member_tvb = composite->members[i];
+		member_length = MIN(abs_length, member_tvb->length - member_offset);
 
-	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
-		DISSECTOR_ASSERT(!tvb->real_data);
-		return tvb_memcpy(member_tvb, target, member_offset, abs_length);
+		tvb_memcpy(member_tvb, target, member_offset, member_length);
+		target		+= member_length;
+		abs_length	-= member_length;
+		member_offset	 = 0;
+		i++;
 	}
-	else {
-		/* The requested data is non-contiguous inside
-		 * the member tvb. We have to memcpy() the part that's in the member tvb,
-		 * then iterate across the other member tvb's, copying their portions
-		 * until we have copied all data.
-		 */
-		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
 
-		/* composite_memcpy() can't handle a member_length of zero. */
-		DISSECTOR_ASSERT(member_length > 0);
+	return _target;
+}
 
-		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
-		abs_length	-= member_length;
+static gint
+composite_find_guint8(tvbuff_t *tvb, guint abs_offset, guint limit, guint8 needle)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite = &composite_tvb->composite;
+	tvbuff_t   *member_tvb;
+	guint	    i, member_offset, member_length;
+	gint	    result;
 
-		/* Recurse */
-		if (abs_length > 0) {
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
-		}
+	/* Search each member in turn, rather than flattening the tvbuff */
+	i = composite_find_member(composite, abs_offset);
+	if (i == composite->num_members)
+		return -1;
 
-		return target;
+	member_offset = abs_offset - composite->start_offsets[i];
+	while (limit > 0 && i < composite->num_members) {
+		member_tvb = composite->members[i];
+		member_length = MIN(limit, member_tvb->length - member_offset);
+
+		result = tvb_find_guint8(member_tvb, member_offset, member_length, needle);
+		if (result != -1)
+			return composite->start_offsets[i] + result;
+
+		limit	     -= member_length;
+		member_offset = 0;
+		i++;
 	}
 
-	DISSECTOR_ASSERT_NOT_REACHED();
+	return -1;
+}
+
+static gint
+composite_pbrk_guint8(tvbuff_t *tvb, guint abs_offset, guint limit, const ws_mempbrk_pattern* pattern, guchar *found_needle)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite = &composite_tvb->composite;
+	tvbuff_t   *member_tvb;
+	guint	    i, member_offset, member_length;
+	gint	    result;
+
+	i = composite_find_member(composite, abs_offset);
+	if (i == composite->num_members)
+		return -1;
+
+	member_offset = abs_offset - composite->start_offsets[i];
+	while (limit > 0 && i < composite->num_members) {
+		member_tvb = composite->members[i];
+		member_length = MIN(limit, member_tvb->length - member_offset);
+
+		result = tvb_ws_mempbrk_pattern_guint8(member_tvb, member_offset, member_length, pattern, found_needle);
+		if (result != -1)
+			return composite->start_offsets[i] + result;
+
+		limit	     -= member_length;
+		member_offset = 0;
+		i++;
+	}
+
+	return -1;
 }
 
 static const struct tvb_ops tvb_composite_ops = {
@@ -179,8 +258,8 @@ static const struct tvb_ops tvb_composite_ops = {
 	composite_offset,     /* offset */
 	composite_get_ptr,    /* get_ptr */
 	composite_memcpy,     /* memcpy */
-	NULL,                 /* find_guint8 XXX */
-	NULL,                 /* pbrk_guint8 XXX */
+	composite_find_guint8, /* find_guint8 */
+	composite_pbrk_guint8, /* pbrk_guint8 */
 	NULL,                 /* clone */
 };
 
@@ -188,9 +267,13 @@ static const struct tvb_ops tvb_composite_ops = {
  * Composite tvb
  *
  *   1. A composite tvb is automatically chained to its first member when the
- *      tvb is finalized.
+ *      tvb is finalized, unless it owns tvbs (see tvb_composite_own()).
  *      This means that composite tvb members must all be in the same chain.
  *      ToDo: enforce this: By searching the chain?
+ *
+ *   2. A composite tvb that owns tvbs is not chained to anything; it
+ *      frees the tvbs it owns when it's freed, so its members must all be
+ *      owned tvbs or in the chains of owned tvbs.
  */
 tvbuff_t *
 tvb_new_composite(void)
@@ -199,9 +282,13 @@ tvb_new_composite(void)
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	composite->tvbs		 = NULL;
+	g_queue_init(&composite->tvbs);
+	composite->members	 = NULL;
+	composite->num_members	 = 0;
+	composite->last_member	 = 0;
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
+	composite->owned	 = NULL;
 
 	return tvb;
 }
@@ -221,7 +308,7 @@ tvb_composite_append(tvbuff_t *tvb, tvbuff_t *member)
 	DISSECTOR_ASSERT(member->length);
 
 	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_append(composite->tvbs, member);
+	g_queue_push_tail(&composite->tvbs, member);
 }
 
 void
@@ -239,14 +326,28 @@ tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member)
 	DISSECTOR_ASSERT(member->length);
 
 	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_prepend(composite->tvbs, member);
+	g_queue_push_head(&composite->tvbs, member);
+}
+
+void
+tvb_composite_own(tvbuff_t *tvb, tvbuff_t *owned)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite;
+
+	DISSECTOR_ASSERT(tvb && !tvb->initialized);
+	DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops);
+	DISSECTOR_ASSERT(owned);
+
+	composite        = &composite_tvb->composite;
+	composite->owned = g_slist_prepend(composite->owned, owned);
 }
 
 void
 tvb_composite_finalize(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	GSList	   *slist;
+	GList	   *list;
 	guint	    num_members;
 	tvbuff_t   *member_tvb;
 	tvb_comp_t *composite;
@@ -259,7 +360,7 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	DISSECTOR_ASSERT(tvb->contained_length == 0);
 
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
+	num_members = g_queue_get_length(&composite->tvbs);
 
 	/* Dissectors should not create composite TVBs if they're not going to
 	 * put at least one TVB in them.
@@ -267,12 +368,15 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	 */
 	DISSECTOR_ASSERT(num_members);
 
+	composite->members = g_new(tvbuff_t *, num_members);
+	composite->num_members = num_members;
 	composite->start_offsets = g_new(guint, num_members);
 	composite->end_offsets = g_new(guint, num_members);
 
-	for (slist = composite->tvbs; slist != NULL; slist = slist->next) {
+	for (list = composite->tvbs.head; list != NULL; list = list->next) {
 		DISSECTOR_ASSERT((guint) i < num_members);
-		member_tvb = (tvbuff_t *)slist->data;
+		member_tvb = (tvbuff_t *)list->data;
+		composite->members[i] = member_tvb;
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
@@ -280,10 +384,10 @@ tvb_composite_finalize(tvbuff_t *tvb)
 		composite->end_offsets[i] = tvb->length - 1;
 		i++;
 	}
+	g_queue_clear(&composite->tvbs);
 
-	DISSECTOR_ASSERT(composite->tvbs);
-
-	tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb); /* chain composite tvb to first member */
+	if (!composite->owned)
+		tvb_add_to_chain(composite->members[0], tvb); /* chain composite tvb to first member */
 	tvb->initialized = TRUE;
 	tvb->ds_tvb = tvb;
 }
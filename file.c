@@ -24,6 +24,7 @@
 #include <version_info.h>
 
 #include <wiretap/merge.h>
+#include <wiretap/wtap_index.h>
 
 #include <epan/exceptions.h>
 #include <epan/epan.h>
@@ -70,6 +71,7 @@
 # include <ws2tcpip.h>
 #endif
 
+static void read_index(capture_file *cf, wtap_index_t *idx);
 static gboolean read_record(capture_file *cf, dfilter_t *dfcode,
     epan_dissect_t *edt, column_info *cinfo, gint64 offset);
 
@@ -299,6 +301,7 @@ cf_open(capture_file *cf, const char *fname, unsigned int type, gboolean is_temp
   cf->drops_known = FALSE;
   cf->drops     = 0;
   cf->snap      = wtap_snapshot_length(cf->provider.wth);
+  cf->frames_unvisited = FALSE;
 
   /* Allocate a frame_data_sequence for the frames in this file */
   cf->provider.frames = new_frame_data_sequence();
@@ -500,6 +503,8 @@ cf_read(capture_file *cf, gboolean reloading)
   guint                tap_flags;
   gboolean             compiled;
   volatile gboolean    is_read_aborted = FALSE;
+  wtap_index_t        *volatile idx = NULL;
+  volatile gboolean    building_index = FALSE;
 
   /* The update_progress_dlg call below might end up accepting a user request to
    * trigger redissection/rescans which can modify/destroy the dissection
@@ -542,6 +547,22 @@ cf_read(capture_file *cf, gboolean reloading)
 
   reset_tap_listeners();
 
+  /*
+   * If the file is big enough, look for an index of it, or build one.
+   * The frames in an index can only be taken without being dissected
+   * if nothing needs to see them on the first pass.
+   */
+  if (prefs.gui_fileopen_index_size != 0 && !cf->is_tempfile &&
+      wtap_file_size(cf->provider.wth, NULL) >= (gint64)prefs.gui_fileopen_index_size * 1000000) {
+    if (!create_proto_tree && cf->rfcode == NULL &&
+        !tap_listeners_require_dissection() && tap_flags == 0)
+      idx = wtap_index_open(cf->provider.wth, cf->filename);
+    if (idx == NULL) {
+      idx = wtap_index_new(cf->provider.wth);
+      building_index = (idx != NULL);
+    }
+  }
+
   name_ptr = g_filename_display_basename(cf->filename);
 
   if (reloading)
@@ -563,6 +584,7 @@ cf_read(capture_file *cf, gboolean reloading)
 
   TRY {
     int     count             = 0;
+    gboolean resumed          = TRUE;
 
     gint64  size;
     gint64  file_pos;
@@ -581,7 +603,13 @@ cf_read(capture_file *cf, gboolean reloading)
 
     g_timer_start(prog_timer);
 
-    while ((wtap_read(cf->provider.wth, &err, &err_info, &data_offset))) {
+    if (idx != NULL && !building_index) {
+      /* Take the frames from the index, and read whatever follows them. */
+      read_index(cf, idx);
+      resumed = wtap_index_resume(cf->provider.wth, idx, &err);
+    }
+
+    while (resumed && (wtap_read(cf->provider.wth, &err, &err_info, &data_offset))) {
       if (size >= 0) {
         count++;
         file_pos = wtap_read_so_far(cf->provider.wth);
@@ -636,6 +664,8 @@ cf_read(capture_file *cf, gboolean reloading)
            hours even on fast machines) just to see that it was the wrong file. */
         break;
       }
+      if (building_index)
+        wtap_index_add(idx, cf->provider.wth, data_offset);
       read_record(cf, dfcode, &edt, cinfo, data_offset);
     }
   }
@@ -656,6 +686,17 @@ cf_read(capture_file *cf, gboolean reloading)
   /* Free the display name */
   g_free(name_ptr);
 
+  if (idx != NULL) {
+    /* If we read the whole file, save its index. Not being able to
+       do so, say because the directory isn't writable, isn't an error. */
+    if (building_index && err == 0 && !cf->stop_flag && !is_read_aborted) {
+      int index_err;
+
+      wtap_index_write(idx, cf->provider.wth, cf->filename, &index_err);
+    }
+    wtap_index_free(idx);
+  }
+
   /* Cleanup and release all dfilter resources */
   dfilter_free(dfcode);
 
@@ -1211,6 +1252,55 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
   epan_dissect_reset(edt);
 }
 
+/*
+ * Add the frames in an index to the packet list without reading or
+ * dissecting them; they're dissected when they're looked at.  Nothing
+ * may need to see them on the first pass, i.e. there's no display or
+ * read filter and no taps.
+ */
+static void
+read_index(capture_file *cf, wtap_index_t *idx)
+{
+  guint32       n, count = wtap_index_count(idx);
+  wtap_rec      rec;
+  frame_data    fdlocal;
+  frame_data   *fdata;
+  gint64        offset;
+  gboolean      has_comment;
+
+  wtap_rec_init(&rec);
+  for (n = 0; n < count && !cf->stop_flag; n++) {
+    offset = wtap_index_get_rec(idx, n, &rec, &has_comment);
+    cf_add_encapsulation_type(cf, rec.rec_header.packet_header.pkt_encap);
+
+    frame_data_init(&fdlocal, cf->count + 1, &rec, offset, cf->cum_bytes);
+    fdlocal.flags.has_phdr_comment = has_comment;
+    fdata = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+
+    cf->count++;
+    if (has_comment)
+      cf->packet_comment_count++;
+    cf->f_datalen = offset + fdlocal.cap_len;
+
+    frame_data_set_before_dissect(fdata, &cf->elapsed_time,
+                                  &cf->provider.ref, cf->provider.prev_dis);
+    cf->provider.prev_cap = fdata;
+    fdata->flags.passed_dfilter = 1;
+    cf->displayed_count++;
+    packet_list_append(NULL, fdata);
+
+    frame_data_set_after_dissect(fdata, &cf->cum_bytes);
+    cf->provider.prev_dis = fdata;
+    if (cf->first_displayed == 0)
+      cf->first_displayed = fdata->num;
+    cf->last_displayed = fdata->num;
+  }
+  wtap_rec_cleanup(&rec);
+
+  /* The first full dissection of the frames has to be done in order. */
+  cf->frames_unvisited = TRUE;
+}
+
 /*
  * Read in a new record.
  * Returns TRUE if the packet was added to the packet (record) list,
@@ -1339,9 +1429,11 @@ merge_callback(merge_event event, int num _U_,
         if (g_timer_elapsed(cb_data->prog_timer, NULL) > PROGBAR_UPDATE_INTERVAL) {
             float  progbar_val;
             gint64 file_pos = 0;
-            /* Get the sum of the seek positions in all of the files. */
+            /* Get the sum of the seek positions in all of the files.
+               Don't ask wiretap for them; the files may be being read
+               ahead on other threads. */
             for (i = 0; i < in_file_count; i++)
-              file_pos += wtap_read_so_far(in_files[i].wth);
+              file_pos += in_files[i].read_so_far;
 
             progbar_val = (gfloat) file_pos / (gfloat) cb_data->f_len;
             if (progbar_val > 1.0f) {
@@ -1620,6 +1712,13 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   g_assert(!cf->read_lock);
   cf->read_lock = TRUE;
 
+  /* If the frames were read from an index, the only frames dissected so
+     far are the ones that were looked at, out of order; start afresh. */
+  if (cf->frames_unvisited) {
+    redissect = TRUE;
+    cf->frames_unvisited = FALSE;
+  }
+
   /* Compile the current display filter.
    * We assume this will not fail since cf->dfilter is only set in
    * cf_filter IFF the filter was valid.
@@ -2214,6 +2313,10 @@ cf_retap_packets(capture_file *cf)
     return CF_READ_ABORTED;
   }
 
+  /* The taps have to see the frames dissected in order. */
+  if (cf->frames_unvisited)
+    rescan_packets(cf, "Reprocessing", "all packets", TRUE);
+
   cf_callback_invoke(cf_cb_file_retap_started, cf);
 
   /* Get the union of the flags for all tap listeners. */
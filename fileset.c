@@ -19,6 +19,7 @@
 
 #include <glib.h>
 
+#include <wsutil/capture_manifest.h>
 #include <wsutil/file_util.h>
 #include <wsutil/filesystem.h>
 
@@ -29,6 +30,7 @@
 typedef struct _fileset {
     GList   *entries;
     char    *dirname;
+    capture_manifest *manifest;     /* what dumpcap says is in the files, if it kept a manifest */
 } fileset;
 
 /*
@@ -36,7 +38,7 @@ typedef struct _fileset {
  *
  * XXX This should probably be per-main-window instead of global.
  */
-static fileset set = { NULL, NULL};
+static fileset set = { NULL, NULL, NULL };
 
 /*
  * Given a stat structure, get the creation time of the file if available,
@@ -157,6 +159,51 @@ fileset_is_file_in_set(const char *fname1, const char *fname2)
     return TRUE;
 }
 
+/* read the manifest dumpcap keeps of the files of the set, if there is one */
+static void
+fileset_read_manifest(const char *dirname, const char *fname)
+{
+    char        *pfx;
+    size_t       minlen = strlen("_00001_20050418010750");
+    char        *capname;
+    char        *path;
+    int          err;
+
+    /* test_00001_20050418010750.cap -> test.cap.manifest */
+    capname = g_strdup(fname);
+    pfx = strrchr(capname, '.');
+    if (pfx == NULL) {  /* suffix is optional */
+        pfx = capname + strlen(capname);
+    }
+    memmove(pfx - minlen, pfx, strlen(pfx) + 1);
+
+    path = g_strdup_printf("%s%s%s", dirname, capname, CAPTURE_MANIFEST_SUFFIX);
+    set.manifest = capture_manifest_read(path, &err);
+
+    g_free(path);
+    g_free(capname);
+}
+
+/* get a file's entry in the manifest, or NULL */
+static const capture_manifest_entry *
+fileset_manifest_entry(const char *fname)
+{
+    guint i;
+
+    if (set.manifest == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < set.manifest->entries->len; i++) {
+        const capture_manifest_entry *mentry =
+            (const capture_manifest_entry *)g_ptr_array_index(set.manifest->entries, i);
+
+        if (strcmp(mentry->name, fname) == 0) {
+            return mentry;
+        }
+    }
+    return NULL;
+}
+
 /* GCompareFunc helper for g_list_find_custom() */
 static gint
 fileset_find_by_path(gconstpointer a, gconstpointer b)
@@ -210,6 +257,7 @@ fileset_add_file(const char *dirname, const char *fname, gboolean current)
     ws_statb64 buf;
     char *path;
     fileset_entry *entry = NULL;
+    const capture_manifest_entry *mentry;
 
 
     path = g_strdup_printf("%s%s", dirname, fname);
@@ -231,6 +279,15 @@ fileset_add_file(const char *dirname, const char *fname, gboolean current)
             entry->size     = buf.st_size;
             entry->current  = current;
 
+            mentry = fileset_manifest_entry(fname);
+            if (mentry != NULL) {
+                entry->first = mentry->first;
+                entry->last  = mentry->last;
+            } else {
+                nstime_set_unset(&entry->first);
+                nstime_set_unset(&entry->last);
+            }
+
             set.entries = g_list_append(set.entries, entry);
         }
 
@@ -292,6 +349,8 @@ fileset_add_dir(const char *fname, void *window)
 
     /* is the current file probably a part of any fileset? */
     if(fileset_filename_match_pattern(fname)) {
+        fileset_read_manifest(dirname->str, get_basename(fname));
+
         /* yes, go through the files in the directory and check if the file in question is part of the current file set */
         if ((dir = ws_dir_open(dirname->str, 0, NULL)) != NULL) {
             while ((file = ws_dir_read_name(dir)) != NULL) {
@@ -418,6 +477,8 @@ void fileset_delete(void)
         g_free( (gpointer) set.dirname);
         set.dirname = NULL;
     }
+    capture_manifest_free(set.manifest);
+    set.manifest = NULL;
 }
 
 /*
@@ -11,6 +11,8 @@
 #ifndef __FILESET_H__
 #define __FILESET_H__
 
+#include <wsutil/nstime.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -22,6 +24,8 @@ typedef struct _fileset_entry {
     time_t   mtime;          /* last modified time */
     gint64   size;           /* size of file in bytes */
     gboolean current;        /* is this the currently loaded file? */
+    nstime_t first;          /* time stamp of the earliest packet, from the set's manifest, or unset */
+    nstime_t last;           /* time stamp of the latest packet, from the set's manifest, or unset */
 } fileset_entry;
 
 
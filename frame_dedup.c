@@ -0,0 +1,431 @@
+/* frame_dedup.c
+ * Routines for detecting duplicate frames
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <wsutil/pint.h>
+
+#include "frame_dedup.h"
+
+/* A frame in the window, oldest first. */
+typedef struct {
+    guint64   key;
+    nstime_t  ts;
+} dedup_entry_t;
+
+/*
+ * A slot of the hash table, which is open addressed with linear probing.
+ * A key of 0 marks an empty slot, so keys are never 0.
+ */
+typedef struct {
+    guint64   key;
+    guint32   count;    /* frames in the window with this key */
+    nstime_t  newest;   /* time stamp of the latest of them */
+} dedup_slot_t;
+
+typedef struct {
+    guint32   offset;
+    guint32   len;
+} dedup_mask_t;
+
+struct _frame_dedup {
+    gboolean       by_time;
+    guint32        max_frames;  /* frames kept, if !by_time */
+    nstime_t       window;      /* span of time kept, if by_time */
+    nstime_t       latest;      /* latest time stamp seen */
+
+    /* The window, as a ring that grows as needed. */
+    dedup_entry_t *entries;
+    guint32        entries_size;    /* a power of 2 */
+    guint32        first;
+    guint32        n_entries;
+
+    dedup_slot_t  *slots;
+    guint32        slots_size;      /* a power of 2 */
+    guint32        n_keys;
+
+    guint32        prefix;
+    GArray        *masks;           /* dedup_mask_t */
+    GByteArray    *scratch;         /* frame with the masked bytes zeroed */
+};
+
+#define DEDUP_INITIAL_SIZE  1024
+
+/*
+ * XXH64, by Yann Collet; a fast hash with good dispersion that isn't
+ * meant to withstand an attacker, which we don't need.
+ */
+#define XXH_PRIME64_1   G_GUINT64_CONSTANT(11400714785074694791)
+#define XXH_PRIME64_2   G_GUINT64_CONSTANT(14029467366897019727)
+#define XXH_PRIME64_3   G_GUINT64_CONSTANT(1609587929392839161)
+#define XXH_PRIME64_4   G_GUINT64_CONSTANT(9650029242287828579)
+#define XXH_PRIME64_5   G_GUINT64_CONSTANT(2870177450012600261)
+
+static inline guint64
+xxh_rotl64(guint64 x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64
+xxh64_round(guint64 acc, guint64 input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline guint64
+xxh64_merge_round(guint64 acc, guint64 val)
+{
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static guint64
+xxh64(const guint8 *p, gsize len, guint64 seed)
+{
+    const guint8 *end = p + len;
+    guint64       h;
+
+    if (len >= 32) {
+        const guint8 *limit = end - 32;
+        guint64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        guint64 v2 = seed + XXH_PRIME64_2;
+        guint64 v3 = seed;
+        guint64 v4 = seed - XXH_PRIME64_1;
+
+        do {
+            v1 = xxh64_round(v1, pletoh64(p));
+            v2 = xxh64_round(v2, pletoh64(p + 8));
+            v3 = xxh64_round(v3, pletoh64(p + 16));
+            v4 = xxh64_round(v4, pletoh64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = xxh_rotl64(v1, 1) + xxh_rotl64(v2, 7) +
+            xxh_rotl64(v3, 12) + xxh_rotl64(v4, 18);
+        h = xxh64_merge_round(h, v1);
+        h = xxh64_merge_round(h, v2);
+        h = xxh64_merge_round(h, v3);
+        h = xxh64_merge_round(h, v4);
+    } else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += (guint64)len;
+
+    while (p + 8 <= end) {
+        h ^= xxh64_round(0, pletoh64(p));
+        h = xxh_rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (guint64)pletoh32(p) * XXH_PRIME64_1;
+        h = xxh_rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = xxh_rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static frame_dedup_t *
+frame_dedup_new(void)
+{
+    frame_dedup_t *dedup = g_new0(frame_dedup_t, 1);
+
+    nstime_set_unset(&dedup->latest);
+    dedup->entries_size = DEDUP_INITIAL_SIZE;
+    dedup->entries = g_new(dedup_entry_t, dedup->entries_size);
+    dedup->slots_size = 2 * DEDUP_INITIAL_SIZE;
+    dedup->slots = g_new0(dedup_slot_t, dedup->slots_size);
+    dedup->masks = g_array_new(FALSE, FALSE, sizeof(dedup_mask_t));
+    dedup->scratch = g_byte_array_new();
+    return dedup;
+}
+
+frame_dedup_t *
+frame_dedup_new_frames(guint32 window_frames)
+{
+    frame_dedup_t *dedup = frame_dedup_new();
+
+    dedup->max_frames = window_frames > 0 ? window_frames - 1 : 0;
+    return dedup;
+}
+
+frame_dedup_t *
+frame_dedup_new_time(const nstime_t *window)
+{
+    frame_dedup_t *dedup = frame_dedup_new();
+
+    dedup->by_time = TRUE;
+    dedup->window = *window;
+    return dedup;
+}
+
+void
+frame_dedup_ignore_prefix(frame_dedup_t *dedup, guint32 bytes)
+{
+    dedup->prefix = bytes;
+}
+
+void
+frame_dedup_ignore_bytes(frame_dedup_t *dedup, guint32 offset, guint32 len)
+{
+    dedup_mask_t mask;
+
+    mask.offset = offset;
+    mask.len = len;
+    g_array_append_val(dedup->masks, mask);
+}
+
+static inline guint32
+slot_index(const frame_dedup_t *dedup, guint64 key)
+{
+    /* XXH64's low bits are as good as any. */
+    return (guint32)key & (dedup->slots_size - 1);
+}
+
+static dedup_slot_t *
+find_slot(frame_dedup_t *dedup, guint64 key)
+{
+    guint32 i = slot_index(dedup, key);
+
+    while (dedup->slots[i].key != 0 && dedup->slots[i].key != key)
+        i = (i + 1) & (dedup->slots_size - 1);
+    return &dedup->slots[i];
+}
+
+static void
+grow_slots(frame_dedup_t *dedup)
+{
+    dedup_slot_t *old_slots = dedup->slots;
+    guint32       old_size = dedup->slots_size;
+    guint32       i;
+
+    dedup->slots_size *= 2;
+    dedup->slots = g_new0(dedup_slot_t, dedup->slots_size);
+    for (i = 0; i < old_size; i++) {
+        if (old_slots[i].key != 0)
+            *find_slot(dedup, old_slots[i].key) = old_slots[i];
+    }
+    g_free(old_slots);
+}
+
+/*
+ * Empty a slot, moving later slots of the same probe sequence back so
+ * that lookups don't stop short at the hole.
+ */
+static void
+remove_slot(frame_dedup_t *dedup, dedup_slot_t *slot)
+{
+    guint32 mask = dedup->slots_size - 1;
+    guint32 hole = (guint32)(slot - dedup->slots);
+    guint32 i = hole;
+
+    for (;;) {
+        guint32 home;
+
+        i = (i + 1) & mask;
+        if (dedup->slots[i].key == 0)
+            break;
+        home = slot_index(dedup, dedup->slots[i].key);
+        /* Can the entry at i move back to the hole? */
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            dedup->slots[hole] = dedup->slots[i];
+            hole = i;
+        }
+    }
+    dedup->slots[hole].key = 0;
+    dedup->n_keys--;
+}
+
+static void
+grow_entries(frame_dedup_t *dedup)
+{
+    guint32 old_size = dedup->entries_size;
+    guint32 wrapped;
+
+    dedup->entries_size *= 2;
+    dedup->entries = g_renew(dedup_entry_t, dedup->entries, dedup->entries_size);
+
+    /* Move the part of the ring that wrapped around to after the rest. */
+    wrapped = dedup->first + dedup->n_entries > old_size ?
+              dedup->first + dedup->n_entries - old_size : 0;
+    if (wrapped != 0)
+        memcpy(&dedup->entries[old_size], dedup->entries,
+               wrapped * sizeof(dedup_entry_t));
+}
+
+/* Drop the oldest frame of the window. */
+static void
+evict_oldest(frame_dedup_t *dedup)
+{
+    dedup_entry_t *entry = &dedup->entries[dedup->first];
+    dedup_slot_t  *slot = find_slot(dedup, entry->key);
+
+    if (--slot->count == 0)
+        remove_slot(dedup, slot);
+    dedup->first = (dedup->first + 1) & (dedup->entries_size - 1);
+    dedup->n_entries--;
+}
+
+/* Is a frame at ts out of the window, if the latest frame is at latest? */
+static gboolean
+outside_time_window(const frame_dedup_t *dedup, const nstime_t *ts,
+                    const nstime_t *latest)
+{
+    nstime_t delta;
+
+    nstime_delta(&delta, latest, ts);
+    return nstime_cmp(&delta, &dedup->window) > 0;
+}
+
+static guint64
+frame_hash(frame_dedup_t *dedup, const guint8 *data, guint32 len, guint32 skip)
+{
+    guint32 offset = dedup->prefix;
+    guint64 key;
+    guint   i;
+
+    if (len <= offset)
+        offset = 0;
+    offset += skip;
+    if (offset >= len)
+        offset = 0;
+
+    if (dedup->masks->len != 0) {
+        g_byte_array_set_size(dedup->scratch, len);
+        memcpy(dedup->scratch->data, data, len);
+        for (i = 0; i < dedup->masks->len; i++) {
+            const dedup_mask_t *mask = &g_array_index(dedup->masks, dedup_mask_t, i);
+
+            if (mask->offset < len)
+                memset(&dedup->scratch->data[mask->offset], 0,
+                       MIN(mask->len, len - mask->offset));
+        }
+        data = dedup->scratch->data;
+    }
+
+    /* Seed with the length, so frames of different lengths differ. */
+    key = xxh64(data + offset, len - offset, len);
+    return key != 0 ? key : 1;
+}
+
+gboolean
+frame_dedup_check(frame_dedup_t *dedup, const guint8 *data, guint32 len,
+                  guint32 skip, const nstime_t *ts, guint64 *hash)
+{
+    guint64        key = frame_hash(dedup, data, len, skip);
+    dedup_slot_t  *slot;
+    dedup_entry_t *entry;
+    gboolean       duplicate = FALSE;
+
+    if (hash != NULL)
+        *hash = key;
+
+    if (dedup->by_time) {
+        if (nstime_is_unset(&dedup->latest) || nstime_cmp(ts, &dedup->latest) > 0)
+            dedup->latest = *ts;
+        while (dedup->n_entries != 0 &&
+               outside_time_window(dedup, &dedup->entries[dedup->first].ts,
+                                   &dedup->latest))
+            evict_oldest(dedup);
+    } else if (dedup->max_frames == 0) {
+        return FALSE;
+    }
+
+    slot = find_slot(dedup, key);
+    if (slot->key != 0) {
+        if (!dedup->by_time) {
+            duplicate = TRUE;
+        } else {
+            /*
+             * As when we compared frames one by one, a frame that came
+             * before a later one in the file isn't taken to be a copy of
+             * it; with out of order time stamps, that means we only look
+             * at the latest copy.
+             */
+            duplicate = nstime_cmp(&slot->newest, ts) <= 0 &&
+                        !outside_time_window(dedup, &slot->newest, ts);
+        }
+    }
+
+    /* Make room for this frame, which may change the table. */
+    if (!dedup->by_time && dedup->n_entries == dedup->max_frames) {
+        evict_oldest(dedup);
+        slot = find_slot(dedup, key);
+    }
+
+    if (slot->key != 0) {
+        slot->count++;
+        if (dedup->by_time && nstime_cmp(ts, &slot->newest) > 0)
+            slot->newest = *ts;
+    } else {
+        slot->key = key;
+        slot->count = 1;
+        if (dedup->by_time)
+            slot->newest = *ts;
+        else
+            nstime_set_unset(&slot->newest);
+        if (++dedup->n_keys > dedup->slots_size / 2)
+            grow_slots(dedup);
+    }
+
+    if (dedup->n_entries == dedup->entries_size)
+        grow_entries(dedup);
+    entry = &dedup->entries[(dedup->first + dedup->n_entries) & (dedup->entries_size - 1)];
+    entry->key = key;
+    if (dedup->by_time)
+        entry->ts = *ts;
+    dedup->n_entries++;
+
+    return duplicate;
+}
+
+void
+frame_dedup_free(frame_dedup_t *dedup)
+{
+    if (dedup == NULL)
+        return;
+
+    g_free(dedup->entries);
+    g_free(dedup->slots);
+    g_array_free(dedup->masks, TRUE);
+    g_byte_array_free(dedup->scratch, TRUE);
+    g_free(dedup);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
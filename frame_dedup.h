@@ -0,0 +1,88 @@
+/* frame_dedup.h
+ * Definitions for detecting duplicate frames
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FRAME_DEDUP_H__
+#define __FRAME_DEDUP_H__
+
+#include <glib.h>
+
+#include <wsutil/nstime.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A duplicate frame detector remembers a 64-bit hash of each frame in a
+ * window of recent frames, in a hash table, so checking a frame takes the
+ * same time however large the window is.  The window is either a number
+ * of frames or a span of time.
+ *
+ * Two frames are taken to be the same if they have the same length and
+ * the same hash; with a 64-bit hash, the odds of any two different
+ * frames colliding while checking 30 million frames against a window of
+ * 30 million are about 1 in 40,000.
+ */
+typedef struct _frame_dedup frame_dedup_t;
+
+/** Create a detector for duplicates among the previous window_frames - 1
+ * frames.  A window of 0 or 1 finds no duplicates. */
+frame_dedup_t *frame_dedup_new_frames(guint32 window_frames);
+
+/** Create a detector for duplicates among the frames with time stamps
+ * up to window before the frame's own. */
+frame_dedup_t *frame_dedup_new_time(const nstime_t *window);
+
+/** Leave the given number of bytes at the start of each frame out of its
+ * hash, unless the frame is too short to have anything left. */
+void frame_dedup_ignore_prefix(frame_dedup_t *dedup, guint32 bytes);
+
+/** Leave the bytes from offset for len bytes out of each frame's hash,
+ * such as a TTL or checksum that a router between the capture points
+ * changes.  May be used several times. */
+void frame_dedup_ignore_bytes(frame_dedup_t *dedup, guint32 offset, guint32 len);
+
+/**
+ * Check whether a frame is a duplicate of one in the window, and add it
+ * to the window.
+ *
+ * @param dedup The detector.
+ * @param data The frame's data.
+ * @param len The frame's length.
+ * @param skip Bytes at the start of the frame to leave out of the hash,
+ *        in addition to the ignored prefix, such as a radiotap header.
+ * @param ts The frame's time stamp; only used with a time window.
+ * @param hash Set to the frame's hash, for showing it; may be NULL.
+ * @return TRUE if the frame is a duplicate.
+ */
+gboolean frame_dedup_check(frame_dedup_t *dedup, const guint8 *data,
+                           guint32 len, guint32 skip, const nstime_t *ts,
+                           guint64 *hash);
+
+void frame_dedup_free(frame_dedup_t *dedup);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FRAME_DEDUP_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
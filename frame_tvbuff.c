@@ -31,16 +31,30 @@ struct tvb_frame {
 	guint offset;
 };
 
+static GMutex *read_mutex = NULL;
+
+void
+frame_tvbuff_set_read_mutex(GMutex *mutex)
+{
+	read_mutex = mutex;
+}
+
 static gboolean
 frame_read(struct tvb_frame *frame_tvb, wtap_rec *rec, Buffer *buf)
 {
 	int    err;
 	gchar *err_info;
+	gboolean ok;
 
 	/* XXX, what if phdr->caplen isn't equal to
 	 * frame_tvb->tvb.length + frame_tvb->offset?
 	 */
-	if (!wtap_seek_read(frame_tvb->prov->wth, frame_tvb->file_off, rec, buf, &err, &err_info)) {
+	if (read_mutex)
+		g_mutex_lock(read_mutex);
+	ok = wtap_seek_read(frame_tvb->prov->wth, frame_tvb->file_off, rec, buf, &err, &err_info);
+	if (read_mutex)
+		g_mutex_unlock(read_mutex);
+	if (!ok) {
 		/* XXX - report error! */
 		switch (err) {
 			case WTAP_ERR_BAD_FILE:
@@ -31,6 +31,13 @@ extern tvbuff_t *file_tvbuff_new(const struct packet_provider_data *prov,
 extern tvbuff_t *file_tvbuff_new_buffer(const struct packet_provider_data *prov,
     const frame_data *fd, Buffer *buf);
 
+/*
+ * Set a mutex to hold while frame tvbuffs whose data isn't in memory
+ * read it back from the file, if something else may be reading from
+ * the random-access stream on another thread; NULL for none.
+ */
+extern void frame_tvbuff_set_read_mutex(GMutex *mutex);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
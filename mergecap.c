@@ -16,6 +16,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <errno.h>
+
+/*
+ * Just make sure we include the prototype for strptime as well
+ * (needed for glibc 2.2) but make sure we do this only if not
+ * yet defined.
+ */
+
+#ifndef __USE_XOPEN
+#  define __USE_XOPEN
+#endif
+
+#include <time.h>
 #include <glib.h>
 
 #ifdef HAVE_GETOPT_H
@@ -30,6 +42,11 @@
 #include <wsutil/wsgetopt.h>
 #endif
 
+#ifndef HAVE_STRPTIME
+# include "wsutil/strptime.h"
+#endif
+
+#include <wsutil/capture_manifest.h>
 #include <wsutil/clopts_common.h>
 #include <wsutil/cmdarg_err.h>
 #include <wsutil/crash_info.h>
@@ -53,6 +70,8 @@
 
 #include "ui/failure_message.h"
 
+#define LONGOPT_COMPRESS (65536+1)
+
 /*
  * Show the usage
  */
@@ -73,9 +92,20 @@ print_usage(FILE *output)
   fprintf(output, "  -F <capture type> set the output file type; default is pcap.\n");
 #endif
   fprintf(output, "                    an empty \"-F\" option will list the file types.\n");
+  fprintf(output, "  --compress <type> compress the output file with gzip, zstd or lz4;\n");
+  fprintf(output, "                    \"--compress help\" lists the types available.\n");
   fprintf(output, "  -I <IDB merge mode> set the merge mode for Interface Description Blocks; default is 'all'.\n");
   fprintf(output, "                    an empty \"-I\" option will list the merge modes.\n");
   fprintf(output, "\n");
+  fprintf(output, "Packet selection:\n");
+  fprintf(output, "  -A <start time>   only output packets whose timestamp is after (or equal\n");
+  fprintf(output, "                    to) the given time (format as YYYY-MM-DD hh:mm:ss).\n");
+  fprintf(output, "  -B <stop time>    only output packets whose timestamp is before the\n");
+  fprintf(output, "                    given time (format as YYYY-MM-DD hh:mm:ss).\n");
+  fprintf(output, "                    an <infile> ending in \"%s\" is the manifest of a ring\n", CAPTURE_MANIFEST_SUFFIX);
+  fprintf(output, "                    buffer capture; only its files with packets in that\n");
+  fprintf(output, "                    time are read.\n");
+  fprintf(output, "\n");
   fprintf(output, "Miscellaneous:\n");
   fprintf(output, "  -h                display this help and exit.\n");
   fprintf(output, "  -v                verbose output.\n");
@@ -164,6 +194,75 @@ list_idb_merge_modes(void) {
   }
 }
 
+static void
+list_output_compression_types(void) {
+  GSList *compression_type_names, *name;
+
+  fprintf(stderr, "mergecap: The available output compression types for the \"--compress\" flag are:\n");
+  compression_type_names = wtap_get_all_output_compression_type_names_list();
+  for (name = compression_type_names; name != NULL; name = g_slist_next(name))
+    fprintf(stderr, "    %s\n", (const char *)name->data);
+  g_slist_free(compression_type_names);
+}
+
+/*
+ * Parse a time given with -A or -B.
+ */
+static gboolean
+parse_time_arg(const char *arg, nstime_t *ts)
+{
+  struct tm tm;
+
+  memset(&tm, 0, sizeof(struct tm));
+  if (!strptime(arg, "%Y-%m-%d %T", &tm)) {
+    fprintf(stderr, "mergecap: \"%s\" isn't a valid time format\n", arg);
+    return FALSE;
+  }
+  tm.tm_isdst = -1;
+  ts->secs = mktime(&tm);
+  ts->nsecs = 0;
+  return TRUE;
+}
+
+/*
+ * Add the input files named on the command line to a list, replacing
+ * each ring buffer manifest with the files it lists that can have
+ * packets between start and stop.
+ */
+static gboolean
+add_in_files(GPtrArray *in_filenames, char *const *args, int n_args,
+             const nstime_t *start, const nstime_t *stop)
+{
+  int i;
+  guint j;
+
+  for (i = 0; i < n_args; i++) {
+    capture_manifest *manifest;
+    GPtrArray *paths;
+    int err;
+
+    if (!g_str_has_suffix(args[i], CAPTURE_MANIFEST_SUFFIX)) {
+      g_ptr_array_add(in_filenames, g_strdup(args[i]));
+      continue;
+    }
+    manifest = capture_manifest_read(args[i], &err);
+    if (manifest == NULL) {
+      if (err == EINVAL)
+        cmdarg_err("\"%s\" isn't a capture manifest.", args[i]);
+      else
+        cmdarg_err("The capture manifest \"%s\" could not be read: %s.",
+                   args[i], g_strerror(err));
+      return FALSE;
+    }
+    paths = capture_manifest_select(manifest, start, stop);
+    for (j = 0; j < paths->len; j++)
+      g_ptr_array_add(in_filenames, g_strdup((const char *)g_ptr_array_index(paths, j)));
+    g_ptr_array_free(paths, TRUE);
+    capture_manifest_free(manifest);
+  }
+  return TRUE;
+}
+
 static gboolean
 merge_callback(merge_event event, int num,
                const merge_in_file_t in_files[], const guint in_file_count,
@@ -239,6 +338,7 @@ real_main(int argc, char *argv[])
   static const struct option long_options[] = {
       {"help", no_argument, NULL, 'h'},
       {"version", no_argument, NULL, 'V'},
+      {"compress", required_argument, NULL, LONGOPT_COMPRESS},
       {0, 0, 0, 0 }
   };
   gboolean            do_append          = FALSE;
@@ -250,6 +350,7 @@ real_main(int argc, char *argv[])
 #else
   int                 file_type          = WTAP_FILE_TYPE_SUBTYPE_PCAP; /* default to pcap format */
 #endif
+  wtap_compression_type compression_type = WTAP_UNCOMPRESSED;
   int                 err                = 0;
   gchar              *err_info           = NULL;
   int                 err_fileno;
@@ -257,6 +358,10 @@ real_main(int argc, char *argv[])
   char               *out_filename       = NULL;
   merge_result        status             = MERGE_OK;
   idb_merge_mode      mode               = IDB_MERGE_MODE_MAX;
+  nstime_t            start_time, stop_time;
+  gboolean            have_start_time    = FALSE;
+  gboolean            have_stop_time     = FALSE;
+  GPtrArray          *in_filenames       = NULL;
   merge_progress_callback_t cb;
 
   cmdarg_err_init(mergecap_cmdarg_err, mergecap_cmdarg_err_cont);
@@ -304,13 +409,29 @@ real_main(int argc, char *argv[])
   wtap_init(TRUE);
 
   /* Process the options first */
-  while ((opt = getopt_long(argc, argv, "aF:hI:s:vVw:", long_options, NULL)) != -1) {
+  while ((opt = getopt_long(argc, argv, "aA:B:F:hI:s:vVw:", long_options, NULL)) != -1) {
 
     switch (opt) {
     case 'a':
       do_append = !do_append;
       break;
 
+    case 'A':
+      if (!parse_time_arg(optarg, &start_time)) {
+        status = MERGE_ERR_INVALID_OPTION;
+        goto clean_exit;
+      }
+      have_start_time = TRUE;
+      break;
+
+    case 'B':
+      if (!parse_time_arg(optarg, &stop_time)) {
+        status = MERGE_ERR_INVALID_OPTION;
+        goto clean_exit;
+      }
+      have_stop_time = TRUE;
+      break;
+
     case 'F':
       file_type = wtap_short_string_to_file_type_subtype(optarg);
       if (file_type < 0) {
@@ -363,6 +484,21 @@ real_main(int argc, char *argv[])
       out_filename = optarg;
       break;
 
+    case LONGOPT_COMPRESS:
+      if (strcmp(optarg, "help") == 0) {
+        list_output_compression_types();
+        goto clean_exit;
+      }
+      compression_type = wtap_name_to_compression_type(optarg);
+      if (compression_type == WTAP_UNKNOWN_COMPRESSION) {
+        fprintf(stderr, "mergecap: \"%s\" isn't a valid output compression type\n",
+                optarg);
+        list_output_compression_types();
+        status = MERGE_ERR_INVALID_OPTION;
+        goto clean_exit;
+      }
+      break;
+
     case '?':              /* Bad options if GNU getopt */
       switch(optopt) {
       case'F':
@@ -398,6 +534,26 @@ real_main(int argc, char *argv[])
     return 1;
   }
 
+  if (have_start_time && have_stop_time &&
+      nstime_cmp(&start_time, &stop_time) > 0) {
+    fprintf(stderr, "mergecap: start time is after the stop time\n");
+    status = MERGE_ERR_INVALID_OPTION;
+    goto clean_exit;
+  }
+
+  in_filenames = g_ptr_array_new_with_free_func(g_free);
+  if (!add_in_files(in_filenames, &argv[optind], in_file_count,
+                    have_start_time ? &start_time : NULL,
+                    have_stop_time ? &stop_time : NULL)) {
+    status = MERGE_ERR_INVALID_OPTION;
+    goto clean_exit;
+  }
+  if (in_filenames->len == 0) {
+    fprintf(stderr, "mergecap: None of the files in the manifests have packets in that time\n");
+    status = MERGE_ERR_INVALID_OPTION;
+    goto clean_exit;
+  }
+
   /* setting IDB merge mode must use PCAPNG output */
   if (mode != IDB_MERGE_MODE_MAX && file_type != WTAP_FILE_TYPE_SUBTYPE_PCAPNG) {
     fprintf(stderr, "The IDB merge mode can only be used with PCAPNG output format\n");
@@ -410,21 +566,15 @@ real_main(int argc, char *argv[])
     mode = IDB_MERGE_MODE_ALL_SAME;
   }
 
-  /* open the outfile */
-  if (strcmp(out_filename, "-") == 0) {
-    /* merge the files to the standard output */
-    status = merge_files_to_stdout(file_type,
-                                   (const char *const *) &argv[optind],
-                                   in_file_count, do_append, mode, snaplen,
-                                   "mergecap", verbose ? &cb : NULL,
-                                   &err, &err_info, &err_fileno, &err_framenum);
-  } else {
-    /* merge the files to the outfile */
-    status = merge_files(out_filename, file_type,
-                         (const char *const *) &argv[optind], in_file_count,
-                         do_append, mode, snaplen, "mergecap", verbose ? &cb : NULL,
-                         &err, &err_info, &err_fileno, &err_framenum);
-  }
+  /* merge the files to the outfile, or to the standard output for "-" */
+  status = merge_files_in_time_range(strcmp(out_filename, "-") == 0 ? NULL : out_filename,
+                                     file_type, compression_type,
+                                     (const char *const *) in_filenames->pdata,
+                                     in_filenames->len, do_append, mode, snaplen,
+                                     have_start_time ? &start_time : NULL,
+                                     have_stop_time ? &stop_time : NULL,
+                                     "mergecap", verbose ? &cb : NULL,
+                                     &err, &err_info, &err_fileno, &err_framenum);
 
   switch (status) {
     case MERGE_OK:
@@ -436,7 +586,7 @@ real_main(int argc, char *argv[])
       break;
 
     case MERGE_ERR_CANT_OPEN_INFILE:
-      cfile_open_failure_message("mergecap", argv[optind + err_fileno],
+      cfile_open_failure_message("mergecap", (const char *)g_ptr_array_index(in_filenames, err_fileno),
                                  err, err_info);
       break;
 
@@ -445,17 +595,17 @@ real_main(int argc, char *argv[])
       break;
 
     case MERGE_ERR_CANT_READ_INFILE:
-      cfile_read_failure_message("mergecap", argv[optind + err_fileno],
+      cfile_read_failure_message("mergecap", (const char *)g_ptr_array_index(in_filenames, err_fileno),
                                  err, err_info);
       break;
 
     case MERGE_ERR_BAD_PHDR_INTERFACE_ID:
       cmdarg_err("Record %u of \"%s\" has an interface ID that does not match any IDB in its file.",
-                 err_framenum, argv[optind + err_fileno]);
+                 err_framenum, (const char *)g_ptr_array_index(in_filenames, err_fileno));
       break;
 
     case MERGE_ERR_CANT_WRITE_OUTFILE:
-       cfile_write_failure_message("mergecap", argv[optind + err_fileno],
+       cfile_write_failure_message("mergecap", (const char *)g_ptr_array_index(in_filenames, err_fileno),
                                    out_filename, err, err_info, err_framenum,
                                    file_type);
        break;
@@ -470,6 +620,8 @@ real_main(int argc, char *argv[])
   }
 
 clean_exit:
+  if (in_filenames != NULL)
+    g_ptr_array_free(in_filenames, TRUE);
   wtap_cleanup();
   free_progdirs();
   return (status == MERGE_OK) ? 0 : 2;
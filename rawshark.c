@@ -763,7 +763,7 @@ real_main(int argc, char *argv[])
         for (i = 0; i < n_rfilters; i++) {
             gchar *err_msg;
 
-            if (!dfilter_compile(rfilters[i], &rfcodes[n_rfcodes], &err_msg)) {
+            if (!dfilter_compile_flags(rfilters[i], &rfcodes[n_rfcodes], &err_msg, DF_ALLOW_FILE_SETS)) {
                 cmdarg_err("%s", err_msg);
                 g_free(err_msg);
                 ret = INVALID_DFILTER;
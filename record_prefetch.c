@@ -0,0 +1,410 @@
+/* record_prefetch.c
+ * Read capture file records ahead of dissection on a separate thread
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <wsutil/buffer.h>
+
+#include <epan/frame_data.h>
+
+#include "record_prefetch.h"
+
+typedef struct {
+  record_prefetch_deferred_func func;
+  gpointer                      data;
+  GDestroyNotify                free_func;  /* for data, if func isn't called */
+} deferred_call_t;
+
+typedef struct {
+  wtap_rec  rec;
+  Buffer    buf;
+  gint64    data_offset;
+  GSList   *deferred;     /* deferred_call_t *, in the order they were made */
+} prefetch_slot_t;
+
+struct _record_prefetch {
+  wtap            *wth;
+  GThread         *thread;
+
+  /* For reading frames at known offsets, rather than sequentially. */
+  frame_data_sequence *frames;
+  guint32          next_frame;
+  guint32          last_frame;
+
+  GMutex           wtap_mtx;    /* held by the reader while it's in wiretap */
+
+  GMutex           queue_mtx;   /* protects everything below */
+  GCond            not_empty;
+  GCond            not_full;
+  prefetch_slot_t *slots;
+  guint            n_slots;
+  guint            head;        /* slot the consumer gets next, or holds */
+  guint            count;       /* slots filled, including one being held */
+  gboolean         holding;     /* consumer holds the slot at head */
+  gboolean         done;        /* reader got an EOF or an error */
+  gboolean         stop;        /* consumer asked the reader to stop */
+  int              err;
+  gchar           *err_info;
+
+  GSList          *pending;     /* calls deferred for the slot being read, reversed */
+};
+
+static guint
+rec_data_length(const wtap_rec *rec)
+{
+  switch (rec->rec_type) {
+
+  case REC_TYPE_PACKET:
+    return rec->rec_header.packet_header.caplen;
+
+  case REC_TYPE_FT_SPECIFIC_EVENT:
+  case REC_TYPE_FT_SPECIFIC_REPORT:
+    return rec->rec_header.ft_specific_header.record_len;
+
+  case REC_TYPE_SYSCALL:
+    return rec->rec_header.syscall_header.event_filelen;
+  }
+  return 0;
+}
+
+/*
+ * Copy the record wiretap just read into a slot.  The record's options
+ * buffer is scratch space for the file readers, so it isn't copied, and
+ * the comment is copied because wiretap may reuse or free it on the next
+ * read.
+ */
+static void
+slot_fill(prefetch_slot_t *slot, const wtap_rec *rec, const guint8 *pd,
+    gint64 data_offset)
+{
+  Buffer options_buf = slot->rec.options_buf;
+  guint  len = rec_data_length(rec);
+
+  g_free(slot->rec.opt_comment);
+  slot->rec = *rec;
+  slot->rec.options_buf = options_buf;
+  slot->rec.opt_comment = g_strdup(rec->opt_comment);
+
+  ws_buffer_assure_space(&slot->buf, len);
+  if (len != 0)
+    memcpy(ws_buffer_start_ptr(&slot->buf), pd, len);
+  slot->data_offset = data_offset;
+}
+
+/*
+ * Read the next record sequentially.
+ */
+static gboolean
+read_sequential(record_prefetch_t *rp, prefetch_slot_t *slot, int *err,
+    gchar **err_info)
+{
+  gint64 data_offset;
+
+  if (!wtap_read(rp->wth, err, err_info, &data_offset))
+    return FALSE;
+  slot_fill(slot, wtap_get_rec(rp->wth), wtap_get_buf_ptr(rp->wth),
+            data_offset);
+  return TRUE;
+}
+
+/*
+ * Read the next frame in the sequence from its known offset.
+ */
+static gboolean
+read_frame(record_prefetch_t *rp, prefetch_slot_t *slot, int *err,
+    gchar **err_info)
+{
+  frame_data *fdata;
+
+  if (rp->next_frame > rp->last_frame) {
+    /* That's all of them. */
+    *err = 0;
+    *err_info = NULL;
+    return FALSE;
+  }
+  fdata = frame_data_sequence_find(rp->frames, rp->next_frame++);
+
+  g_free(slot->rec.opt_comment);
+  slot->rec.opt_comment = NULL;
+  if (!wtap_seek_read(rp->wth, fdata->file_off, &slot->rec, &slot->buf,
+                      err, err_info))
+    return FALSE;
+
+  /*
+   * wtap_seek_read() filled in our own record, so the comment it
+   * allocated is already ours to free.
+   */
+  slot->data_offset = fdata->file_off;
+  return TRUE;
+}
+
+static void
+run_deferred(GSList *deferred)
+{
+  GSList *l;
+
+  for (l = deferred; l != NULL; l = g_slist_next(l)) {
+    deferred_call_t *call = (deferred_call_t *)l->data;
+
+    call->func(call->data);
+    g_free(call);
+  }
+  g_slist_free(deferred);
+}
+
+static gpointer
+record_prefetch_worker(gpointer data)
+{
+  record_prefetch_t *rp = (record_prefetch_t *)data;
+  prefetch_slot_t   *slot;
+  gboolean           ok;
+  int                err;
+  gchar             *err_info;
+
+  for (;;) {
+    g_mutex_lock(&rp->queue_mtx);
+    while (rp->count == rp->n_slots && !rp->stop)
+      g_cond_wait(&rp->not_full, &rp->queue_mtx);
+    if (rp->stop) {
+      g_mutex_unlock(&rp->queue_mtx);
+      break;
+    }
+    slot = &rp->slots[(rp->head + rp->count) % rp->n_slots];
+    g_mutex_unlock(&rp->queue_mtx);
+
+    /*
+     * The slot is past the end of the filled ones, so the consumer
+     * won't look at it until we publish it below.
+     */
+    g_mutex_lock(&rp->wtap_mtx);
+    if (rp->frames != NULL)
+      ok = read_frame(rp, slot, &err, &err_info);
+    else
+      ok = read_sequential(rp, slot, &err, &err_info);
+    g_mutex_unlock(&rp->wtap_mtx);
+
+    g_mutex_lock(&rp->queue_mtx);
+    if (ok) {
+      slot->deferred = g_slist_reverse(rp->pending);
+      rp->pending = NULL;
+      rp->count++;
+    } else {
+      rp->done = TRUE;
+      rp->err = err;
+      rp->err_info = err_info;
+    }
+    g_cond_signal(&rp->not_empty);
+    g_mutex_unlock(&rp->queue_mtx);
+
+    if (!ok)
+      break;
+  }
+  return NULL;
+}
+
+static record_prefetch_t *
+record_prefetch_start(wtap *wth, frame_data_sequence *frames,
+    guint32 frame_count, guint depth)
+{
+  record_prefetch_t *rp = g_new0(record_prefetch_t, 1);
+  guint              i;
+
+  if (depth == 0)
+    depth = RECORD_PREFETCH_DEFAULT_DEPTH;
+  else if (depth > RECORD_PREFETCH_MAX_DEPTH)
+    depth = RECORD_PREFETCH_MAX_DEPTH;
+
+  rp->wth = wth;
+  rp->frames = frames;
+  rp->next_frame = 1;
+  rp->last_frame = frame_count;
+  g_mutex_init(&rp->wtap_mtx);
+  g_mutex_init(&rp->queue_mtx);
+  g_cond_init(&rp->not_empty);
+  g_cond_init(&rp->not_full);
+
+  /*
+   * One extra slot, as the consumer holds on to the record it was
+   * last handed while the reader keeps going.
+   */
+  rp->n_slots = depth + 1;
+  rp->slots = g_new0(prefetch_slot_t, rp->n_slots);
+  for (i = 0; i < rp->n_slots; i++) {
+    wtap_rec_init(&rp->slots[i].rec);
+    ws_buffer_init(&rp->slots[i].buf, 1514);
+  }
+
+  rp->thread = g_thread_new("record_prefetch", record_prefetch_worker, rp);
+  return rp;
+}
+
+record_prefetch_t *
+record_prefetch_new(wtap *wth, guint depth)
+{
+  return record_prefetch_start(wth, NULL, 0, depth);
+}
+
+record_prefetch_t *
+record_prefetch_new_frames(wtap *wth, frame_data_sequence *frames,
+    guint32 frame_count, guint depth)
+{
+  return record_prefetch_start(wth, frames, frame_count, depth);
+}
+
+gboolean
+record_prefetch_read(record_prefetch_t *rp, wtap_rec **rec, const guint8 **pd,
+    gint64 *data_offset, int *err, gchar **err_info)
+{
+  prefetch_slot_t *slot;
+  GSList          *deferred;
+
+  g_mutex_lock(&rp->queue_mtx);
+
+  /* We're done with the record we handed out last time. */
+  if (rp->holding) {
+    rp->holding = FALSE;
+    rp->head = (rp->head + 1) % rp->n_slots;
+    rp->count--;
+    g_cond_signal(&rp->not_full);
+  }
+
+  while (rp->count == 0 && !rp->done)
+    g_cond_wait(&rp->not_empty, &rp->queue_mtx);
+
+  if (rp->count == 0) {
+    /*
+     * EOF or error.  Run anything deferred after the last record,
+     * e.g. name resolution blocks at the end of a pcapng file.
+     */
+    deferred = g_slist_reverse(rp->pending);
+    rp->pending = NULL;
+    *err = rp->err;
+    *err_info = rp->err_info;
+    rp->err = 0;
+    rp->err_info = NULL;
+    g_mutex_unlock(&rp->queue_mtx);
+
+    run_deferred(deferred);
+    return FALSE;
+  }
+
+  slot = &rp->slots[rp->head];
+  deferred = slot->deferred;
+  slot->deferred = NULL;
+  rp->holding = TRUE;
+  g_mutex_unlock(&rp->queue_mtx);
+
+  run_deferred(deferred);
+
+  *rec = &slot->rec;
+  *pd = ws_buffer_start_ptr(&slot->buf);
+  *data_offset = slot->data_offset;
+  *err = 0;
+  *err_info = NULL;
+  return TRUE;
+}
+
+void
+record_prefetch_defer(record_prefetch_t *rp,
+    record_prefetch_deferred_func func, gpointer data,
+    GDestroyNotify free_func)
+{
+  deferred_call_t *call = g_new(deferred_call_t, 1);
+
+  call->func = func;
+  call->data = data;
+  call->free_func = free_func;
+
+  /* Only the reader touches this list until it's handed over. */
+  rp->pending = g_slist_prepend(rp->pending, call);
+}
+
+void
+record_prefetch_lock(record_prefetch_t *rp)
+{
+  if (rp != NULL)
+    g_mutex_lock(&rp->wtap_mtx);
+}
+
+void
+record_prefetch_unlock(record_prefetch_t *rp)
+{
+  if (rp != NULL)
+    g_mutex_unlock(&rp->wtap_mtx);
+}
+
+GMutex *
+record_prefetch_get_mutex(record_prefetch_t *rp)
+{
+  return &rp->wtap_mtx;
+}
+
+static void
+free_deferred(GSList *deferred)
+{
+  GSList *l;
+
+  /* The calls are never going to be made; just discard their data. */
+  for (l = deferred; l != NULL; l = g_slist_next(l)) {
+    deferred_call_t *call = (deferred_call_t *)l->data;
+
+    call->free_func(call->data);
+    g_free(call);
+  }
+  g_slist_free(deferred);
+}
+
+void
+record_prefetch_free(record_prefetch_t *rp)
+{
+  guint i;
+
+  if (rp == NULL)
+    return;
+
+  g_mutex_lock(&rp->queue_mtx);
+  rp->stop = TRUE;
+  g_cond_signal(&rp->not_full);
+  g_mutex_unlock(&rp->queue_mtx);
+  g_thread_join(rp->thread);
+
+  for (i = 0; i < rp->n_slots; i++) {
+    free_deferred(rp->slots[i].deferred);
+    g_free(rp->slots[i].rec.opt_comment);
+    wtap_rec_cleanup(&rp->slots[i].rec);
+    ws_buffer_free(&rp->slots[i].buf);
+  }
+  g_free(rp->slots);
+  free_deferred(rp->pending);
+  g_free(rp->err_info);
+
+  g_cond_clear(&rp->not_full);
+  g_cond_clear(&rp->not_empty);
+  g_mutex_clear(&rp->queue_mtx);
+  g_mutex_clear(&rp->wtap_mtx);
+  g_free(rp);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
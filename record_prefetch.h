@@ -0,0 +1,148 @@
+/* record_prefetch.h
+ * Read capture file records ahead of dissection on a separate thread
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __RECORD_PREFETCH_H__
+#define __RECORD_PREFETCH_H__
+
+#include <wiretap/wtap.h>
+#include <epan/frame_data_sequence.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A record prefetcher runs wiretap on a thread of its own, reading and
+ * decoding up to a fixed number of records ahead of the caller, so that
+ * file I/O, decompression and record parsing overlap with dissection.
+ *
+ * Records are handed back strictly in file order.  The record and data
+ * returned by record_prefetch_read() stay valid until the next call to
+ * record_prefetch_read() or record_prefetch_free().
+ *
+ * Dissection itself still happens on the calling thread; epan isn't
+ * reentrant, so this is a two-stage pipeline rather than a worker pool.
+ * Dissecting and printing frames in parallel takes several processes;
+ * see dissect_workers.h.
+ */
+typedef struct _record_prefetch record_prefetch_t;
+
+/** Function called on the consuming thread for work deferred by the
+ * reader thread; see record_prefetch_defer(). */
+typedef void (*record_prefetch_deferred_func)(gpointer data);
+
+/** Default and maximum number of records read ahead. */
+#define RECORD_PREFETCH_DEFAULT_DEPTH   256
+#define RECORD_PREFETCH_MAX_DEPTH       65536
+
+/**
+ * Start reading records sequentially from wth, with wtap_read(), on a
+ * new thread.  The caller must not call any wiretap routine that reads
+ * from, or modifies the state of, wth until record_prefetch_free() has
+ * been called, other than while holding the lock taken with
+ * record_prefetch_lock().
+ *
+ * @param wth the wiretap session to read from
+ * @param depth the maximum number of records to read ahead
+ * @return the new prefetcher
+ */
+record_prefetch_t *record_prefetch_new(wtap *wth, guint depth);
+
+/**
+ * Start reading frames 1 through frame_count of frames, in order, with
+ * wtap_seek_read(), on a new thread.  This is for a second pass over a
+ * file whose frames have already been read sequentially; the same
+ * restrictions on the use of wth apply as for record_prefetch_new(),
+ * including reading from the random-access stream, e.g. by frame
+ * tvbuffs; see record_prefetch_get_mutex().
+ *
+ * @param wth the wiretap session to read from
+ * @param frames the frames to read
+ * @param frame_count the number of frames to read
+ * @param depth the maximum number of records to read ahead
+ * @return the new prefetcher
+ */
+record_prefetch_t *record_prefetch_new_frames(wtap *wth,
+    frame_data_sequence *frames, guint32 frame_count, guint depth);
+
+/**
+ * Get the next record.
+ *
+ * Before returning a record, any work deferred by the reader thread while
+ * reading up to that record is run on the calling thread.
+ *
+ * @param rp the prefetcher
+ * @param rec set to point to the record's metadata
+ * @param pd set to point to the record's data
+ * @param data_offset set to the record's offset in the file
+ * @param err set to the error code on a read error
+ * @param err_info set to additional error information on a read error
+ * @return TRUE if a record was returned, FALSE on EOF or a read error
+ */
+gboolean record_prefetch_read(record_prefetch_t *rp, wtap_rec **rec,
+    const guint8 **pd, gint64 *data_offset, int *err, gchar **err_info);
+
+/**
+ * Defer a call until just before the record currently being read is
+ * handed to the consumer, or until the consumer gets EOF or an error.
+ * Must only be called from the reader thread, i.e. from wiretap callbacks
+ * such as the name resolution or decryption secrets callbacks.
+ *
+ * func is called on the consuming thread and is responsible for freeing
+ * data.  If the prefetcher is freed before the call is made, data is
+ * freed with free_func instead.
+ *
+ * @param rp the prefetcher
+ * @param func the function to call
+ * @param data the argument to pass to it
+ * @param free_func the function to free data with if func isn't called
+ */
+void record_prefetch_defer(record_prefetch_t *rp,
+    record_prefetch_deferred_func func, gpointer data,
+    GDestroyNotify free_func);
+
+/**
+ * Lock out the reader thread so that per-file information kept by
+ * wiretap, such as the interface descriptions, can be examined safely.
+ * Does nothing if rp is NULL.
+ */
+void record_prefetch_lock(record_prefetch_t *rp);
+void record_prefetch_unlock(record_prefetch_t *rp);
+
+/**
+ * Get the mutex taken by record_prefetch_lock(), for code that can't be
+ * handed the prefetcher itself.
+ */
+GMutex *record_prefetch_get_mutex(record_prefetch_t *rp);
+
+/**
+ * Stop the reader thread, waiting for it to finish, and free the
+ * prefetcher and any records it holds.
+ */
+void record_prefetch_free(record_prefetch_t *rp);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* record_prefetch.h */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 2
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=2 tabstop=8 expandtab:
+ * :indentSize=2:tabSize=8:noTabs=true:
+ */
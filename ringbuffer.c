@@ -43,6 +43,8 @@
 
 #include "ringbuffer.h"
 #include <wsutil/file_util.h>
+#include <wsutil/cwstream.h>
+#include <wsutil/capture_manifest.h>
 
 
 /* Ringbuffer file structure */
@@ -62,6 +64,13 @@ typedef struct _ringbuf_data {
   int           fd;                  /* Current ringbuffer file descriptor */
   FILE         *pdh;
   gboolean      group_read_access;   /* TRUE if files need to be opened with group read access */
+  gboolean      use_stream;          /* TRUE if files are to be compressed, or written on a thread */
+  ws_cwstream_type compress_type;    /* How to compress them */
+  ws_cwstream_options write_options;
+
+  capture_manifest *manifest;        /* What's in the files */
+  capture_manifest_entry *curr_entry; /* The current file's entry in it */
+  gchar        *manifest_path;
 } ringbuf_data;
 
 static ringbuf_data rb_data;
@@ -81,6 +90,7 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
     if (rb_data.unlimited == FALSE) {
       /* remove old file (if any, so ignore error) */
       ws_unlink(rfile->name);
+      capture_manifest_remove_file(rb_data.manifest, rfile->name);
     }
     g_free(rfile->name);
   }
@@ -112,6 +122,9 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
     *err = errno;
   }
 
+  if (rb_data.fd != -1)
+    rb_data.curr_entry = capture_manifest_add_file(rb_data.manifest, rfile->name);
+
   return rb_data.fd;
 }
 
@@ -119,7 +132,8 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
  * Initialize the ringbuffer data structures
  */
 int
-ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_access)
+ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_access,
+             const char *compress_type, const ws_cwstream_options *write_options)
 {
   unsigned int i;
   char        *pfx, *last_pathsep;
@@ -133,6 +147,25 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
   rb_data.fd = -1;
   rb_data.pdh = NULL;
   rb_data.group_read_access = group_read_access;
+  rb_data.use_stream = FALSE;
+  memset(&rb_data.write_options, 0, sizeof rb_data.write_options);
+  rb_data.manifest = NULL;
+  rb_data.curr_entry = NULL;
+  rb_data.manifest_path = NULL;
+
+  if (compress_type != NULL) {
+    if (!ws_cwstream_name_to_type(compress_type, &rb_data.compress_type)) {
+      return -1;
+    }
+    rb_data.use_stream = TRUE;
+  }
+  if (write_options != NULL) {
+    if (!rb_data.use_stream) {
+      rb_data.compress_type = WS_CWSTREAM_NONE;
+      rb_data.use_stream = TRUE;
+    }
+    rb_data.write_options = *write_options;
+  }
 
   /* just to be sure ... */
   if (num_files <= RINGBUFFER_MAX_NUM_FILES) {
@@ -193,6 +226,10 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
     rb_data.files[i].name = NULL;
   }
 
+  /* the manifest goes next to the files, named after the capture file */
+  rb_data.manifest = capture_manifest_new(NULL);
+  rb_data.manifest_path = g_strconcat(capfile_name, CAPTURE_MANIFEST_SUFFIX, NULL);
+
   /* create the first file */
   if (ringbuf_open_file(&rb_data.files[0], NULL) == -1) {
     ringbuf_error_cleanup();
@@ -209,12 +246,42 @@ const gchar *ringbuf_current_filename(void)
 }
 
 /*
- * Calls ws_fdopen() for the current ringbuffer file
+ * Counts a packet written to the current ringbuffer file in the manifest
+ */
+void
+ringbuf_add_packet(guint32 interface_id, const nstime_t *ts, guint32 caplen)
+{
+  if (rb_data.curr_entry != NULL)
+    capture_manifest_add_packet(rb_data.curr_entry, interface_id, ts, caplen);
+}
+
+/*
+ * Writes the manifest.  Not being able to doesn't stop the capture, as
+ * the files themselves are fine; the manifest just doesn't list the
+ * latest of them
+ */
+static void
+ringbuf_write_manifest(void)
+{
+  int err;
+
+  if (rb_data.manifest != NULL)
+    capture_manifest_write(rb_data.manifest, rb_data.manifest_path, &err);
+}
+
+/*
+ * Calls ws_fdopen() for the current ringbuffer file, or, if the files
+ * are to be compressed or written on a thread of their own, makes a
+ * ws_cwstream for it
  */
 FILE *
 ringbuf_init_libpcap_fdopen(int *err)
 {
-  rb_data.pdh = ws_fdopen(rb_data.fd, "wb");
+  if (rb_data.use_stream)
+    rb_data.pdh = ws_cwstream_fdopen_stdio(rb_data.fd, rb_data.compress_type,
+                                           &rb_data.write_options);
+  else
+    rb_data.pdh = ws_fdopen(rb_data.fd, "wb");
   if (rb_data.pdh == NULL) {
     if (err != NULL) {
       *err = errno;
@@ -246,6 +313,7 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
 
   rb_data.pdh = NULL;
   rb_data.fd  = -1;
+  rb_data.curr_entry = NULL;
 
   /* get the next file number and open it */
 
@@ -254,9 +322,13 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
   next_rfile = &rb_data.files[next_file_index];
 
   if (ringbuf_open_file(next_rfile, err) == -1) {
+    ringbuf_write_manifest();
     return FALSE;
   }
 
+  /* the finished file, and the new one, which has no packets yet */
+  ringbuf_write_manifest();
+
   if (ringbuf_init_libpcap_fdopen(err) == NULL) {
     return FALSE;
   }
@@ -289,6 +361,8 @@ ringbuf_libpcap_dump_close(gchar **save_file, int *err)
     rb_data.pdh = NULL;
     rb_data.fd  = -1;
   }
+  ringbuf_write_manifest();
+  rb_data.curr_entry = NULL;
 
   /* set the save file name to the current file */
   *save_file = rb_data.files[rb_data.curr_file_num % rb_data.num_files].name;
@@ -321,6 +395,11 @@ ringbuf_free(void)
     g_free(rb_data.fsuffix);
     rb_data.fsuffix = NULL;
   }
+  capture_manifest_free(rb_data.manifest);
+  rb_data.manifest = NULL;
+  rb_data.curr_entry = NULL;
+  g_free(rb_data.manifest_path);
+  rb_data.manifest_path = NULL;
 }
 
 /*
@@ -352,6 +431,9 @@ ringbuf_error_cleanup(void)
       }
     }
   }
+  if (rb_data.manifest_path != NULL) {
+    ws_unlink(rb_data.manifest_path);
+  }
   /* free the memory */
   ringbuf_free();
 }
@@ -13,6 +13,8 @@
 
 #include <stdio.h>
 #include "wiretap/wtap.h"
+#include <wsutil/cwstream.h>
+#include <wsutil/nstime.h>
 
 #define RINGBUFFER_UNLIMITED_FILES 0
 /* Minimum number of ringbuffer files */
@@ -23,8 +25,10 @@
 /* Maximum number for FAT filesystems */
 #define RINGBUFFER_WARN_NUM_FILES 65535
 
-int ringbuf_init(const char *capture_name, guint num_files, gboolean group_read_access);
+int ringbuf_init(const char *capture_name, guint num_files, gboolean group_read_access,
+                 const char *compress_type, const ws_cwstream_options *write_options);
 const gchar *ringbuf_current_filename(void);
+void ringbuf_add_packet(guint32 interface_id, const nstime_t *ts, guint32 caplen);
 FILE *ringbuf_init_libpcap_fdopen(int *err);
 gboolean ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd,
                              int *err);
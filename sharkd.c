@@ -33,6 +33,7 @@
 #include <version_info.h>
 #include <wiretap/wtap_opttypes.h>
 #include <wiretap/pcapng.h>
+#include <wiretap/wtap_index.h>
 
 #include <epan/decode_as.h>
 #include <epan/timestamp.h>
@@ -164,6 +165,10 @@ main(int argc, char *argv[])
 
   wtap_init(TRUE);
 
+  /* Frames read from a pipe or the standard input are read again from
+     a temporary copy of it. */
+  wtap_set_pipe_spill(TRUE);
+
   /* Register all dissectors; we must do this before checking for the
      "-G" flag, as the "-G" flag dumps information registered by the
      dissectors, and we must do it before we read the preferences, in
@@ -327,6 +332,38 @@ process_packet(capture_file *cf, epan_dissect_t *edt,
   return passed;
 }
 
+/*
+ * Add the frames in an index to the set of frames without reading or
+ * dissecting them; they're dissected when they're asked for.
+ */
+static void
+process_index(capture_file *cf, wtap_index_t *idx)
+{
+  guint32        n, count = wtap_index_count(idx);
+  wtap_rec       rec;
+  frame_data     fdlocal;
+  gint64         offset;
+  gboolean       has_comment;
+
+  wtap_rec_init(&rec);
+  for (n = 0; n < count; n++) {
+    offset = wtap_index_get_rec(idx, n, &rec, &has_comment);
+    frame_data_init(&fdlocal, cf->count + 1, &rec, offset, cum_bytes);
+    fdlocal.flags.has_phdr_comment = has_comment;
+    /* Set the reference and previous frames, and the elapsed time,
+       as dissecting the frame would. */
+    frame_data_set_before_dissect(&fdlocal, &cf->elapsed_time,
+                                  &cf->provider.ref, cf->provider.prev_dis);
+    if (cf->provider.ref == &fdlocal) {
+      ref_frame = fdlocal;
+      cf->provider.ref = &ref_frame;
+    }
+    frame_data_set_after_dissect(&fdlocal, &cum_bytes);
+    cf->provider.prev_cap = cf->provider.prev_dis = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+    cf->count++;
+  }
+  wtap_rec_cleanup(&rec);
+}
 
 static int
 load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
@@ -335,6 +372,9 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
   gchar       *err_info = NULL;
   gint64       data_offset;
   epan_dissect_t *edt = NULL;
+  wtap_index_t *idx = NULL;
+  gboolean     building_index = FALSE;
+  gboolean     resumed = TRUE;
 
   {
     /* Allocate a frame_data_sequence for all the frames. */
@@ -360,9 +400,34 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
       /* We're not going to display the protocol tree on this pass,
          so it's not going to be "visible". */
       edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
+
+      /*
+       * If the whole of a big enough file is to be read, look for an
+       * index of it, or build one.  The frames in an index can only be
+       * taken without being dissected if nothing needs to see them on
+       * this pass.
+       */
+      if (prefs.gui_fileopen_index_size != 0 && !cf->is_tempfile &&
+          max_packet_count == 0 && max_byte_count == 0 &&
+          wtap_file_size(cf->provider.wth, NULL) >= (gint64)prefs.gui_fileopen_index_size * 1000000) {
+        if (!create_proto_tree)
+          idx = wtap_index_open(cf->provider.wth, cf->filename);
+        if (idx == NULL) {
+          idx = wtap_index_new(cf->provider.wth);
+          building_index = (idx != NULL);
+        }
+      }
+    }
+
+    if (idx != NULL && !building_index) {
+      /* Take the frames from the index, and read whatever follows them. */
+      process_index(cf, idx);
+      resumed = wtap_index_resume(cf->provider.wth, idx, &err);
     }
 
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
+    while (resumed && wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
+      if (building_index)
+        wtap_index_add(idx, cf->provider.wth, data_offset);
       if (process_packet(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
                          wtap_get_buf_ptr(cf->provider.wth))) {
         /* Stop reading if we have the maximum number of packets;
@@ -382,6 +447,17 @@ load_cap_file(capture_file *cf, int max_packet_count, gint64 max_byte_count)
       edt = NULL;
     }
 
+    if (idx != NULL) {
+      /* If we read the whole file, save its index; not being able to
+         do so isn't an error. */
+      if (building_index && err == 0) {
+        int index_err;
+
+        wtap_index_write(idx, cf->provider.wth, cf->filename, &index_err);
+      }
+      wtap_index_free(idx);
+    }
+
     /* Close the sequential I/O side, to free up memory it requires. */
     wtap_sequential_close(cf->provider.wth);
 
@@ -0,0 +1,49 @@
+#
+# -*- coding: utf-8 -*-
+# Wireshark tests
+# By Gerald Combs <gerald@wireshark.org>
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Write synthetic pcap and pcapng files for tests'''
+
+import struct
+
+LINKTYPE_ETHERNET = 1
+LINKTYPE_RAW = 101
+
+def usecs(secs):
+    '''Convert a time in seconds to the microseconds that time stamps are given in'''
+    return int(secs * 1000000)
+
+def write_pcap(path, linktype, records):
+    '''Write a pcap file of (time stamp in microseconds, frame) records'''
+    with open(path, 'wb') as f:
+        f.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, linktype))
+        for ts, frame in records:
+            f.write(struct.pack('<IIII', ts // 1000000, ts % 1000000, len(frame), len(frame)))
+            f.write(frame)
+
+def _pcapng_block(block_type, body):
+    body += bytes(-len(body) % 4)
+    length = len(body) + 12
+    return struct.pack('<II', block_type, length) + body + struct.pack('<I', length)
+
+def pcapng_shb():
+    '''A pcapng section header block'''
+    return _pcapng_block(0x0a0d0d0a, struct.pack('<IHHq', 0x1a2b3c4d, 1, 0, -1))
+
+def pcapng_idb(linktype):
+    '''A pcapng interface description block, with microsecond time stamps'''
+    return _pcapng_block(0x00000001, struct.pack('<HHI', linktype, 0, 65535))
+
+def pcapng_epb(interface_id, ts, frame):
+    '''A pcapng enhanced packet block, with a time stamp in microseconds'''
+    return _pcapng_block(0x00000006, struct.pack('<IIIII', interface_id,
+        ts >> 32, ts & 0xffffffff, len(frame), len(frame)) + frame)
+
+def write_pcapng(path, blocks):
+    '''Write a pcapng file of blocks, which should start with a section header block'''
+    with open(path, 'wb') as f:
+        for block in blocks:
+            f.write(block)
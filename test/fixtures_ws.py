@@ -86,6 +86,11 @@ def cmd_capinfos(program):
     return program('capinfos')
 
 
+@fixtures.fixture(scope='session')
+def cmd_dftest(program):
+    return program('dftest')
+
+
 @fixtures.fixture(scope='session')
 def cmd_dumpcap(program):
     return program('dumpcap')
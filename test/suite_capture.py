@@ -302,6 +302,21 @@ def check_dumpcap_ringbuffer_stdin(cmd_dumpcap):
             elif filesize is not None:
                 capturekb = os.path.getsize(rbf) / 1000
                 self.assertGreaterEqual(capturekb, filesize)
+
+        # dumpcap lists the files, and what's in them, in a manifest.
+        manifest_file = testout_file + '.manifest'
+        self.cleanup_files.append(manifest_file)
+        self.assertTrue(os.path.isfile(manifest_file))
+        with open(manifest_file) as manifest:
+            manifest_lines = manifest.read().splitlines()
+        self.assertEqual(len(manifest_lines), 2)
+        rb_names = sorted(os.path.basename(rbf) for rbf in rb_files)
+        self.assertEqual(sorted(line.split('\t')[0] for line in manifest_lines), rb_names)
+        for line in manifest_lines:
+            fields = line.split('\t')
+            self.assertEqual(len(fields), 6)
+            if packets is not None:
+                self.assertEqual(int(fields[3]), packets)
     return check_dumpcap_ringbuffer_stdin_real
 
 
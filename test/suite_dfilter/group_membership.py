@@ -2,6 +2,9 @@
 #
 # SPDX-License-Identifier: GPL-2.0-or-later
 
+import os
+import subprocess
+import tempfile
 import unittest
 import fixtures
 from suite_dfilter.dfiltertest import *
@@ -48,3 +51,57 @@ class case_membership(unittest.TestCase):
         # expression should be parsed as "0.1 .. .7"
         dfilter = 'frame.time_delta in {0.1...7}'
         checkDFilterCount(dfilter, 0)
+
+    # Sets with enough elements are looked up in a table.
+    def test_membership_10_large_integer(self, checkDFilterCount):
+        dfilter = 'tcp.port in {1 2 3 4 5 6 7 8 9 3267}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_11_large_integer_range(self, checkDFilterCount):
+        dfilter = 'tcp.dstport in {1 2 3 4 5 6 7 8 9 10..79 81..65535}'
+        checkDFilterCount(dfilter, 0)
+
+    def test_membership_12_large_ip(self, checkDFilterCount):
+        dfilter = 'ip.dst in {10.0.0.1 10.0.0.2 10.0.0.3 10.0.0.4 10.0.0.5 10.0.0.6 10.0.0.7 207.46.0.0/16}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_13_large_string(self, checkDFilterCount):
+        dfilter = 'http.request.method in {"GET" "POST" "PUT" "DELETE" "OPTIONS" "TRACE" "CONNECT" "HEAD"}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_14_large_string_no_match(self, checkDFilterCount):
+        dfilter = 'http.request.method in {"GET" "POST" "PUT" "DELETE" "OPTIONS" "TRACE" "CONNECT" "PATCH"}'
+        checkDFilterCount(dfilter, 0)
+
+    def set_file(self, contents):
+        fd, path = tempfile.mkstemp(suffix='.txt')
+        with os.fdopen(fd, 'w') as f:
+            f.write(contents)
+        self.addCleanup(os.remove, path)
+        return path
+
+    def test_membership_15_file(self, checkDFilterCount):
+        path = self.set_file('# Addresses\n192.168.0.1\n\n10.0.0.1 .. 10.0.0.9\n')
+        dfilter = 'ip.addr in @' + path
+        checkDFilterCount(dfilter, 1)
+
+    def test_membership_16_file_no_match(self, checkDFilterCount):
+        path = self.set_file('PATCH\nHEAD something\n')
+        dfilter = 'http.request.method in @' + path
+        checkDFilterCount(dfilter, 0)
+
+    def test_membership_17_file_missing(self, checkDFilterFail):
+        dfilter = 'ip.addr in @' + os.path.join(tempfile.gettempdir(), 'no-such-set-file.txt')
+        checkDFilterFail(dfilter)
+
+    def test_membership_18_file_bad_element(self, dfilter_cmd, base_env):
+        # Only where the bad element is is shown, not what it is.
+        path = self.set_file('80\nsecret-value\n')
+        proc = subprocess.run(dfilter_cmd('tcp.port in @' + path),
+                              stdout=subprocess.PIPE,
+                              stderr=subprocess.STDOUT,
+                              universal_newlines=True,
+                              env=base_env)
+        self.assertEqual(proc.returncode, 2)
+        self.assertIn('Line 2 of "%s"' % path, proc.stdout)
+        self.assertNotIn('secret-value', proc.stdout)
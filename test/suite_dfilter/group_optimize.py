@@ -0,0 +1,118 @@
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import subprocess
+import unittest
+import fixtures
+from suite_dfilter.dfiltertest import *
+
+
+@fixtures.uses_fixtures
+class case_optimize(unittest.TestCase):
+    trace_file = "http.pcap"
+
+    def test_double_not_1(self, checkDFilterCount):
+        dfilter = 'not not tcp'
+        checkDFilterCount(dfilter, 1)
+
+    def test_double_not_2(self, checkDFilterCount):
+        dfilter = 'not not not tcp'
+        checkDFilterCount(dfilter, 0)
+
+    def test_single_member_set(self, checkDFilterCount):
+        dfilter = 'tcp.dstport in {80}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_repeated_set_members(self, checkDFilterCount):
+        dfilter = 'tcp.dstport in {81 81 80 81}'
+        checkDFilterCount(dfilter, 1)
+
+    def test_repeated_and_terms(self, checkDFilterCount):
+        dfilter = 'tcp.dstport == 80 and ip and tcp.dstport == 80'
+        checkDFilterCount(dfilter, 1)
+
+    def test_repeated_or_terms(self, checkDFilterCount):
+        dfilter = 'tcp.dstport == 81 or udp or tcp.dstport == 81'
+        checkDFilterCount(dfilter, 0)
+
+    def test_reordered_and(self, checkDFilterCount):
+        dfilter = 'http.request.method matches "^G" and tcp and not udp'
+        checkDFilterCount(dfilter, 1)
+
+    def test_reordered_or(self, checkDFilterCount):
+        dfilter = 'http contains "GET" or udp or tcp.dstport == 81'
+        checkDFilterCount(dfilter, 1)
+
+    def test_mixed_and_or(self, checkDFilterCount):
+        dfilter = '(tcp.dstport == 81 or http contains "GET") and (ip and not (udp or tcp.dstport == 81))'
+        checkDFilterCount(dfilter, 1)
+
+    def test_contradiction(self, checkDFilterCount):
+        dfilter = 'tcp and http contains "GET" and not tcp'
+        checkDFilterCount(dfilter, 0)
+
+
+@fixtures.uses_fixtures
+class case_specialized(unittest.TestCase):
+    # dftest --benchmark fails if the optimized filter, which compares
+    # integer and IPv4 fields directly, disagrees with the generic code.
+    def check_benchmark(self, cmd_dftest, capture_file, base_env, dfilter):
+        output = subprocess.check_output((cmd_dftest,
+            '--benchmark', capture_file('dhcp.pcap'),
+            dfilter), universal_newlines=True, env=base_env)
+        self.assertIn('Benchmark: 4 frames', output)
+
+    def test_specialized_integer(self, cmd_dftest, capture_file, base_env):
+        self.check_benchmark(cmd_dftest, capture_file, base_env,
+            'frame.len >= 300 and udp.srcport != 68 or ip.ttl < 64')
+
+    def test_specialized_ipv4(self, cmd_dftest, capture_file, base_env):
+        self.check_benchmark(cmd_dftest, capture_file, base_env,
+            'ip.addr == 192.168.0.0/16 and not ip.dst == 255.255.255.255')
+
+    def test_specialized_set(self, cmd_dftest, capture_file, base_env):
+        self.check_benchmark(cmd_dftest, capture_file, base_env,
+            'udp.port in {67 68} and ip.src in {0.0.0.0 192.168.0.1..192.168.0.10}')
+
+
+@fixtures.uses_fixtures
+class case_prefilter(unittest.TestCase):
+    # dftest --benchmark fails if the prefilter rejects a frame that the
+    # filter matches.  Every frame in dhcp.pcap is an IPv4 packet with the
+    # DHCP magic cookie.
+    def check_prefilter(self, cmd_dftest, capture_file, base_env, dfilter,
+                        prefilter, rejected):
+        output = subprocess.check_output((cmd_dftest,
+            '--benchmark', capture_file('dhcp.pcap'),
+            dfilter), universal_newlines=True, env=base_env)
+        self.assertIn('Prefilter: %s\n' % prefilter, output)
+        self.assertIn('Prefilter:   %d frames rejected' % rejected, output)
+
+    def test_prefilter_contains(self, cmd_dftest, capture_file, base_env):
+        self.check_prefilter(cmd_dftest, capture_file, base_env,
+            'frame contains 63:82:53:63 and udp',
+            'frame contains 63:82:53:63', 0)
+
+    def test_prefilter_slice(self, cmd_dftest, capture_file, base_env):
+        self.check_prefilter(cmd_dftest, capture_file, base_env,
+            'udp and frame[12:2] == 86:dd',
+            'frame[12:2] == 86:dd', 4)
+
+    def test_prefilter_or(self, cmd_dftest, capture_file, base_env):
+        self.check_prefilter(cmd_dftest, capture_file, base_env,
+            'frame contains "GET" or frame[-4:4] == ff:ff:ff:ff',
+            '(frame[-4:4] == ff:ff:ff:ff or frame contains 47:45:54)', 4)
+
+    def test_prefilter_not(self, cmd_dftest, capture_file, base_env):
+        output = subprocess.check_output((cmd_dftest,
+            'not frame contains "GET"'), universal_newlines=True, env=base_env)
+        self.assertNotIn('Prefilter:', output)
+
+    def test_tshark_prefilter(self, cmd_tshark, capture_file, base_env):
+        for dfilter in ('frame contains 63:82:53:63 and udp.srcport == 68',
+                        'frame[12:2] == 08:00 and ip.src == 192.168.0.1'):
+            outputs = []
+            for prefilter in ((), ('--prefilter',)):
+                outputs.append(subprocess.check_output((cmd_tshark,
+                    '-n', '-r', capture_file('dhcp.pcap'), '-Y', dfilter
+                    ) + prefilter, universal_newlines=True, env=base_env))
+            self.assertEqual(outputs[0], outputs[1])
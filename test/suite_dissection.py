@@ -9,7 +9,9 @@
 #
 '''Dissection tests'''
 
+import capture_writer
 import os.path
+import struct
 import subprocesstest
 import unittest
 import fixtures
@@ -87,3 +89,173 @@ class case_dissect_tcp(subprocesstest.SubprocessTestCase):
                 '-Y', 'dns', '-Tfields', '-edns.qry.name',
             ))
         self.assertEqual(proc.stdout_str.strip(), 'example.com')
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_dissect_prune(subprocesstest.SubprocessTestCase):
+    def check_prune(self, cmd_tshark, capture_file, args):
+        outputs = []
+        for prune in ((), ('--prune-dissection',)):
+            proc = self.assertRun((cmd_tshark,
+                    '-r', capture_file('http.pcap'),
+                ) + args + prune)
+            outputs.append(proc.stdout_str)
+        self.assertEqual(outputs[0], outputs[1])
+        return outputs[1]
+
+    def test_prune_fields(self, cmd_tshark, capture_file):
+        '''Pruning must not change the fields written.'''
+        output = self.check_prune(cmd_tshark, capture_file,
+                ('-Tfields', '-eip.src', '-etcp.srcport', '-ehttp.request.method'))
+        self.assertIn('GET', output)
+
+    def test_prune_filter(self, cmd_tshark, capture_file):
+        '''Pruning must not change the packets a display filter matches.'''
+        self.check_prune(cmd_tshark, capture_file,
+                ('-Y', 'http.request or data', '-Tfields', '-eframe.number'))
+
+def write_tcp_pcap(path, segments):
+    '''Write a raw IPv4 pcap file of TCP segments between 10.0.0.1:1024 and
+    10.0.0.2:80, given as (time in seconds, from client, TCP flags) tuples'''
+    client = bytes((10, 0, 0, 1))
+    server = bytes((10, 0, 0, 2))
+    records = []
+    for ts, from_client, flags in segments:
+        if from_client:
+            addrs, ports = (client, server), (1024, 80)
+        else:
+            addrs, ports = (server, client), (80, 1024)
+        frame = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 40, 0, 0, 64, 6, 0, *addrs)
+        frame += struct.pack('!HHIIBBHHH', ports[0], ports[1], 1, 1, 5 << 4, flags, 65535, 0, 0)
+        records.append((capture_writer.usecs(ts), frame))
+    capture_writer.write_pcap(path, capture_writer.LINKTYPE_RAW, records)
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_dissect_retire_conversations(subprocesstest.SubprocessTestCase):
+    syn, fin, rst, ack = 0x02, 0x01, 0x04, 0x10
+
+    def tcp_streams(self, cmd_tshark, segments, args):
+        pcap_file = self.filename_from_id('retire.pcap')
+        write_tcp_pcap(pcap_file, segments)
+        proc = self.assertRun((cmd_tshark,
+                '-r', pcap_file,
+                '-Tfields', '-etcp.stream',
+            ) + args)
+        return proc.stdout_str.split()
+
+    def test_retire_idle(self, cmd_tshark):
+        '''A conversation idle for longer than the timeout is retired.'''
+        segments = (
+            (0.0, True, self.syn),
+            (0.1, False, self.syn | self.ack),
+            (0.2, True, self.ack),
+            (30.0, True, self.ack),
+            (30.1, False, self.ack),
+        )
+        self.assertEqual(self.tcp_streams(cmd_tshark, segments, ()),
+                ['0', '0', '0', '0', '0'])
+        self.assertEqual(self.tcp_streams(cmd_tshark, segments, ('--retire-conversations', '60')),
+                ['0', '0', '0', '0', '0'])
+        self.assertEqual(self.tcp_streams(cmd_tshark, segments, ('--retire-conversations', '10')),
+                ['0', '0', '0', '1', '1'])
+
+    def test_retire_closed(self, cmd_tshark):
+        '''A closed connection's conversation is retired after its own timeout.'''
+        segments = (
+            (0.0, True, self.syn),
+            (0.1, False, self.syn | self.ack),
+            (0.2, True, self.ack),
+            (0.3, True, self.fin | self.ack),
+            (0.4, False, self.fin | self.ack),
+            (0.5, True, self.ack),
+            (3.0, True, self.ack),
+        )
+        self.assertEqual(self.tcp_streams(cmd_tshark, segments, ('--retire-conversations', '60')),
+                ['0'] * 7)
+        self.assertEqual(self.tcp_streams(cmd_tshark, segments, ('--retire-conversations', '60,1')),
+                ['0'] * 6 + ['1'])
+
+    def test_retire_between_frames(self, cmd_tshark, capture_file):
+        '''Retiring every conversation between frames leaves dissectors working.'''
+        # Protocols over TCP and UDP that keep data of their own in
+        # conversations.
+        for capture in ('http.pcap', 'http-ooo.pcap', 'nfs.pcap', 'tftp.pcap',
+                        'dns-ooo.pcap', 'tcp-badsegments.pcap', 'rsasnakeoil2.pcap'):
+            with open(capture_file(capture), 'rb') as f:
+                contents = f.read()
+            magic, _, _, _, _, _, linktype = struct.unpack_from('<IHHiIII', contents)
+            self.assertEqual(magic, 0xa1b2c3d4)
+            # Space the frames 10 seconds apart.
+            records = []
+            offset = 24
+            while offset < len(contents):
+                _, _, caplen, _ = struct.unpack_from('<IIII', contents, offset)
+                records.append((len(records) * 10000000, contents[offset + 16:offset + 16 + caplen]))
+                offset += 16 + caplen
+            spaced_file = self.filename_from_id('spaced-' + capture)
+            capture_writer.write_pcap(spaced_file, linktype, records)
+            self.assertRun((cmd_tshark,
+                    '-r', spaced_file, '-V',
+                    '--retire-conversations', '1',
+                ))
+            self.assertEqual(self.countOutput(r'^Frame \d+:'), len(records))
+
+    def test_retire_two_pass(self, cmd_tshark, capture_file):
+        '''Retiring conversations can't be combined with a two-pass analysis.'''
+        proc = self.runProcess((cmd_tshark,
+                '-2', '--retire-conversations', '10',
+                '-r', capture_file('http.pcap'),
+            ))
+        self.assertNotEqual(proc.returncode, 0)
+
+def write_ipv4_fragments_pcap(path, fragments):
+    '''Write a raw IPv4 pcap file of UDP datagram fragments from 10.0.0.1 to
+    10.0.0.2, given as (time in seconds, IP ID, offset in 8-byte units,
+    more fragments) tuples, each with 8 bytes of data'''
+    records = []
+    for ts, ip_id, offset, more in fragments:
+        flags_offset = (0x2000 if more else 0) | offset
+        frame = struct.pack('!BBHHHBBH4s4s', 0x45, 0, 28, ip_id, flags_offset, 64, 17, 0,
+                bytes((10, 0, 0, 1)), bytes((10, 0, 0, 2)))
+        frame += bytes(8)
+        records.append((capture_writer.usecs(ts), frame))
+    capture_writer.write_pcap(path, capture_writer.LINKTYPE_RAW, records)
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_dissect_reassembly_limits(subprocesstest.SubprocessTestCase):
+    def evicted_in(self, cmd_tshark, fragments, args):
+        pcap_file = self.filename_from_id('fragments.pcap')
+        write_ipv4_fragments_pcap(pcap_file, fragments)
+        proc = self.assertRun((cmd_tshark,
+                '-r', pcap_file,
+                '-Y', 'frame.reassembly_evicted',
+                '-Tfields', '-eframe.number',
+            ) + args)
+        return proc.stdout_str.split()
+
+    def test_reassembly_age_limits(self, cmd_tshark):
+        '''Reassemblies without a fragment for too long are abandoned.'''
+        fragments = (
+            (0.0, 1, 0, True),
+            (20.0, 2, 0, True),
+            (25.0, 3, 0, True),
+            (26.0, 2, 1, False),
+        )
+        self.assertEqual(self.evicted_in(cmd_tshark, fragments, ()), [])
+        self.assertEqual(self.evicted_in(cmd_tshark, fragments, ('--reassembly-limits', '0,0,10')),
+                ['2'])
+        self.assertEqual(self.evicted_in(cmd_tshark, fragments, ('--reassembly-limits', '0,1')),
+                ['3', '4'])
+
+    def test_reassembly_stats(self, cmd_tshark):
+        '''Abandoned reassemblies are counted by -z reassembly,tree.'''
+        pcap_file = self.filename_from_id('fragments.pcap')
+        write_ipv4_fragments_pcap(pcap_file, ((0.0, 1, 0, True), (20.0, 2, 0, True)))
+        self.assertRun((cmd_tshark,
+                '-q', '-r', pcap_file,
+                '--reassembly-limits', '0,0,10',
+                '-z', 'reassembly,tree',
+            ))
+        self.assertTrue(self.grepOutput('IPv4'))
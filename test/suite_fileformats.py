@@ -9,9 +9,16 @@
 #
 '''File format conversion tests'''
 
+import capture_writer
+import gzip
 import os.path
+import re
+import shutil
+import subprocess
+import struct
 import subprocesstest
 import unittest
+import zlib
 import fixtures
 
 # XXX Currently unused. It would be nice to be able to use this below.
@@ -110,6 +117,21 @@ class case_fileformat_pcapng(subprocesstest.SubprocessTestCase):
             )
         self.assertTrue(self.diffOutput(capture_proc.stdout_str, fileformats_baseline_str, 'tshark', baseline_file))
 
+    def test_pcapng_late_idb_capinfos(self):
+        '''An interface described after the packets of a file big enough to be read in chunks'''
+        late_idb_file = self.filename_from_id('late-idb.pcapng')
+        frame = bytes(60000)
+        blocks = [capture_writer.pcapng_shb(), capture_writer.pcapng_idb(capture_writer.LINKTYPE_ETHERNET)]
+        for i in range(600):
+            blocks.append(capture_writer.pcapng_epb(0, capture_writer.usecs(1 + i), frame))
+        blocks.append(capture_writer.pcapng_idb(capture_writer.LINKTYPE_RAW))
+        blocks.append(capture_writer.pcapng_epb(1, capture_writer.usecs(601), frame))
+        capture_writer.write_pcapng(late_idb_file, blocks)
+        capinfos_out = self.getCaptureInfo(capinfos_args=('-c', '-I'), cap_file=late_idb_file)
+        self.assertTrue(re.search(r'Number of packets:\s+601', capinfos_out) is not None)
+        self.assertTrue(re.search(r'Number of interfaces in file: 2', capinfos_out) is not None)
+        self.assertTrue(re.search(r'Interface #1 info:.*?Number of packets = 1\n', capinfos_out, re.DOTALL) is not None)
+
 @fixtures.fixture
 def check_pcapng_dsb_fields(request, cmd_tshark):
     '''Factory that checks whether the DSB within the capture file matches.'''
@@ -216,6 +238,65 @@ class case_fileformat_pcapng_dsb(subprocesstest.SubprocessTestCase):
         ))
 
 
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_editcap_dedup(subprocesstest.SubprocessTestCase):
+    def write_frames(self, path, frames):
+        '''Write (time stamp in seconds, kind) frames, with the same contents for each kind'''
+        capture_writer.write_pcap(path, capture_writer.LINKTYPE_ETHERNET,
+            [(capture_writer.usecs(ts), bytes(14) + bytes((kind,)) * 46) for ts, kind in frames])
+
+    def test_editcap_dedup_frames(self, cmd_editcap, cmd_mergecap, capture_file):
+        '''Remove duplicate packets within a window of frames'''
+        testin_file = self.filename_from_id('testin.pcap')
+        testout_file = self.filename_from_id('testout.pcap')
+        # Each packet of dhcp.pcap, then each again, four packets later.
+        self.assertRun((cmd_mergecap,
+            '-a', '-F', 'pcap', '-w', testin_file,
+            capture_file('dhcp.pcap'), capture_file('dhcp.pcap'),
+        ))
+        self.assertRun((cmd_editcap, '-D', '5', testin_file, testout_file))
+        self.checkPacketCount(4, cap_file=testout_file)
+        self.assertRun((cmd_editcap, '-D', '4', testin_file, testout_file))
+        self.checkPacketCount(8, cap_file=testout_file)
+        # Ignoring every byte leaves only the lengths, 314 and 342.
+        self.assertRun((cmd_editcap, '-D', '5', '--ignore-field', '0:1000',
+            capture_file('dhcp.pcap'), testout_file,
+        ))
+        self.checkPacketCount(2, cap_file=testout_file)
+
+    def test_editcap_dedup_time(self, cmd_editcap):
+        '''Remove duplicate packets within a window of time'''
+        testin_file = self.filename_from_id('testin.pcap')
+        testout_file = self.filename_from_id('testout.pcap')
+        self.write_frames(testin_file, (
+            (0.0, 1),
+            (0.5, 1),   # 0.5s after the last copy: a duplicate
+            (2.0, 1),   # 1.5s after the last copy: kept
+            (2.2, 2),
+            (2.9, 1),   # 0.9s after the last copy: a duplicate
+        ))
+        self.assertRun((cmd_editcap, '-w', '1.0', testin_file, testout_file))
+        self.checkPacketCount(3, cap_file=testout_file)
+        self.assertRun((cmd_editcap, '-w', '0.4', testin_file, testout_file))
+        self.checkPacketCount(5, cap_file=testout_file)
+
+    def test_editcap_dedup_time_out_of_order(self, cmd_editcap):
+        '''Remove duplicate packets within a window of time, with time stamps out of order'''
+        testin_file = self.filename_from_id('testin.pcap')
+        testout_file = self.filename_from_id('testout.pcap')
+        self.write_frames(testin_file, (
+            (5.0, 1),
+            (5.1, 2),
+            (4.8, 1),   # before the copy seen already: kept
+            (5.3, 1),   # 0.3s after the latest copy: a duplicate
+            (4.9, 2),   # before the copy seen already: kept
+            (5.2, 2),   # 0.1s after the latest copy: a duplicate
+        ))
+        self.assertRun((cmd_editcap, '-w', '1.0', testin_file, testout_file))
+        self.checkPacketCount(4, cap_file=testout_file)
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_fileformat_mime(subprocesstest.SubprocessTestCase):
@@ -227,3 +308,133 @@ class case_fileformat_mime(subprocesstest.SubprocessTestCase):
                 '-Tfields', '-e', 'frame.len', '-e', 'pcapng.block.length',
             ))
         self.assertEqual(proc.stdout_str.strip(), '480\t128,128,88,88,132,132,132,132')
+
+
+@fixtures.fixture(scope='session')
+def compression_types(cmd_editcap, make_env):
+    '''The compression types that files can be read and written with.'''
+    try:
+        compress_help = subprocess.check_output(
+            (cmd_editcap, '--compress', 'help'),
+            stderr=subprocess.PIPE,
+            universal_newlines=True,
+            env=make_env()
+        )
+    except subprocess.CalledProcessError:
+        return ()
+    return compress_help.split()
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_fileformat_compression(subprocesstest.SubprocessTestCase):
+    def check_compressed_read(self, cmd_tshark, capture_file, compressed_file):
+        '''Check that a compressed copy of dhcp.pcapng reads as the original does.'''
+        for two_pass in ((), ('-2',)):
+            plain_proc = self.assertRun((cmd_tshark,
+                '-V', '-r', capture_file('dhcp.pcapng'),
+            ) + two_pass)
+            compressed_proc = self.assertRun((cmd_tshark,
+                '-V', '-r', compressed_file,
+            ) + two_pass)
+            self.assertEqual(plain_proc.stdout_str, compressed_proc.stdout_str)
+
+    def test_read_zstd(self, cmd_tshark, capture_file, compression_types):
+        '''Read a file compressed by the zstd program'''
+        if 'zstd' not in compression_types:
+            self.skipTest('Requires Zstandard support.')
+        zstd = shutil.which('zstd')
+        if not zstd:
+            self.skipTest('Requires the zstd program.')
+        zst_file = self.filename_from_id('dhcp.pcapng.zst')
+        self.assertRun((zstd, '-q', '-o', zst_file, capture_file('dhcp.pcapng')))
+        self.check_compressed_read(cmd_tshark, capture_file, zst_file)
+
+    def test_read_lz4(self, cmd_tshark, capture_file, compression_types):
+        '''Read a file compressed by the lz4 program'''
+        if 'lz4' not in compression_types:
+            self.skipTest('Requires LZ4 support.')
+        lz4 = shutil.which('lz4')
+        if not lz4:
+            self.skipTest('Requires the lz4 program.')
+        lz4_file = self.filename_from_id('dhcp.pcapng.lz4')
+        self.assertRun((lz4, '-q', capture_file('dhcp.pcapng'), lz4_file))
+        self.check_compressed_read(cmd_tshark, capture_file, lz4_file)
+
+    def check_compressed_write(self, cmd_editcap, cmd_mergecap, cmd_tshark, compression, magic):
+        '''Write a file big enough for several compressed frames with Editcap, Mergecap and TShark, and read it back.'''
+        big_file = self.filename_from_id('big.pcap')
+        records = []
+        for i in range(64):
+            frame = bytes(6) + bytes(6) + bytes((0x08, 0x00))
+            frame += bytes((0x45, 0, 0xea, 0x5c, i >> 8, i & 0xff, 0, 0, 64, 253, 0, 0, 10, 0, 0, 1, 10, 0, 0, 2))
+            frame += bytes((i % 251,)) * 60008
+            records.append((capture_writer.usecs(1 + i / 8), frame))
+        capture_writer.write_pcap(big_file, capture_writer.LINKTYPE_ETHERNET, records)
+        fields = ('-T', 'fields',
+            '-e', 'frame.number', '-e', 'frame.time_epoch', '-e', 'frame.len',
+            '-e', 'ip.id', '-e', 'data.data',
+        )
+        plain_proc = self.assertRun((cmd_tshark, '-r', big_file) + fields)
+
+        editcap_file = self.filename_from_id('editcap.pcap.' + compression)
+        self.assertRun((cmd_editcap, '--compress', compression, '-F', 'pcap',
+            big_file, editcap_file))
+        mergecap_file = self.filename_from_id('mergecap.pcap.' + compression)
+        self.assertRun((cmd_mergecap, '--compress', compression, '-F', 'pcap',
+            '-w', mergecap_file, big_file))
+        tshark_file = self.filename_from_id('tshark.pcap.' + compression)
+        self.assertRun((cmd_tshark, '--compress', compression, '-F', 'pcap',
+            '-r', big_file, '-w', tshark_file))
+
+        for compressed_file in (editcap_file, mergecap_file, tshark_file):
+            with open(compressed_file, 'rb') as f:
+                self.assertEqual(f.read(len(magic)), magic)
+            self.assertLess(os.path.getsize(compressed_file), os.path.getsize(big_file))
+            for two_pass in ((), ('-2',)):
+                compressed_proc = self.assertRun((cmd_tshark,
+                    '-r', compressed_file,
+                ) + fields + two_pass)
+                self.assertEqual(plain_proc.stdout_str, compressed_proc.stdout_str)
+
+    def test_write_zstd(self, cmd_editcap, cmd_mergecap, cmd_tshark, compression_types):
+        '''Write and read back zstd compressed files'''
+        if 'zstd' not in compression_types:
+            self.skipTest('Requires Zstandard support.')
+        self.check_compressed_write(cmd_editcap, cmd_mergecap, cmd_tshark, 'zstd', b'\x28\xb5\x2f\xfd')
+
+    def test_write_lz4(self, cmd_editcap, cmd_mergecap, cmd_tshark, compression_types):
+        '''Write and read back lz4 compressed files'''
+        if 'lz4' not in compression_types:
+            self.skipTest('Requires LZ4 support.')
+        self.check_compressed_write(cmd_editcap, cmd_mergecap, cmd_tshark, 'lz4', b'\x04\x22\x4d\x18')
+
+    def test_read_gzip_members(self, cmd_tshark, capture_file):
+        '''Read a gzip file made of many members'''
+        with open(capture_file('dhcp.pcapng'), 'rb') as f:
+            contents = f.read()
+        gz_file = self.filename_from_id('dhcp.pcapng.gz')
+        with open(gz_file, 'wb') as f:
+            for offset in range(0, len(contents), 100):
+                f.write(gzip.compress(contents[offset:offset + 100]))
+        self.check_compressed_read(cmd_tshark, capture_file, gz_file)
+
+    def test_read_bgzf(self, cmd_tshark, capture_file):
+        '''Read a BGZF file, whose members give their own size'''
+        def bgzf_member(data):
+            deflater = zlib.compressobj(wbits=-15)
+            deflated = deflater.compress(data) + deflater.flush()
+            # ID1, ID2, CM, FLG (FEXTRA), MTIME, XFL, OS, XLEN, then the
+            # "BC" subfield, with the size of the member less one.
+            header = struct.pack('<BBBBIBBHBBHH', 0x1f, 0x8b, 8, 4, 0, 0, 255, 6,
+                ord('B'), ord('C'), 2, 18 + len(deflated) + 8 - 1)
+            return header + deflated + struct.pack('<II', zlib.crc32(data), len(data))
+        with open(capture_file('dhcp.pcapng'), 'rb') as f:
+            contents = f.read()
+        bgzf_file = self.filename_from_id('dhcp.pcapng.bgzf.gz')
+        with open(bgzf_file, 'wb') as f:
+            for offset in range(0, len(contents), 100):
+                f.write(bgzf_member(contents[offset:offset + 100]))
+            # The empty member that ends a BGZF file.
+            f.write(bgzf_member(b''))
+        self.check_compressed_read(cmd_tshark, capture_file, bgzf_file)
@@ -9,8 +9,10 @@
 #
 '''File I/O tests'''
 
+import capture_writer
 import io
 import os.path
+import struct
 import subprocesstest
 import sys
 import unittest
@@ -70,6 +72,69 @@ class case_tshark_io(subprocesstest.SubprocessTestCase):
         '''Read direct and write direct using TShark'''
         check_io_4_packets(self, capture_file, cmd=cmd_tshark)
 
+    def test_tshark_io_prefetch(self, cmd_tshark, capture_file):
+        '''Read with records prefetched on a separate thread using TShark'''
+        for two_pass in ((), ('-2',)):
+            plain_proc = self.assertRun((cmd_tshark,
+                '-r', capture_file('dhcp.pcapng'),
+            ) + two_pass)
+            prefetch_proc = self.assertRun((cmd_tshark,
+                '--prefetch', '2',
+                '-r', capture_file('dhcp.pcapng'),
+            ) + two_pass)
+            self.assertEqual(plain_proc.stdout_str, prefetch_proc.stdout_str)
+
+    def test_tshark_io_workers_two_pass(self, cmd_tshark, capture_file):
+        '''Print the second pass in worker processes using TShark'''
+        if sys.platform.startswith('win32'):
+            self.skipTest('--workers is UN*X only')
+        for dfilter in ((), ('-Y', 'dhcp.option.dhcp == 3')):
+            plain_proc = self.assertRun((cmd_tshark,
+                '-2', '-r', capture_file('dhcp.pcapng'),
+            ) + dfilter)
+            workers_proc = self.assertRun((cmd_tshark,
+                '-2', '--workers', '2',
+                '-r', capture_file('dhcp.pcapng'),
+            ) + dfilter)
+            self.assertEqual(plain_proc.stdout_str, workers_proc.stdout_str)
+
+    def test_tshark_io_workers_one_pass(self, cmd_tshark):
+        '''Dissect parts of a file in worker processes using TShark'''
+        if sys.platform.startswith('win32'):
+            self.skipTest('--workers is UN*X only')
+        # Big enough to be split in two 16 MiB parts.
+        big_file = self.filename_from_id('big.pcap')
+        records = []
+        for i in range(600):
+            frame = bytes(6) + bytes(6) + struct.pack('!H', 0x0800)
+            frame += struct.pack('!BBHHHBBH4s4s', 0x45, 0, 60028, i, 0, 64, 17, 0,
+                bytes((10, 0, 0, 1)), bytes((10, 0, 0, 2)))
+            frame += struct.pack('!HHHH', 1024, 9, 60008, 0) + bytes(60000)
+            records.append((capture_writer.usecs(1 + i * 0.25), frame))
+        capture_writer.write_pcap(big_file, capture_writer.LINKTYPE_ETHERNET, records)
+        fields = ('-T', 'fields',
+            '-e', 'frame.number', '-e', 'frame.time_delta',
+            '-e', 'frame.time_relative', '-e', 'frame.cum_bytes',
+            '-e', 'ip.id',
+        )
+        plain_proc = self.assertRun((cmd_tshark, '-r', big_file) + fields)
+        workers_proc = self.assertRun((cmd_tshark,
+            '--workers', '2', '-r', big_file,
+        ) + fields)
+        self.assertEqual(plain_proc.stdout_str, workers_proc.stdout_str)
+
+    def test_tshark_io_stdin_two_pass(self, cmd_tshark, capture_file):
+        '''Read from stdin in two passes using TShark'''
+        # cat -B "${CAPTURE_DIR}dhcp.pcap" | $DUT -2 -V -r -
+        cat_dhcp_cmd = subprocesstest.cat_dhcp_command('cat')
+        stdin_cmd = '{0} | "{1}" -2 -V -r -'.format(cat_dhcp_cmd, cmd_tshark)
+        stdin_proc = self.assertRun(stdin_cmd, shell=True)
+        direct_proc = self.assertRun((cmd_tshark,
+            '-2', '-V',
+            '-r', capture_file('dhcp.pcap'),
+        ))
+        self.assertEqual(stdin_proc.stdout_str, direct_proc.stdout_str)
+
 
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
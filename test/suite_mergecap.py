@@ -9,8 +9,11 @@
 #
 '''Mergecap tests'''
 
+import capture_writer
+import os
 import re
 import subprocesstest
+import time
 import fixtures
 
 testout_pcap = 'testout.pcap'
@@ -26,6 +29,12 @@ file_type_to_testout = {
     'pcapng': testout_pcapng,
 }
 
+def write_synthetic_pcap(path, timestamps):
+    '''Write a pcap file with a small Ethernet frame at each time stamp, in microseconds'''
+    frame = bytes(range(60))
+    capture_writer.write_pcap(path, capture_writer.LINKTYPE_ETHERNET,
+        [(ts, frame) for ts in timestamps])
+
 # common checking code:
 # arg 1 = return value from mergecap command
 # arg 2 = file type string
@@ -286,3 +295,104 @@ class case_mergecap_pcapng(subprocesstest.SubprocessTestCase):
         ))
         # check for 11 IDBs, 88*3=264 total pkts, 86*3=258 in first IDB
         check_mergecap(self, mergecap_proc, 'pcapng', 'Per packet', 264, 11, 258)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_mergecap_many_files(subprocesstest.SubprocessTestCase):
+    '''Merge many synthetic files, logging how long it takes'''
+
+    def merge_synthetic(self, cmd_mergecap, file_timestamps):
+        # Too many files for some command lines, so list them in a
+        # capture manifest, as dumpcap does for a ring buffer.
+        manifest_file = self.filename_from_id('testin.manifest')
+        with open(manifest_file, 'w') as manifest:
+            for i, timestamps in enumerate(file_timestamps):
+                in_file = self.filename_from_id('testin{:04d}.pcap'.format(i))
+                write_synthetic_pcap(in_file, timestamps)
+                manifest.write('{}\t-\t-\t{}\t{}\t\n'.format(os.path.basename(in_file), len(timestamps), 60 * len(timestamps)))
+        testout_file = self.filename_from_id(testout_pcap)
+        start = time.time()
+        self.assertRun((cmd_mergecap, '-F', 'pcap', '-w', testout_file, manifest_file))
+        self.log_fd.write('Merged {} files in {:.3f}s\n'.format(len(file_timestamps), time.time() - start))
+        self.checkPacketCount(sum(len(t) for t in file_timestamps), cap_file=testout_file)
+        capinfos_testout = self.getCaptureInfo(capinfos_args=('-o',), cap_file=testout_file)
+        self.assertTrue(re.search(r'Strict time order:\s+True', capinfos_testout) is not None)
+
+    def test_mergecap_few_interleaved(self, cmd_mergecap):
+        '''Merge a few files whose packets interleave'''
+        self.merge_synthetic(cmd_mergecap,
+            [[j * 10 + i for j in range(2000)] for i in range(4)])
+
+    def test_mergecap_many_interleaved(self, cmd_mergecap):
+        '''Merge more files than are kept open, whose packets interleave'''
+        self.merge_synthetic(cmd_mergecap,
+            [[j * 1000 + i for j in range(20)] for i in range(100)])
+
+    def test_mergecap_many_consecutive(self, cmd_mergecap):
+        '''Merge many files covering consecutive spans of time, given out of order'''
+        spans = [[(i * 100 + j) * 1000 for j in range(100)] for i in range(2000)]
+        spans.reverse()
+        self.merge_synthetic(cmd_mergecap, spans)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_mergecap_time_range(subprocesstest.SubprocessTestCase):
+    '''Merge only the packets of a span of time'''
+
+    # -A and -B take local times.
+    base = int(time.mktime(time.strptime('2019-01-01 12:00:00', '%Y-%m-%d %H:%M:%S')))
+
+    def time_arg(self, offset):
+        return time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(self.base + offset))
+
+    def input_files(self):
+        '''Three files of ten packets, one a second, as (path, time stamps)'''
+        return [(self.filename_from_id('testin{}.pcap'.format(i)),
+                [(self.base + i * 10 + j) * 1000000 for j in range(10)]) for i in range(3)]
+
+    def write_manifest(self, written_files):
+        '''Write the input files in written_files and a manifest of them all'''
+        manifest_file = self.filename_from_id('testin.pcap.manifest')
+        with open(manifest_file, 'w') as manifest:
+            for i, (in_file, timestamps) in enumerate(self.input_files()):
+                if i in written_files:
+                    write_synthetic_pcap(in_file, timestamps)
+                manifest.write('{}\t{}.000000000\t{}.000000000\t{}\t{}\t0\n'.format(
+                    os.path.basename(in_file), timestamps[0] // 1000000, timestamps[-1] // 1000000,
+                    len(timestamps), 60 * len(timestamps)))
+        return manifest_file
+
+    def test_mergecap_time_range_files(self, cmd_mergecap):
+        '''Merge the packets of a span of time from capture files'''
+        in_files = self.input_files()
+        for in_file, timestamps in in_files:
+            write_synthetic_pcap(in_file, timestamps)
+        testout_file = self.filename_from_id(testout_pcap)
+        self.assertRun((cmd_mergecap, '-F', 'pcap', '-w', testout_file,
+            '-A', self.time_arg(5), '-B', self.time_arg(15),
+        ) + tuple(in_file for in_file, _ in in_files))
+        # Packets 5 up to, but not including, 15.
+        self.checkPacketCount(10, cap_file=testout_file)
+
+    def test_mergecap_time_range_manifest(self, cmd_mergecap):
+        '''Merge the packets of a span of time from the files of a manifest'''
+        # The last file isn't there, so it mustn't be opened.
+        manifest_file = self.write_manifest((0, 1))
+        testout_file = self.filename_from_id(testout_pcap)
+        self.assertRun((cmd_mergecap, '-F', 'pcap', '-w', testout_file,
+            '-A', self.time_arg(12), '-B', self.time_arg(20),
+            manifest_file,
+        ))
+        self.checkPacketCount(8, cap_file=testout_file)
+
+    def test_mergecap_time_range_manifest_empty(self, cmd_mergecap):
+        '''Merge a span of time that none of the files of a manifest have packets in'''
+        manifest_file = self.write_manifest(())
+        testout_file = self.filename_from_id(testout_pcap)
+        self.assertRun((cmd_mergecap, '-F', 'pcap', '-w', testout_file,
+            '-A', self.time_arg(100),
+            manifest_file,
+        ), expected_return=2)
+        self.assertTrue(self.grepOutput('None of the files in the manifests have packets in that time'))
@@ -9,9 +9,13 @@
 #
 '''sharkd tests'''
 
+import gzip
 import json
+import os
+import struct
 import subprocess
 import unittest
+import capture_writer
 import subprocesstest
 import fixtures
 from matchers import *
@@ -133,6 +137,14 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
             {"err": 0, "filter": "ok", "field": "ok"},
         ))
 
+    def test_sharkd_req_check_set_file(self, check_sharkd_session, capture_file):
+        # Filters from a client can't read files with "@file".
+        check_sharkd_session((
+            {"req": "check", "filter": "ip.addr in @" + capture_file('dhcp.pcap')},
+        ), (
+            {"err": 0, "filter": 'Set elements can\'t be read from a file ("@%s") here.' % capture_file('dhcp.pcap')},
+        ))
+
     def test_sharkd_req_complete_field(self, check_sharkd_session):
         check_sharkd_session((
             {"req": "complete"},
@@ -453,3 +465,86 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
                 {"v": 2, "d": "Yes - with IV"}
             ]}}},
         ))
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_sharkd_index(subprocesstest.SubprocessTestCase):
+    # Fetched last first, so that a compressed file is seeked back through.
+    index_frames = (3000, 2999, 1500, 2, 1)
+
+    def write_big_pcap(self, path):
+        '''Write a pcap file of about 3 MB, of random data that doesn't
+        compress, and return the time from its first frame to its last.'''
+        records = []
+        for i in range(3000):
+            payload = os.urandom(1000)
+            frame = bytes(12) + struct.pack('!H', 0x0800)
+            frame += struct.pack('!BBHHHBBH4s4s', 0x45, 0, 20 + len(payload),
+                i, 0, 64, 253, 0, bytes((10, 0, 0, 1)), bytes((10, 0, 0, 2)))
+            frame += payload
+            records.append((capture_writer.usecs(10 + i * 0.37 + (i % 7) * 0.01), frame))
+        capture_writer.write_pcap(path, capture_writer.LINKTYPE_ETHERNET, records)
+        return (records[-1][0] - records[0][0]) / 1000000
+
+    def load_indexed(self, run_sharkd_session, cap_file):
+        '''Load a file, indexing it if it's over 1 MB, and return the
+        status, the frame list, and some frames' data.'''
+        commands = [
+            {"req": "setconf", "name": "gui.fileopen.index_size", "value": "1"},
+            {"req": "load", "file": cap_file},
+            {"req": "status"},
+            {"req": "frames"},
+        ] + [{"req": "frame", "frame": n, "bytes": True} for n in self.index_frames]
+        outputs = run_sharkd_session([json.dumps(x) for x in commands])
+        self.assertEqual(outputs[:2], ({"err": 0}, {"err": 0}))
+        return outputs[2:]
+
+    def check_index(self, run_sharkd_session, cap_file, duration):
+        index_file = cap_file + '.wsidx'
+
+        # Reading the file through writes an index of it.
+        first = self.load_indexed(run_sharkd_session, cap_file)
+        self.assertEqual(first[0]['frames'], 3000)
+        self.assertAlmostEqual(first[0]['duration'], duration, places=6)
+        with open(index_file, 'rb') as f:
+            index_data = f.read()
+
+        # It's used, as it is, the next time, with the same results.
+        os.utime(index_file, (0, 0))
+        self.assertEqual(self.load_indexed(run_sharkd_session, cap_file), first)
+        self.assertEqual(os.stat(index_file).st_mtime, 0)
+
+        # It's stale once the file's modification time changes, and
+        # rewritten.
+        cap_stat = os.stat(cap_file)
+        os.utime(cap_file, (cap_stat.st_atime, cap_stat.st_mtime + 10))
+        self.assertEqual(self.load_indexed(run_sharkd_session, cap_file), first)
+        with open(index_file, 'rb') as f:
+            self.assertNotEqual(f.read(), index_data)
+
+        # An index that claims more entries than it has is rejected too.
+        # The count follows the magic number, version, byte order, file
+        # size, time and hash, file type and number of state blocks.
+        os.utime(index_file, (0, 0))
+        with open(index_file, 'r+b') as f:
+            f.seek(8 + 4 + 4 + 8 + 8 + 20 + 4 + 4)
+            f.write(struct.pack('=I', 0xffffffff))
+        self.assertEqual(self.load_indexed(run_sharkd_session, cap_file), first)
+        self.assertNotEqual(os.stat(index_file).st_mtime, 0)
+
+    def test_sharkd_index_pcap(self, run_sharkd_session):
+        '''Write, reuse and reject an index of a pcap file'''
+        cap_file = self.filename_from_id('big.pcap')
+        duration = self.write_big_pcap(cap_file)
+        self.check_index(run_sharkd_session, cap_file, duration)
+
+    def test_sharkd_index_gzip(self, run_sharkd_session):
+        '''Write, reuse and reject an index of a gzipped pcap file, and
+        seek through it with the index's seek points'''
+        pcap_file = self.filename_from_id('big.pcap')
+        cap_file = self.filename_from_id('big.pcap.gz')
+        duration = self.write_big_pcap(pcap_file)
+        with open(pcap_file, 'rb') as f_in, gzip.open(cap_file, 'wb') as f_out:
+            f_out.write(f_in.read())
+        self.check_index(run_sharkd_session, cap_file, duration)
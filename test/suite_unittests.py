@@ -20,10 +20,26 @@ import fixtures
 
 @fixtures.uses_fixtures
 class case_unittests(subprocesstest.SubprocessTestCase):
+    def test_unit_conversation_test(self, program, base_env):
+        '''conversation_test'''
+        self.assertRun(program('conversation_test'), env=base_env)
+
+    def test_unit_cwstream_test(self, program, base_env):
+        '''cwstream_test'''
+        self.assertRun(program('cwstream_test'), env=base_env)
+
     def test_unit_exntest(self, program, base_env):
         '''exntest'''
         self.assertRun(program('exntest'), env=base_env)
 
+    def test_unit_file_wrappers_test(self, program, base_env):
+        '''file_wrappers_test'''
+        self.assertRun(program('file_wrappers_test'), env=base_env)
+
+    def test_unit_flow_table_test(self, program, base_env):
+        '''flow_table_test'''
+        self.assertRun(program('flow_table_test'), env=base_env)
+
     def test_unit_oids_test(self, program, base_env):
         '''oids_test'''
         self.assertRun(program('oids_test'), env=base_env)
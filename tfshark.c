@@ -889,7 +889,7 @@ real_main(int argc, char *argv[])
   build_column_format_array(&cfile.cinfo, prefs_p->num_cols, TRUE);
 
   if (rfilter != NULL) {
-    if (!dfilter_compile(rfilter, &rfcode, &err_msg)) {
+    if (!dfilter_compile_flags(rfilter, &rfcode, &err_msg, DF_ALLOW_FILE_SETS)) {
       cmdarg_err("%s", err_msg);
       g_free(err_msg);
       exit_status = INVALID_FILTER;
@@ -899,7 +899,7 @@ real_main(int argc, char *argv[])
   cfile.rfcode = rfcode;
 
   if (dfilter != NULL) {
-    if (!dfilter_compile(dfilter, &dfcode, &err_msg)) {
+    if (!dfilter_compile_flags(dfilter, &dfcode, &err_msg, DF_ALLOW_FILE_SETS)) {
       cmdarg_err("%s", err_msg);
       g_free(err_msg);
       exit_status = INVALID_FILTER;
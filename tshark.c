@@ -55,6 +55,7 @@
 #include <version_info.h>
 #include <wiretap/wtap_opttypes.h>
 #include <wiretap/pcapng.h>
+#include <wiretap/wtap_chunk.h>
 
 #include "globals.h"
 #include <epan/timestamp.h>
@@ -63,6 +64,10 @@
 #include <epan/wslua/init_wslua.h>
 #endif
 #include "frame_tvbuff.h"
+#include "record_prefetch.h"
+#ifndef _WIN32
+#include "dissect_workers.h"
+#endif
 #include <epan/disabled_protos.h>
 #include <epan/prefs.h>
 #include <epan/column.h>
@@ -89,6 +94,8 @@
 #include <epan/epan_dissect.h>
 #include <epan/tap.h>
 #include <epan/stat_tap_ui.h>
+#include <epan/conversation.h>
+#include <epan/reassemble.h>
 #include <epan/conversation_table.h>
 #include <epan/srt_table.h>
 #include <epan/rtd_table.h>
@@ -142,6 +149,13 @@
 #define LONGOPT_COLOR (65536+1000)
 #define LONGOPT_NO_DUPLICATE_KEYS (65536+1001)
 #define LONGOPT_ELASTIC_MAPPING_FILTER (65536+1002)
+#define LONGOPT_PREFETCH (65536+1003)
+#define LONGOPT_PREFILTER (65536+1004)
+#define LONGOPT_PRUNE_DISSECTION (65536+1005)
+#define LONGOPT_COMPRESS (65536+1006)
+#define LONGOPT_RETIRE_CONVERSATIONS (65536+1007)
+#define LONGOPT_REASSEMBLY_LIMITS (65536+1008)
+#define LONGOPT_WORKERS (65536+1009)
 
 #if 0
 #define tshark_debug(...) g_warning(__VA_ARGS__)
@@ -157,6 +171,20 @@ static frame_data prev_dis_frame;
 static frame_data prev_cap_frame;
 
 static gboolean perform_two_pass_analysis;
+static guint prefetch_depth = 0;
+static record_prefetch_t *prefetch = NULL;
+static wtap_chunk_t *worker_chunk = NULL; /* the chunk a one-pass worker reads */
+static gboolean prefilter_requested = FALSE;
+static gboolean use_prefilter = FALSE; /* TRUE if we skip frames the prefilter rejects */
+static gboolean prune_requested = FALSE;
+static gboolean prune_dissection = FALSE; /* TRUE if we skip protocols nothing is wanted from */
+static guint retire_idle_secs = 0;
+static guint retire_closed_secs = 0;
+static guint32 reassembly_max_kbytes = 0;
+static guint32 reassembly_max_frames = 0;
+static guint32 reassembly_max_secs = 0;
+static guint workers_requested = 0;
+static gboolean use_workers = FALSE; /* TRUE if packets are dissected in worker processes */
 static guint32 epan_auto_reset_count = 0;
 static gboolean epan_auto_reset = FALSE;
 
@@ -183,6 +211,7 @@ static gboolean line_buffered;
 static gboolean really_quiet = FALSE;
 static gchar* delimiter_char = " ";
 static gboolean dissect_color = FALSE;
+static wtap_compression_type out_compression_type = WTAP_UNCOMPRESSED;
 
 static print_format_e print_format = PR_FMT_TEXT;
 static print_stream_t *print_stream = NULL;
@@ -290,6 +319,17 @@ list_capture_types(void) {
   g_free(captypes);
 }
 
+static void
+list_output_compression_types(void) {
+  GSList *compression_type_names, *name;
+
+  fprintf(stderr, "tshark: The available output compression types for the \"--compress\" flag are:\n");
+  compression_type_names = wtap_get_all_output_compression_type_names_list();
+  for (name = compression_type_names; name != NULL; name = g_slist_next(name))
+    fprintf(stderr, "    %s\n", (const char *)name->data);
+  g_slist_free(compression_type_names);
+}
+
 static void
 list_read_capture_types(void) {
   int                 i;
@@ -383,6 +423,23 @@ print_usage(FILE *output)
   fprintf(output, "                           enable dissection of heuristic protocol\n");
   fprintf(output, "  --disable-heuristic <short_name>\n");
   fprintf(output, "                           disable dissection of heuristic protocol\n");
+  fprintf(output, "  --prefetch <records>     read up to <records> records ahead of dissection\n");
+  fprintf(output, "                           on a separate thread\n");
+  fprintf(output, "  --prefilter              don't dissect frames whose raw bytes can't match\n");
+  fprintf(output, "                           the display filter\n");
+  fprintf(output, "  --prune-dissection       don't dissect stateless protocols that no filter\n");
+  fprintf(output, "                           or -e field needs\n");
+  fprintf(output, "  --retire-conversations <idle>[,<closed>]\n");
+  fprintf(output, "                           free conversations idle for <idle> seconds, or\n");
+  fprintf(output, "                           closed and idle for <closed> seconds\n");
+  fprintf(output, "  --reassembly-limits <kB>[,<frames>[,<seconds>]]\n");
+  fprintf(output, "                           abandon reassemblies when a table holds over\n");
+  fprintf(output, "                           <kB> kilobytes, or after <frames> frames or\n");
+  fprintf(output, "                           <seconds> seconds without a fragment\n");
+#ifndef _WIN32
+  fprintf(output, "  --workers <count>        dissect and print the packets of a file in <count>\n");
+  fprintf(output, "                           processes at once\n");
+#endif
 
   /*fprintf(output, "\n");*/
   fprintf(output, "Output:\n");
@@ -399,6 +456,8 @@ print_usage(FILE *output)
   fprintf(output, "  -F <output file type>    set the output file type, default is pcap\n");
 #endif
   fprintf(output, "                           an empty \"-F\" option will list the file types\n");
+  fprintf(output, "  --compress <type>        compress the output file; \"--compress help\" lists\n");
+  fprintf(output, "                           the types\n");
   fprintf(output, "  -V                       add output of packet tree        (Packet Details)\n");
   fprintf(output, "  -O <protocols>           Only show packet details of these protocols, comma\n");
   fprintf(output, "                           separated\n");
@@ -670,6 +729,72 @@ must_do_dissection(dfilter_t *rfcode, dfilter_t *dfcode,
       tap_listeners_require_dissection() || dissect_color;
 }
 
+static gboolean
+can_use_prefilter(dfilter_t *dfcode)
+{
+  /* Frames rejected by the display filter's conditions on their raw
+     bytes can go undissected if --prefilter was given, unless:
+
+        we're doing two passes, as the first pass must see every frame;
+
+        some tap needs to see every frame;
+
+        a postdissector wants fields from every frame. */
+  return prefilter_requested && dfcode != NULL && dfilter_has_prefilter(dfcode) &&
+      !perform_two_pass_analysis && !tap_listeners_require_dissection() &&
+      !postdissectors_want_hfids();
+}
+
+static gboolean
+can_prune_dissection(void)
+{
+  /* Protocols that nothing wanted from a packet can come from can go
+     undissected if --prune-dissection was given, unless:
+
+        some tap needs to see every protocol;
+
+        we're printing the protocol tree; with -T fields the fields
+        are taken from a tree that isn't visible instead. */
+  return prune_requested && !tap_listeners_require_dissection() &&
+      (output_action == WRITE_FIELDS || !(print_packet_info && print_details));
+}
+
+static gboolean
+can_use_workers(void)
+{
+  /* The packets of a file can be dissected and printed by worker
+     processes if --workers was given, unless:
+
+        we're not printing packet information;
+
+        some tap needs to see every packet, in this process;
+
+        sessions are reset every so many packets, which restarts the
+        frame numbers;
+
+        the output format puts something between packets that depends
+        on whether a packet has been printed before (JSON). */
+  return workers_requested > 1 && print_packet_info &&
+      !tap_listeners_require_dissection() && !epan_auto_reset &&
+      output_action != WRITE_JSON && output_action != WRITE_JSON_RAW;
+}
+
+/*
+ * Create the epan_dissect_t for a pass over the packets.
+ */
+static epan_dissect_t *
+new_edt(capture_file *cf, gboolean create_proto_tree, gboolean proto_tree_visible)
+{
+  epan_dissect_t *edt;
+
+  if (prune_dissection)
+    proto_tree_visible = FALSE;
+  edt = epan_dissect_new(cf->epan, create_proto_tree, proto_tree_visible);
+  if (prune_dissection)
+    epan_dissect_prune_protocols(edt, TRUE);
+  return edt;
+}
+
 static int
 real_main(int argc, char *argv[])
 {
@@ -687,6 +812,13 @@ real_main(int argc, char *argv[])
     {"color", no_argument, NULL, LONGOPT_COLOR},
     {"no-duplicate-keys", no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
     {"elastic-mapping-filter", required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
+    {"prefetch", required_argument, NULL, LONGOPT_PREFETCH},
+    {"prefilter", no_argument, NULL, LONGOPT_PREFILTER},
+    {"prune-dissection", no_argument, NULL, LONGOPT_PRUNE_DISSECTION},
+    {"compress", required_argument, NULL, LONGOPT_COMPRESS},
+    {"retire-conversations", required_argument, NULL, LONGOPT_RETIRE_CONVERSATIONS},
+    {"reassembly-limits", required_argument, NULL, LONGOPT_REASSEMBLY_LIMITS},
+    {"workers", required_argument, NULL, LONGOPT_WORKERS},
     {0, 0, 0, 0 }
   };
   gboolean             arg_error = FALSE;
@@ -915,6 +1047,10 @@ real_main(int argc, char *argv[])
 
   wtap_init(TRUE);
 
+  /* A two-pass read of a pipe or the standard input goes back to packets
+     in a temporary copy of it. */
+  wtap_set_pipe_spill(TRUE);
+
   /* Register all dissectors; we must do this before checking for the
      "-G" flag, as the "-G" flag dumps information registered by the
      dissectors, and we must do it before we read the preferences, in
@@ -1453,6 +1589,78 @@ real_main(int argc, char *argv[])
       no_duplicate_keys = TRUE;
       node_children_grouper = proto_node_group_children_by_json_key;
       break;
+    case LONGOPT_PREFETCH:
+      prefetch_depth = get_positive_int(optarg, "prefetch depth");
+      if (prefetch_depth > RECORD_PREFETCH_MAX_DEPTH) {
+        cmdarg_err("The prefetch depth can't be larger than %u.",
+                   RECORD_PREFETCH_MAX_DEPTH);
+        exit_status = INVALID_OPTION;
+        goto clean_exit;
+      }
+      break;
+    case LONGOPT_PREFILTER:
+      prefilter_requested = TRUE;
+      break;
+    case LONGOPT_PRUNE_DISSECTION:
+      prune_requested = TRUE;
+      break;
+    case LONGOPT_RETIRE_CONVERSATIONS:
+    {
+      char *comma = strchr(optarg, ',');
+
+      if (comma != NULL) {
+        *comma = '\0';
+        retire_closed_secs = get_guint32(comma + 1, "closed conversation idle time");
+      }
+      retire_idle_secs = get_positive_int(optarg, "conversation idle time");
+      break;
+    }
+    case LONGOPT_REASSEMBLY_LIMITS:
+    {
+      char *frames = strchr(optarg, ',');
+      char *secs = NULL;
+
+      if (frames != NULL) {
+        *frames++ = '\0';
+        secs = strchr(frames, ',');
+        if (secs != NULL) {
+          *secs++ = '\0';
+          reassembly_max_secs = get_guint32(secs, "reassembly age limit in seconds");
+        }
+        reassembly_max_frames = get_guint32(frames, "reassembly age limit in frames");
+      }
+      reassembly_max_kbytes = get_guint32(optarg, "reassembly memory limit");
+      break;
+    }
+    case LONGOPT_WORKERS:
+#ifdef _WIN32
+      cmdarg_err("--workers isn't supported on Windows.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+#else
+      workers_requested = get_positive_int(optarg, "number of workers");
+      if (workers_requested > DISSECT_WORKERS_MAX) {
+        cmdarg_err("The number of workers can't be larger than %u.",
+                   DISSECT_WORKERS_MAX);
+        exit_status = INVALID_OPTION;
+        goto clean_exit;
+      }
+#endif
+      break;
+    case LONGOPT_COMPRESS:
+      if (strcmp(optarg, "help") == 0) {
+        list_output_compression_types();
+        exit_status = EXIT_SUCCESS;
+        goto clean_exit;
+      }
+      out_compression_type = wtap_name_to_compression_type(optarg);
+      if (out_compression_type == WTAP_UNKNOWN_COMPRESSION) {
+        cmdarg_err("\"%s\" isn't a valid output compression type", optarg);
+        list_output_compression_types();
+        exit_status = INVALID_OPTION;
+        goto clean_exit;
+      }
+      break;
     default:
     case '?':        /* Bad flag - print usage message */
       switch(optopt) {
@@ -1483,6 +1691,23 @@ real_main(int argc, char *argv[])
     goto clean_exit;
   }
 
+  if (retire_idle_secs != 0) {
+    /* Frames of retired conversations can't be dissected again. */
+    if (perform_two_pass_analysis) {
+      cmdarg_err("--retire-conversations does not support two pass analysis.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
+    conversation_set_retire_timeouts(retire_idle_secs, retire_closed_secs);
+  }
+
+  if (reassembly_max_kbytes != 0 || reassembly_max_frames != 0 || reassembly_max_secs != 0) {
+    guint64 max_bytes = (guint64)reassembly_max_kbytes * 1024;
+
+    reassembly_tables_set_limits((guint32)MIN(max_bytes, G_MAXUINT32),
+                                 reassembly_max_frames, reassembly_max_secs);
+  }
+
   /* If we specified output fields, but not the output field type... */
   if ((WRITE_FIELDS != output_action && WRITE_XML != output_action && WRITE_JSON != output_action && WRITE_EK != output_action) && 0 != output_fields_num_fields(output_fields)) {
         cmdarg_err("Output fields were specified with \"-e\", "
@@ -1555,6 +1780,12 @@ real_main(int argc, char *argv[])
        we should print packet information */
     if (!quiet)
       print_packet_info = TRUE;
+    if (out_compression_type != WTAP_UNCOMPRESSED) {
+      cmdarg_err("Output compression requested, but the packets aren't being"
+          " written to a file.");
+      exit_status = INVALID_OPTION;
+      goto clean_exit;
+    }
   } else {
 #ifdef HAVE_LIBPCAP
     const char *save_file = global_capture_opts.save_file;
@@ -1723,6 +1954,37 @@ real_main(int argc, char *argv[])
           exit_status = INVALID_OPTION;
           goto clean_exit;
         }
+        if (out_compression_type != WTAP_UNCOMPRESSED) {
+          /* dumpcap writes the file, and only knows these. */
+          switch (out_compression_type) {
+
+          case WTAP_ZSTD_COMPRESSED:
+            global_capture_opts.compress_type = g_strdup("zstd");
+            break;
+
+          case WTAP_LZ4_COMPRESSED:
+            global_capture_opts.compress_type = g_strdup("lz4");
+            break;
+
+          default:
+            cmdarg_err("Live captures can only be compressed with zstd or lz4.");
+            exit_status = INVALID_OPTION;
+            goto clean_exit;
+          }
+          /* We'd be reading the file while the last frame is still
+             being filled. */
+          if (tap_listeners_require_dissection()) {
+            cmdarg_err("Taps aren't supported when capturing to a compressed file.");
+            exit_status = INVALID_OPTION;
+            goto clean_exit;
+          }
+          if (print_packet_info) {
+            cmdarg_err("Printing dissected packets isn't supported when capturing"
+                " to a compressed file.");
+            exit_status = INVALID_OPTION;
+            goto clean_exit;
+          }
+        }
         if (global_capture_opts.multi_files_on) {
           /* Multiple-file mode doesn't work under certain conditions:
              a) it doesn't work if you're writing to the standard output;
@@ -1874,7 +2136,7 @@ real_main(int argc, char *argv[])
 
   if (rfilter != NULL) {
     tshark_debug("Compiling read filter: '%s'", rfilter);
-    if (!dfilter_compile(rfilter, &rfcode, &err_msg)) {
+    if (!dfilter_compile_flags(rfilter, &rfcode, &err_msg, DF_ALLOW_FILE_SETS)) {
       cmdarg_err("%s", err_msg);
       g_free(err_msg);
       epan_cleanup();
@@ -1902,7 +2164,7 @@ real_main(int argc, char *argv[])
 
   if (dfilter != NULL) {
     tshark_debug("Compiling display filter: '%s'", dfilter);
-    if (!dfilter_compile(dfilter, &dfcode, &err_msg)) {
+    if (!dfilter_compile_flags(dfilter, &dfcode, &err_msg, DF_ALLOW_FILE_SETS)) {
       cmdarg_err("%s", err_msg);
       g_free(err_msg);
       epan_cleanup();
@@ -2035,6 +2297,9 @@ real_main(int argc, char *argv[])
        other things, what taps are listening, so determine that after
        starting the statistics taps. */
     do_dissection = must_do_dissection(rfcode, dfcode, pdu_export_arg);
+    use_prefilter = can_use_prefilter(dfcode);
+    prune_dissection = can_prune_dissection();
+    use_workers = can_use_workers();
 
     /* Process the packets in the file */
     tshark_debug("tshark: invoking process_cap_file() to process the packets");
@@ -2195,6 +2460,8 @@ real_main(int argc, char *argv[])
        other things, what taps are listening, so determine that after
        starting the statistics taps. */
     do_dissection = must_do_dissection(rfcode, dfcode, pdu_export_arg);
+    use_prefilter = can_use_prefilter(dfcode);
+    prune_dissection = can_prune_dissection();
 
     /*
      * XXX - this returns FALSE if an error occurred, but it also
@@ -2400,13 +2667,39 @@ tshark_get_frame_ts(struct packet_provider_data *prov, guint32 frame_num)
   return NULL;
 }
 
+/*
+ * The interface descriptions belong to wiretap, which may be adding to
+ * them on the prefetch thread, so look at them with that locked out.
+ */
+static const char *
+tshark_get_interface_name(struct packet_provider_data *prov, guint32 interface_id)
+{
+  const char *name;
+
+  record_prefetch_lock(prefetch);
+  name = cap_file_provider_get_interface_name(prov, interface_id);
+  record_prefetch_unlock(prefetch);
+  return name;
+}
+
+static const char *
+tshark_get_interface_description(struct packet_provider_data *prov, guint32 interface_id)
+{
+  const char *descr;
+
+  record_prefetch_lock(prefetch);
+  descr = cap_file_provider_get_interface_description(prov, interface_id);
+  record_prefetch_unlock(prefetch);
+  return descr;
+}
+
 static epan_t *
 tshark_epan_new(capture_file *cf)
 {
   static const struct packet_provider_funcs funcs = {
     tshark_get_frame_ts,
-    cap_file_provider_get_interface_name,
-    cap_file_provider_get_interface_description,
+    tshark_get_interface_name,
+    tshark_get_interface_description,
     NULL,
   };
 
@@ -2650,6 +2943,8 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
     /* Attempt to open the capture file and set up to read from it. */
     switch(cf_open((capture_file *)cap_session->cf, capture_opts->save_file, WTAP_TYPE_AUTO, is_tempfile, &err)) {
     case CF_OK:
+      /* dumpcap is still writing the file, so don't map it. */
+      wtap_disable_mapping(((capture_file *)cap_session->cf)->provider.wth);
       break;
     case CF_ERROR:
       /* Don't unlink (delete) the save file - leave it around,
@@ -2726,7 +3021,7 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
        printing packet details, which is true if we're printing stuff
        ("print_packet_info" is true) and we're in verbose mode
        ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = new_edt(cf, create_proto_tree, print_packet_info && print_details);
 
     while (to_read-- && cf->provider.wth) {
       wtap_cleareof(cf->provider.wth);
@@ -2964,17 +3259,23 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
   }
 
   if (passed) {
+    frame_data *fdata;
+
     frame_data_set_after_dissect(&fdlocal, &cum_bytes);
-    cf->provider.prev_cap = cf->provider.prev_dis = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+    fdata = frame_data_sequence_add(cf->provider.frames, &fdlocal);
+    cf->provider.prev_cap = cf->provider.prev_dis = fdata;
 
     /* If we're not doing dissection then there won't be any dependent frames.
      * More importantly, edt.pi.dependent_frames won't be initialized because
      * epan hasn't been initialized.
      * if we *are* doing dissection, then mark the dependent frames, but only
      * if a display filter was given and it matches this packet.
+     * Remember which frames it matched, for the second-pass workers to
+     * know which frame was displayed before their first.
      */
     if (edt && cf->dfcode) {
       if (dfilter_apply_edt(cf->dfcode, edt)) {
+        fdata->flags.passed_dfilter = 1;
         g_slist_foreach(edt->pi.dependent_frames, find_and_mark_frame_depended_upon, cf->provider.frames);
       }
     }
@@ -2995,7 +3296,7 @@ process_packet_first_pass(capture_file *cf, epan_dissect_t *edt,
 static gboolean
 process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
                            frame_data *fdata, wtap_rec *rec,
-                           Buffer *buf, guint tap_flags)
+                           const guchar *pd, guint tap_flags)
 {
   column_info    *cinfo;
   gboolean        passed;
@@ -3018,6 +3319,11 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    /* If the fields to write are taken from a tree that isn't visible,
+       prime the epan_dissect_t with them. */
+    if (prune_dissection && output_action == WRITE_FIELDS)
+      output_fields_prime_edt(output_fields, edt);
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
@@ -3042,7 +3348,7 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
     }
 
     epan_dissect_run_with_taps(edt, cf->cd_t, rec,
-                               frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
+                               frame_tvbuff_new(&cf->provider, fdata, pd),
                                fdata, cinfo);
 
     /* Run the read/display filter if we have one. */
@@ -3079,6 +3385,533 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
   return passed || fdata->flags.dependent_of_displayed;
 }
 
+/*
+ * While records are being prefetched, wiretap calls the name resolution
+ * and secrets callbacks on the prefetch thread.  Queue what they're
+ * handed and pass it on to epan on this thread, just before the record
+ * that followed it in the file, so that it's seen in the same order as
+ * without prefetching.
+ */
+typedef struct {
+  gboolean is_ipv6;
+  guint32  addr4;
+  guint8   addr6[16];
+  gchar   *name;           /* points just past this structure */
+} prefetched_name_t;
+
+typedef struct {
+  guint32 secrets_type;
+  guint   size;
+  guint8 *secrets;         /* points just past this structure */
+} prefetched_secrets_t;
+
+static void
+prefetched_name_add(gpointer data)
+{
+  prefetched_name_t *nm = (prefetched_name_t *)data;
+
+  if (nm->is_ipv6)
+    add_ipv6_name((const ws_in6_addr *)nm->addr6, nm->name);
+  else
+    add_ipv4_name(nm->addr4, nm->name);
+  g_free(nm);
+}
+
+static prefetched_name_t *
+prefetched_name_new(gboolean is_ipv6, const gchar *name)
+{
+  size_t             name_len = strlen(name) + 1;
+  prefetched_name_t *nm = (prefetched_name_t *)g_malloc0(sizeof *nm + name_len);
+
+  nm->is_ipv6 = is_ipv6;
+  nm->name = (gchar *)(nm + 1);
+  memcpy(nm->name, name, name_len);
+  return nm;
+}
+
+static void
+prefetch_add_ipv4_name(const guint addr, const gchar *name)
+{
+  prefetched_name_t *nm = prefetched_name_new(FALSE, name);
+
+  nm->addr4 = addr;
+  record_prefetch_defer(prefetch, prefetched_name_add, nm, g_free);
+}
+
+static void
+prefetch_add_ipv6_name(const void *addrp, const gchar *name)
+{
+  prefetched_name_t *nm = prefetched_name_new(TRUE, name);
+
+  memcpy(nm->addr6, addrp, sizeof nm->addr6);
+  record_prefetch_defer(prefetch, prefetched_name_add, nm, g_free);
+}
+
+static void
+prefetched_secrets_add(gpointer data)
+{
+  prefetched_secrets_t *sec = (prefetched_secrets_t *)data;
+
+  secrets_wtap_callback(sec->secrets_type, sec->secrets, sec->size);
+  g_free(sec);
+}
+
+static void
+prefetch_add_secrets(guint32 secrets_type, const void *secrets, guint size)
+{
+  prefetched_secrets_t *sec = (prefetched_secrets_t *)g_malloc(sizeof *sec + size);
+
+  sec->secrets_type = secrets_type;
+  sec->size = size;
+  sec->secrets = (guint8 *)(sec + 1);
+  memcpy(sec->secrets, secrets, size);
+  record_prefetch_defer(prefetch, prefetched_secrets_add, sec, g_free);
+}
+
+/*
+ * If asked to, start reading records sequentially on a separate thread.
+ */
+static void
+start_prefetch(capture_file *cf)
+{
+  if (prefetch_depth == 0)
+    return;
+
+  tshark_debug("tshark: prefetching up to %u records", prefetch_depth);
+  wtap_set_cb_new_ipv4(cf->provider.wth, prefetch_add_ipv4_name);
+  wtap_set_cb_new_ipv6(cf->provider.wth, prefetch_add_ipv6_name);
+  wtap_set_cb_new_secrets(cf->provider.wth, prefetch_add_secrets);
+  prefetch = record_prefetch_new(cf->provider.wth, prefetch_depth);
+
+  /* Frame tvbuffs may read from the random-access stream meanwhile. */
+  frame_tvbuff_set_read_mutex(record_prefetch_get_mutex(prefetch));
+}
+
+/*
+ * If asked to, start reading the frames found by the first pass on a
+ * separate thread, so the reads for the second pass overlap with its
+ * dissection.
+ */
+static void
+start_prefetch_frames(capture_file *cf)
+{
+  if (prefetch_depth == 0)
+    return;
+
+  tshark_debug("tshark: prefetching up to %u frames", prefetch_depth);
+  prefetch = record_prefetch_new_frames(cf->provider.wth, cf->provider.frames,
+                                        cf->count, prefetch_depth);
+  frame_tvbuff_set_read_mutex(record_prefetch_get_mutex(prefetch));
+}
+
+static void
+stop_prefetch(capture_file *cf)
+{
+  if (prefetch == NULL)
+    return;
+
+  frame_tvbuff_set_read_mutex(NULL);
+  record_prefetch_free(prefetch);
+  prefetch = NULL;
+  wtap_set_cb_new_ipv4(cf->provider.wth, add_ipv4_name);
+  wtap_set_cb_new_ipv6(cf->provider.wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
+  wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
+}
+
+/*
+ * Read the next record in the file, from the prefetch thread if there
+ * is one, from the chunk of the file a worker dissects if we're one,
+ * otherwise directly.
+ */
+static gboolean
+read_next_record(capture_file *cf, wtap_rec **rec, const guchar **pd,
+                 gint64 *data_offset, int *err, gchar **err_info)
+{
+  if (prefetch != NULL)
+    return record_prefetch_read(prefetch, rec, pd, data_offset, err, err_info);
+
+  if (worker_chunk != NULL) {
+    if (!wtap_chunk_read(worker_chunk, err, err_info, data_offset))
+      return FALSE;
+  } else if (!wtap_read(cf->provider.wth, err, err_info, data_offset))
+    return FALSE;
+  *rec = wtap_get_rec(cf->provider.wth);
+  *pd = wtap_get_buf_ptr(cf->provider.wth);
+  return TRUE;
+}
+
+#ifndef _WIN32
+/*
+ * With --workers, the packets of a file are dissected and printed by
+ * worker processes, each taking a part of the file; see dissect_workers.h.
+ *
+ * In a two-pass analysis, the workers are forked after the first pass,
+ * so each starts with the state that pass built, and each does the
+ * second pass over a range of frames.
+ *
+ * In a one-pass analysis, the file has to be one that can be read in
+ * chunks (see wtap_chunk.h), and each worker dissects a chunk from
+ * scratch, so dissectors that depend on earlier packets see only those
+ * of the worker's own chunk.  The chunks are read through first, on a
+ * thread each, to count their records, so that the workers can number
+ * their frames, and time them, following the chunks before theirs.
+ */
+typedef struct {
+  /* A chunk of the file, for a one-pass analysis. */
+  gint64        start;          /* its byte range */
+  gint64        end;
+  wtap_chunk_t *chunk;          /* while its records are being counted */
+  guint32       count;          /* number of records */
+  guint32       bytes;          /* their length, as cum_bytes counts it */
+  nstime_t      first_ts;       /* time stamp of its first record */
+  nstime_t      last_ts;        /* time stamp of its last record */
+  nstime_t      prev_ts;        /* time stamp of the record before it */
+  guint32       cum_bytes;      /* cum_bytes before it */
+  int           err;
+  gchar        *err_info;
+
+  /* A range of frames, for a two-pass analysis. */
+  guint32       last_frame;     /* number of the last frame */
+  frame_data   *prev_dis;       /* frame displayed before the first */
+
+  guint32       first_frame;    /* number of the first frame, for both */
+} worker_part_t;
+
+typedef struct {
+  capture_file   *cf;
+  epan_dissect_t *edt;
+  guint           tap_flags;
+  nstime_t        ref_ts;       /* time stamp of the file's first record */
+  worker_part_t  *parts;
+} worker_plan_t;
+
+static gpointer
+count_chunk_records(gpointer data)
+{
+  worker_part_t *part = (worker_part_t *)data;
+  wtap          *wth = wtap_chunk_wtap(part->chunk);
+  frame_data     fdata;
+  gint64         data_offset;
+
+  while (wtap_chunk_read(part->chunk, &part->err, &part->err_info,
+                         &data_offset)) {
+    frame_data_init(&fdata, part->count + 1, wtap_get_rec(wth), data_offset,
+                    part->bytes);
+    if (part->count == 0)
+      part->first_ts = fdata.abs_ts;
+    part->last_ts = fdata.abs_ts;
+    part->bytes = fdata.cum_bytes;
+    part->count++;
+  }
+  return NULL;
+}
+
+/*
+ * Split the file into chunks for the workers of a one-pass analysis, and
+ * count their records.  Returns NULL if the file has to be read through
+ * instead: because it can't be read in chunks, or isn't big enough to be
+ * worth it, or reading the chunks didn't get the records that reading it
+ * through would, or got an error, which is then reported when it's read
+ * through.
+ */
+static worker_part_t *
+plan_chunk_workers(capture_file *cf, guint *num_parts, nstime_t *ref_ts)
+{
+  GArray        *bounds;
+  GPtrArray     *chunks;
+  GThread      **threads;
+  worker_part_t *parts;
+  guint          n, i;
+  gboolean       ok = TRUE;
+  guint32        frames = 0;
+  guint32        bytes = 0;
+  nstime_t       prev_ts;
+
+  bounds = wtap_chunk_split(cf->provider.wth, workers_requested);
+  if (bounds == NULL)
+    return NULL;
+  n = bounds->len - 1;
+
+  parts = g_new0(worker_part_t, n);
+  chunks = g_ptr_array_new_with_free_func((GDestroyNotify)wtap_chunk_close);
+  for (i = 0; i < n; i++) {
+    parts[i].start = g_array_index(bounds, gint64, i);
+    parts[i].end = g_array_index(bounds, gint64, i + 1);
+    parts[i].chunk = wtap_chunk_open(cf->filename, parts[i].start,
+                                     parts[i].end, &parts[i].err,
+                                     &parts[i].err_info);
+    if (parts[i].chunk == NULL) {
+      ok = FALSE;
+      break;
+    }
+    g_ptr_array_add(chunks, parts[i].chunk);
+  }
+  g_array_free(bounds, TRUE);
+
+  if (ok) {
+    threads = g_new(GThread *, n);
+    for (i = 0; i < n; i++)
+      threads[i] = g_thread_new("tshark chunk counter", count_chunk_records,
+                                &parts[i]);
+    for (i = 0; i < n; i++)
+      g_thread_join(threads[i]);
+    g_free(threads);
+
+    for (i = 0; i < n; i++) {
+      if (parts[i].err != 0)
+        ok = FALSE;
+    }
+    if (ok)
+      ok = wtap_chunks_consistent(chunks);
+  }
+
+  /* The workers open the chunks again for themselves. */
+  for (i = 0; i < n; i++) {
+    parts[i].chunk = NULL;
+    g_free(parts[i].err_info);
+    parts[i].err_info = NULL;
+  }
+  g_ptr_array_free(chunks, TRUE);
+  if (!ok) {
+    g_free(parts);
+    return NULL;
+  }
+
+  nstime_set_zero(ref_ts);
+  nstime_set_zero(&prev_ts);
+  for (i = 0; i < n; i++) {
+    parts[i].first_frame = frames + 1;
+    parts[i].cum_bytes = bytes;
+    parts[i].prev_ts = prev_ts;
+    if (parts[i].count != 0) {
+      if (frames == 0)
+        *ref_ts = parts[i].first_ts;
+      prev_ts = parts[i].last_ts;
+    }
+    frames += parts[i].count;
+    bytes += parts[i].bytes;
+  }
+  *num_parts = n;
+  return parts;
+}
+
+/*
+ * The work of a worker in a one-pass analysis: dissect and print the
+ * records of a chunk of the file.
+ */
+static gboolean
+dissect_chunk_worker(guint worker, gpointer data)
+{
+  worker_plan_t *plan = (worker_plan_t *)data;
+  worker_part_t *part = &plan->parts[worker];
+  capture_file  *cf = plan->cf;
+  wtap_rec      *rec;
+  const guchar  *pd;
+  gint64         data_offset;
+  int            err;
+  gchar         *err_info;
+
+  worker_chunk = wtap_chunk_open(cf->filename, part->start, part->end,
+                                 &err, &err_info);
+  if (worker_chunk == NULL) {
+    cfile_open_failure_message("TShark", cf->filename, err, err_info);
+    return FALSE;
+  }
+
+  /* Dissect the chunk's records as the file's; the chunk's reader also
+     has the interface descriptions it reads. */
+  cf->provider.wth = wtap_chunk_wtap(worker_chunk);
+  wtap_set_cb_new_ipv4(cf->provider.wth, add_ipv4_name);
+  wtap_set_cb_new_ipv6(cf->provider.wth, (wtap_new_ipv6_callback_t) add_ipv6_name);
+  wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
+
+  /* Number and time the frames following those of the chunks before.
+     With a display filter, which of those were displayed isn't known,
+     so the displayed frames are counted from the start of the chunk. */
+  cf->count = part->first_frame - 1;
+  if (cf->count != 0) {
+    ref_frame.num = 1;
+    ref_frame.abs_ts = plan->ref_ts;
+    cf->provider.ref = &ref_frame;
+    prev_cap_frame.num = cf->count;
+    prev_cap_frame.abs_ts = part->prev_ts;
+    cf->provider.prev_cap = &prev_cap_frame;
+    if (cf->dfcode == NULL) {
+      prev_dis_frame = prev_cap_frame;
+      cf->provider.prev_dis = &prev_dis_frame;
+      cum_bytes = part->cum_bytes;
+    }
+  }
+
+  while (read_next_record(cf, &rec, &pd, &data_offset, &err, &err_info))
+    process_packet_single_pass(cf, plan->edt, data_offset, rec, pd,
+                               plan->tap_flags);
+  if (err != 0) {
+    cfile_read_failure_message("TShark", cf->filename, err, err_info);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Do the only pass of a one-pass analysis in workers, if the file can be
+ * split up for them.
+ *
+ * @return FALSE if it can't be, and the file has to be read through;
+ * otherwise TRUE, with *success set to FALSE if a worker failed.
+ */
+static gboolean
+process_chunks_in_workers(capture_file *cf, epan_dissect_t *edt,
+                          guint tap_flags, gboolean *success)
+{
+  worker_plan_t plan;
+  guint         num_parts;
+  int           err;
+
+  plan.parts = plan_chunk_workers(cf, &num_parts, &plan.ref_ts);
+  if (plan.parts == NULL)
+    return FALSE;
+  plan.cf = cf;
+  plan.edt = edt;
+  plan.tap_flags = tap_flags;
+
+  tshark_debug("tshark: dissecting %u chunks in workers", num_parts);
+  if (!dissect_workers_run(num_parts, dissect_chunk_worker, &plan, &err)) {
+    if (err != 0)
+      cmdarg_err("The packets couldn't be dissected in workers: %s.",
+                 g_strerror(err));
+    *success = FALSE;
+  }
+  cf->count = plan.parts[num_parts - 1].first_frame - 1 +
+              plan.parts[num_parts - 1].count;
+  g_free(plan.parts);
+  return TRUE;
+}
+
+/*
+ * Split the frames found by the first pass of a two-pass analysis among
+ * the workers for the second pass.  Returns NULL if there are too few
+ * frames to split, or if the file can't be opened again, by each worker,
+ * for reading at random.
+ */
+static worker_part_t *
+plan_frame_workers(capture_file *cf, guint *num_parts)
+{
+  worker_part_t *parts;
+  frame_data    *fdata;
+  frame_data    *prev_dis = NULL;
+  guint          n, i;
+  guint32        framenum;
+
+  n = MIN(workers_requested, cf->count);
+  if (n < 2)
+    return NULL;
+  if (strcmp(cf->filename, "-") == 0 || test_for_fifo(cf->filename) != 0)
+    return NULL;
+
+  parts = g_new0(worker_part_t, n);
+  for (i = 0; i < n; i++) {
+    parts[i].first_frame = (guint32)((guint64)cf->count * i / n) + 1;
+    parts[i].last_frame = (guint32)((guint64)cf->count * (i + 1) / n);
+  }
+
+  /* The frame the second pass would have displayed before each part is
+     taken to be the last one before it that the display filter matched
+     on the first pass. */
+  for (i = 0, framenum = 1; i < n; i++) {
+    for (; framenum < parts[i].first_frame; framenum++) {
+      fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+      if (cf->dfcode == NULL || fdata->flags.passed_dfilter)
+        prev_dis = fdata;
+    }
+    parts[i].prev_dis = prev_dis;
+  }
+  *num_parts = n;
+  return parts;
+}
+
+/*
+ * The work of a worker in a two-pass analysis: do the second pass over
+ * a range of frames.
+ */
+static gboolean
+dissect_frames_worker(guint worker, gpointer data)
+{
+  worker_plan_t *plan = (worker_plan_t *)data;
+  worker_part_t *part = &plan->parts[worker];
+  capture_file  *cf = plan->cf;
+  frame_data    *fdata;
+  guint32        framenum;
+  wtap_rec       rec;
+  Buffer         buf;
+  int            err = 0;
+  gchar         *err_info = NULL;
+
+  /* The descriptor we were forked with shares its file position with
+     the other workers', so read with one of our own. */
+  wtap_fdclose(cf->provider.wth);
+  if (!wtap_fdreopen(cf->provider.wth, cf->filename, &err)) {
+    cfile_open_failure_message("TShark", cf->filename, err, NULL);
+    return FALSE;
+  }
+
+  cf->provider.prev_dis = part->prev_dis;
+  cf->provider.prev_cap = part->first_frame > 1 ?
+      frame_data_sequence_find(cf->provider.frames, part->first_frame - 1) : NULL;
+
+  wtap_rec_init(&rec);
+  ws_buffer_init(&buf, 1500);
+  for (framenum = part->first_frame; err == 0 && framenum <= part->last_frame; framenum++) {
+    fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+    if (wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, &err,
+                       &err_info))
+      process_packet_second_pass(cf, plan->edt, fdata, &rec,
+                                 ws_buffer_start_ptr(&buf), plan->tap_flags);
+  }
+  wtap_rec_cleanup(&rec);
+  ws_buffer_free(&buf);
+  if (err != 0) {
+    cfile_read_failure_message("TShark", cf->filename, err, err_info);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/*
+ * Do the second pass of a two-pass analysis in workers, if there are
+ * enough frames.
+ *
+ * @return FALSE if there aren't, and the second pass has to be done
+ * here; otherwise TRUE, with *success set to FALSE if a worker failed.
+ */
+static gboolean
+process_frames_in_workers(capture_file *cf, epan_dissect_t *edt,
+                          guint tap_flags, gboolean *success)
+{
+  worker_plan_t plan;
+  guint         num_parts;
+  int           err;
+
+  plan.parts = plan_frame_workers(cf, &num_parts);
+  if (plan.parts == NULL)
+    return FALSE;
+  plan.cf = cf;
+  plan.edt = edt;
+  plan.tap_flags = tap_flags;
+  nstime_set_zero(&plan.ref_ts);
+
+  tshark_debug("tshark: doing the second pass in %u workers", num_parts);
+  if (!dissect_workers_run(num_parts, dissect_frames_worker, &plan, &err)) {
+    if (err != 0)
+      cmdarg_err("The packets couldn't be dissected in workers: %s.",
+                 g_strerror(err));
+    *success = FALSE;
+  }
+  g_free(plan.parts);
+  return TRUE;
+}
+#endif /* _WIN32 */
+
 static gboolean
 process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     gboolean out_file_name_res, int max_packet_count, gint64 max_byte_count)
@@ -3094,6 +3927,8 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
   wtap_dump_params params = WTAP_DUMP_PARAMS_INIT;
   wtap_rec     rec;
   Buffer       buf;
+  wtap_rec    *rec_ptr;
+  const guchar *pd;
   epan_dissect_t *edt = NULL;
   char        *shb_user_appl;
 
@@ -3112,10 +3947,10 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
     tshark_debug("tshark: writing format type %d, to %s", out_file_type, save_file);
     if (strcmp(save_file, "-") == 0) {
       /* Write to the standard output. */
-      pdh = wtap_dump_open_stdout(out_file_type, WTAP_UNCOMPRESSED, &params,
+      pdh = wtap_dump_open_stdout(out_file_type, out_compression_type, &params,
                                   &err);
     } else {
-      pdh = wtap_dump_open(save_file, out_file_type, WTAP_UNCOMPRESSED, &params,
+      pdh = wtap_dump_open(save_file, out_file_type, out_compression_type, &params,
                            &err);
     }
 
@@ -3175,13 +4010,13 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
 
       /* We're not going to display the protocol tree on this pass,
          so it's not going to be "visible". */
-      edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
+      edt = new_edt(cf, create_proto_tree, FALSE);
     }
 
     tshark_debug("tshark: reading records for first pass");
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
-      if (process_packet_first_pass(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
-                                    wtap_get_buf_ptr(cf->provider.wth))) {
+    start_prefetch(cf);
+    while (read_next_record(cf, &rec_ptr, &pd, &data_offset, &err, &err_info)) {
+      if (process_packet_first_pass(cf, edt, data_offset, rec_ptr, pd)) {
         /* Stop reading if we have the maximum number of packets;
          * When the -c option has not been used, max_packet_count
          * starts at 0, which practically means, never stop reading.
@@ -3196,6 +4031,8 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
       }
     }
 
+    stop_prefetch(cf);
+
     /*
      * If we got a read error on the first pass, remember the error, so
      * but do the second pass, so we can at least process the packets we
@@ -3254,7 +4091,7 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
          printing packet details, which is true if we're printing stuff
          ("print_packet_info" is true) and we're in verbose mode
          ("packet_details" is true). */
-      edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+      edt = new_edt(cf, create_proto_tree, print_packet_info && print_details);
     }
 
     /*
@@ -3263,35 +4100,56 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
      */
     set_resolution_synchrony(TRUE);
 
-    for (framenum = 1; err == 0 && framenum <= cf->count; framenum++) {
-      fdata = frame_data_sequence_find(cf->provider.frames, framenum);
-      if (wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, &err,
-                         &err_info)) {
-        tshark_debug("tshark: invoking process_packet_second_pass() for frame #%d", framenum);
-        if (process_packet_second_pass(cf, edt, fdata, &rec, &buf,
-                                       tap_flags)) {
-          /* Either there's no read filtering or this packet passed the
-             filter, so, if we're writing to a capture file, write
-             this packet out. */
-          if (pdh != NULL) {
-            tshark_debug("tshark: writing packet #%d to outfile", framenum);
-            if (!wtap_dump(pdh, &rec, ws_buffer_start_ptr(&buf), &err, &err_info)) {
-              /* Error writing to a capture file */
-              tshark_debug("tshark: error writing to a capture file (%d)", err);
-
-              /* Report the error.
-                 XXX - framenum is not necessarily the frame number in
-                 the input file if there was a read filter. */
-              cfile_write_failure_message("TShark", cf->filename, save_file,
-                                          err, err_info, framenum,
-                                          out_file_type);
-              wtap_dump_close(pdh, &err);
-              wtap_dump_params_cleanup(&params);
-              exit(2);
+#ifndef _WIN32
+    if (use_workers && pdh == NULL &&
+        process_frames_in_workers(cf, edt, tap_flags, &success)) {
+      /* The workers did the second pass over all the frames. */
+    } else
+#endif
+    {
+      start_prefetch_frames(cf);
+      for (framenum = 1; err == 0 && framenum <= cf->count; framenum++) {
+        gboolean read_ok;
+
+        fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+        if (prefetch != NULL) {
+          read_ok = record_prefetch_read(prefetch, &rec_ptr, &pd, &data_offset,
+                                         &err, &err_info);
+        } else {
+          read_ok = wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf,
+                                   &err, &err_info);
+          rec_ptr = &rec;
+          pd = ws_buffer_start_ptr(&buf);
+        }
+        if (read_ok) {
+          tshark_debug("tshark: invoking process_packet_second_pass() for frame #%d", framenum);
+          if (process_packet_second_pass(cf, edt, fdata, rec_ptr, pd,
+                                         tap_flags)) {
+            /* Either there's no read filtering or this packet passed the
+               filter, so, if we're writing to a capture file, write
+               this packet out. */
+            if (pdh != NULL) {
+              tshark_debug("tshark: writing packet #%d to outfile", framenum);
+              if (!wtap_dump(pdh, rec_ptr, pd, &err, &err_info)) {
+                /* Error writing to a capture file */
+                tshark_debug("tshark: error writing to a capture file (%d)", err);
+
+                /* Report the error.
+                   XXX - framenum is not necessarily the frame number in
+                   the input file if there was a read filter. */
+                cfile_write_failure_message("TShark", cf->filename, save_file,
+                                            err, err_info, framenum,
+                                            out_file_type);
+                wtap_dump_close(pdh, &err);
+                wtap_dump_params_cleanup(&params);
+                exit(2);
+              }
             }
           }
         }
       }
+
+      stop_prefetch(cf);
     }
 
     if (edt) {
@@ -3341,7 +4199,7 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
          printing packet details, which is true if we're printing stuff
          ("print_packet_info" is true) and we're in verbose mode
          ("packet_details" is true). */
-      edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+      edt = new_edt(cf, create_proto_tree, print_packet_info && print_details);
     }
 
     /*
@@ -3351,42 +4209,53 @@ process_cap_file(capture_file *cf, char *save_file, int out_file_type,
      */
     set_resolution_synchrony(TRUE);
 
-    while (wtap_read(cf->provider.wth, &err, &err_info, &data_offset)) {
-      framenum++;
+#ifndef _WIN32
+    if (use_workers && pdh == NULL && max_packet_count == 0 && max_byte_count == 0 &&
+        process_chunks_in_workers(cf, edt, tap_flags, &success)) {
+      /* The workers dissected and printed all the packets. */
+    } else
+#endif
+    {
+      start_prefetch(cf);
+      while (read_next_record(cf, &rec_ptr, &pd, &data_offset, &err, &err_info)) {
+        framenum++;
 
-      tshark_debug("tshark: processing packet #%d", framenum);
+        tshark_debug("tshark: processing packet #%d", framenum);
 
-      reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
+        reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
 
-      if (process_packet_single_pass(cf, edt, data_offset, wtap_get_rec(cf->provider.wth),
-                                     wtap_get_buf_ptr(cf->provider.wth), tap_flags)) {
-        /* Either there's no read filtering or this packet passed the
-           filter, so, if we're writing to a capture file, write
-           this packet out. */
-        if (pdh != NULL) {
-          tshark_debug("tshark: writing packet #%d to outfile", framenum);
-          if (!wtap_dump(pdh, wtap_get_rec(cf->provider.wth), wtap_get_buf_ptr(cf->provider.wth), &err, &err_info)) {
-            /* Error writing to a capture file */
-            tshark_debug("tshark: error writing to a capture file (%d)", err);
-            cfile_write_failure_message("TShark", cf->filename, save_file,
-                                        err, err_info, framenum, out_file_type);
-            wtap_dump_close(pdh, &err);
-            wtap_dump_params_cleanup(&params);
-            exit(2);
+        if (process_packet_single_pass(cf, edt, data_offset, rec_ptr, pd,
+                                       tap_flags)) {
+          /* Either there's no read filtering or this packet passed the
+             filter, so, if we're writing to a capture file, write
+             this packet out. */
+          if (pdh != NULL) {
+            tshark_debug("tshark: writing packet #%d to outfile", framenum);
+            if (!wtap_dump(pdh, rec_ptr, pd, &err, &err_info)) {
+              /* Error writing to a capture file */
+              tshark_debug("tshark: error writing to a capture file (%d)", err);
+              cfile_write_failure_message("TShark", cf->filename, save_file,
+                                          err, err_info, framenum, out_file_type);
+              wtap_dump_close(pdh, &err);
+              wtap_dump_params_cleanup(&params);
+              exit(2);
+            }
           }
         }
+        /* Stop reading if we have the maximum number of packets;
+         * When the -c option has not been used, max_packet_count
+         * starts at 0, which practically means, never stop reading.
+         * (unless we roll over max_packet_count ?)
+         */
+        if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
+          tshark_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
+                        max_packet_count, data_offset, max_byte_count);
+          err = 0; /* This is not an error */
+          break;
+        }
       }
-      /* Stop reading if we have the maximum number of packets;
-       * When the -c option has not been used, max_packet_count
-       * starts at 0, which practically means, never stop reading.
-       * (unless we roll over max_packet_count ?)
-       */
-      if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
-        tshark_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
-                      max_packet_count, data_offset, max_byte_count);
-        err = 0; /* This is not an error */
-        break;
-      }
+
+      stop_prefetch(cf);
     }
 
     if (edt) {
@@ -3501,6 +4370,11 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    /* If the fields to write are taken from a tree that isn't visible,
+       prime the epan_dissect_t with them. */
+    if (prune_dissection && output_action == WRITE_FIELDS)
+      output_fields_prime_edt(output_fields, edt);
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
@@ -3520,18 +4394,25 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
       cf->provider.ref = &ref_frame;
     }
 
-    if (dissect_color) {
-      color_filters_prime_edt(edt);
-      fdata.flags.need_colorize = 1;
-    }
+    if (use_prefilter && rec->rec_type == REC_TYPE_PACKET &&
+        !dfilter_prefilter_data(cf->dfcode, pd, fdata.cap_len)) {
+      /* The display filter can't match this frame's bytes, so don't
+         bother dissecting it. */
+      passed = FALSE;
+    } else {
+      if (dissect_color) {
+        color_filters_prime_edt(edt);
+        fdata.flags.need_colorize = 1;
+      }
 
-    epan_dissect_run_with_taps(edt, cf->cd_t, rec,
-                               frame_tvbuff_new(&cf->provider, &fdata, pd),
-                               &fdata, cinfo);
+      epan_dissect_run_with_taps(edt, cf->cd_t, rec,
+                                 frame_tvbuff_new(&cf->provider, &fdata, pd),
+                                 &fdata, cinfo);
 
-    /* Run the filter if we have it. */
-    if (cf->dfcode)
-      passed = dfilter_apply_edt(cf->dfcode, edt);
+      /* Run the filter if we have it. */
+      if (cf->dfcode)
+        passed = dfilter_apply_edt(cf->dfcode, edt);
+    }
   }
 
   if (passed) {
@@ -446,6 +446,8 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
         /* Attempt to open the capture file and set up to read from it. */
         switch(cf_open((capture_file *)cap_session->cf, capture_opts->save_file, WTAP_TYPE_AUTO, is_tempfile, &err)) {
             case CF_OK:
+                /* dumpcap is still writing the file, so don't map it. */
+                wtap_disable_mapping(((capture_file *)cap_session->cf)->provider.wth);
                 break;
             case CF_ERROR:
                 /* Don't unlink (delete) the save file - leave it around,
@@ -58,13 +58,13 @@ populate_html_table(gpointer data, gpointer user_data)
     wmem_free(NULL, tmp);
 }
 
-const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString table_name, wmem_map_t *hash_table)
+const QString ConversationHashTablesDialog::hashTableToHtmlTable(const QString table_name, conversation_hashtable_t *hash_table)
 {
     wmem_list_t *conversation_keys = NULL;
     guint num_keys = 0;
     if (hash_table)
     {
-        conversation_keys = wmem_map_get_keys(NULL, hash_table);
+        conversation_keys = conversation_hashtable_get_keys(NULL, hash_table);
         num_keys = wmem_list_count(conversation_keys);
     }
 
@@ -11,7 +11,7 @@
 #define CONVERSATION_HASH_TABLES_DIALOG_H
 
 #include "geometry_state_dialog.h"
-#include <epan/wmem/wmem.h>
+#include <epan/conversation.h>
 
 namespace Ui {
 class ConversationHashTablesDialog;
@@ -28,7 +28,7 @@ public:
 private:
     Ui::ConversationHashTablesDialog *ui;
 
-    const QString hashTableToHtmlTable(const QString table_name, wmem_map_t *hash_table);
+    const QString hashTableToHtmlTable(const QString table_name, conversation_hashtable_t *hash_table);
 };
 
 #endif // CONVERSATION_HASH_TABLES_DIALOG_H
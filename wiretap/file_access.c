@@ -15,6 +15,7 @@
 
 #include <wsutil/file_util.h>
 #include <wsutil/tempfile.h>
+#include <wsutil/cwstream.h>
 
 #include "wtap-int.h"
 #include "file_wrappers.h"
@@ -727,13 +728,30 @@ heuristic_uses_extension(unsigned int i, const char *extension)
 	return FALSE;	/* it's not one of them */
 }
 
+/*
+ * Whether pipes and the standard input may be opened for random access,
+ * by copying them to a temporary file.
+ */
+static gboolean pipe_spill = FALSE;
+
+void
+wtap_set_pipe_spill(gboolean spill)
+{
+	pipe_spill = spill;
+}
+
 /* Opens a file and prepares a wtap struct.
    If "do_random" is TRUE, it opens the file twice; the second open
    allows the application to do random-access I/O without moving
    the seek offset for sequential I/O, which is used by Wireshark
    so that it can do sequential I/O to a capture file that's being
    written to as new packets arrive independently of random I/O done
-   to display protocol trees for packets when they're selected. */
+   to display protocol trees for packets when they're selected.
+
+   Pipes and the standard input can only be opened for random access
+   if wtap_set_pipe_spill() has been called; what's read from them is
+   then copied to a temporary file, and the random-access stream reads
+   that. */
 wtap *
 wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_info,
 		  gboolean do_random)
@@ -744,6 +762,9 @@ wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_
 	wtap	*wth;
 	unsigned int	i;
 	gboolean use_stdin = FALSE;
+	gboolean spill = FALSE;
+	int	spill_fd;
+	char	*spill_path;
 	gchar *extension;
 	wtap_block_t shb;
 
@@ -777,10 +798,16 @@ wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_
 		 * if possible, so at least some file types can be
 		 * opened from pipes, so we don't completely disallow opens
 		 * of pipes.
+		 *
+		 * If we've been asked to, we copy the pipe to a temporary
+		 * file as it's read, and do random access to that.
 		 */
 		if (do_random) {
-			*err = WTAP_ERR_RANDOM_OPEN_PIPE;
-			return NULL;
+			if (!pipe_spill) {
+				*err = WTAP_ERR_RANDOM_OPEN_PIPE;
+				return NULL;
+			}
+			spill = TRUE;
 		}
 		ispipe = TRUE;
 	} else if (S_ISDIR(statb.st_mode)) {
@@ -801,11 +828,15 @@ wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_
 	 * they have different file positions.  If we're opening the
 	 * standard input, we can only dup it to get additional
 	 * descriptors, so we can't have two independent descriptors,
-	 * and thus can't do random access.
+	 * and thus can't do random access - unless we copy it to a
+	 * temporary file as it's read.
 	 */
 	if (use_stdin && do_random) {
-		*err = WTAP_ERR_RANDOM_OPEN_STDIN;
-		return NULL;
+		if (!pipe_spill) {
+			*err = WTAP_ERR_RANDOM_OPEN_STDIN;
+			return NULL;
+		}
+		spill = TRUE;
 	}
 
 	errno = ENOMEM;
@@ -847,7 +878,26 @@ wtap_open_offline(const char *filename, unsigned int type, int *err, char **err_
 		}
 	}
 
-	if (do_random) {
+	if (spill) {
+		spill_fd = create_tempfile(&spill_path, "wireshark_spill", NULL);
+		if (spill_fd == -1) {
+			*err = errno;
+			file_close(wth->fh);
+			g_free(wth);
+			return NULL;
+		}
+		/* The sequential stream now owns spill_fd, and closes it. */
+		file_set_spill(wth->fh, spill_fd);
+		wth->spill_path = g_strdup(spill_path);
+		if (!(wth->random_fh = file_open(wth->spill_path))) {
+			*err = errno;
+			file_close(wth->fh);
+			ws_unlink(wth->spill_path);
+			g_free(wth->spill_path);
+			g_free(wth);
+			return NULL;
+		}
+	} else if (do_random) {
 		if (!(wth->random_fh = file_open(filename))) {
 			*err = errno;
 			file_close(wth->fh);
@@ -2215,10 +2265,11 @@ wtap_dump_can_open(int file_type_subtype)
 	return TRUE;
 }
 
-#ifdef HAVE_ZLIB
 gboolean
 wtap_dump_can_compress(int file_type_subtype)
 {
+	GSList *compression_type_names;
+
 	/*
 	 * If this is an unknown file type, or if we have to
 	 * seek when writing out a file with this file type,
@@ -2228,15 +2279,11 @@ wtap_dump_can_compress(int file_type_subtype)
 	    || dump_open_table[file_type_subtype].writing_must_seek)
 		return FALSE;
 
-	return TRUE;
+	/* And can we write compressed files at all? */
+	compression_type_names = wtap_get_all_output_compression_type_names_list();
+	g_slist_free(compression_type_names);
+	return compression_type_names != NULL;
 }
-#else
-gboolean
-wtap_dump_can_compress(int file_type_subtype _U_)
-{
-	return FALSE;
-}
-#endif
 
 gboolean
 wtap_dump_has_name_resolution(int file_type_subtype)
@@ -2263,13 +2310,16 @@ wtap_dump_supports_comment_types(int file_type_subtype, guint32 comment_types)
 	return FALSE;
 }
 
-static gboolean wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int *err);
+static gboolean wtap_dump_open_check(int file_type_subtype, int encap,
+				     wtap_compression_type compression_type,
+				     int *err);
 static wtap_dumper* wtap_dump_alloc_wdh(int file_type_subtype, int encap, int snaplen,
 					wtap_compression_type compression_type,
 					int *err);
 static gboolean wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype,
 				      int *err);
 
+static gboolean wtap_dump_uses_cwstream(wtap_dumper *wdh);
 static WFILE_T wtap_dump_file_open(wtap_dumper *wdh, const char *filename);
 static WFILE_T wtap_dump_file_fdopen(wtap_dumper *wdh, int fd);
 static int wtap_dump_file_close(wtap_dumper *wdh);
@@ -2286,9 +2336,9 @@ wtap_dump_init_dumper(int file_type_subtype, wtap_compression_type compression_t
 	/* Check whether we can open a capture file with that file type
 	   and that encapsulation, and, if the compression type isn't
 	   "uncompressed", whether we can write a *compressed* file
-	   of that file type. */
+	   of that file type with that compression type. */
 	if (!wtap_dump_open_check(file_type_subtype, params->encap,
-	    (compression_type != WTAP_UNCOMPRESSED), err))
+	    compression_type, err))
 		return NULL;
 
 	/* Allocate a data structure for the output stream. */
@@ -2354,6 +2404,11 @@ wtap_dump_init_dumper(int file_type_subtype, wtap_compression_type compression_t
 	/* Set Decryption Secrets Blocks */
 	wdh->dsbs_initial = params->dsbs_initial;
 	wdh->dsbs_growing = params->dsbs_growing;
+	/* Write through a ws_cwstream even if we're not compressing? */
+	if (params->write_options != NULL) {
+		wdh->write_options = *params->write_options;
+		wdh->async_write = (compression_type == WTAP_UNCOMPRESSED);
+	}
 	return wdh;
 }
 
@@ -2520,7 +2575,8 @@ wtap_dump_open_stdout(int file_type_subtype, wtap_compression_type compression_t
 }
 
 static gboolean
-wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int *err)
+wtap_dump_open_check(int file_type_subtype, int encap,
+    wtap_compression_type compression_type, int *err)
 {
 	if (!wtap_dump_can_open(file_type_subtype)) {
 		/* Invalid type, or type we don't know how to write. */
@@ -2543,8 +2599,12 @@ wtap_dump_open_check(int file_type_subtype, int encap, gboolean compressed, int
 	if (*err != 0)
 		return FALSE;
 
-	/* if compression is wanted, do we support this for this file_type_subtype? */
-	if(compressed && !wtap_dump_can_compress(file_type_subtype)) {
+	/* if compression is wanted, do we support this for this file_type_subtype,
+	   and do we support that type of compression? */
+	if (compression_type != WTAP_UNCOMPRESSED &&
+	    (!wtap_dump_can_compress(file_type_subtype) ||
+	     compression_type == WTAP_UNKNOWN_COMPRESSION ||
+	     wtap_compression_type_extension(compression_type) == NULL)) {
 		*err = WTAP_ERR_COMPRESSION_NOT_SUPPORTED;
 		return FALSE;
 	}
@@ -2582,7 +2642,7 @@ wtap_dump_open_finish(wtap_dumper *wdh, int file_type_subtype, int *err)
 
 	/* Can we do a seek on the file descriptor?
 	   If not, note that fact. */
-	if (wdh->compression_type != WTAP_UNCOMPRESSED) {
+	if (wdh->compression_type != WTAP_UNCOMPRESSED || wdh->async_write) {
 		cant_seek = TRUE;
 	} else {
 		fd = ws_fileno((FILE *)wdh->fh);
@@ -2627,13 +2687,25 @@ wtap_dump(wtap_dumper *wdh, const wtap_rec *rec,
 void
 wtap_dump_flush(wtap_dumper *wdh)
 {
+	int err;
+
+	if (wtap_dump_uses_cwstream(wdh)) {
+		/* Errors are reported by the next write or the close. */
+		(void)ws_cwstream_flush((ws_cwstream *)wdh->fh, &err);
+		return;
+	}
+
+	switch (wdh->compression_type) {
+
 #ifdef HAVE_ZLIB
-	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
+	case WTAP_GZIP_COMPRESSED:
 		gzwfile_flush((GZWFILE_T)wdh->fh);
-	} else
+		break;
 #endif
-	{
+
+	default:
 		fflush((FILE *)wdh->fh);
+		break;
 	}
 }
 
@@ -2699,43 +2771,87 @@ gboolean wtap_dump_get_needs_reload(wtap_dumper *wdh) {
         return wdh->needs_reload;
 }
 
+/* is fh a ws_cwstream rather than a FILE * or a GZWFILE_T? */
+static gboolean
+wtap_dump_uses_cwstream(wtap_dumper *wdh)
+{
+	return wdh->async_write ||
+	    wdh->compression_type == WTAP_ZSTD_COMPRESSED ||
+	    wdh->compression_type == WTAP_LZ4_COMPRESSED;
+}
+
+/* the type of stream the frames of a compression type are written with */
+static ws_cwstream_type
+wtap_dump_cwstream_type(wtap_compression_type compression_type)
+{
+	switch (compression_type) {
+
+	case WTAP_ZSTD_COMPRESSED:
+		return WS_CWSTREAM_ZSTD;
+
+	case WTAP_LZ4_COMPRESSED:
+		return WS_CWSTREAM_LZ4;
+
+	default:
+		return WS_CWSTREAM_NONE;
+	}
+}
+
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
 static WFILE_T
 wtap_dump_file_open(wtap_dumper *wdh, const char *filename)
 {
-	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
+	int fd;
+	ws_cwstream *stream;
+	int save_errno;
+
+	if (wtap_dump_uses_cwstream(wdh)) {
+		fd = ws_open(filename, O_BINARY|O_WRONLY|O_CREAT|O_TRUNC, 0666);
+		if (fd == -1)
+			return NULL;
+		stream = ws_cwstream_fdopen(fd,
+		    wtap_dump_cwstream_type(wdh->compression_type),
+		    &wdh->write_options);
+		if (stream == NULL) {
+			save_errno = errno;
+			ws_close(fd);
+			errno = save_errno;
+		}
+		return stream;
+	}
+
+	switch (wdh->compression_type) {
+
+#ifdef HAVE_ZLIB
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_open(filename);
-	} else {
+#endif
+
+	default:
 		return ws_fopen(filename, "wb");
 	}
 }
-#else
-static WFILE_T
-wtap_dump_file_open(wtap_dumper *wdh _U_, const char *filename)
-{
-	return ws_fopen(filename, "wb");
-}
-#endif
 
 /* internally open a file for writing (compressed or not) */
-#ifdef HAVE_ZLIB
 static WFILE_T
 wtap_dump_file_fdopen(wtap_dumper *wdh, int fd)
 {
-	if (wdh->compression_type == WTAP_GZIP_COMPRESSED) {
+	if (wtap_dump_uses_cwstream(wdh))
+		return ws_cwstream_fdopen(fd,
+		    wtap_dump_cwstream_type(wdh->compression_type),
+		    &wdh->write_options);
+
+	switch (wdh->compression_type) {
+
+#ifdef HAVE_ZLIB
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_fdopen(fd);
-	} else {
+#endif
+
+	default:
 		return ws_fdopen(fd, "wb");
 	}
 }
-#else
-static WFILE_T
-wtap_dump_file_fdopen(wtap_dumper *wdh _U_, int fd)
-{
-	return ws_fdopen(fd, "wb");
-}
-#endif
 
 /* internally writing raw bytes (compressed or not) */
 gboolean
@@ -2755,6 +2871,10 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 		}
 	} else
 #endif
+	if (wtap_dump_uses_cwstream(wdh)) {
+		if (!ws_cwstream_write((ws_cwstream *)wdh->fh, buf, bufsize, err))
+			return FALSE;
+	} else
 	{
 		errno = WTAP_ERR_CANT_WRITE;
 		nwritten = fwrite(buf, 1, bufsize, (FILE *)wdh->fh);
@@ -2777,23 +2897,38 @@ wtap_dump_file_write(wtap_dumper *wdh, const void *buf, size_t bufsize, int *err
 static int
 wtap_dump_file_close(wtap_dumper *wdh)
 {
+	int err;
+
+	if (wtap_dump_uses_cwstream(wdh)) {
+		if (!ws_cwstream_close((ws_cwstream *)wdh->fh, &err)) {
+			errno = err;
+			return EOF;
+		}
+		return 0;
+	}
+
+	switch (wdh->compression_type) {
+
 #ifdef HAVE_ZLIB
-	if (wdh->compression_type == WTAP_GZIP_COMPRESSED)
+	case WTAP_GZIP_COMPRESSED:
 		return gzwfile_close((GZWFILE_T)wdh->fh);
-	else
 #endif
+
+	default:
 		return fclose((FILE *)wdh->fh);
+	}
 }
 
 gint64
 wtap_dump_file_seek(wtap_dumper *wdh, gint64 offset, int whence, int *err)
 {
-#ifdef HAVE_ZLIB
 	if (wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
+	} else if (wdh->async_write) {
+		*err = WTAP_ERR_CANT_SEEK;
+		return -1;
 	} else
-#endif
 	{
 		if (-1 == ws_fseek64((FILE *)wdh->fh, offset, whence)) {
 			*err = errno;
@@ -2809,12 +2944,13 @@ gint64
 wtap_dump_file_tell(wtap_dumper *wdh, int *err)
 {
 	gint64 rval;
-#ifdef HAVE_ZLIB
 	if (wdh->compression_type != WTAP_UNCOMPRESSED) {
 		*err = WTAP_ERR_CANT_SEEK_COMPRESSED;
 		return -1;
+	} else if (wdh->async_write) {
+		*err = WTAP_ERR_CANT_SEEK;
+		return -1;
 	} else
-#endif
 	{
 		if (-1 == (rval = ws_ftell64((FILE *)wdh->fh))) {
 			*err = errno;
@@ -27,6 +27,15 @@
 #include <zlib.h>
 #endif /* HAVE_ZLIB */
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4.h>
+#include <lz4frame.h>
+#endif /* HAVE_LZ4FRAME_H */
+
 /*
  * See RFC 1952:
  *
@@ -34,6 +43,27 @@
  *
  * for a description of the gzip file format.
  *
+ * See RFC 8878:
+ *
+ *      https://tools.ietf.org/html/rfc8878
+ *
+ * for a description of the Zstandard file format, and
+ *
+ *      https://github.com/lz4/lz4/blob/dev/doc/lz4_Frame_format.md
+ *
+ * for a description of the LZ4 frame format.  Both are sequences of
+ * frames that can each be decompressed on their own, so the start of
+ * each frame is a fast seek point.
+ *
+ * A gzip file can also be a sequence of members that can each be
+ * decompressed on their own; BGZF files, for example, are made of
+ * members of at most 64 KB, each of which has its size in a "BC"
+ * subfield of its header's extra field.  See:
+ *
+ *      https://samtools.github.io/hts-specs/SAMv1.pdf
+ *
+ * for a description of BGZF.
+ *
  * Some other compressed file formats we might want to support:
  *
  *      XZ format: http://tukaani.org/xz/
@@ -49,21 +79,25 @@
 static struct compression_type {
     wtap_compression_type  type;
     const char            *extension;
+    const char            *name;
     const char            *description;
 } compression_types[] = {
 #ifdef HAVE_ZLIB
-    { WTAP_GZIP_COMPRESSED, "gz", "gzip compressed" },
+    { WTAP_GZIP_COMPRESSED, "gz", "gzip", "gzip compressed" },
+#endif
+#ifdef HAVE_ZSTD
+    { WTAP_ZSTD_COMPRESSED, "zst", "zstd", "Zstandard compressed" },
 #endif
-    { WTAP_UNCOMPRESSED, NULL, NULL }
+#ifdef HAVE_LZ4FRAME_H
+    { WTAP_LZ4_COMPRESSED, "lz4", "lz4", "LZ4 compressed" },
+#endif
+    { WTAP_UNCOMPRESSED, NULL, NULL, NULL }
 };
 
 wtap_compression_type
 wtap_get_compression_type(wtap *wth)
 {
-	gboolean is_compressed;
-
-	is_compressed = file_iscompressed((wth->fh == NULL) ? wth->random_fh : wth->fh);
-	return is_compressed ? WTAP_GZIP_COMPRESSED : WTAP_UNCOMPRESSED;
+	return file_get_compression_type((wth->fh == NULL) ? wth->random_fh : wth->fh);
 }
 
 const char *
@@ -102,16 +136,75 @@ wtap_get_all_compression_type_extensions_list(void)
 	return extensions;
 }
 
+wtap_compression_type
+wtap_name_to_compression_type(const char *name)
+{
+	if (strcmp(name, "none") == 0)
+		return WTAP_UNCOMPRESSED;
+	for (struct compression_type *p = compression_types;
+	    p->type != WTAP_UNCOMPRESSED; p++) {
+		if (strcmp(name, p->name) == 0)
+			return p->type;
+	}
+	return WTAP_UNKNOWN_COMPRESSION;
+}
+
+/*
+ * Everything we can read, we can also write.
+ */
+GSList *
+wtap_get_all_output_compression_type_names_list(void)
+{
+	GSList *names;
+
+	names = NULL;	/* empty list, to start with */
+
+	for (struct compression_type *p = compression_types;
+	    p->type != WTAP_UNCOMPRESSED; p++)
+		names = g_slist_append(names, (gpointer)p->name);
+
+	return names;
+}
+
 /* #define GZBUFSIZE 8192 */
 #define GZBUFSIZE 4096
 
+/*
+ * Uncompressed files are read through a memory mapping of the file,
+ * rather than copied into the output buffer, where there's enough
+ * address space for that.  Not on Windows, where a file that's mapped
+ * can't be renamed or removed, as saving over it does.
+ */
+#if GLIB_SIZEOF_VOID_P >= 8 && !defined(_WIN32)
+#define WTAP_READ_MAPPED
+#if defined(__linux__)
+#include <sys/vfs.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/param.h>
+#include <sys/mount.h>
+#endif
+#endif
+
+/*
+ * How much of a mapping the output buffer covers at a time; it has
+ * to fit in a guint.
+ */
+#define MAPPED_WINDOW G_GINT64_CONSTANT(1073741824)
+
 /* values for wtap_reader compression */
 typedef enum {
     UNKNOWN,       /* unknown - look for a gzip header */
     UNCOMPRESSED,  /* uncompressed - copy input directly */
 #ifdef HAVE_ZLIB
     ZLIB,          /* decompress a zlib stream */
-    GZIP_AFTER_HEADER
+    GZIP_AFTER_HEADER,
+    GZIP_MEMBERS,  /* decompress gzip members on a pool of threads */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD,          /* decompress a Zstandard frame */
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    LZ4,           /* decompress an LZ4 frame */
 #endif
 } compression_t;
 
@@ -131,10 +224,12 @@ struct wtap_reader {
     struct wtap_reader_buf out; /* output buffer, containing uncompressed data */
 
     gboolean eof;               /* TRUE if end of input file reached */
+    gboolean flush_pending;     /* TRUE if the decompressor has output left without more input */
     gint64 start;               /* where the gzip data started, for rewinding */
     gint64 raw;                 /* where the raw data started, for seeking */
     compression_t compression;  /* type of compression, if any */
     gboolean is_compressed;     /* FALSE if completely uncompressed, TRUE otherwise */
+    wtap_compression_type compression_type; /* the first compression found, if any */
 
     /* seek request */
     gint64 skip;                /* amount to skip (already rewound if backwards) */
@@ -148,10 +243,30 @@ struct wtap_reader {
     /* zlib inflate stream */
     z_stream strm;              /* stream structure in-place (not a pointer) */
     gboolean dont_check_crc;    /* TRUE if we aren't supposed to check the CRC */
+
+    /* decompressing gzip members in parallel */
+    struct gz_members *members; /* the members being decompressed, or NULL */
+    gint64 members_skip;        /* offset of a member to decompress the usual way */
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;         /* Zstandard decompression context, or NULL */
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    LZ4F_decompressionContext_t lz4; /* LZ4 decompression context, or NULL */
 #endif
     /* fast seeking */
     GPtrArray *fast_seek;
     void *fast_seek_cur;
+    gboolean random_flag;       /* TRUE if this is the random-access stream */
+
+    /* reading an uncompressed file through a mapping */
+    GMappedFile *mapped;        /* mapping the output buffer points into, or NULL */
+    guint8 *out_buf;            /* the output buffer's own memory, while it does */
+    GSList *retired_mappings;   /* earlier mappings, that data may still be lent from */
+    gboolean never_map;         /* TRUE if the file may shrink, so mustn't be mapped */
+
+    /* copying what's read from a pipe, so it can be read again */
+    int spill_fd;               /* file descriptor to copy it to, or -1 */
 };
 
 /* Current read offset within a buffer. */
@@ -181,6 +296,13 @@ bytes_in_buffer(struct wtap_reader_buf *buf)
     return (guint)((buf->next + buf->avail) - buf->buf);
 }
 
+/* TRUE if there's no more input to generate output from. */
+static gboolean
+input_exhausted(FILE_T state)
+{
+    return state->eof && state->in.avail == 0 && !state->flush_pending;
+}
+
 /* Reset a buffer, discarding all data in the buffer, so we read into
    it starting at the beginning. */
 static void
@@ -190,6 +312,29 @@ buf_reset(struct wtap_reader_buf *buf)
     buf->avail = 0;
 }
 
+/*
+ * Copy raw data just read to the spill file, if there is one.  It's
+ * written straight away, rather than buffered, as the random-access
+ * stream may read it as soon as the records in it have been read.
+ */
+static gboolean
+spill_write(FILE_T state, const guint8 *data, ssize_t len)
+{
+    ssize_t ret;
+
+    while (len > 0) {
+        ret = ws_write(state->spill_fd, data, (unsigned int)len);
+        if (ret < 0) {
+            state->err = errno;
+            state->err_info = NULL;
+            return FALSE;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return TRUE;
+}
+
 static int
 buf_read(FILE_T state, struct wtap_reader_buf *buf)
 {
@@ -223,6 +368,8 @@ buf_read(FILE_T state, struct wtap_reader_buf *buf)
     }
     if (ret == 0)
         state->eof = TRUE;
+    else if (state->spill_fd != -1 && !spill_write(state, read_ptr, ret))
+        return -1;
     state->raw_pos += ret;
     buf->avail += ret;
     return 0;
@@ -240,6 +387,158 @@ fill_in_buffer(FILE_T state)
     return 0;
 }
 
+/* Get at least n bytes in the input buffer, unless the input ends
+   first, without discarding any of the ones that are there. */
+static int
+fill_in_buffer_to(FILE_T state, guint n)
+{
+    while (state->in.avail < n && !state->eof) {
+        if (state->in.next != state->in.buf) {
+            memmove(state->in.buf, state->in.next, state->in.avail);
+            state->in.next = state->in.buf;
+        }
+        if (fill_in_buffer(state) == -1)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+ * Point the output buffer at the part of the mapping that starts at
+ * the current position.
+ */
+static void
+map_window(FILE_T state)
+{
+    gint64 offset = state->start + state->pos;
+    gint64 len = (gint64)g_mapped_file_get_length(state->mapped);
+    guint8 *data = (guint8 *)g_mapped_file_get_contents(state->mapped);
+
+    /* The end of the mapping is only the end of the file if the file
+       hasn't grown since it was mapped; that's checked for, by trying
+       to map it again, before we get here with nothing left. */
+    if (offset >= len) {
+        state->out.buf = data + len;
+        state->out.next = state->out.buf;
+        state->out.avail = 0;
+        state->eof = TRUE;
+        return;
+    }
+    state->out.buf = data + offset;
+    state->out.next = state->out.buf;
+    state->out.avail = (guint)MIN(len - offset, MAPPED_WINDOW);
+    state->eof = FALSE;
+}
+
+#ifdef WTAP_READ_MAPPED
+/*
+ * Whether a file is on local storage.  A mapped file that's truncated
+ * under us kills us with SIGBUS when we touch the part that's gone, and
+ * a file on a network file system can be truncated by another host at
+ * any time, so only local files are mapped.  If we can't tell, assume
+ * the file isn't local.
+ */
+static gboolean
+fd_is_local(int fd)
+{
+#if defined(__linux__)
+    struct statfs sfs;
+
+    if (fstatfs(fd, &sfs) == -1)
+        return FALSE;
+    switch ((guint32)sfs.f_type) {
+
+    case 0x6969:        /* NFS_SUPER_MAGIC */
+    case 0x517B:        /* SMB_SUPER_MAGIC */
+    case 0xFF534D42:    /* CIFS_MAGIC_NUMBER */
+    case 0xFE534D42:    /* SMB2_MAGIC_NUMBER */
+    case 0x65735546:    /* FUSE_SUPER_MAGIC */
+    case 0x01021997:    /* V9FS_MAGIC */
+    case 0x00C36400:    /* CEPH_SUPER_MAGIC */
+    case 0x5346414F:    /* AFS_FS_MAGIC */
+        return FALSE;
+    }
+    return TRUE;
+#elif defined(MNT_LOCAL)
+    struct statfs sfs;
+
+    if (fstatfs(fd, &sfs) == -1)
+        return FALSE;
+    return (sfs.f_flags & MNT_LOCAL) != 0;
+#else
+    (void)fd;
+    return FALSE;
+#endif
+}
+#endif
+
+/*
+ * Map an uncompressed file, or map it again if it's grown since it was
+ * mapped, and point the output buffer into the mapping.  Returns FALSE,
+ * leaving everything as it was, if that can't be done.
+ */
+static gboolean
+map_file(FILE_T state)
+{
+#ifdef WTAP_READ_MAPPED
+    ws_statb64 st;
+    GMappedFile *mapped;
+
+    if (state->never_map)
+        return FALSE;
+    if (state->mapped == NULL && !fd_is_local(state->fd)) {
+        state->never_map = TRUE;
+        return FALSE;
+    }
+    if (ws_fstat64(state->fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size <= state->start + state->pos)
+        return FALSE;
+    if (state->mapped != NULL &&
+        (gint64)g_mapped_file_get_length(state->mapped) >= st.st_size)
+        return FALSE;
+    mapped = g_mapped_file_new_from_fd(state->fd, TRUE, NULL);
+    if (mapped == NULL)
+        return FALSE;
+
+    if (state->mapped != NULL) {
+        /* Packet data may still be lent out from the old mapping. */
+        state->retired_mappings = g_slist_prepend(state->retired_mappings,
+                                                  state->mapped);
+    } else {
+        /* Keep the output buffer for if we stop using a mapping. */
+        state->out_buf = state->out.buf;
+    }
+    state->mapped = mapped;
+    map_window(state);
+    return TRUE;
+#else
+    (void)state;
+    return FALSE;
+#endif
+}
+
+/*
+ * Stop reading through a mapping, and go back to reading the file
+ * descriptor at the current position.
+ */
+static void
+unmap_file(FILE_T state)
+{
+    if (state->mapped == NULL)
+        return;
+
+    state->retired_mappings = g_slist_prepend(state->retired_mappings,
+                                              state->mapped);
+    state->mapped = NULL;
+    state->out.buf = state->out_buf;
+    state->out_buf = NULL;
+    buf_reset(&state->out);
+    buf_reset(&state->in);
+    state->raw_pos = state->start + state->pos;
+    (void)ws_lseek64(state->fd, state->raw_pos, SEEK_SET);
+    state->eof = FALSE;
+}
+
 #define ZLIB_WINSIZE 32768
 
 struct fast_seek_point {
@@ -640,7 +939,586 @@ DIAG_ON(cast-qual)
         state->fast_seek_cur = NULL;
     }
 }
+
+/*
+ * Decompressing the members of a gzip file in parallel.
+ *
+ * The members are found by looking through the compressed data for
+ * headers; a BGZF member's header says where the next one starts, but
+ * for other members we look for the next thing that could be a header.
+ * That might be in the middle of a member rather than at its start, so a
+ * member is only used if it decompresses to the end of the data up to
+ * the next header, with the right CRC and length; if it doesn't, it's
+ * decompressed the usual way, which finds where it really ends, and the
+ * members after that are looked for again from there.  The same goes for
+ * members too big to be worth holding in memory.
+ */
+
+/* the most compressed or decompressed data a member can have */
+#define GZ_MEMBER_MAX_SIZE (2 * 1024 * 1024)
+
+/* how much compressed data to read at a time when looking for members */
+#define GZ_MEMBERS_READ_SIZE (256 * 1024)
+
+#define GZ_MEMBERS_MAX_THREADS 8
+
+struct gz_member {
+    gint64 start;           /* offset of its header in the file */
+    guint hdr_len;          /* length of its header */
+    guint8 *in;             /* its compressed data, after the header */
+    guint in_len;
+    guint8 *out;            /* its decompressed data */
+    guint out_len;
+    gboolean ok;            /* it decompressed to the end of its data */
+    gboolean done;          /* a thread is done with it */
+};
+
+struct gz_members {
+    GThreadPool *pool;
+    gboolean check_crc;
+    guint ahead;            /* the most members to decompress ahead */
+    guint used;             /* members used so far */
+
+    /* shared with the threads */
+    GMutex mutex;
+    GCond cond;             /* signalled when a member is done */
+
+    GQueue queue;           /* members handed to the pool, in file order */
+    struct gz_member *cur;  /* member the output buffer points into */
+    guint8 *out_buf;        /* the output buffer's own memory, meanwhile */
+
+    /* looking for members */
+    guint8 *scan;           /* compressed data from scan_start on */
+    gint64 scan_start;
+    guint scan_len;
+    gboolean scan_eof;      /* the end of the file has been read */
+    gboolean scan_done;     /* no more members are to be handed out */
+    gint64 next;            /* offset of the next member to hand out */
+};
+
+/*
+ * Look at what might be the header of a gzip member, of which len bytes
+ * are available.  Returns the length of the header, 0 if more of it is
+ * needed to tell, or -1 if it isn't one; *bgzf_size is set to the size
+ * of the member if it's a BGZF member, or 0 otherwise.
+ */
+static int
+gz_member_header(const guint8 *p, guint len, guint *bgzf_size)
+{
+    guint hdr_len, xlen, i, slen;
+    const guint8 *end;
+    guint8 flags;
+
+    *bgzf_size = 0;
+
+    /* ID1, ID2, CM (deflate) and FLG, without its reserved bits */
+    if ((len > 0 && p[0] != 31) || (len > 1 && p[1] != 139) ||
+        (len > 2 && p[2] != 8) || (len > 3 && (p[3] & 0xe0) != 0))
+        return -1;
+    if (len < 10)
+        return 0;
+    flags = p[3];
+    hdr_len = 10;
+
+    if (flags & 4) {
+        /* extra field */
+        if (len < hdr_len + 2)
+            return 0;
+        xlen = p[hdr_len] | (p[hdr_len + 1] << 8);
+        hdr_len += 2;
+        if (len < hdr_len + xlen)
+            return 0;
+        for (i = hdr_len; i + 4 <= hdr_len + xlen; i += 4 + slen) {
+            slen = p[i + 2] | (p[i + 3] << 8);
+            if (p[i] == 'B' && p[i + 1] == 'C' && slen == 2 &&
+                i + 6 <= hdr_len + xlen)
+                *bgzf_size = (p[i + 4] | (p[i + 5] << 8)) + 1;
+        }
+        hdr_len += xlen;
+    }
+    if (flags & 8) {
+        /* file name */
+        end = (const guint8 *)memchr(p + hdr_len, 0, len - hdr_len);
+        if (end == NULL)
+            return 0;
+        hdr_len = (guint)(end - p) + 1;
+    }
+    if (flags & 16) {
+        /* comment */
+        if (len <= hdr_len)
+            return 0;
+        end = (const guint8 *)memchr(p + hdr_len, 0, len - hdr_len);
+        if (end == NULL)
+            return 0;
+        hdr_len = (guint)(end - p) + 1;
+    }
+    if (flags & 2) {
+        /* header CRC */
+        hdr_len += 2;
+    }
+    if (len < hdr_len)
+        return 0;
+    return (int)hdr_len;
+}
+
+static void
+gz_member_free(struct gz_member *member)
+{
+    if (member == NULL)
+        return;
+    g_free(member->in);
+    g_free(member->out);
+    g_free(member);
+}
+
+/* Decompress a member, on one of the pool's threads. */
+static void
+gz_member_inflate(gpointer data, gpointer user_data)
+{
+    struct gz_member *member = (struct gz_member *)data;
+    struct gz_members *members = (struct gz_members *)user_data;
+    z_stream strm;
+    guint out_size;
+    guint8 *out;
+    const guint8 *trailer;
+    guint32 crc, len;
+    int ret = Z_OK;
+    gboolean ok = FALSE;
+
+    memset(&strm, 0, sizeof strm);
+    out_size = MIN(MAX(member->in_len * 4, 65536), GZ_MEMBER_MAX_SIZE);
+    member->out = (guint8 *)g_try_malloc(out_size);
+    if (member->out != NULL && member->in_len >= 8 &&
+        inflateInit2(&strm, -15) == Z_OK) {         /* raw inflate */
+        strm.next_in = member->in;
+        strm.avail_in = member->in_len;
+        strm.next_out = member->out;
+        strm.avail_out = out_size;
+        for (;;) {
+            ret = inflate(&strm, Z_NO_FLUSH);
+            if (ret != Z_OK || strm.avail_out != 0)
+                break;
+            /* It might not be done; make room for more. */
+            if (out_size == GZ_MEMBER_MAX_SIZE)
+                break;
+            out_size = MIN(out_size * 2, GZ_MEMBER_MAX_SIZE);
+            out = (guint8 *)g_try_realloc(member->out, out_size);
+            if (out == NULL)
+                break;
+            member->out = out;
+            strm.next_out = out + strm.total_out;
+            strm.avail_out = out_size - (guint)strm.total_out;
+        }
+
+        /* It has to end with its trailer, right before the next member. */
+        if (ret == Z_STREAM_END && strm.avail_in == 8) {
+            member->out_len = (guint)strm.total_out;
+            trailer = member->in + member->in_len - 8;
+            crc = pletoh32(trailer);
+            len = pletoh32(trailer + 4);
+            ok = len == member->out_len &&
+                 (!members->check_crc ||
+                  crc == crc32(crc32(0L, Z_NULL, 0), member->out, member->out_len));
+        }
+        inflateEnd(&strm);
+    }
+    g_free(member->in);
+    member->in = NULL;
+
+    g_mutex_lock(&members->mutex);
+    member->ok = ok;
+    member->done = TRUE;
+    g_cond_broadcast(&members->cond);
+    g_mutex_unlock(&members->mutex);
+}
+
+/*
+ * Read more of the file to look for members in, dropping what's before
+ * the next member.  Returns FALSE if nothing more can be read.
+ */
+static gboolean
+gz_members_read_more(FILE_T state)
+{
+    struct gz_members *members = state->members;
+    guint keep = (guint)(members->next - members->scan_start);
+    ssize_t ret;
+
+    if (members->scan_eof)
+        return FALSE;
+    if (keep != 0) {
+        memmove(members->scan, members->scan + keep, members->scan_len - keep);
+        members->scan_len -= keep;
+        members->scan_start = members->next;
+    }
+    ret = ws_read(state->fd, members->scan + members->scan_len,
+                  GZ_MEMBER_MAX_SIZE + GZ_MEMBERS_READ_SIZE - members->scan_len);
+    if (ret <= 0) {
+        /* An error is reported when it's read the usual way. */
+        members->scan_eof = TRUE;
+        return FALSE;
+    }
+    if (state->spill_fd != -1 &&
+        !spill_write(state, members->scan + members->scan_len, ret)) {
+        members->scan_eof = TRUE;
+        return FALSE;
+    }
+    state->raw_pos += ret;
+    members->scan_len += (guint)ret;
+    return TRUE;
+}
+
+/*
+ * Find the next member, and take its compressed data.  Returns NULL if
+ * there isn't one to decompress in parallel.
+ */
+static struct gz_member *
+gz_members_scan(FILE_T state)
+{
+    struct gz_members *members = state->members;
+    struct gz_member *member;
+    const guint8 *p, *q;
+    guint avail, member_len, search, bgzf_size, dummy;
+    int hdr_len, ret;
+
+    /* its header */
+    for (;;) {
+        p = members->scan + (members->next - members->scan_start);
+        avail = members->scan_len - (guint)(members->next - members->scan_start);
+        hdr_len = gz_member_header(p, avail, &bgzf_size);
+        if (hdr_len > 0)
+            break;
+        if (hdr_len < 0 || avail >= GZ_MEMBER_MAX_SIZE ||
+            !gz_members_read_more(state))
+            return NULL;
+    }
+
+    if (bgzf_size != 0) {
+        /* It says where it ends. */
+        member_len = bgzf_size;
+        while (avail < member_len) {
+            if (!gz_members_read_more(state))
+                return NULL;
+            p = members->scan + (members->next - members->scan_start);
+            avail = members->scan_len - (guint)(members->next - members->scan_start);
+        }
+    } else {
+        /* It ends where the next member starts, or at the end of the
+           file; the smallest deflate stream is 2 bytes, and it's
+           followed by an 8-byte trailer. */
+        search = hdr_len + 10;
+        for (;;) {
+            member_len = 0;
+            while (search < avail) {
+                q = (const guint8 *)memchr(p + search, 31, avail - search);
+                if (q == NULL) {
+                    search = avail;
+                    break;
+                }
+                search = (guint)(q - p);
+                ret = gz_member_header(q, avail - search, &dummy);
+                if (ret > 0) {
+                    member_len = search;
+                    break;
+                }
+                if (ret == 0 && !members->scan_eof)
+                    break;      /* need more to tell */
+                search++;
+            }
+            if (member_len != 0)
+                break;
+            if (avail >= GZ_MEMBER_MAX_SIZE)
+                return NULL;
+            if (!gz_members_read_more(state)) {
+                if (!members->scan_eof)
+                    return NULL;
+                if (search < avail)
+                    continue;   /* look at what was left, knowing it's the end */
+                member_len = avail;
+                break;
+            }
+            p = members->scan + (members->next - members->scan_start);
+            avail = members->scan_len - (guint)(members->next - members->scan_start);
+        }
+    }
+    if (member_len > GZ_MEMBER_MAX_SIZE || member_len < (guint)hdr_len + 8)
+        return NULL;
+
+    member = g_new0(struct gz_member, 1);
+    member->start = members->next;
+    member->hdr_len = hdr_len;
+    member->in_len = member_len - hdr_len;
+    member->in = (guint8 *)g_memdup(p + hdr_len, member->in_len);
+    members->next += member_len;
+    return member;
+}
+
+/* Keep the pool busy with the members after the one being used. */
+static void
+gz_members_dispatch(FILE_T state)
+{
+    struct gz_members *members = state->members;
+    struct gz_member *member;
+    guint ahead;
+
+    /* Start with a few, in case only the start of the file is read. */
+    ahead = MIN(members->ahead, members->used + 1);
+    while (!members->scan_done && g_queue_get_length(&members->queue) < ahead) {
+        member = gz_members_scan(state);
+        if (member == NULL) {
+            members->scan_done = TRUE;
+            break;
+        }
+        g_queue_push_tail(&members->queue, member);
+        if (!g_thread_pool_push(members->pool, member, NULL))
+            gz_member_inflate(member, members);
+    }
+}
+
+/*
+ * Start decompressing the members of a gzip file, starting with the one
+ * whose header is at the start of the input buffer, in parallel, if
+ * that's worth doing.
+ */
+static gboolean
+gz_members_start(FILE_T state)
+{
+    struct gz_members *members;
+    gint64 start = state->raw_pos - state->in.avail;
+    guint n_threads = 1;
+    ws_statb64 st;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    n_threads = MIN(g_get_num_processors(), GZ_MEMBERS_MAX_THREADS);
+#endif
+    /* Not for random access, which only reads a little at a time, or
+       for a member that's already been found not to be worth it; and
+       we have to be able to go back to decompressing the usual way. */
+    if (n_threads < 2 || state->random_flag || start == state->members_skip ||
+        ws_fstat64(state->fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return FALSE;
+
+    members = g_new0(struct gz_members, 1);
+    members->pool = g_thread_pool_new(gz_member_inflate, members, n_threads,
+                                      FALSE, NULL);
+    if (members->pool == NULL) {
+        g_free(members);
+        return FALSE;
+    }
+    members->check_crc = !state->dont_check_crc;
+    members->ahead = n_threads * 2;
+    g_mutex_init(&members->mutex);
+    g_cond_init(&members->cond);
+    g_queue_init(&members->queue);
+    members->out_buf = state->out.buf;
+
+    /* Start with what's already been read. */
+    members->scan = (guint8 *)g_malloc(GZ_MEMBER_MAX_SIZE + GZ_MEMBERS_READ_SIZE);
+    memcpy(members->scan, state->in.next, state->in.avail);
+    members->scan_start = start;
+    members->scan_len = state->in.avail;
+    members->next = start;
+    buf_reset(&state->in);
+
+    state->members = members;
+    state->compression = GZIP_MEMBERS;
+    if (!state->is_compressed)
+        state->compression_type = WTAP_GZIP_COMPRESSED;
+    state->is_compressed = TRUE;
+    return TRUE;
+}
+
+/*
+ * Stop decompressing members in parallel, and put back the output
+ * buffer, discarding what's in it.
+ */
+static void
+gz_members_end(FILE_T state)
+{
+    struct gz_members *members = state->members;
+    struct gz_member *member;
+
+    if (members == NULL)
+        return;
+
+    /* Drop the members not started on, and wait for the rest. */
+    g_thread_pool_free(members->pool, TRUE, TRUE);
+    while ((member = (struct gz_member *)g_queue_pop_head(&members->queue)) != NULL)
+        gz_member_free(member);
+    gz_member_free(members->cur);
+    state->out.buf = members->out_buf;
+    buf_reset(&state->out);
+
+    g_mutex_clear(&members->mutex);
+    g_cond_clear(&members->cond);
+    g_free(members->scan);
+    g_free(members);
+    state->members = NULL;
+}
+
+/* Point the output buffer at the next member's decompressed data. */
+static void
+gz_members_read(FILE_T state)
+{
+    struct gz_members *members = state->members;
+    struct gz_member *member;
+    gint64 resume;
+
+    gz_members_dispatch(state);
+    member = (struct gz_member *)g_queue_pop_head(&members->queue);
+    if (member != NULL) {
+        g_mutex_lock(&members->mutex);
+        while (!member->done)
+            g_cond_wait(&members->cond, &members->mutex);
+        g_mutex_unlock(&members->mutex);
+
+        if (member->ok) {
+            if (state->fast_seek)
+                fast_seek_header(state, member->start + member->hdr_len,
+                                 state->pos, GZIP_AFTER_HEADER);
+            gz_member_free(members->cur);
+            members->cur = member;
+            members->used++;
+            state->out.buf = member->out;
+            state->out.next = member->out;
+            state->out.avail = member->out_len;
+            return;
+        }
+
+        /* Decompress it, and report anything wrong with it, the usual way. */
+        resume = member->start;
+        gz_member_free(member);
+    } else {
+        /* Go on the usual way from wherever the members ran out. */
+        resume = members->next;
+    }
+
+    gz_members_end(state);
+    state->members_skip = resume;
+    if (ws_lseek64(state->fd, resume, SEEK_SET) == -1) {
+        state->err = errno;
+        state->err_info = NULL;
+        return;
+    }
+    state->raw_pos = resume;
+    buf_reset(&state->in);
+    state->eof = FALSE;
+    state->compression = UNKNOWN;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void
+zstd_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
+    size_t ret = 1;
+
+    output.dst = buf;
+    output.size = count;
+    output.pos = 0;
+
+    /* fill output buffer up to end of frame or error */
+    do {
+        /* get more input, unless there's output to flush without it */
+        if (state->in.avail == 0 && !state->flush_pending) {
+            if (fill_in_buffer(state) == -1)
+                break;
+            if (state->in.avail == 0) {
+                /* EOF */
+                state->err = WTAP_ERR_SHORT_READ;
+                state->err_info = NULL;
+                break;
+            }
+        }
+        state->flush_pending = FALSE;
+
+        input.src = state->in.next;
+        input.size = state->in.avail;
+        input.pos = 0;
+        ret = ZSTD_decompressStream(state->zstd, &output, &input);
+        state->in.next += input.pos;
+        state->in.avail -= (guint)input.pos;
+        if (ZSTD_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = ZSTD_getErrorName(ret);
+            break;
+        }
+
+        /* The decompressor might have more output for us than fit. */
+        if (output.pos == output.size && ret != 0)
+            state->flush_pending = TRUE;
+    } while (output.pos < output.size && ret != 0);
+
+    state->out.next = buf;
+    state->out.avail = (guint)output.pos;
+
+    if (ret == 0)
+        state->compression = UNKNOWN;      /* ready for next frame, once have is 0 */
+}
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4FRAME_H
+static void
+lz4_reset(FILE_T state)
+{
+#if LZ4_VERSION_NUMBER >= 10800
+    LZ4F_resetDecompressionContext(state->lz4);
+#else
+    /* There's no way to reset a context after an error before 1.8.0. */
+    LZ4F_freeDecompressionContext(state->lz4);
+    if (LZ4F_isError(LZ4F_createDecompressionContext(&state->lz4, LZ4F_VERSION)))
+        state->lz4 = NULL;
 #endif
+}
+
+static void
+lz4_read(FILE_T state, unsigned char *buf, unsigned int count)
+{
+    size_t in_size, out_size;
+    unsigned int have = 0;
+    size_t ret = 1;
+
+    /* fill output buffer up to end of frame or error */
+    do {
+        /* get more input, unless there's output to flush without it */
+        if (state->in.avail == 0 && !state->flush_pending) {
+            if (fill_in_buffer(state) == -1)
+                break;
+            if (state->in.avail == 0) {
+                /* EOF */
+                state->err = WTAP_ERR_SHORT_READ;
+                state->err_info = NULL;
+                break;
+            }
+        }
+        state->flush_pending = FALSE;
+
+        in_size = state->in.avail;
+        out_size = count - have;
+        ret = LZ4F_decompress(state->lz4, buf + have, &out_size,
+                              state->in.next, &in_size, NULL);
+        state->in.next += in_size;
+        state->in.avail -= (guint)in_size;
+        have += (unsigned int)out_size;
+        if (LZ4F_isError(ret)) {
+            state->err = WTAP_ERR_DECOMPRESS;
+            state->err_info = LZ4F_getErrorName(ret);
+            break;
+        }
+
+        /* The decompressor might have more output for us than fit. */
+        if (have == count && ret != 0)
+            state->flush_pending = TRUE;
+    } while (have < count && ret != 0);
+
+    state->out.next = buf;
+    state->out.avail = have;
+
+    if (ret == 0)
+        state->compression = UNKNOWN;      /* ready for next frame, once have is 0 */
+}
+#endif /* HAVE_LZ4FRAME_H */
 
 static int
 gz_head(FILE_T state)
@@ -655,6 +1533,65 @@ gz_head(FILE_T state)
             return 0;
     }
 
+    /* look for the Zstandard and LZ4 frame magic numbers, which are
+       left in the input for the decompressor */
+    if (fill_in_buffer_to(state, 4) == -1)
+        return -1;
+    if (state->in.avail >= 4 && memcmp(state->in.next, "\x28\xB5\x2F\xFD", 4) == 0) {
+#ifdef HAVE_ZSTD
+        if (state->zstd == NULL && (state->zstd = ZSTD_createDStream()) == NULL) {
+            state->err = ENOMEM;
+            state->err_info = NULL;
+            return -1;
+        }
+        ZSTD_initDStream(state->zstd);
+        state->compression = ZSTD;
+        if (!state->is_compressed)
+            state->compression_type = WTAP_ZSTD_COMPRESSED;
+        state->is_compressed = TRUE;
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, ZSTD);
+        return 0;
+#else /* HAVE_ZSTD */
+        state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+        state->err_info = "reading zstd-compressed files isn't supported";
+        return -1;
+#endif /* HAVE_ZSTD */
+    }
+    if (state->in.avail >= 4 && memcmp(state->in.next, "\x04\x22\x4D\x18", 4) == 0) {
+#ifdef HAVE_LZ4FRAME_H
+        if (state->lz4 == NULL) {
+            if (LZ4F_isError(LZ4F_createDecompressionContext(&state->lz4, LZ4F_VERSION)))
+                state->lz4 = NULL;
+        } else
+            lz4_reset(state);
+        if (state->lz4 == NULL) {
+            state->err = ENOMEM;
+            state->err_info = NULL;
+            return -1;
+        }
+        state->compression = LZ4;
+        if (!state->is_compressed)
+            state->compression_type = WTAP_LZ4_COMPRESSED;
+        state->is_compressed = TRUE;
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, LZ4);
+        return 0;
+#else /* HAVE_LZ4FRAME_H */
+        state->err = WTAP_ERR_DECOMPRESSION_NOT_SUPPORTED;
+        state->err_info = "reading lz4-compressed files isn't supported";
+        return -1;
+#endif /* HAVE_LZ4FRAME_H */
+    }
+
+#ifdef HAVE_ZLIB
+    /* if it's a gzip member, it and the ones after it might be
+       decompressed in parallel */
+    if (state->in.avail >= 2 && state->in.next[0] == 31 &&
+        state->in.next[1] == 139 && gz_members_start(state))
+        return 0;
+#endif
+
     /* look for the gzip magic header bytes 31 and 139 */
     if (state->in.next[0] == 31) {
         state->in.avail--;
@@ -734,6 +1671,8 @@ gz_head(FILE_T state)
             inflateReset(&(state->strm));
             state->strm.adler = crc32(0L, Z_NULL, 0);
             state->compression = ZLIB;
+            if (!state->is_compressed)
+                state->compression_type = WTAP_GZIP_COMPRESSED;
             state->is_compressed = TRUE;
 #ifdef Z_BLOCK
             if (state->fast_seek) {
@@ -777,6 +1716,11 @@ gz_head(FILE_T state)
         buf_reset(&state->in);
     }
     state->compression = UNCOMPRESSED;
+
+    /* If we can, read the rest of the file from a mapping of it; not
+       if it's the uncompressed tail of a compressed file, though. */
+    if (!state->is_compressed)
+        (void)map_file(state);
     return 0;
 }
 
@@ -790,13 +1734,32 @@ fill_out_buffer(FILE_T state)
             return 0;
     }
     if (state->compression == UNCOMPRESSED) {           /* straight copy */
-        if (buf_read(state, &state->out) < 0)
+        if (state->mapped != NULL) {
+            /* Move on through the mapping, mapping the file again
+               if we're at the end of it and it's grown. */
+            if (state->start + state->pos >= (gint64)g_mapped_file_get_length(state->mapped))
+                (void)map_file(state);
+            map_window(state);
+        } else if (buf_read(state, &state->out) < 0)
             return -1;
     }
 #ifdef HAVE_ZLIB
     else if (state->compression == ZLIB) {      /* decompress */
         zlib_read(state, state->out.buf, state->size << 1);
     }
+    else if (state->compression == GZIP_MEMBERS) {
+        gz_members_read(state);
+    }
+#endif
+#ifdef HAVE_ZSTD
+    else if (state->compression == ZSTD) {
+        zstd_read(state, state->out.buf, state->size << 1);
+    }
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    else if (state->compression == LZ4) {
+        lz4_read(state, state->out.buf, state->size << 1);
+    }
 #endif
     return 0;
 }
@@ -823,7 +1786,7 @@ gz_skip(FILE_T state, gint64 len)
                any more data into the output buffer, so
                return an error indication. */
             return -1;
-        } else if (state->eof && state->in.avail == 0) {
+        } else if (input_exhausted(state)) {
             /* We have nothing in the output buffer, and
                we're at the end of the input; just return. */
             break;
@@ -840,8 +1803,12 @@ gz_skip(FILE_T state, gint64 len)
 static void
 gz_reset(FILE_T state)
 {
+#ifdef HAVE_ZLIB
+    gz_members_end(state);        /* not decompressing members in parallel */
+#endif
     buf_reset(&state->out);       /* no output data available */
     state->eof = FALSE;           /* not at end of file */
+    state->flush_pending = FALSE; /* no output left in the decompressor */
     state->compression = UNKNOWN; /* look for gzip header */
 
     state->seek_pending = FALSE;  /* no seek request pending */
@@ -873,6 +1840,7 @@ file_fdopen(int fd)
 
     /* open the file with the appropriate mode (or just use fd) */
     state->fd = fd;
+    state->spill_fd = -1;
 
     /* we don't yet know whether it's compressed */
     state->is_compressed = FALSE;
@@ -933,6 +1901,9 @@ file_fdopen(int fd)
 
     /* for now, assume we should check the crc */
     state->dont_check_crc = FALSE;
+
+    /* no member has been found not worth decompressing in parallel */
+    state->members_skip = -1;
 #endif
     /* return stream */
     return state;
@@ -991,11 +1962,163 @@ file_open(const char *path)
 }
 
 void
-file_set_random_access(FILE_T stream, gboolean random_flag _U_, GPtrArray *seek)
+file_set_random_access(FILE_T stream, gboolean random_flag, GPtrArray *seek)
 {
     stream->fast_seek = seek;
+    stream->random_flag = random_flag;
+}
+
+/*
+ * Copy everything read from the stream from now on to fd, which is
+ * closed when the stream is.  Used for pipes, so that a second stream
+ * opened on what fd refers to can read any of it again.
+ */
+void
+file_set_spill(FILE_T stream, int fd)
+{
+    stream->spill_fd = fd;
+}
+
+/*
+ * Read the stream with read() from now on, never through a mapping; for
+ * files that are still being written, and so might be truncated.
+ */
+void
+file_set_unmapped(FILE_T stream)
+{
+    stream->never_map = TRUE;
+    unmap_file(stream);
+}
+
+/*
+ * Save the fast seek points found so far, so that a later reader of the
+ * same file can seek without reading it through first.
+ */
+void
+file_fast_seek_save(GPtrArray *fast_seek, GByteArray *out)
+{
+    struct fast_seek_point *item;
+    guint32 count, compression;
+    guint i;
+
+    count = fast_seek->len;
+    g_byte_array_append(out, (const guint8 *)&count, sizeof count);
+    for (i = 0; i < fast_seek->len; i++) {
+        item = (struct fast_seek_point *)fast_seek->pdata[i];
+
+        compression = item->compression;
+        g_byte_array_append(out, (const guint8 *)&item->out, sizeof item->out);
+        g_byte_array_append(out, (const guint8 *)&item->in, sizeof item->in);
+        g_byte_array_append(out, (const guint8 *)&compression, sizeof compression);
+#ifdef HAVE_ZLIB
+        if (item->compression == ZLIB) {
+            gint32 bits;
+
+#ifdef HAVE_INFLATEPRIME
+            bits = item->data.zlib.bits;
+#else
+            bits = 0;
+#endif
+            g_byte_array_append(out, (const guint8 *)&bits, sizeof bits);
+            g_byte_array_append(out, (const guint8 *)&item->data.zlib.adler,
+                                sizeof item->data.zlib.adler);
+            g_byte_array_append(out, (const guint8 *)&item->data.zlib.total_out,
+                                sizeof item->data.zlib.total_out);
+            g_byte_array_append(out, item->data.zlib.window, ZLIB_WINSIZE);
+        }
+#endif
+    }
+}
+
+#define FAST_SEEK_TAKE(dst, size) \
+    do { \
+        if (len < (size)) \
+            goto fail; \
+        memcpy((dst), data, (size)); \
+        data += (size); \
+        len -= (size); \
+    } while (0)
+
+/*
+ * Replace the fast seek points with ones saved by file_fast_seek_save().
+ * Returns the number of bytes used, or 0 if the data isn't valid.
+ */
+gsize
+file_fast_seek_restore(GPtrArray *fast_seek, const guint8 *data, gsize len)
+{
+    struct fast_seek_point *val;
+    GPtrArray *points;
+    gsize start_len = len;
+    guint32 count, compression, i;
+
+    points = g_ptr_array_new_with_free_func(g_free);
+    FAST_SEEK_TAKE(&count, sizeof count);
+    for (i = 0; i < count; i++) {
+        val = g_new(struct fast_seek_point, 1);
+        g_ptr_array_add(points, val);
+
+        FAST_SEEK_TAKE(&val->out, sizeof val->out);
+        FAST_SEEK_TAKE(&val->in, sizeof val->in);
+        FAST_SEEK_TAKE(&compression, sizeof compression);
+        switch (compression) {
+
+        case UNCOMPRESSED:
+            break;
+
+#ifdef HAVE_ZLIB
+        case ZLIB:
+        {
+            gint32 bits;
+
+            FAST_SEEK_TAKE(&bits, sizeof bits);
+#ifdef HAVE_INFLATEPRIME
+            val->data.zlib.bits = bits;
+#else
+            if (bits != 0)
+                goto fail;
+#endif
+            FAST_SEEK_TAKE(&val->data.zlib.adler, sizeof val->data.zlib.adler);
+            FAST_SEEK_TAKE(&val->data.zlib.total_out, sizeof val->data.zlib.total_out);
+            FAST_SEEK_TAKE(val->data.zlib.window, ZLIB_WINSIZE);
+            break;
+        }
+
+        case GZIP_AFTER_HEADER:
+            break;
+#endif
+
+#ifdef HAVE_ZSTD
+        case ZSTD:
+            break;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+        case LZ4:
+            break;
+#endif
+
+        default:
+            goto fail;
+        }
+        val->compression = (compression_t)compression;
+    }
+
+    /* All of it is valid; take the points. */
+    for (i = 0; i < fast_seek->len; i++)
+        g_free(fast_seek->pdata[i]);
+    g_ptr_array_set_size(fast_seek, 0);
+    for (i = 0; i < points->len; i++)
+        g_ptr_array_add(fast_seek, points->pdata[i]);
+    g_ptr_array_free(points, FALSE);
+    return start_len - len;
+
+fail:
+    g_ptr_array_free(points, TRUE);
+    return 0;
 }
 
+#undef FAST_SEEK_TAKE
+
 gint64
 file_seek(FILE_T file, gint64 offset, int whence, int *err)
 {
@@ -1046,6 +2169,25 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
         return file->pos;
     }
 
+    /*
+     * If we're reading through a mapping, just move to that part of it.
+     */
+    if (file->mapped != NULL) {
+        if (file->pos + offset < 0) {
+            *err = EINVAL;
+            return -1;
+        }
+        file->pos += offset;
+        file->err = 0;
+        file->err_info = NULL;
+        /* If we're seeking past the end of the mapping, the file may
+           have grown since it was mapped. */
+        if (file->start + file->pos >= (gint64)g_mapped_file_get_length(file->mapped))
+            (void)map_file(file);
+        map_window(file);
+        return file->pos;
+    }
+
     /*
      * Are we seeking backwards?
      */
@@ -1077,6 +2219,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             file->out.avail += adjustment;
             file->out.next -= adjustment;
             file->pos -= adjustment;
+            /* An uncompressed file may have grown since we got to
+               the end of it. */
+            if (file->compression == UNCOMPRESSED)
+                file->eof = FALSE;
             return file->pos;
         }
     } else {
@@ -1130,12 +2276,27 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             off = here->in;
             off2 = here->out;
         } else
+#endif
+#ifdef HAVE_ZSTD
+        if (here->compression == ZSTD) {
+            off = here->in;
+            off2 = here->out;
+        } else
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        if (here->compression == LZ4) {
+            off = here->in;
+            off2 = here->out;
+        } else
 #endif
         {
             off2 = (file->pos + offset);
             off = here->in + (off2 - here->out);
         }
 
+#ifdef HAVE_ZLIB
+        gz_members_end(file);
+#endif
         if (ws_lseek64(file->fd, off, SEEK_SET) == -1) {
             *err = errno;
             return -1;
@@ -1145,6 +2306,7 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
         file->raw_pos = off;
         buf_reset(&file->out);
         file->eof = FALSE;
+        file->flush_pending = FALSE;
         file->seek_pending = FALSE;
         file->err = 0;
         file->err_info = NULL;
@@ -1182,6 +2344,18 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             strm->adler = crc32(0L, Z_NULL, 0);
             file->compression = ZLIB;
         } else
+#endif
+#ifdef HAVE_ZSTD
+        if (here->compression == ZSTD) {
+            /* The point is at the start of a frame, so there's nothing
+               to pick up; just look for the frame as if it were new. */
+            file->compression = UNKNOWN;
+        } else
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        if (here->compression == LZ4) {
+            file->compression = UNKNOWN;
+        } else
 #endif
             file->compression = here->compression;
 
@@ -1292,6 +2466,9 @@ file_tell(FILE_T stream)
 gint64
 file_tell_raw(FILE_T stream)
 {
+    /* Nothing is read from a mapping until it's asked for. */
+    if (stream->mapped != NULL)
+        return stream->start + stream->pos;
     return stream->raw_pos;
 }
 
@@ -1312,6 +2489,12 @@ file_iscompressed(FILE_T stream)
     return stream->is_compressed;
 }
 
+wtap_compression_type
+file_get_compression_type(FILE_T stream)
+{
+    return stream->is_compressed ? stream->compression_type : WTAP_UNCOMPRESSED;
+}
+
 int
 file_read(void *buf, unsigned int len, FILE_T file)
 {
@@ -1354,7 +2537,7 @@ file_read(void *buf, unsigned int len, FILE_T file)
                any more data into the output buffer, so
                return an error indication. */
             return -1;
-        } else if (file->eof && file->in.avail == 0) {
+        } else if (input_exhausted(file)) {
             /* We have nothing in the output buffer, and
                we're at the end of the input; just return
                with what we've gotten so far. */
@@ -1373,6 +2556,38 @@ file_read(void *buf, unsigned int len, FILE_T file)
     return (int)got;
 }
 
+/*
+ * If the next count bytes of the file are in a mapping of it, skip over
+ * them and return a pointer to them in the mapping; otherwise, return
+ * NULL without reading anything.  The data stays valid until the file
+ * is closed.
+ */
+guint8 *
+file_read_mapped(FILE_T file, unsigned int count)
+{
+    guint8 *data;
+
+    if (file->mapped == NULL || file->seek_pending)
+        return NULL;
+
+    /* Move the output buffer along the mapping if it ends too soon,
+       and map the file again if the mapping does and it's grown. */
+    if (file->out.avail < count) {
+        map_window(file);
+        if (file->out.avail < count &&
+            file->start + file->pos + count > (gint64)g_mapped_file_get_length(file->mapped))
+            (void)map_file(file);
+        if (file->out.avail < count)
+            return NULL;
+    }
+
+    data = file->out.next;
+    file->out.next += count;
+    file->out.avail -= count;
+    file->pos += count;
+    return data;
+}
+
 /*
  * XXX - this *peeks* at next byte, not a character.
  */
@@ -1409,7 +2624,7 @@ file_peekc(FILE_T file)
         else if (file->err != 0) {
             return -1;
         }
-        else if (file->eof && file->in.avail == 0) {
+        else if (input_exhausted(file)) {
             return -1;
         }
         else if (fill_out_buffer(file) == -1) {
@@ -1525,7 +2740,7 @@ int
 file_eof(FILE_T file)
 {
     /* return end-of-file state */
-    return (file->eof && file->in.avail == 0 && file->out.avail == 0);
+    return (input_exhausted(file) && file->out.avail == 0);
 }
 
 /*
@@ -1567,6 +2782,17 @@ file_fdreopen(FILE_T file, const char *path)
     if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
         return FALSE;
     file->fd = fd;
+
+    /* The mapping is of the file we had open; map the new one. */
+    if (file->mapped != NULL) {
+        unmap_file(file);
+        (void)map_file(file);
+    } else if (ws_lseek64(fd, file->raw_pos, SEEK_SET) == -1) {
+        /* Pick up reading where we left off. */
+        ws_close(fd);
+        file->fd = -1;
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -1578,12 +2804,25 @@ file_close(FILE_T file)
     /* free memory and close file */
     if (file->size) {
 #ifdef HAVE_ZLIB
+        gz_members_end(file);
         inflateEnd(&(file->strm));
 #endif
-        g_free(file->out.buf);
+#ifdef HAVE_ZSTD
+        ZSTD_freeDStream(file->zstd);
+#endif
+#ifdef HAVE_LZ4FRAME_H
+        if (file->lz4 != NULL)
+            LZ4F_freeDecompressionContext(file->lz4);
+#endif
+        g_free(file->mapped != NULL ? file->out_buf : file->out.buf);
         g_free(file->in.buf);
     }
+    if (file->mapped != NULL)
+        g_mapped_file_unref(file->mapped);
+    g_slist_free_full(file->retired_mappings, (GDestroyNotify)g_mapped_file_unref);
     g_free(file->fast_seek_cur);
+    if (file->spill_fd != -1)
+        ws_close(file->spill_fd);
     file->err = 0;
     file->err_info = NULL;
     g_free(file);
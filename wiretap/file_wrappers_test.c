@@ -0,0 +1,228 @@
+/* file_wrappers_test.c
+ * Standalone program to test reading a capture file that grows while
+ * it's being read, as a live capture's file or a spilled pipe does,
+ * both through a mapping of it and with read().
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include <wsutil/file_util.h>
+#include <wsutil/buffer.h>
+
+#include "wtap.h"
+
+#define TEST_RECORD_LEN     60
+#define PCAP_HDR_LEN        24
+#define PCAP_REC_HDR_LEN    16
+
+/* Offset of the nth record, counting from 0, in the test file. */
+#define RECORD_OFFSET(n)    (PCAP_HDR_LEN + (n) * (PCAP_REC_HDR_LEN + TEST_RECORD_LEN))
+
+static void
+write_all(int fd, const void *data, gsize len)
+{
+    g_assert_cmpint(ws_write(fd, data, (unsigned int)len), ==, (int)len);
+}
+
+static void
+write_pcap_header(int fd)
+{
+    guint8 hdr[PCAP_HDR_LEN];
+    guint32 magic = 0xa1b2c3d4, snaplen = 65535, network = 1;
+    guint16 version_major = 2, version_minor = 4;
+
+    /* In host byte order, so records aren't fixed up after reading. */
+    memset(hdr, 0, sizeof hdr);
+    memcpy(hdr, &magic, 4);
+    memcpy(hdr + 4, &version_major, 2);
+    memcpy(hdr + 6, &version_minor, 2);
+    memcpy(hdr + 16, &snaplen, 4);
+    memcpy(hdr + 20, &network, 4);
+    write_all(fd, hdr, sizeof hdr);
+}
+
+/*
+ * Write part of the nth test record; its data is all n, so it can be
+ * told from the others.
+ */
+static void
+write_record_part(int fd, guint n, gsize start, gsize end)
+{
+    guint8 rec[PCAP_REC_HDR_LEN + TEST_RECORD_LEN];
+    guint32 rec_hdr[4] = { n, 0, TEST_RECORD_LEN, TEST_RECORD_LEN };
+
+    memcpy(rec, rec_hdr, sizeof rec_hdr);
+    memset(rec + PCAP_REC_HDR_LEN, (int)n, TEST_RECORD_LEN);
+    write_all(fd, rec + start, end - start);
+}
+
+static void
+write_record(int fd, guint n)
+{
+    write_record_part(fd, n, 0, PCAP_REC_HDR_LEN + TEST_RECORD_LEN);
+}
+
+static void
+check_record(const guint8 *data, guint len, guint n)
+{
+    guint i;
+
+    g_assert_cmpuint(len, ==, TEST_RECORD_LEN);
+    for (i = 0; i < len; i++)
+        g_assert_cmpuint(data[i], ==, n);
+}
+
+static void
+check_seek_read(wtap *wth, guint n)
+{
+    wtap_rec rec;
+    Buffer buf;
+    int err;
+    gchar *err_info;
+
+    wtap_rec_init(&rec);
+    ws_buffer_init(&buf, 1514);
+    g_assert_true(wtap_seek_read(wth, RECORD_OFFSET(n), &rec, &buf, &err, &err_info));
+    check_record(ws_buffer_start_ptr(&buf), rec.rec_header.packet_header.caplen, n);
+    ws_buffer_free(&buf);
+    wtap_rec_cleanup(&rec);
+}
+
+static void
+check_read(wtap *wth, guint n)
+{
+    int err;
+    gchar *err_info;
+    gint64 data_offset;
+
+    g_assert_true(wtap_read(wth, &err, &err_info, &data_offset));
+    g_assert_cmpint(data_offset, ==, RECORD_OFFSET(n));
+    check_record(wtap_get_buf_ptr(wth), wtap_get_rec(wth)->rec_header.packet_header.caplen, n);
+}
+
+static void
+check_eof(wtap *wth)
+{
+    int err;
+    gchar *err_info;
+    gint64 data_offset;
+
+    g_assert_false(wtap_read(wth, &err, &err_info, &data_offset));
+    g_assert_cmpint(err, ==, 0);
+}
+
+/*
+ * Read a file, with both streams, appending records to it while it's
+ * being read: one after everything's been read, and one in two parts,
+ * so that the random-access stream first finds only some of it.
+ */
+static void
+test_growing_file(gboolean unmapped)
+{
+    gchar *path;
+    int fd;
+    wtap *wth;
+    wtap_rec rec;
+    Buffer buf;
+    int err;
+    gchar *err_info;
+
+    fd = g_file_open_tmp("file_wrappers_test_XXXXXX.pcap", &path, NULL);
+    g_assert_cmpint(fd, !=, -1);
+    write_pcap_header(fd);
+    write_record(fd, 0);
+    write_record(fd, 1);
+
+    wth = wtap_open_offline(path, WTAP_TYPE_AUTO, &err, &err_info, TRUE);
+    g_assert_nonnull(wth);
+    if (unmapped)
+        wtap_disable_mapping(wth);
+    check_read(wth, 0);
+    check_read(wth, 1);
+    check_eof(wth);
+
+    /* Have the random-access stream get as far as the end of the file. */
+    check_seek_read(wth, 1);
+
+    /* A record appended after that can be read with both streams. */
+    write_record(fd, 2);
+    wtap_cleareof(wth);
+    check_read(wth, 2);
+    check_eof(wth);
+    check_seek_read(wth, 0);
+    check_seek_read(wth, 2);
+
+    /* One that's only partly there can't be read... */
+    write_record_part(fd, 3, 0, PCAP_REC_HDR_LEN + TEST_RECORD_LEN / 2);
+    wtap_rec_init(&rec);
+    ws_buffer_init(&buf, 1514);
+    g_assert_false(wtap_seek_read(wth, RECORD_OFFSET(3), &rec, &buf, &err, &err_info));
+    g_assert_cmpint(err, ==, WTAP_ERR_SHORT_READ);
+    g_free(err_info);
+    ws_buffer_free(&buf);
+    wtap_rec_cleanup(&rec);
+
+    /* ...until the rest of it's there. */
+    write_record_part(fd, 3, PCAP_REC_HDR_LEN + TEST_RECORD_LEN / 2,
+                      PCAP_REC_HDR_LEN + TEST_RECORD_LEN);
+    check_seek_read(wth, 3);
+    check_seek_read(wth, 1);
+    wtap_cleareof(wth);
+    check_read(wth, 3);
+
+    wtap_close(wth);
+    ws_close(fd);
+    ws_unlink(path);
+    g_free(path);
+}
+
+static void
+file_wrappers_test_growing_mapped(void)
+{
+    test_growing_file(FALSE);
+}
+
+static void
+file_wrappers_test_growing_unmapped(void)
+{
+    test_growing_file(TRUE);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/file_wrappers/growing/mapped",   file_wrappers_test_growing_mapped);
+    g_test_add_func("/file_wrappers/growing/unmapped", file_wrappers_test_growing_unmapped);
+
+    wtap_init(FALSE);
+    result = g_test_run();
+    wtap_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
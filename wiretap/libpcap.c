@@ -670,6 +670,38 @@ static int libpcap_try_record(wtap *wth, FILE_T fh, int *err, gchar **err_info)
 	return 0;
 }
 
+/*
+ * Find the first record that starts at or after "offset" and before "end",
+ * when reading the file in chunks, and position wth->fh at it.  A record
+ * header has no marker, so this looks for a place where the same checks
+ * that are made when the file is opened pass for MAX_RECORDS_TO_TRY
+ * records in a row.
+ *
+ * Returns the offset of the record, "end" if none was found, or -1 on an
+ * I/O error.
+ */
+gint64
+libpcap_find_record(wtap *wth, gint64 offset, gint64 end, int *err,
+    gchar **err_info)
+{
+	gint64 pos;
+	int ret;
+
+	for (pos = offset; pos < end; pos++) {
+		if (file_seek(wth->fh, pos, SEEK_SET, err) == -1)
+			return -1;
+		ret = libpcap_try(wth, err, err_info);
+		if (ret == -1)
+			return -1;
+		if (ret == 0) {
+			if (file_seek(wth->fh, pos, SEEK_SET, err) == -1)
+				return -1;
+			return pos;
+		}
+	}
+	return end;
+}
+
 /* Read the next packet */
 static gboolean libpcap_read(wtap *wth, int *err, gchar **err_info,
     gint64 *data_offset)
@@ -784,10 +816,17 @@ libpcap_read_packet(wtap *wth, FILE_T fh, wtap_rec *rec,
 	rec->rec_header.packet_header.len = orig_size;
 
 	/*
-	 * Read the packet data.
+	 * Read the packet data.  Unless pcap_read_post_process() will
+	 * have to byte-swap parts of it, it can be left where it is
+	 * if the file is mapped.
 	 */
-	if (!wtap_read_packet_bytes(fh, buf, packet_size, err, err_info))
-		return FALSE;	/* failed */
+	if (libpcap->byte_swapped) {
+		if (!wtap_read_packet_bytes(fh, buf, packet_size, err, err_info))
+			return FALSE;	/* failed */
+	} else {
+		if (!wtap_read_packet_bytes_in_place(fh, buf, packet_size, err, err_info))
+			return FALSE;	/* failed */
+	}
 
 	pcap_read_post_process(wth->file_type_subtype, wth->file_encap,
 	    rec, ws_buffer_start_ptr(buf), libpcap->byte_swapped, -1);
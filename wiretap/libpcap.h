@@ -97,6 +97,8 @@ struct pcaprec_nokia_hdr {
 };
 
 wtap_open_return_val libpcap_open(wtap *wth, int *err, gchar **err_info);
+gint64 libpcap_find_record(wtap *wth, gint64 offset, gint64 end, int *err,
+    gchar **err_info);
 gboolean libpcap_dump_open(wtap_dumper *wdh, int *err);
 int libpcap_dump_can_write_encap(int encap);
 
@@ -26,7 +26,9 @@
 #include "wtap_opttypes.h"
 #include "pcapng.h"
 #include "wtap-int.h"
+#include "file_wrappers.h"
 
+#include <wsutil/buffer.h>
 #include <wsutil/filesystem.h>
 #include "wsutil/os_version_info.h"
 
@@ -99,8 +101,361 @@ add_idb_index_map(merge_in_file_t *in_file, const guint orig_index, const guint
     g_array_append_val(in_file->idb_index_map, found_index);
 }
 
+/*
+ * Inputs are read ahead of the merge on threads of their own when there
+ * are only a few of them, so that decompressing and parsing one file
+ * overlaps with the others and with writing the output.  With many
+ * inputs, the threads would cost more than they save.
+ */
+#define MERGE_READ_AHEAD_MAX_FILES  8
+#define MERGE_READ_AHEAD_RECORDS    256
+
+/*
+ * Most inputs we keep a file descriptor open for.  Past that, the input
+ * read from least recently is closed and reopened when we next need a
+ * record from it, which, for the usual case of many files covering
+ * consecutive spans of time, such as a ring buffer, happens about once
+ * per file.
+ */
+#define MERGE_MAX_OPEN_FILES        64
+
+typedef struct {
+    wtap_rec  rec;
+    Buffer    buf;
+    GArray   *dsbs;     /* wtap_block_t's of DSBs read along with the record */
+    gint64    read_so_far;  /* wtap_read_so_far() after reading the record */
+} read_ahead_slot_t;
+
+typedef struct {
+    merge_in_file_t   *in_file;
+    GThread           *thread;
+    GMutex             mutex;       /* protects everything below */
+    GCond              not_empty;
+    GCond              not_full;
+    read_ahead_slot_t  slots[MERGE_READ_AHEAD_RECORDS];
+    guint              head;        /* slot the merge gets next, or holds */
+    guint              count;       /* slots filled, including one being held */
+    gboolean           holding;     /* merge holds the slot at head */
+    gboolean           done;        /* reader got an EOF or an error */
+    gboolean           stop;        /* merge asked the reader to stop */
+    int                err;
+    gchar             *err_info;
+} read_ahead_t;
+
+/* What we keep for each input file, in addition to its merge_in_file_t. */
+typedef struct {
+    wtap_rec      *rec;         /* record read but not yet merged */
+    const guint8  *pd;          /* its data */
+    read_ahead_t  *read_ahead;  /* reads records ahead on a thread, or NULL */
+    gboolean       reopenable;  /* a regular file we can close and reopen */
+    gboolean       fd_closed;   /* file descriptor closed, by us */
+    guint64        last_read;   /* when we last read from it */
+} merge_in_file_priv_t;
+
+/*
+ * The state of a merge.  The files with a record ready to be merged are
+ * kept in a binary min-heap ordered by that record, so picking the next
+ * record costs O(log N) rather than O(N) in the number of input files.
+ */
+typedef struct {
+    merge_in_file_t      *in_files;
+    guint                 in_file_count;
+    merge_in_file_priv_t *priv;
+    guint                *heap;         /* indices of in_files */
+    guint                 heap_len;
+    gboolean              heap_filled;  /* have we read a record from each file? */
+    merge_in_file_t      *taken;        /* file of the record last handed out */
+    guint                 open_files;   /* files with a file descriptor open */
+    guint64               reads;        /* for last_read */
+} merge_state_t;
+
+static merge_state_t *
+merge_state_new(guint in_file_count)
+{
+    merge_state_t *ms = g_new0(merge_state_t, 1);
+
+    ms->in_file_count = in_file_count;
+    ms->priv = g_new0(merge_in_file_priv_t, in_file_count);
+    ms->heap = g_new(guint, in_file_count);
+    return ms;
+}
+
+static void
+merge_state_free(merge_state_t *ms)
+{
+    g_free(ms->heap);
+    g_free(ms->priv);
+    g_free(ms);
+}
+
+/*
+ * Amount of data in the record, which is all we need to copy from the
+ * buffer wiretap read it into.
+ */
+static guint
+rec_data_length(const wtap_rec *rec)
+{
+    switch (rec->rec_type) {
+
+    case REC_TYPE_PACKET:
+        return rec->rec_header.packet_header.caplen;
+
+    case REC_TYPE_FT_SPECIFIC_EVENT:
+    case REC_TYPE_FT_SPECIFIC_REPORT:
+        return rec->rec_header.ft_specific_header.record_len;
+
+    case REC_TYPE_SYSCALL:
+        return rec->rec_header.syscall_header.event_filelen;
+    }
+    return 0;
+}
+
+/*
+ * Read the next record of a file into a slot.  The record's options
+ * buffer is scratch space for the file readers, so it isn't copied, and
+ * the comment is copied because wiretap may reuse or free it on the next
+ * read.  DSBs read along with the record are passed on with it, as only
+ * this thread may look at wth->dsbs while it's running.
+ */
+static gboolean
+read_ahead_fill(read_ahead_t *ra, read_ahead_slot_t *slot, int *err,
+                gchar **err_info)
+{
+    merge_in_file_t *in_file = ra->in_file;
+    gint64        data_offset;
+    wtap_rec     *rec;
+    Buffer        options_buf;
+    guint         len;
+
+    if (!wtap_read(in_file->wth, err, err_info, &data_offset))
+        return FALSE;
+
+    rec = wtap_get_rec(in_file->wth);
+    options_buf = slot->rec.options_buf;
+    len = rec_data_length(rec);
+    g_free(slot->rec.opt_comment);
+    slot->rec = *rec;
+    slot->rec.options_buf = options_buf;
+    slot->rec.opt_comment = g_strdup(rec->opt_comment);
+    ws_buffer_assure_space(&slot->buf, len);
+    if (len != 0)
+        memcpy(ws_buffer_start_ptr(&slot->buf), wtap_get_buf_ptr(in_file->wth), len);
+
+    slot->read_so_far = wtap_read_so_far(in_file->wth);
+
+    g_array_set_size(slot->dsbs, 0);
+    if (in_file->wth->dsbs) {
+        GArray *in_dsb = in_file->wth->dsbs;
+        for (; in_file->dsbs_seen < in_dsb->len; in_file->dsbs_seen++) {
+            wtap_block_t wblock = g_array_index(in_dsb, wtap_block_t, in_file->dsbs_seen);
+            g_array_append_val(slot->dsbs, wblock);
+        }
+    }
+    return TRUE;
+}
+
+static gpointer
+read_ahead_worker(gpointer data)
+{
+    read_ahead_t      *ra = (read_ahead_t *)data;
+    read_ahead_slot_t *slot;
+    gboolean           ok;
+    int                err;
+    gchar             *err_info;
+
+    for (;;) {
+        g_mutex_lock(&ra->mutex);
+        while (ra->count == MERGE_READ_AHEAD_RECORDS && !ra->stop)
+            g_cond_wait(&ra->not_full, &ra->mutex);
+        if (ra->stop) {
+            g_mutex_unlock(&ra->mutex);
+            break;
+        }
+        slot = &ra->slots[(ra->head + ra->count) % MERGE_READ_AHEAD_RECORDS];
+        g_mutex_unlock(&ra->mutex);
+
+        /*
+         * The slot is past the end of the filled ones, so the merge
+         * won't look at it until we publish it below.
+         */
+        err_info = NULL;
+        ok = read_ahead_fill(ra, slot, &err, &err_info);
+
+        g_mutex_lock(&ra->mutex);
+        if (ok) {
+            ra->count++;
+        } else {
+            ra->done = TRUE;
+            ra->err = err;
+            ra->err_info = err_info;
+        }
+        g_cond_signal(&ra->not_empty);
+        g_mutex_unlock(&ra->mutex);
+
+        if (!ok)
+            break;
+    }
+    return NULL;
+}
+
+static read_ahead_t *
+read_ahead_new(merge_in_file_t *in_file)
+{
+    read_ahead_t *ra = g_new0(read_ahead_t, 1);
+    guint         i;
+
+    ra->in_file = in_file;
+    g_mutex_init(&ra->mutex);
+    g_cond_init(&ra->not_empty);
+    g_cond_init(&ra->not_full);
+    for (i = 0; i < MERGE_READ_AHEAD_RECORDS; i++) {
+        wtap_rec_init(&ra->slots[i].rec);
+        ws_buffer_init(&ra->slots[i].buf, 1514);
+        ra->slots[i].dsbs = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
+    }
+    ra->thread = g_thread_new("merge_read_ahead", read_ahead_worker, ra);
+    return ra;
+}
+
+/*
+ * Get the next record the thread read.  It stays valid until the next
+ * call.
+ */
+static gboolean
+read_ahead_next(read_ahead_t *ra, merge_in_file_priv_t *priv,
+                GArray *dsb_combined, int *err, gchar **err_info)
+{
+    read_ahead_slot_t *slot;
+
+    g_mutex_lock(&ra->mutex);
+
+    /* We're done with the record we handed out last time. */
+    if (ra->holding) {
+        ra->holding = FALSE;
+        ra->head = (ra->head + 1) % MERGE_READ_AHEAD_RECORDS;
+        ra->count--;
+        g_cond_signal(&ra->not_full);
+    }
+
+    while (ra->count == 0 && !ra->done)
+        g_cond_wait(&ra->not_empty, &ra->mutex);
+
+    if (ra->count == 0) {
+        *err = ra->err;
+        *err_info = ra->err_info;
+        ra->err = 0;
+        ra->err_info = NULL;
+        g_mutex_unlock(&ra->mutex);
+        return FALSE;
+    }
+
+    slot = &ra->slots[ra->head];
+    ra->holding = TRUE;
+    g_mutex_unlock(&ra->mutex);
+
+    /*
+     * As for files we read from directly, the DSBs go to the output file
+     * with the next record written, which can be before records from
+     * other files that sort before this one; they only need to be ahead
+     * of the records of their own file.
+     */
+    if (dsb_combined)
+        g_array_append_vals(dsb_combined, slot->dsbs->data, slot->dsbs->len);
+    priv->rec = &slot->rec;
+    priv->pd = ws_buffer_start_ptr(&slot->buf);
+    ra->in_file->read_so_far = slot->read_so_far;
+    return TRUE;
+}
+
+static void
+read_ahead_free(read_ahead_t *ra)
+{
+    guint i;
+
+    if (ra == NULL)
+        return;
+
+    g_mutex_lock(&ra->mutex);
+    ra->stop = TRUE;
+    g_cond_signal(&ra->not_full);
+    g_mutex_unlock(&ra->mutex);
+    g_thread_join(ra->thread);
+
+    for (i = 0; i < MERGE_READ_AHEAD_RECORDS; i++) {
+        g_free(ra->slots[i].rec.opt_comment);
+        wtap_rec_cleanup(&ra->slots[i].rec);
+        ws_buffer_free(&ra->slots[i].buf);
+        g_array_free(ra->slots[i].dsbs, TRUE);
+    }
+    g_free(ra->err_info);
+
+    g_cond_clear(&ra->not_full);
+    g_cond_clear(&ra->not_empty);
+    g_mutex_clear(&ra->mutex);
+    g_free(ra);
+}
+
+/*
+ * Start reading ahead on each input file, if there are few enough of
+ * them for that to pay off.
+ */
+static void
+merge_start_read_ahead(merge_state_t *ms)
+{
+    guint i;
+
+#if GLIB_CHECK_VERSION(2,36,0)
+    if (g_get_num_processors() < 2)
+        return;
+#endif
+    if (ms->in_file_count > MERGE_READ_AHEAD_MAX_FILES)
+        return;
+
+    for (i = 0; i < ms->in_file_count; i++)
+        ms->priv[i].read_ahead = read_ahead_new(&ms->in_files[i]);
+}
+
+/*
+ * Close the file descriptor of an input file, remembering to reopen it
+ * if we need to read from it again.
+ */
+static void
+merge_fdclose(merge_state_t *ms, guint i)
+{
+    if (ms->priv[i].fd_closed)
+        return;
+    wtap_fdclose(ms->in_files[i].wth);
+    ms->priv[i].fd_closed = TRUE;
+    ms->open_files--;
+}
+
+/*
+ * Make room for opening another input file, if we're at the limit, by
+ * closing the one we've read from least recently.
+ */
+static void
+merge_make_room(merge_state_t *ms)
+{
+    guint i;
+    guint lru = G_MAXUINT;
+
+    if (ms->open_files < MERGE_MAX_OPEN_FILES)
+        return;
+
+    for (i = 0; i < ms->in_file_count; i++) {
+        if (ms->priv[i].fd_closed || !ms->priv[i].reopenable ||
+            ms->priv[i].read_ahead != NULL)
+            continue;
+        if (lru == G_MAXUINT || ms->priv[i].last_read < ms->priv[lru].last_read)
+            lru = i;
+    }
+    if (lru != G_MAXUINT)
+        merge_fdclose(ms, lru);
+}
+
 /** Open a number of input files to merge.
  *
+ * @param ms merge state, to keep count of open files in
  * @param in_file_count number of entries in in_file_names
  * @param in_file_names filenames of the input files
  * @param out_files output pointer with filled file array, or NULL
@@ -110,7 +465,8 @@ add_idb_index_map(merge_in_file_t *in_file, const guint orig_index, const guint
  * @return TRUE if all files could be opened, FALSE otherwise
  */
 static gboolean
-merge_open_in_files(guint in_file_count, const char *const *in_file_names,
+merge_open_in_files(merge_state_t *ms,
+                    guint in_file_count, const char *const *in_file_names,
                     merge_in_file_t **out_files, merge_progress_callback_t* cb,
                     int *err, gchar **err_info, guint *err_fileno)
 {
@@ -122,12 +478,15 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
 
     files = (merge_in_file_t *)g_malloc0(files_size);
     *out_files = NULL;
+    ms->in_files = files;
 
     for (i = 0; i < in_file_count; i++) {
+        merge_make_room(ms);
         files[i].filename    = in_file_names[i];
         files[i].wth         = wtap_open_offline(in_file_names[i], WTAP_TYPE_AUTO, err, err_info, FALSE);
         files[i].state       = RECORD_NOT_PRESENT;
         files[i].packet_num  = 0;
+        files[i].read_so_far = 0;
 
         if (!files[i].wth) {
             /* Close the files we've already opened. */
@@ -147,6 +506,9 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
         }
         files[i].size = size;
         files[i].idb_index_map = g_array_new(FALSE, FALSE, sizeof(guint));
+        ms->open_files++;
+        ms->priv[i].reopenable = strcmp(in_file_names[i], "-") != 0 &&
+                                 g_file_test(in_file_names[i], G_FILE_TEST_IS_REGULAR);
     }
 
     if (cb)
@@ -158,14 +520,18 @@ merge_open_in_files(guint in_file_count, const char *const *in_file_names,
 
 /** Close the input files again.
  *
+ * @param ms merge state
  * @param in_file_count number of entries in in_files
  * @param in_files input file array to be closed
  */
 static void
-merge_close_in_files(int in_file_count, merge_in_file_t in_files[])
+merge_close_in_files(merge_state_t *ms, int in_file_count, merge_in_file_t in_files[])
 {
     int i;
     for (i = 0; i < in_file_count; i++) {
+        /* Stop the reader thread before closing what it reads from. */
+        read_ahead_free(ms->priv[i].read_ahead);
+        ms->priv[i].read_ahead = NULL;
         cleanup_in_file(&in_files[i]);
     }
 }
@@ -202,21 +568,116 @@ merge_select_frame_type(int in_file_count, merge_in_file_t in_files[])
 }
 
 /*
- * returns TRUE if first argument is earlier than second
+ * Does file a's record go before file b's?  Records with no time stamp
+ * are treated as earlier than all other records, in file order.  Yes,
+ * this means you won't get a chronological merge of those records, but
+ * you obviously *can't* get that.  Of records with the same time stamp,
+ * the one from the later file goes first, as it always has.
  */
 static gboolean
-is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
+merge_heap_before(const merge_state_t *ms, guint a, guint b)
 {
-    if (l->secs > r->secs) {  /* left is later */
-        return FALSE;
-    } else if (l->secs < r->secs) { /* left is earlier */
-        return TRUE;
-    } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
+    const wtap_rec *rec_a = ms->priv[a].rec;
+    const wtap_rec *rec_b = ms->priv[b].rec;
+    gboolean        a_has_ts = (rec_a->presence_flags & WTAP_HAS_TS) != 0;
+    gboolean        b_has_ts = (rec_b->presence_flags & WTAP_HAS_TS) != 0;
+    int             cmp;
+
+    if (!a_has_ts || !b_has_ts) {
+        if (a_has_ts != b_has_ts)
+            return !a_has_ts;
+        return a < b;
+    }
+    cmp = nstime_cmp(&rec_a->ts, &rec_b->ts);
+    if (cmp != 0)
+        return cmp < 0;
+    return a > b;
+}
+
+static void
+merge_heap_sift_up(merge_state_t *ms, guint pos)
+{
+    guint file = ms->heap[pos];
+
+    while (pos > 0) {
+        guint parent = (pos - 1) / 2;
+        if (!merge_heap_before(ms, file, ms->heap[parent]))
+            break;
+        ms->heap[pos] = ms->heap[parent];
+        pos = parent;
+    }
+    ms->heap[pos] = file;
+}
+
+static void
+merge_heap_sift_down(merge_state_t *ms, guint pos)
+{
+    guint file = ms->heap[pos];
+
+    for (;;) {
+        guint child = 2 * pos + 1;
+        if (child >= ms->heap_len)
+            break;
+        if (child + 1 < ms->heap_len &&
+            merge_heap_before(ms, ms->heap[child + 1], ms->heap[child]))
+            child++;
+        if (!merge_heap_before(ms, ms->heap[child], file))
+            break;
+        ms->heap[pos] = ms->heap[child];
+        pos = child;
+    }
+    ms->heap[pos] = file;
+}
+
+/*
+ * Read the next record of an input file, reopening it first if we
+ * closed it to stay within MERGE_MAX_OPEN_FILES.  At EOF or on an
+ * error, its file descriptor is closed, as we won't read from it again.
+ */
+static gboolean
+merge_in_file_read(merge_state_t *ms, guint i, GArray *dsb_combined,
+                   int *err, gchar **err_info)
+{
+    merge_in_file_t      *in_file = &ms->in_files[i];
+    merge_in_file_priv_t *priv = &ms->priv[i];
+    gint64                data_offset;
+
+    if (priv->read_ahead != NULL)
+        return read_ahead_next(priv->read_ahead, priv, dsb_combined, err,
+                               err_info);
+
+    if (priv->fd_closed) {
+        merge_make_room(ms);
+        if (!file_fdreopen(in_file->wth->fh, in_file->filename)) {
+            *err = errno;
+            *err_info = NULL;
+            return FALSE;
+        }
+        priv->fd_closed = FALSE;
+        ms->open_files++;
+    }
+    priv->last_read = ++ms->reads;
+
+    if (!wtap_read(in_file->wth, err, err_info, &data_offset)) {
+        if (priv->reopenable)
+            merge_fdclose(ms, i);
         return FALSE;
     }
-    /* either one < two or one == two
-     * either way, return one
+    priv->rec = wtap_get_rec(in_file->wth);
+    priv->pd = wtap_get_buf_ptr(in_file->wth);
+    in_file->read_so_far = wtap_read_so_far(in_file->wth);
+
+    /*
+     * If any DSBs were read before this record, be sure to pass those now
+     * such that wtap_dump can pick it up.
      */
+    if (dsb_combined && in_file->wth->dsbs) {
+        GArray *in_dsb = in_file->wth->dsbs;
+        for (; in_file->dsbs_seen < in_dsb->len; in_file->dsbs_seen++) {
+            wtap_block_t wblock = g_array_index(in_dsb, wtap_block_t, in_file->dsbs_seen);
+            g_array_append_val(dsb_combined, wblock);
+        }
+    }
     return TRUE;
 }
 
@@ -232,8 +693,8 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
- * @param in_file_count number of entries in in_files
- * @param in_files input file array
+ * @param ms merge state
+ * @param dsb_combined DSBs for the output file, or NULL
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
  * @return pointer to merge_in_file_t for file from which that packet
@@ -241,78 +702,69 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * all files
  */
 static merge_in_file_t *
-merge_read_packet(int in_file_count, merge_in_file_t in_files[],
+merge_read_packet(merge_state_t *ms, GArray *dsb_combined,
                   int *err, gchar **err_info)
 {
-    int i;
-    int ei = -1;
-    nstime_t tv = NSTIME_INIT_MAX;
-    wtap_rec *rec;
-
-    /*
-     * Make sure we have a record available from each file that's not at
-     * EOF, and search for the record with the earliest time stamp or
-     * with no time stamp (those records are treated as earlier than
-     * all other records).  Yes, this means you won't get a chronological
-     * merge of those records, but you obviously *can't* get that.
-     */
-    for (i = 0; i < in_file_count; i++) {
-        gint64 data_offset;
+    merge_in_file_t *in_files = ms->in_files;
+    guint i;
 
-        if (in_files[i].state == RECORD_NOT_PRESENT) {
-            /*
-             * No packet available, and we haven't seen an error or EOF yet,
-             * so try to read the next packet.
-             */
-            if (!wtap_read(in_files[i].wth, err, err_info, &data_offset)) {
+    if (!ms->heap_filled) {
+        /* Read the first record of each file. */
+        for (i = 0; i < ms->in_file_count; i++) {
+            if (!merge_in_file_read(ms, i, dsb_combined, err, err_info)) {
                 if (*err != 0) {
                     in_files[i].state = GOT_ERROR;
                     return &in_files[i];
                 }
                 in_files[i].state = AT_EOF;
-            } else
-                in_files[i].state = RECORD_PRESENT;
-        }
-
-        if (in_files[i].state == RECORD_PRESENT) {
-            rec = wtap_get_rec(in_files[i].wth);
-            if (!(rec->presence_flags & WTAP_HAS_TS)) {
-                /*
-                 * No time stamp.  Pick this record, and stop looking.
-                 */
-                ei = i;
-                break;
+                continue;
             }
-            if (is_earlier(&rec->ts, &tv)) {
-                /*
-                 * This record's time stamp is earlier than any of the
-                 * records we've seen so far.  Pick it, for now, but
-                 * keep looking.
-                 */
-                tv = rec->ts;
-                ei = i;
+            in_files[i].state = RECORD_PRESENT;
+            ms->heap[ms->heap_len++] = i;
+            merge_heap_sift_up(ms, ms->heap_len - 1);
+        }
+        ms->heap_filled = TRUE;
+    } else if (ms->taken != NULL) {
+        /*
+         * Replace the record we handed out last time, which was at the
+         * top of the heap, with the next one from the same file.
+         */
+        i = (guint)(ms->taken - in_files);
+        ms->taken = NULL;
+        if (merge_in_file_read(ms, i, dsb_combined, err, err_info)) {
+            in_files[i].state = RECORD_PRESENT;
+        } else {
+            if (*err != 0) {
+                in_files[i].state = GOT_ERROR;
+                return &in_files[i];
             }
+            in_files[i].state = AT_EOF;
+            ms->heap[0] = ms->heap[--ms->heap_len];
         }
+        if (ms->heap_len != 0)
+            merge_heap_sift_down(ms, 0);
     }
 
-    if (ei == -1) {
+    if (ms->heap_len == 0) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
     }
 
     /* We'll need to read another packet from this file. */
-    in_files[ei].state = RECORD_NOT_PRESENT;
+    i = ms->heap[0];
+    in_files[i].state = RECORD_NOT_PRESENT;
+    ms->taken = &in_files[i];
 
     /* Count this packet. */
-    in_files[ei].packet_num++;
+    in_files[i].packet_num++;
 
     /*
      * Return a pointer to the merge_in_file_t of the file from which the
      * packet was read.
      */
     *err = 0;
-    return &in_files[ei];
+    return &in_files[i];
 }
 
 /** Read the next packet, in file sequence order, from the set of files
@@ -327,8 +779,8 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
- * @param in_file_count number of entries in in_files
- * @param in_files input file array
+ * @param ms merge state
+ * @param dsb_combined DSBs for the output file, or NULL
  * @param err wiretap error, if failed
  * @param err_info wiretap error string, if failed
  * @return pointer to merge_in_file_t for file from which that packet
@@ -336,19 +788,19 @@ merge_read_packet(int in_file_count, merge_in_file_t in_files[],
  * all files
  */
 static merge_in_file_t *
-merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
+merge_append_read_packet(merge_state_t *ms, GArray *dsb_combined,
                          int *err, gchar **err_info)
 {
-    int i;
-    gint64 data_offset;
+    merge_in_file_t *in_files = ms->in_files;
+    guint i;
 
     /*
      * Find the first file not at EOF, and read the next packet from it.
      */
-    for (i = 0; i < in_file_count; i++) {
+    for (i = 0; i < ms->in_file_count; i++) {
         if (in_files[i].state == AT_EOF)
             continue; /* This file is already at EOF */
-        if (wtap_read(in_files[i].wth, err, err_info, &data_offset))
+        if (merge_in_file_read(ms, i, dsb_combined, err, err_info))
             break; /* We have a packet */
         if (*err != 0) {
             /* Read error - quit immediately. */
@@ -358,7 +810,7 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
         /* EOF - flag this file as being at EOF, and try the next one. */
         in_files[i].state = AT_EOF;
     }
-    if (i == in_file_count) {
+    if (i == ms->in_file_count) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
@@ -828,10 +1280,27 @@ map_rec_interface_id(wtap_rec *rec, const merge_in_file_t *in_file)
     return TRUE;
 }
 
+/*
+ * Is a record in the span of time from start up to, but not including,
+ * stop?  Records without time stamps are kept.
+ */
+static gboolean
+in_time_range(const wtap_rec *rec, const nstime_t *start, const nstime_t *stop)
+{
+    if (!(rec->presence_flags & WTAP_HAS_TS))
+        return TRUE;
+    if (start != NULL && nstime_cmp(&rec->ts, start) < 0)
+        return FALSE;
+    if (stop != NULL && nstime_cmp(&rec->ts, stop) >= 0)
+        return FALSE;
+    return TRUE;
+}
+
 static merge_result
-merge_process_packets(wtap_dumper *pdh, const int file_type,
+merge_process_packets(merge_state_t *ms, wtap_dumper *pdh, const int file_type,
                       merge_in_file_t *in_files, const guint in_file_count,
                       const gboolean do_append, guint snaplen,
+                      const nstime_t *start, const nstime_t *stop,
                       merge_progress_callback_t* cb,
                       GArray *dsb_combined,
                       int *err, gchar **err_info, guint *err_fileno,
@@ -843,15 +1312,17 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
     gboolean            stop_flag = FALSE;
     wtap_rec *rec,      snap_rec;
 
+    merge_start_read_ahead(ms);
+
     for (;;) {
         *err = 0;
 
         if (do_append) {
-            in_file = merge_append_read_packet(in_file_count, in_files, err,
+            in_file = merge_append_read_packet(ms, dsb_combined, err,
                                                err_info);
         }
         else {
-            in_file = merge_read_packet(in_file_count, in_files, err,
+            in_file = merge_read_packet(ms, dsb_combined, err,
                                         err_info);
         }
 
@@ -876,7 +1347,10 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
             break;
         }
 
-        rec = wtap_get_rec(in_file->wth);
+        rec = ms->priv[in_file - in_files].rec;
+
+        if ((start != NULL || stop != NULL) && !in_time_range(rec, start, stop))
+            continue;
 
         switch (rec->rec_type) {
 
@@ -913,20 +1387,8 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
                 }
             }
         }
-        /*
-         * If any DSBs were read before this record, be sure to pass those now
-         * such that wtap_dump can pick it up.
-         */
-        if (dsb_combined && in_file->wth->dsbs) {
-            GArray *in_dsb = in_file->wth->dsbs;
-            for (guint i = in_file->dsbs_seen; i < in_dsb->len; i++) {
-                wtap_block_t wblock = g_array_index(in_dsb, wtap_block_t, i);
-                g_array_append_val(dsb_combined, wblock);
-                in_file->dsbs_seen++;
-            }
-        }
 
-        if (!wtap_dump(pdh, rec, wtap_get_buf_ptr(in_file->wth), err, err_info)) {
+        if (!wtap_dump(pdh, rec, ms->priv[in_file - in_files].pd, err, err_info)) {
             status = MERGE_ERR_CANT_WRITE_OUTFILE;
             break;
         }
@@ -953,7 +1415,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
      * holds references to blocks in the input file (such as the DSB). Even if
      * those DSBs are only written when wtap_dump is called and nothing bad will
      * happen now, let's keep all pointers in pdh valid for correctness sake. */
-    merge_close_in_files(in_file_count, in_files);
+    merge_close_in_files(ms, in_file_count, in_files);
 
     if (status == MERGE_OK || in_file == NULL) {
         *err_fileno = 0;
@@ -969,9 +1431,12 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
 static merge_result
 merge_files_common(const gchar* out_filename, /* normal output mode */
                    gchar **out_filenamep, const char *pfx, /* tempfile mode  */
-                   const int file_type, const char *const *in_filenames,
+                   const int file_type,
+                   const wtap_compression_type compression_type,
+                   const char *const *in_filenames,
                    const guint in_file_count, const gboolean do_append,
                    const idb_merge_mode mode, guint snaplen,
+                   const nstime_t *start, const nstime_t *stop,
                    const gchar *app_name, merge_progress_callback_t* cb,
                    int *err, gchar **err_info, guint *err_fileno,
                    guint32 *err_framenum)
@@ -983,6 +1448,7 @@ merge_files_common(const gchar* out_filename, /* normal output mode */
     GArray             *shb_hdrs = NULL;
     wtapng_iface_descriptions_t *idb_inf = NULL;
     GArray             *dsb_combined = NULL;
+    merge_state_t      *ms;
 
     g_assert(in_file_count > 0);
     g_assert(in_filenames != NULL);
@@ -997,9 +1463,11 @@ merge_files_common(const gchar* out_filename, /* normal output mode */
     merge_debug("merge_files: begin");
 
     /* open the input files */
-    if (!merge_open_in_files(in_file_count, in_filenames, &in_files, cb,
+    ms = merge_state_new(in_file_count);
+    if (!merge_open_in_files(ms, in_file_count, in_filenames, &in_files, cb,
                              err, err_info, err_fileno)) {
         merge_debug("merge_files: merge_open_in_files() failed with err=%d", *err);
+        merge_state_free(ms);
         *err_framenum = 0;
         return MERGE_ERR_CANT_OPEN_INFILE;
     }
@@ -1040,15 +1508,16 @@ merge_files_common(const gchar* out_filename, /* normal output mode */
         params.dsbs_growing = dsb_combined;
     }
     if (out_filename) {
-        pdh = wtap_dump_open(out_filename, file_type, WTAP_UNCOMPRESSED, &params, err);
+        pdh = wtap_dump_open(out_filename, file_type, compression_type, &params, err);
     } else if (out_filenamep) {
         pdh = wtap_dump_open_tempfile(out_filenamep, pfx, file_type,
-                                      WTAP_UNCOMPRESSED, &params, err);
+                                      compression_type, &params, err);
     } else {
-        pdh = wtap_dump_open_stdout(file_type, WTAP_UNCOMPRESSED, &params, err);
+        pdh = wtap_dump_open_stdout(file_type, compression_type, &params, err);
     }
     if (pdh == NULL) {
-        merge_close_in_files(in_file_count, in_files);
+        merge_close_in_files(ms, in_file_count, in_files);
+        merge_state_free(ms);
         g_free(in_files);
         wtap_block_array_free(shb_hdrs);
         wtap_free_idb_info(idb_inf);
@@ -1062,10 +1531,12 @@ merge_files_common(const gchar* out_filename, /* normal output mode */
     if (cb)
         cb->callback_func(MERGE_EVENT_READY_TO_MERGE, 0, in_files, in_file_count, cb->data);
 
-    status = merge_process_packets(pdh, file_type, in_files, in_file_count,
-                                   do_append, snaplen, cb, dsb_combined, err, err_info,
+    status = merge_process_packets(ms, pdh, file_type, in_files, in_file_count,
+                                   do_append, snaplen, start, stop, cb,
+                                   dsb_combined, err, err_info,
                                    err_fileno, err_framenum);
 
+    merge_state_free(ms);
     g_free(in_files);
     wtap_block_array_free(shb_hdrs);
     wtap_free_idb_info(idb_inf);
@@ -1083,6 +1554,7 @@ merge_files_common(const gchar* out_filename, /* normal output mode */
  */
 merge_result
 merge_files(const gchar* out_filename, const int file_type,
+            const wtap_compression_type compression_type,
             const char *const *in_filenames, const guint in_file_count,
             const gboolean do_append, const idb_merge_mode mode,
             guint snaplen, const gchar *app_name, merge_progress_callback_t* cb,
@@ -1092,8 +1564,10 @@ merge_files(const gchar* out_filename, const int file_type,
     g_assert(out_filename != NULL);
 
     return merge_files_common(out_filename, NULL, NULL,
-                              file_type, in_filenames, in_file_count,
-                              do_append, mode, snaplen, app_name, cb, err,
+                              file_type, compression_type,
+                              in_filenames, in_file_count,
+                              do_append, mode, snaplen, NULL, NULL,
+                              app_name, cb, err,
                               err_info, err_fileno, err_framenum);
 }
 
@@ -1117,8 +1591,10 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
     *out_filenamep = NULL;
 
     return merge_files_common(NULL, out_filenamep, pfx,
-                              file_type, in_filenames, in_file_count,
-                              do_append, mode, snaplen, app_name, cb, err,
+                              file_type, WTAP_UNCOMPRESSED,
+                              in_filenames, in_file_count,
+                              do_append, mode, snaplen, NULL, NULL,
+                              app_name, cb, err,
                               err_info, err_fileno, err_framenum);
 }
 
@@ -1128,7 +1604,9 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
  * on failure.
  */
 merge_result
-merge_files_to_stdout(const int file_type, const char *const *in_filenames,
+merge_files_to_stdout(const int file_type,
+                      const wtap_compression_type compression_type,
+                      const char *const *in_filenames,
                       const guint in_file_count, const gboolean do_append,
                       const idb_merge_mode mode, guint snaplen,
                       const gchar *app_name, merge_progress_callback_t* cb,
@@ -1136,8 +1614,35 @@ merge_files_to_stdout(const int file_type, const char *const *in_filenames,
                       guint32 *err_framenum)
 {
     return merge_files_common(NULL, NULL, NULL,
-                              file_type, in_filenames, in_file_count,
-                              do_append, mode, snaplen, app_name, cb, err,
+                              file_type, compression_type,
+                              in_filenames, in_file_count,
+                              do_append, mode, snaplen, NULL, NULL,
+                              app_name, cb, err,
+                              err_info, err_fileno, err_framenum);
+}
+
+/*
+ * Merges the records of the files from one time up to another to an
+ * output file, or to the standard output if out_filename is NULL, and
+ * invokes callback during execution. Returns MERGE_OK on success, or a
+ * MERGE_ERR_XXX on failure.
+ */
+merge_result
+merge_files_in_time_range(const gchar* out_filename, const int file_type,
+                          const wtap_compression_type compression_type,
+                          const char *const *in_filenames,
+                          const guint in_file_count, const gboolean do_append,
+                          const idb_merge_mode mode, guint snaplen,
+                          const nstime_t *start, const nstime_t *stop,
+                          const gchar *app_name, merge_progress_callback_t* cb,
+                          int *err, gchar **err_info, guint *err_fileno,
+                          guint32 *err_framenum)
+{
+    return merge_files_common(out_filename, NULL, NULL,
+                              file_type, compression_type,
+                              in_filenames, in_file_count,
+                              do_append, mode, snaplen, start, stop,
+                              app_name, cb, err,
                               err_info, err_fileno, err_framenum);
 }
 
@@ -35,6 +35,7 @@ typedef struct merge_in_file_s {
     gint64          size;           /* file size */
     GArray         *idb_index_map;  /* used for mapping the old phdr interface_id values to new during merge */
     guint           dsbs_seen;      /* number of elements processed so far from wth->dsbs */
+    gint64          read_so_far;    /* bytes read up to the record last merged from the file, for progress reports */
 } merge_in_file_t;
 
 /** Return values from merge_files(). */
@@ -115,6 +116,7 @@ typedef struct {
  *
  * @param out_filename The output filename
  * @param file_type The WTAP_FILE_TYPE_SUBTYPE_XXX output file type
+ * @param compression_type The WTAP_XXX_COMPRESSION compression type, if any
  * @param in_filenames An array of input filenames to merge from
  * @param in_file_count The number of entries in in_filenames
  * @param do_append Whether to append by file order instead of chronological order
@@ -134,6 +136,7 @@ typedef struct {
  */
 WS_DLL_PUBLIC merge_result
 merge_files(const gchar* out_filename, const int file_type,
+            const wtap_compression_type compression_type,
             const char *const *in_filenames, const guint in_file_count,
             const gboolean do_append, const idb_merge_mode mode,
             guint snaplen, const gchar *app_name, merge_progress_callback_t* cb,
@@ -175,6 +178,7 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
 /** Merge the given input files to the standard output
  *
  * @param file_type The WTAP_FILE_TYPE_SUBTYPE_XXX output file type
+ * @param compression_type The WTAP_XXX_COMPRESSION compression type, if any
  * @param in_filenames An array of input filenames to merge from
  * @param in_file_count The number of entries in in_filenames
  * @param do_append Whether to append by file order instead of chronological order
@@ -193,13 +197,51 @@ merge_files_to_tempfile(gchar **out_filenamep, const char *pfx,
  * @return the frame type
  */
 WS_DLL_PUBLIC merge_result
-merge_files_to_stdout(const int file_type, const char *const *in_filenames,
+merge_files_to_stdout(const int file_type,
+                      const wtap_compression_type compression_type,
+                      const char *const *in_filenames,
                       const guint in_file_count, const gboolean do_append,
                       const idb_merge_mode mode, guint snaplen,
                       const gchar *app_name, merge_progress_callback_t* cb,
                       int *err, gchar **err_info, guint *err_fileno,
                       guint32 *err_framenum);
 
+/** Merge the records of the given input files from one time up to, but
+ *  not including, another to an output file or the standard output
+ *
+ * @param out_filename The output filename, or NULL for the standard output
+ * @param file_type The WTAP_FILE_TYPE_SUBTYPE_XXX output file type
+ * @param compression_type The WTAP_XXX_COMPRESSION compression type, if any
+ * @param in_filenames An array of input filenames to merge from
+ * @param in_file_count The number of entries in in_filenames
+ * @param do_append Whether to append by file order instead of chronological order
+ * @param mode The IDB_MERGE_MODE_XXX merge mode for interface data
+ * @param snaplen The snaplen to limit it to, or 0 to leave as it is in the files
+ * @param start The time of the first records to keep, or NULL for no limit
+ * @param stop The time of the first records not to keep, or NULL for no limit
+ * @param app_name The application name performing the merge, used in SHB info
+ * @param cb The callback information to use during execution
+ * @param[out] err Set to the internal WTAP_ERR_XXX error code if it failed
+ *   with MERGE_ERR_CANT_OPEN_INFILE, MERGE_ERR_CANT_OPEN_OUTFILE,
+ *   MERGE_ERR_CANT_READ_INFILE, MERGE_ERR_CANT_WRITE_OUTFILE, or
+ *   MERGE_ERR_CANT_CLOSE_OUTFILE
+ * @param[out] err_info Additional information for some WTAP_ERR_XXX codes
+ * @param[out] err_fileno Set to the input file number which failed, if it
+ *   failed
+ * @param[out] err_framenum Set to the input frame number if it failed
+ * @return the frame type
+ */
+WS_DLL_PUBLIC merge_result
+merge_files_in_time_range(const gchar* out_filename, const int file_type,
+                          const wtap_compression_type compression_type,
+                          const char *const *in_filenames,
+                          const guint in_file_count, const gboolean do_append,
+                          const idb_merge_mode mode, guint snaplen,
+                          const nstime_t *start, const nstime_t *stop,
+                          const gchar *app_name, merge_progress_callback_t* cb,
+                          int *err, gchar **err_info, guint *err_fileno,
+                          guint32 *err_framenum);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -1309,10 +1309,17 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *pn, wta
     wblock->rec->ts.secs = (time_t)(ts / iface_info.time_units_per_second);
     wblock->rec->ts.nsecs = (int)(((ts % iface_info.time_units_per_second) * 1000000000) / iface_info.time_units_per_second);
 
-    /* "(Enhanced) Packet Block" read capture data */
-    if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
-                                packet.cap_len - pseudo_header_len, err, err_info))
-        return FALSE;
+    /* "(Enhanced) Packet Block" read capture data; it's left in place
+       in a mapped file unless it has to be byte-swapped afterwards */
+    if (pn->byte_swapped) {
+        if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+                                    packet.cap_len - pseudo_header_len, err, err_info))
+            return FALSE;
+    } else {
+        if (!wtap_read_packet_bytes_in_place(fh, wblock->frame_buffer,
+                                             packet.cap_len - pseudo_header_len, err, err_info))
+            return FALSE;
+    }
     block_read += packet.cap_len - pseudo_header_len;
 
     /* jump over potential padding bytes at end of the packet data */
@@ -1588,9 +1595,15 @@ pcapng_read_simple_packet_block(FILE_T fh, pcapng_block_header_t *bh, pcapng_t *
     memset((void *)&wblock->rec->rec_header.packet_header.pseudo_header, 0, sizeof(union wtap_pseudo_header));
 
     /* "Simple Packet Block" read capture data */
-    if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
-                                simple_packet.cap_len, err, err_info))
-        return FALSE;
+    if (pn->byte_swapped) {
+        if (!wtap_read_packet_bytes(fh, wblock->frame_buffer,
+                                    simple_packet.cap_len, err, err_info))
+            return FALSE;
+    } else {
+        if (!wtap_read_packet_bytes_in_place(fh, wblock->frame_buffer,
+                                             simple_packet.cap_len, err, err_info))
+            return FALSE;
+    }
 
     /* jump over potential padding bytes at end of the packet data */
     if ((simple_packet.cap_len % 4) != 0) {
@@ -2785,6 +2798,164 @@ pcapng_open(wtap *wth, int *err, gchar **err_info)
 }
 
 
+/*
+ * How many blocks in a row have to look right for pcapng_find_block()
+ * to take the first of them as a block.
+ */
+#define BLOCKS_TO_CHECK 3
+
+/*
+ * Does what's at "offset" look like a block, with a known type and a
+ * sane length, with the length repeated at the end?
+ *
+ * Returns 1 if it does, setting *block_len, 0 if it doesn't or "offset"
+ * is the end of the file, and -1 on an I/O error.  A section header
+ * block sets *byte_swapped from its byte-order magic.
+ */
+static int
+pcapng_check_block(wtap *wth, gint64 offset, gboolean *byte_swapped,
+                   guint32 *block_len, int *err, gchar **err_info)
+{
+    pcapng_t *pn = (pcapng_t *)wth->priv;
+    pcapng_block_header_t bh;
+    pcapng_enhanced_packet_block_t epb;
+    guint32 magic;
+    guint32 trailer;
+
+    if (file_seek(wth->fh, offset, SEEK_SET, err) == -1)
+        return -1;
+    if (!wtap_read_bytes_or_eof(wth->fh, &bh, sizeof bh, err, err_info)) {
+        if (*err == 0 || *err == WTAP_ERR_SHORT_READ)
+            return 0;
+        return -1;
+    }
+
+    if (bh.block_type == BLOCK_TYPE_SHB) {
+        /* The type reads the same either way; the magic tells. */
+        if (!wtap_read_bytes(wth->fh, &magic, sizeof magic, err, err_info))
+            return *err == WTAP_ERR_SHORT_READ ? 0 : -1;
+        if (magic == PCAPNG_MAGIC)
+            *byte_swapped = FALSE;
+        else if (magic == PCAPNG_SWAPPED_MAGIC)
+            *byte_swapped = TRUE;
+        else
+            return 0;
+    }
+    if (*byte_swapped) {
+        bh.block_type = GUINT32_SWAP_LE_BE(bh.block_type);
+        bh.block_total_length = GUINT32_SWAP_LE_BE(bh.block_total_length);
+    }
+
+    switch (bh.block_type) {
+
+    case BLOCK_TYPE_SHB:
+    case BLOCK_TYPE_IDB:
+    case BLOCK_TYPE_PB:
+    case BLOCK_TYPE_SPB:
+    case BLOCK_TYPE_NRB:
+    case BLOCK_TYPE_ISB:
+    case BLOCK_TYPE_IRIG_TS:
+    case BLOCK_TYPE_ARINC_429:
+    case BLOCK_TYPE_SYSTEMD_JOURNAL:
+    case BLOCK_TYPE_DSB:
+    case BLOCK_TYPE_SYSDIG_EVENT:
+    case BLOCK_TYPE_SYSDIG_EVF:
+        break;
+
+    case BLOCK_TYPE_EPB:
+        /*
+         * By far the most common block, so check the interface and
+         * captured length as well.  Interfaces described later in the
+         * file aren't known yet, so a block for one of them is missed;
+         * that's only a problem for the first block of a chunk, and
+         * pcapng_find_block() callers check for it.
+         */
+        if (bh.block_total_length < MIN_EPB_SIZE)
+            return 0;
+        if (!wtap_read_bytes(wth->fh, &epb, sizeof epb, err, err_info))
+            return *err == WTAP_ERR_SHORT_READ ? 0 : -1;
+        if (*byte_swapped) {
+            epb.interface_id = GUINT32_SWAP_LE_BE(epb.interface_id);
+            epb.captured_len = GUINT32_SWAP_LE_BE(epb.captured_len);
+        }
+        if (epb.interface_id >= pn->interfaces->len ||
+            epb.captured_len > bh.block_total_length - MIN_EPB_SIZE)
+            return 0;
+        break;
+
+    default:
+        return 0;
+    }
+
+    if (bh.block_total_length < MIN_BLOCK_SIZE ||
+        bh.block_total_length > MAX_BLOCK_SIZE ||
+        (bh.block_total_length % 4) != 0)
+        return 0;
+
+    if (file_seek(wth->fh, offset + bh.block_total_length - sizeof trailer,
+                  SEEK_SET, err) == -1)
+        return -1;
+    if (!wtap_read_bytes(wth->fh, &trailer, sizeof trailer, err, err_info))
+        return *err == WTAP_ERR_SHORT_READ ? 0 : -1;
+    if (*byte_swapped)
+        trailer = GUINT32_SWAP_LE_BE(trailer);
+    if (trailer != bh.block_total_length)
+        return 0;
+
+    *block_len = bh.block_total_length;
+    return 1;
+}
+
+/*
+ * Find the first block that starts at or after "offset" and before "end",
+ * when reading the file in chunks, and position wth->fh at it.  Blocks
+ * are 4-byte aligned and have their length at both ends, so this looks
+ * for an aligned offset where BLOCKS_TO_CHECK blocks in a row, or the
+ * blocks up to the end of the file, look right.
+ *
+ * Returns the offset of the block, "end" if none was found, or -1 on an
+ * I/O error.
+ */
+gint64
+pcapng_find_block(wtap *wth, gint64 offset, gint64 end, int *err,
+                  gchar **err_info)
+{
+    pcapng_t *pn = (pcapng_t *)wth->priv;
+    gint64 pos, next;
+    gboolean byte_swapped;
+    gint64 file_size;
+    guint32 block_len;
+    int i, ret;
+
+    file_size = wtap_file_size(wth, err);
+    if (file_size == -1)
+        return -1;
+
+    for (pos = (offset + 3) & ~G_GINT64_CONSTANT(3); pos < end; pos += 4) {
+        byte_swapped = pn->byte_swapped;
+        next = pos;
+        for (i = 0; i < BLOCKS_TO_CHECK; i++) {
+            ret = pcapng_check_block(wth, next, &byte_swapped, &block_len,
+                                     err, err_info);
+            if (ret == -1)
+                return -1;
+            if (ret == 0)
+                break;
+            next += block_len;
+        }
+        /*
+         * Take it if all the blocks looked right, or if those that
+         * did run up to the end of the file.
+         */
+        if (i == BLOCKS_TO_CHECK || (i > 0 && next == file_size)) {
+            if (file_seek(wth->fh, pos, SEEK_SET, err) == -1)
+                return -1;
+            return pos;
+        }
+    }
+    return end;
+}
+
 /* classic wtap: read packet */
 static gboolean
 pcapng_read(wtap *wth, int *err, gchar **err_info, gint64 *data_offset)
@@ -73,6 +73,8 @@ struct pcapng_option_header {
 #define MIN_DSB_SIZE    ((guint32)(MIN_BLOCK_SIZE + sizeof(pcapng_decryption_secrets_block_t)))
 
 wtap_open_return_val pcapng_open(wtap *wth, int *err, gchar **err_info);
+gint64 pcapng_find_block(wtap *wth, gint64 offset, gint64 end, int *err,
+                         gchar **err_info);
 gboolean pcapng_dump_open(wtap_dumper *wdh, int *err);
 int pcapng_dump_can_write_encap(int encap);
 
@@ -35,6 +35,7 @@ struct wtap {
     FILE_T                      fh;
     FILE_T                      random_fh;              /**< Secondary FILE_T for random access */
     gboolean                    ispipe;                 /**< TRUE if the file is a pipe */
+    gchar                      *spill_path;             /**< Temporary file the pipe is copied to for random access, or NULL */
     int                         file_type_subtype;
     guint                       snapshot_length;
     wtap_rec                    rec;
@@ -93,6 +94,8 @@ struct wtap_dumper {
     wtap_compression_type   compression_type;
     gboolean                needs_reload;   /* TRUE if the file requires re-loading after saving with wtap */
     gint64                  bytes_dumped;
+    gboolean                async_write;    /* fh is a ws_cwstream even though we're not compressing */
+    ws_cwstream_options     write_options;
 
     void                    *priv;          /* this one holds per-file state and is free'd automatically by wtap_dump_close() */
     void                    *wslua_data;    /* this one holds wslua state info and is not free'd */
@@ -313,6 +316,23 @@ gboolean
 wtap_read_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
     gchar **err_info);
 
+/*
+ * Read packet data into a Buffer, as wtap_read_packet_bytes() does, but
+ * without copying it if the file is being read through a mapping of it;
+ * the caller must not modify the data.
+ */
+gboolean
+wtap_read_packet_bytes_in_place(FILE_T fh, Buffer *buf, guint length,
+    int *err, gchar **err_info);
+
+/*
+ * The number of blocks read so far that the reader keeps because they
+ * affect the records that follow them, such as section headers and
+ * interface descriptions.
+ */
+guint32
+wtap_state_block_count(wtap *wth);
+
 /*
  * Implementation of wth->subtype_read that reads the full file contents
  * as a single packet.
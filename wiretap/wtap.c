@@ -1227,6 +1227,11 @@ wtap_close(wtap *wth)
 	if (wth->random_fh != NULL)
 		file_close(wth->random_fh);
 
+	if (wth->spill_path != NULL) {
+		ws_unlink(wth->spill_path);
+		g_free(wth->spill_path);
+	}
+
 	g_free(wth->priv);
 
 	if (wth->fast_seek != NULL) {
@@ -1248,6 +1253,15 @@ wtap_cleareof(wtap *wth) {
 	file_clearerr(wth->fh);
 }
 
+void
+wtap_disable_mapping(wtap *wth)
+{
+	if (wth->fh != NULL)
+		file_set_unmapped(wth->fh);
+	if (wth->random_fh != NULL)
+		file_set_unmapped(wth->random_fh);
+}
+
 void wtap_set_cb_new_ipv4(wtap *wth, wtap_new_ipv4_callback_t add_new_ipv4) {
 	if (wth)
 		wth->add_new_ipv4 = add_new_ipv4;
@@ -1398,6 +1412,44 @@ wtap_read_packet_bytes(FILE_T fh, Buffer *buf, guint length, int *err,
 	    err_info);
 }
 
+/*
+ * Read packet data into a Buffer, as wtap_read_packet_bytes() does, but
+ * if the data is in a mapping of the file, have the Buffer point to it
+ * there rather than copying it.  The data must not be modified.
+ */
+gboolean
+wtap_read_packet_bytes_in_place(FILE_T fh, Buffer *buf, guint length,
+    int *err, gchar **err_info)
+{
+	guint8 *data;
+
+	data = file_read_mapped(fh, length);
+	if (data == NULL)
+		return wtap_read_packet_bytes(fh, buf, length, err, err_info);
+	ws_buffer_lend(buf, data, length);
+	return TRUE;
+}
+
+/*
+ * The number of blocks read so far that aren't records, but that the
+ * reader keeps because they affect what follows them.  They're read
+ * when the file is read sequentially, so anything that stands in for
+ * reading the file sequentially, such as an index, or that reads only
+ * part of it, has to take them into account.
+ */
+guint32
+wtap_state_block_count(wtap *wth)
+{
+	guint32 count;
+
+	count = wth->shb_hdrs->len + wth->interface_data->len;
+	if (wth->nrb_hdrs != NULL)
+		count += wth->nrb_hdrs->len;
+	if (wth->dsbs != NULL)
+		count += wth->dsbs->len;
+	return count;
+}
+
 /*
  * Return an approximation of the amount of data we've read sequentially
  * from the file so far.  (gint64, in case that's 64 bits.)
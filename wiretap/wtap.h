@@ -14,6 +14,7 @@
 #include <wsutil/buffer.h>
 #include <wsutil/nstime.h>
 #include <wsutil/inet_addr.h>
+#include <wsutil/cwstream.h>
 #include "wtap_opttypes.h"
 #include "ws_symbol_export.h"
 #include "ws_attributes.h"
@@ -1454,6 +1455,9 @@ typedef struct wtap_dump_params {
     const GArray *dsbs_growing;             /**< DSBs that will be written while writing packets, or NULL.
                                                  This array may grow since the dumper was opened and will subsequently
                                                  be written before newer packets are written in wtap_dump. */
+    const ws_cwstream_options *write_options; /**< If not NULL, gather what's written into large buffers,
+                                                 written on a thread of their own, even if the file isn't
+                                                 compressed; not for file types that need to seek. */
 } wtap_dump_params;
 
 /* Zero-initializer for wtap_dump_params. */
@@ -1659,6 +1663,18 @@ WS_DLL_PUBLIC
 struct wtap* wtap_open_offline(const char *filename, unsigned int type, int *err,
     gchar **err_info, gboolean do_random);
 
+/**
+ * Set whether wtap_open_offline() may open a pipe, or the standard input,
+ * for random access.  If so, what's read from it is copied to a temporary
+ * file, which random access reads from, and which is removed when the
+ * wtap is closed; otherwise, such opens fail with WTAP_ERR_RANDOM_OPEN_PIPE
+ * or WTAP_ERR_RANDOM_OPEN_STDIN.  Off by default.
+ *
+ * @param spill TRUE to copy pipes to a temporary file, FALSE not to
+ */
+WS_DLL_PUBLIC
+void wtap_set_pipe_spill(gboolean spill);
+
 /**
  * If we were compiled with zlib and we're at EOF, unset EOF so that
  * wtap_read/gzread has a chance to succeed. This is necessary if
@@ -1667,6 +1683,15 @@ struct wtap* wtap_open_offline(const char *filename, unsigned int type, int *err
 WS_DLL_PUBLIC
 void wtap_cleareof(wtap *wth);
 
+/**
+ * Read the file with read() rather than through a memory mapping of it.
+ * Do this for a file that's still being written to, such as a live
+ * capture's; if a mapped file is truncated while it's being read,
+ * reading it kills the process with SIGBUS.
+ */
+WS_DLL_PUBLIC
+void wtap_disable_mapping(wtap *wth);
+
 /**
  * Set callback functions to add new hostnames. Currently pcapng-only.
  * MUST match add_ipv4_name and add_ipv6_name in addr_resolv.c.
@@ -1718,7 +1743,10 @@ void wtap_rec_cleanup(wtap_rec *rec);
  */
 typedef enum {
     WTAP_UNCOMPRESSED,
-    WTAP_GZIP_COMPRESSED
+    WTAP_GZIP_COMPRESSED,
+    WTAP_ZSTD_COMPRESSED,
+    WTAP_LZ4_COMPRESSED,
+    WTAP_UNKNOWN_COMPRESSION
 } wtap_compression_type;
 
 WS_DLL_PUBLIC
@@ -1730,6 +1758,21 @@ const char *wtap_compression_type_extension(wtap_compression_type compression_ty
 WS_DLL_PUBLIC
 GSList *wtap_get_all_compression_type_extensions_list(void);
 
+/*
+ * Look up a compression type by the name used for it on command lines,
+ * such as "gzip" or "zstd"; returns WTAP_UNKNOWN_COMPRESSION if there's
+ * no such type, and WTAP_UNCOMPRESSED for "none".
+ */
+WS_DLL_PUBLIC
+wtap_compression_type wtap_name_to_compression_type(const char *name);
+
+/*
+ * Return a list of the names of the compression types files can be
+ * written with; free it with g_slist_free().
+ */
+WS_DLL_PUBLIC
+GSList *wtap_get_all_output_compression_type_names_list(void);
+
 /*** get various information snippets about the current file ***/
 
 /** Return an approximation of the amount of data we've read sequentially
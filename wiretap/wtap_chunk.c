@@ -0,0 +1,223 @@
+/* wtap_chunk.c
+ * Routines for reading capture files in chunks.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include "wtap-int.h"
+#include "file_wrappers.h"
+#include "libpcap.h"
+#include "pcapng.h"
+#include "wtap_chunk.h"
+
+struct wtap_chunk {
+    wtap       *wth;
+    gint64      end;            /* end of the chunk's range */
+    gboolean    found_start;    /* a record was found in the range */
+    gint64      first_offset;   /* offset of the first record read, or -1 */
+    gint64      stop_offset;    /* offset of the record after the chunk, or -1 */
+    guint32     state_blocks;   /* wtap_state_block_count() when opened */
+    gboolean    state_changed;  /* state blocks were read */
+    gboolean    done;
+};
+
+static gboolean
+can_read_chunks(wtap *wth)
+{
+    if (wth->ispipe || wtap_get_compression_type(wth) != WTAP_UNCOMPRESSED)
+        return FALSE;
+
+    switch (wth->file_type_subtype) {
+
+    case WTAP_FILE_TYPE_SUBTYPE_PCAP:
+    case WTAP_FILE_TYPE_SUBTYPE_PCAP_NSEC:
+    case WTAP_FILE_TYPE_SUBTYPE_PCAPNG:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+GArray *
+wtap_chunk_split(wtap *wth, guint max_chunks)
+{
+    GArray *bounds;
+    gint64 data_start, size, chunk_size, bound;
+    guint n_chunks, i;
+    int err;
+
+    if (!can_read_chunks(wth))
+        return NULL;
+
+    data_start = file_tell(wth->fh);
+    size = wtap_file_size(wth, &err);
+    if (size == -1 || size <= data_start)
+        return NULL;
+
+    n_chunks = (guint)MIN((gint64)max_chunks,
+                          (size - data_start) / WTAP_CHUNK_MIN_SIZE);
+    if (n_chunks < 2)
+        return NULL;
+    chunk_size = (size - data_start) / n_chunks;
+
+    bounds = g_array_sized_new(FALSE, FALSE, sizeof(gint64), n_chunks + 1);
+    g_array_append_val(bounds, data_start);
+    for (i = 1; i < n_chunks; i++) {
+        bound = data_start + i * chunk_size;
+        g_array_append_val(bounds, bound);
+    }
+    g_array_append_val(bounds, size);
+    return bounds;
+}
+
+wtap_chunk_t *
+wtap_chunk_open(const char *filename, gint64 start, gint64 end, int *err,
+                gchar **err_info)
+{
+    wtap *wth;
+    wtap_chunk_t *chunk;
+    gint64 first;
+
+    wth = wtap_open_offline(filename, WTAP_TYPE_AUTO, err, err_info, FALSE);
+    if (wth == NULL)
+        return NULL;
+    if (!can_read_chunks(wth)) {
+        /* It's changed since it was split. */
+        wtap_close(wth);
+        *err = WTAP_ERR_CANT_OPEN;
+        return NULL;
+    }
+
+    /*
+     * The first chunk starts with the first record; the others start
+     * with the first record the reader can find in their range.
+     */
+    first = file_tell(wth->fh);
+    if (start > first) {
+        if (wth->file_type_subtype == WTAP_FILE_TYPE_SUBTYPE_PCAPNG)
+            first = pcapng_find_block(wth, start, end, err, err_info);
+        else
+            first = libpcap_find_record(wth, start, end, err, err_info);
+        if (first == -1) {
+            wtap_close(wth);
+            return NULL;
+        }
+    }
+
+    chunk = g_new0(wtap_chunk_t, 1);
+    chunk->wth = wth;
+    chunk->end = end;
+    chunk->found_start = first < end;
+    chunk->first_offset = -1;
+    chunk->stop_offset = -1;
+    chunk->state_blocks = wtap_state_block_count(wth);
+    chunk->done = !chunk->found_start;
+    return chunk;
+}
+
+wtap *
+wtap_chunk_wtap(wtap_chunk_t *chunk)
+{
+    return chunk->wth;
+}
+
+gboolean
+wtap_chunk_read(wtap_chunk_t *chunk, int *err, gchar **err_info,
+                gint64 *offset)
+{
+    gboolean ok;
+
+    *err = 0;
+    *err_info = NULL;
+    if (chunk->done)
+        return FALSE;
+
+    ok = wtap_read(chunk->wth, err, err_info, offset);
+
+    /*
+     * Anything the reader keeps from the blocks it's read, including
+     * any it read on the way to the record after the chunk, might have
+     * been needed by the chunks after this one.
+     */
+    if (wtap_state_block_count(chunk->wth) != chunk->state_blocks)
+        chunk->state_changed = TRUE;
+
+    if (!ok) {
+        chunk->done = TRUE;
+        if (*err == 0) {
+            /* The end of the file. */
+            chunk->stop_offset = file_tell(chunk->wth->fh);
+            if (chunk->first_offset == -1)
+                chunk->first_offset = chunk->stop_offset;
+        }
+        return FALSE;
+    }
+    if (chunk->first_offset == -1)
+        chunk->first_offset = *offset;
+    if (*offset >= chunk->end) {
+        /* That's the first record of the next chunk. */
+        chunk->done = TRUE;
+        chunk->stop_offset = *offset;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean
+wtap_chunks_consistent(GPtrArray *chunks)
+{
+    wtap_chunk_t *chunk;
+    gint64 expected = -1;
+    guint i;
+
+    for (i = 0; i < chunks->len; i++) {
+        chunk = (wtap_chunk_t *)g_ptr_array_index(chunks, i);
+        if (chunk->found_start) {
+            /*
+             * Its first record has to be the one that the chunk before
+             * it stopped at, which it found by reading the file through.
+             */
+            if (chunk->stop_offset == -1 ||
+                (i > 0 && chunk->first_offset != expected))
+                return FALSE;
+            expected = chunk->stop_offset;
+        } else {
+            /*
+             * No record starts in its range, so the record the chunk
+             * before it stopped at had better start after it.
+             */
+            if (i == 0 || expected < chunk->end)
+                return FALSE;
+        }
+        if (chunk->state_changed && i < chunks->len - 1)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+void
+wtap_chunk_close(wtap_chunk_t *chunk)
+{
+    wtap_close(chunk->wth);
+    g_free(chunk);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,92 @@
+/* wtap_chunk.h
+ * Definitions for reading capture files in chunks.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WTAP_CHUNK_H__
+#define __WTAP_CHUNK_H__
+
+#include "wiretap/wtap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * A byte range of a capture file, read with a wtap of its own, so that
+ * the ranges of a file can be read at the same time, each on a thread of
+ * its own.
+ *
+ * A chunk is made of the records that start in its range.  As records
+ * in pcap and pcapng files aren't marked, the reader has to guess where
+ * the first of them starts, and might guess wrong; and blocks such as
+ * interface descriptions in one chunk affect the records in the chunks
+ * after it, which don't see them.  So, once all the chunks of a file have
+ * been read, wtap_chunks_consistent() must be called to check that they
+ * are the records that reading the file through would have got; if they
+ * aren't, the file has to be read through after all.
+ *
+ * Only uncompressed pcap and pcapng files can be read in chunks.
+ */
+typedef struct wtap_chunk wtap_chunk_t;
+
+/**
+ * Split a file that has just been opened, before any records have been
+ * read from it, into byte ranges to be read as chunks.
+ *
+ * @param max_chunks The most ranges to split it into; each range is at
+ * least WTAP_CHUNK_MIN_SIZE bytes.
+ * @return An array of the boundaries of the ranges, as gint64 offsets,
+ * one more than the number of ranges, to be freed with g_array_free(); or
+ * NULL if the file can't be read in chunks, or isn't big enough to be
+ * worth it.
+ */
+WS_DLL_PUBLIC GArray *wtap_chunk_split(wtap *wth, guint max_chunks);
+
+#define WTAP_CHUNK_MIN_SIZE (G_GINT64_CONSTANT(16) * 1024 * 1024)
+
+/**
+ * Open a file for reading the records that start between two of the
+ * boundaries that wtap_chunk_split() returned.
+ *
+ * @return The chunk, or NULL with *err set on an error.
+ */
+WS_DLL_PUBLIC wtap_chunk_t *wtap_chunk_open(const char *filename,
+    gint64 start, gint64 end, int *err, gchar **err_info);
+
+/**
+ * Return the wtap a chunk is read with, for wtap_get_rec(),
+ * wtap_get_buf_ptr() and the like.  Don't call wtap_read() on it.
+ */
+WS_DLL_PUBLIC wtap *wtap_chunk_wtap(wtap_chunk_t *chunk);
+
+/**
+ * Read the next record of a chunk, as wtap_read() does.
+ *
+ * @return TRUE on success; FALSE with *err set to 0 at the end of the
+ * chunk, or to an error code on an error.
+ */
+WS_DLL_PUBLIC gboolean wtap_chunk_read(wtap_chunk_t *chunk, int *err,
+    gchar **err_info, gint64 *offset);
+
+/**
+ * Check that the chunks of a file, all of which have been read to the
+ * end, in order, got the records that reading the file through would
+ * have got.
+ *
+ * @param chunks The wtap_chunk_t pointers, in the order of their ranges.
+ */
+WS_DLL_PUBLIC gboolean wtap_chunks_consistent(GPtrArray *chunks);
+
+WS_DLL_PUBLIC void wtap_chunk_close(wtap_chunk_t *chunk);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WTAP_CHUNK_H__ */
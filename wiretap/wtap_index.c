@@ -0,0 +1,384 @@
+/* wtap_index.c
+ * Routines for indices of the records in capture files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "wtap-int.h"
+#include "file_wrappers.h"
+#include "wtap_index.h"
+#include <wsutil/file_util.h>
+
+/*
+ * The index file is a header, followed by an entry for each record,
+ * followed by the seek points of the capture file if it's compressed.
+ * It's a cache for the machine that wrote it, so everything is in host
+ * byte order; an index written on a machine with another byte order, or
+ * by another version of this code, is ignored.
+ */
+#define WTAP_INDEX_MAGIC        "WSINDEX\n"
+#define WTAP_INDEX_VERSION      1
+#define WTAP_INDEX_BYTE_ORDER   0x1A2B3C4D
+
+/* How much of the start of the capture file is hashed. */
+#define WTAP_INDEX_HASH_SPAN    65536
+#define WTAP_INDEX_HASH_LEN     20      /* SHA-1 */
+
+typedef struct {
+    char    magic[8];
+    guint32 version;
+    guint32 byte_order;
+    gint64  file_size;          /* size of the capture file */
+    gint64  file_mtime;         /* modification time of the capture file */
+    guint8  file_hash[WTAP_INDEX_HASH_LEN]; /* hash of its first bytes */
+    gint32  file_type_subtype;
+    guint32 state_blocks;       /* see wtap_state_block_count() */
+    guint32 count;              /* number of records */
+    gint64  end_offset;         /* offset just past the last record */
+    guint32 entry_size;         /* sizeof (wtap_index_entry_t) */
+    guint32 reserved;
+} wtap_index_header_t;
+
+#define WTAP_INDEX_HAS_COMMENT  0x0001
+
+typedef struct {
+    gint64  data_offset;
+    gint64  secs;
+    gint32  nsecs;
+    guint32 caplen;
+    guint32 len;
+    gint32  pkt_encap;
+    guint32 interface_id;
+    guint32 presence_flags;
+    guint16 tsprec;
+    guint16 flags;
+    guint32 reserved;
+} wtap_index_entry_t;
+
+struct wtap_index {
+    wtap_index_header_t header;
+    gboolean    usable;         /* FALSE if the file can't be indexed */
+    GArray     *entries;        /* entries of an index being built */
+    GMappedFile *mapped;        /* the index file, for an index that was read */
+    const wtap_index_entry_t *mapped_entries;
+};
+
+static gboolean
+can_index(wtap *wth)
+{
+    if (wth->ispipe || wth->random_fh == NULL)
+        return FALSE;
+
+    switch (wth->file_type_subtype) {
+
+    case WTAP_FILE_TYPE_SUBTYPE_PCAP:
+    case WTAP_FILE_TYPE_SUBTYPE_PCAP_NSEC:
+    case WTAP_FILE_TYPE_SUBTYPE_PCAPNG:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+/*
+ * Fill in the parts of a header that identify the capture file.
+ */
+static gboolean
+identify_file(wtap_index_header_t *header, wtap *wth, const char *filename,
+              int *err)
+{
+    ws_statb64 statb;
+    GChecksum *checksum;
+    guint8 *buf;
+    gsize hash_len = WTAP_INDEX_HASH_LEN;
+    int fd;
+    int bytes_read;
+
+    if (wtap_fstat(wth, &statb, err) == -1)
+        return FALSE;
+    header->file_size = statb.st_size;
+    header->file_mtime = (gint64)statb.st_mtime;
+
+    fd = ws_open(filename, O_RDONLY|O_BINARY, 0000 /* no creation so don't matter */);
+    if (fd == -1) {
+        *err = errno;
+        return FALSE;
+    }
+    buf = (guint8 *)g_malloc(WTAP_INDEX_HASH_SPAN);
+    bytes_read = (int)ws_read(fd, buf, WTAP_INDEX_HASH_SPAN);
+    if (bytes_read < 0) {
+        *err = errno;
+        g_free(buf);
+        ws_close(fd);
+        return FALSE;
+    }
+    ws_close(fd);
+
+    checksum = g_checksum_new(G_CHECKSUM_SHA1);
+    g_checksum_update(checksum, buf, bytes_read);
+    g_checksum_get_digest(checksum, header->file_hash, &hash_len);
+    g_checksum_free(checksum);
+    g_free(buf);
+    return TRUE;
+}
+
+gchar *
+wtap_index_filename(const char *filename)
+{
+    return g_strdup_printf("%s.wsidx", filename);
+}
+
+wtap_index_t *
+wtap_index_new(wtap *wth)
+{
+    wtap_index_t *idx;
+
+    if (!can_index(wth))
+        return NULL;
+
+    idx = g_new0(wtap_index_t, 1);
+    idx->header.state_blocks = wtap_state_block_count(wth);
+    idx->usable = TRUE;
+    idx->entries = g_array_new(FALSE, FALSE, sizeof(wtap_index_entry_t));
+    return idx;
+}
+
+void
+wtap_index_add(wtap_index_t *idx, wtap *wth, gint64 data_offset)
+{
+    wtap_index_entry_t entry;
+
+    if (!idx->usable)
+        return;
+
+    /*
+     * Only packets can be indexed, and nothing read since the file
+     * was opened can have added to what the reader keeps.
+     */
+    if (wth->rec.rec_type != REC_TYPE_PACKET ||
+        wtap_state_block_count(wth) != idx->header.state_blocks) {
+        idx->usable = FALSE;
+        g_array_set_size(idx->entries, 0);
+        idx->header.count = 0;
+        return;
+    }
+
+    memset(&entry, 0, sizeof entry);
+    entry.data_offset = data_offset;
+    entry.secs = (gint64)wth->rec.ts.secs;
+    entry.nsecs = wth->rec.ts.nsecs;
+    entry.caplen = wth->rec.rec_header.packet_header.caplen;
+    entry.len = wth->rec.rec_header.packet_header.len;
+    entry.pkt_encap = wth->rec.rec_header.packet_header.pkt_encap;
+    entry.interface_id = wth->rec.rec_header.packet_header.interface_id;
+    entry.presence_flags = wth->rec.presence_flags;
+    entry.tsprec = (guint16)wth->rec.tsprec;
+    if (wth->rec.opt_comment != NULL)
+        entry.flags |= WTAP_INDEX_HAS_COMMENT;
+    g_array_append_val(idx->entries, entry);
+
+    idx->header.count = idx->entries->len;
+    idx->header.end_offset = file_tell(wth->fh);
+}
+
+gboolean
+wtap_index_write(wtap_index_t *idx, wtap *wth, const char *filename, int *err)
+{
+    gchar *index_filename, *tmp_filename;
+    GByteArray *seek_points;
+    FILE *fp;
+    gboolean ok;
+
+    *err = 0;
+    if (!idx->usable || idx->entries == NULL || idx->header.count == 0)
+        return TRUE;
+
+    memcpy(idx->header.magic, WTAP_INDEX_MAGIC, sizeof idx->header.magic);
+    idx->header.version = WTAP_INDEX_VERSION;
+    idx->header.byte_order = WTAP_INDEX_BYTE_ORDER;
+    idx->header.file_type_subtype = wth->file_type_subtype;
+    idx->header.entry_size = sizeof(wtap_index_entry_t);
+    if (!identify_file(&idx->header, wth, filename, err))
+        return FALSE;
+
+    seek_points = g_byte_array_new();
+    if (wth->fast_seek != NULL)
+        file_fast_seek_save(wth->fast_seek, seek_points);
+
+    /*
+     * Write to a temporary file and rename it, so that nobody sees a
+     * partly-written index.
+     */
+    index_filename = wtap_index_filename(filename);
+    tmp_filename = g_strdup_printf("%s.tmp", index_filename);
+    fp = ws_fopen(tmp_filename, "wb");
+    if (fp == NULL) {
+        *err = errno;
+        g_byte_array_free(seek_points, TRUE);
+        g_free(tmp_filename);
+        g_free(index_filename);
+        return FALSE;
+    }
+    ok = fwrite(&idx->header, sizeof idx->header, 1, fp) == 1 &&
+         fwrite(idx->entries->data, sizeof(wtap_index_entry_t),
+                idx->entries->len, fp) == idx->entries->len &&
+         fwrite(seek_points->data, 1, seek_points->len, fp) == seek_points->len;
+    if (!ok)
+        *err = errno;
+    if (fclose(fp) == EOF && ok) {
+        *err = errno;
+        ok = FALSE;
+    }
+    if (ok && ws_rename(tmp_filename, index_filename) == -1) {
+        *err = errno;
+        ok = FALSE;
+    }
+    if (!ok)
+        ws_unlink(tmp_filename);
+
+    g_byte_array_free(seek_points, TRUE);
+    g_free(tmp_filename);
+    g_free(index_filename);
+    return ok;
+}
+
+wtap_index_t *
+wtap_index_open(wtap *wth, const char *filename)
+{
+    wtap_index_header_t file_header;
+    const wtap_index_header_t *header;
+    gchar *index_filename;
+    GMappedFile *mapped;
+    const guint8 *data;
+    gsize len, entries_len;
+    wtap_index_t *idx;
+    int err;
+
+    if (!can_index(wth))
+        return NULL;
+
+    index_filename = wtap_index_filename(filename);
+    mapped = g_mapped_file_new(index_filename, FALSE, NULL);
+    g_free(index_filename);
+    if (mapped == NULL)
+        return NULL;
+
+    data = (const guint8 *)g_mapped_file_get_contents(mapped);
+    len = g_mapped_file_get_length(mapped);
+    if (len < sizeof *header)
+        goto stale;
+    header = (const wtap_index_header_t *)data;
+    if (memcmp(header->magic, WTAP_INDEX_MAGIC, sizeof header->magic) != 0 ||
+        header->version != WTAP_INDEX_VERSION ||
+        header->byte_order != WTAP_INDEX_BYTE_ORDER ||
+        header->entry_size != sizeof(wtap_index_entry_t) ||
+        header->file_type_subtype != wth->file_type_subtype ||
+        header->state_blocks != wtap_state_block_count(wth))
+        goto stale;
+    /* Don't trust the count further than the index's own size. */
+    if (header->count > G_MAXSIZE / sizeof(wtap_index_entry_t) ||
+        header->count > (len - sizeof *header) / sizeof(wtap_index_entry_t))
+        goto stale;
+    entries_len = (gsize)header->count * sizeof(wtap_index_entry_t);
+
+    /* Is it the index of this file, as it is now? */
+    memset(&file_header, 0, sizeof file_header);
+    if (!identify_file(&file_header, wth, filename, &err) ||
+        file_header.file_size != header->file_size ||
+        file_header.file_mtime != header->file_mtime ||
+        memcmp(file_header.file_hash, header->file_hash, WTAP_INDEX_HASH_LEN) != 0)
+        goto stale;
+
+    if (wth->fast_seek != NULL) {
+        if (file_fast_seek_restore(wth->fast_seek,
+                data + sizeof *header + entries_len,
+                len - sizeof *header - entries_len) == 0)
+            goto stale;
+    }
+
+    idx = g_new0(wtap_index_t, 1);
+    idx->header = *header;
+    idx->usable = TRUE;
+    idx->mapped = mapped;
+    idx->mapped_entries = (const wtap_index_entry_t *)(data + sizeof *header);
+    return idx;
+
+stale:
+    g_mapped_file_unref(mapped);
+    return NULL;
+}
+
+guint32
+wtap_index_count(const wtap_index_t *idx)
+{
+    return idx->header.count;
+}
+
+gint64
+wtap_index_get_rec(const wtap_index_t *idx, guint32 n, wtap_rec *rec,
+                   gboolean *has_comment)
+{
+    const wtap_index_entry_t *entry;
+
+    g_assert(n < idx->header.count);
+    if (idx->mapped_entries != NULL)
+        entry = &idx->mapped_entries[n];
+    else
+        entry = &g_array_index(idx->entries, wtap_index_entry_t, n);
+
+    rec->rec_type = REC_TYPE_PACKET;
+    rec->presence_flags = entry->presence_flags;
+    rec->ts.secs = (time_t)entry->secs;
+    rec->ts.nsecs = entry->nsecs;
+    rec->tsprec = entry->tsprec;
+    rec->rec_header.packet_header.caplen = entry->caplen;
+    rec->rec_header.packet_header.len = entry->len;
+    rec->rec_header.packet_header.pkt_encap = entry->pkt_encap;
+    rec->rec_header.packet_header.interface_id = entry->interface_id;
+    rec->opt_comment = NULL;
+    *has_comment = (entry->flags & WTAP_INDEX_HAS_COMMENT) != 0;
+    return entry->data_offset;
+}
+
+gboolean
+wtap_index_resume(wtap *wth, const wtap_index_t *idx, int *err)
+{
+    if (idx->header.count == 0)
+        return TRUE;
+    return file_seek(wth->fh, idx->header.end_offset, SEEK_SET, err) != -1;
+}
+
+void
+wtap_index_free(wtap_index_t *idx)
+{
+    if (idx == NULL)
+        return;
+    if (idx->entries != NULL)
+        g_array_free(idx->entries, TRUE);
+    if (idx->mapped != NULL)
+        g_mapped_file_unref(idx->mapped);
+    g_free(idx);
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local Variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,110 @@
+/* wtap_index.h
+ * Definitions for indices of the records in capture files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __WTAP_INDEX_H__
+#define __WTAP_INDEX_H__
+
+#include "wiretap/wtap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/**
+ * An index of the records in a capture file: the offset, time stamp,
+ * lengths, encapsulation and interface of each of them, along with the
+ * seek points of a compressed file.  It's kept in a file next to the
+ * capture file, so that a program opening the capture file again can
+ * know where its records are without reading it through first.
+ *
+ * Only pcap and pcapng files, compressed or not, are indexed, and only
+ * if all the records are packets and all of the blocks that the reader
+ * keeps, such as interface descriptions and name resolution blocks, are
+ * read when the file is opened or come after the last packet.
+ *
+ * The index is tied to the size, modification time and first bytes of
+ * the capture file; if any of them change, it's ignored.
+ */
+typedef struct wtap_index wtap_index_t;
+
+/**
+ * Return the name of the index file for a capture file, to be freed
+ * with g_free().
+ */
+WS_DLL_PUBLIC gchar *wtap_index_filename(const char *filename);
+
+/**
+ * Start building an index of a file that has just been opened, before
+ * any records have been read from it.
+ *
+ * @return The index, or NULL if files of this type aren't indexed.
+ */
+WS_DLL_PUBLIC wtap_index_t *wtap_index_new(wtap *wth);
+
+/**
+ * Add the record that wtap_read() has just read to the index.
+ *
+ * @param data_offset The offset wtap_read() returned for it.
+ */
+WS_DLL_PUBLIC void wtap_index_add(wtap_index_t *idx, wtap *wth,
+    gint64 data_offset);
+
+/**
+ * Write the index of a capture file that has been read to the end.
+ * Nothing is written if the file can't be indexed.
+ *
+ * @param filename The name of the capture file.
+ * @return TRUE on success or if there's nothing to write, FALSE with
+ * *err set otherwise.
+ */
+WS_DLL_PUBLIC gboolean wtap_index_write(wtap_index_t *idx, wtap *wth,
+    const char *filename, int *err);
+
+/**
+ * Open the index of a capture file that has just been opened, before
+ * any records have been read from it.  If the file is compressed, the
+ * seek points in the index are used for random access to it.
+ *
+ * @param filename The name of the capture file.
+ * @return The index, or NULL if there's no index for the file or it's
+ * out of date.
+ */
+WS_DLL_PUBLIC wtap_index_t *wtap_index_open(wtap *wth, const char *filename);
+
+/** Return the number of records in an index. */
+WS_DLL_PUBLIC guint32 wtap_index_count(const wtap_index_t *idx);
+
+/**
+ * Fill in the metadata for a record from an index; the record data
+ * must be read with wtap_seek_read().
+ *
+ * @param n The number of the record, starting at 0.
+ * @param[out] has_comment Set to TRUE if the record has a comment.
+ * @return The offset to pass to wtap_seek_read() for the record.
+ */
+WS_DLL_PUBLIC gint64 wtap_index_get_rec(const wtap_index_t *idx, guint32 n,
+    wtap_rec *rec, gboolean *has_comment);
+
+/**
+ * Position the sequential reader just after the last record in an
+ * index, so that wtap_read() reads whatever follows it.
+ *
+ * @return TRUE on success, FALSE with *err set otherwise.
+ */
+WS_DLL_PUBLIC gboolean wtap_index_resume(wtap *wth, const wtap_index_t *idx,
+    int *err);
+
+WS_DLL_PUBLIC void wtap_index_free(wtap_index_t *idx);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __WTAP_INDEX_H__ */
@@ -14,6 +14,10 @@
 
 #define SMALL_BUFFER_SIZE (2 * 1024) /* Everyone still uses 1500 byte frames, right? */
 static GPtrArray *small_buffers = NULL; /* Guaranteed to be at least SMALL_BUFFER_SIZE */
+/* Buffers are taken from and given back to the pool on several threads
+ * at once, e.g. by tshark's prefetch thread and the dissecting thread,
+ * or by the threads reading chunks of a file. */
+G_LOCK_DEFINE_STATIC(small_buffers);
 /* XXX - Add medium and large buffers? */
 
 /* Initializes a buffer with a certain amount of allocated space */
@@ -21,14 +25,15 @@ void
 ws_buffer_init(Buffer* buffer, gsize space)
 {
 	g_assert(buffer);
-	if (G_UNLIKELY(!small_buffers)) small_buffers = g_ptr_array_sized_new(1024);
-
 	if (space <= SMALL_BUFFER_SIZE) {
+		G_LOCK(small_buffers);
+		if (G_UNLIKELY(!small_buffers)) small_buffers = g_ptr_array_sized_new(1024);
 		if (small_buffers->len > 0) {
 			buffer->data = (guint8*) g_ptr_array_remove_index(small_buffers, small_buffers->len - 1);
 		} else {
 			buffer->data = (guint8*)g_malloc(SMALL_BUFFER_SIZE);
 		}
+		G_UNLOCK(small_buffers);
 		buffer->allocated = SMALL_BUFFER_SIZE;
 	} else {
 		buffer->data = (guint8*)g_malloc(space);
@@ -36,6 +41,18 @@ ws_buffer_init(Buffer* buffer, gsize space)
 	}
 	buffer->start = 0;
 	buffer->first_free = 0;
+	buffer->lent = NULL;
+	buffer->lent_len = 0;
+}
+
+/* Stops holding lent data; the buffer is then empty */
+static void
+ws_buffer_end_loan(Buffer* buffer)
+{
+	buffer->lent = NULL;
+	buffer->lent_len = 0;
+	buffer->start = 0;
+	buffer->first_free = 0;
 }
 
 /* Frees the memory used by a buffer */
@@ -44,11 +61,15 @@ ws_buffer_free(Buffer* buffer)
 {
 	g_assert(buffer);
 	if (buffer->allocated == SMALL_BUFFER_SIZE) {
+		G_LOCK(small_buffers);
 		g_ptr_array_add(small_buffers, buffer->data);
+		G_UNLOCK(small_buffers);
 	} else {
 		g_free(buffer->data);
 	}
 	buffer->data = NULL;
+	buffer->lent = NULL;
+	buffer->lent_len = 0;
 }
 
 /* Assures that there are 'space' bytes at the end of the used space
@@ -59,10 +80,14 @@ void
 ws_buffer_assure_space(Buffer* buffer, gsize space)
 {
 	g_assert(buffer);
-	gsize available_at_end = buffer->allocated - buffer->first_free;
+	gsize available_at_end;
 	gsize space_used;
 	gboolean space_at_beginning;
 
+	if (buffer->lent != NULL)
+		ws_buffer_end_loan(buffer);
+	available_at_end = buffer->allocated - buffer->first_free;
+
 	/* If we've got the space already, good! */
 	if (space <= available_at_end) {
 		return;
@@ -107,6 +132,14 @@ void
 ws_buffer_remove_start(Buffer* buffer, gsize bytes)
 {
 	g_assert(buffer);
+	if (buffer->lent != NULL) {
+		if (bytes > buffer->lent_len) {
+			g_error("ws_buffer_remove_start trying to remove %" G_GINT64_MODIFIER "u bytes of %" G_GINT64_MODIFIER "u lent!\n",
+				(guint64)bytes, (guint64)buffer->lent_len);
+		}
+		ws_buffer_end_loan(buffer);
+		return;
+	}
 	if (buffer->start + bytes > buffer->first_free) {
 		g_error("ws_buffer_remove_start trying to remove %" G_GINT64_MODIFIER "u bytes. s=%" G_GINT64_MODIFIER "u ff=%" G_GINT64_MODIFIER "u!\n",
 			(guint64)bytes, (guint64)buffer->start,
@@ -122,6 +155,16 @@ ws_buffer_remove_start(Buffer* buffer, gsize bytes)
 }
 
 
+void
+ws_buffer_lend(Buffer* buffer, guint8 *data, gsize len)
+{
+	g_assert(buffer);
+	buffer->start = 0;
+	buffer->first_free = 0;
+	buffer->lent = data;
+	buffer->lent_len = len;
+}
+
 #ifndef SOME_FUNCTIONS_ARE_DEFINES
 void
 ws_buffer_clean(Buffer* buffer)
@@ -145,6 +188,8 @@ gsize
 ws_buffer_length(Buffer* buffer)
 {
 	g_assert(buffer);
+	if (buffer->lent != NULL)
+		return buffer->lent_len;
 	return buffer->first_free - buffer->start;
 }
 #endif
@@ -154,6 +199,8 @@ guint8 *
 ws_buffer_start_ptr(Buffer* buffer)
 {
 	g_assert(buffer);
+	if (buffer->lent != NULL)
+		return buffer->lent;
 	return buffer->data + buffer->start;
 }
 #endif
@@ -163,6 +210,8 @@ guint8 *
 ws_buffer_end_ptr(Buffer* buffer)
 {
 	g_assert(buffer);
+	if (buffer->lent != NULL)
+		return buffer->lent + buffer->lent_len;
 	return buffer->data + buffer->first_free;
 }
 #endif
@@ -179,11 +228,13 @@ ws_buffer_append_buffer(Buffer* buffer, Buffer* src_buffer)
 void
 ws_buffer_cleanup(void)
 {
+	G_LOCK(small_buffers);
 	if (small_buffers) {
 		g_ptr_array_set_free_func(small_buffers, g_free);
 		g_ptr_array_free(small_buffers, TRUE);
 		small_buffers = NULL;
 	}
+	G_UNLOCK(small_buffers);
 }
 
 /*
@@ -18,13 +18,23 @@ extern "C" {
 
 #define SOME_FUNCTIONS_ARE_DEFINES
 
+/*
+ * "lent" and "lent_len" were added in 2.9, which changes the size of
+ * a Buffer and thus of every structure with one in it, and the macros
+ * below read them; code built against the earlier definition has to be
+ * rebuilt.
+ */
 typedef struct Buffer {
 	guint8	*data;
 	gsize	allocated;
 	gsize	start;
 	gsize	first_free;
+	guint8	*lent;		/* data the buffer holds without copying it, or NULL */
+	gsize	lent_len;
 } Buffer;
 
+/* ws_buffer_init() and ws_buffer_free() can be called on several threads
+ * at once, for different buffers. */
 WS_DLL_PUBLIC
 void ws_buffer_init(Buffer* buffer, gsize space);
 WS_DLL_PUBLIC
@@ -38,12 +48,22 @@ void ws_buffer_remove_start(Buffer* buffer, gsize bytes);
 WS_DLL_PUBLIC
 void ws_buffer_cleanup(void);
 
+/*
+ * Make the buffer's contents the 'len' bytes at 'data', without copying
+ * them; the caller must keep them valid for as long as the buffer holds
+ * them.  Anything that changes the buffer's contents - initializing,
+ * freeing, assuring space in, appending to or removing from it - makes
+ * it stop holding them, leaving it empty.
+ */
+WS_DLL_PUBLIC
+void ws_buffer_lend(Buffer* buffer, guint8 *data, gsize len);
+
 #ifdef SOME_FUNCTIONS_ARE_DEFINES
 # define ws_buffer_clean(buffer) ws_buffer_remove_start((buffer), ws_buffer_length(buffer))
 # define ws_buffer_increase_length(buffer,bytes) (buffer)->first_free += (bytes)
-# define ws_buffer_length(buffer) ((buffer)->first_free - (buffer)->start)
-# define ws_buffer_start_ptr(buffer) ((buffer)->data + (buffer)->start)
-# define ws_buffer_end_ptr(buffer) ((buffer)->data + (buffer)->first_free)
+# define ws_buffer_length(buffer) ((buffer)->lent != NULL ? (buffer)->lent_len : (buffer)->first_free - (buffer)->start)
+# define ws_buffer_start_ptr(buffer) ((buffer)->lent != NULL ? (buffer)->lent : (buffer)->data + (buffer)->start)
+# define ws_buffer_end_ptr(buffer) ((buffer)->lent != NULL ? (buffer)->lent + (buffer)->lent_len : (buffer)->data + (buffer)->first_free)
 # define ws_buffer_append_buffer(buffer,src_buffer) ws_buffer_append((buffer), ws_buffer_start_ptr(src_buffer), ws_buffer_length(src_buffer))
 #else
  void ws_buffer_clean(Buffer* buffer);
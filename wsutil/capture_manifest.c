@@ -0,0 +1,368 @@
+/* capture_manifest.c
+ * Routines for manifests of ring buffer capture files
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <glib.h>
+
+#include "capture_manifest.h"
+#include <wsutil/file_util.h>
+
+static void
+capture_manifest_entry_free(gpointer data)
+{
+    capture_manifest_entry *entry = (capture_manifest_entry *)data;
+
+    g_free(entry->name);
+    g_array_free(entry->interfaces, TRUE);
+    g_free(entry);
+}
+
+static capture_manifest_entry *
+capture_manifest_entry_new(const char *name)
+{
+    capture_manifest_entry *entry = g_new0(capture_manifest_entry, 1);
+
+    entry->name = g_path_get_basename(name);
+    nstime_set_unset(&entry->first);
+    nstime_set_unset(&entry->last);
+    entry->interfaces = g_array_new(FALSE, FALSE, sizeof(guint32));
+    return entry;
+}
+
+capture_manifest *
+capture_manifest_new(const char *dir)
+{
+    capture_manifest *manifest = g_new(capture_manifest, 1);
+
+    manifest->dir = g_strdup(dir);
+    manifest->entries = g_ptr_array_new_with_free_func(capture_manifest_entry_free);
+    return manifest;
+}
+
+void
+capture_manifest_free(capture_manifest *manifest)
+{
+    if (manifest == NULL)
+        return;
+    g_free(manifest->dir);
+    g_ptr_array_free(manifest->entries, TRUE);
+    g_free(manifest);
+}
+
+capture_manifest_entry *
+capture_manifest_add_file(capture_manifest *manifest, const char *name)
+{
+    capture_manifest_entry *entry = capture_manifest_entry_new(name);
+
+    g_ptr_array_add(manifest->entries, entry);
+    return entry;
+}
+
+void
+capture_manifest_remove_file(capture_manifest *manifest, const char *name)
+{
+    gchar *basename = g_path_get_basename(name);
+    guint  i;
+
+    for (i = 0; i < manifest->entries->len; i++) {
+        capture_manifest_entry *entry =
+            (capture_manifest_entry *)g_ptr_array_index(manifest->entries, i);
+
+        if (strcmp(entry->name, basename) == 0) {
+            g_ptr_array_remove_index(manifest->entries, i);
+            break;
+        }
+    }
+    g_free(basename);
+}
+
+void
+capture_manifest_add_packet(capture_manifest_entry *entry,
+    guint32 interface_id, const nstime_t *ts, guint32 caplen)
+{
+    GArray *ifaces = entry->interfaces;
+    guint   i;
+
+    entry->packets++;
+    entry->bytes += caplen;
+
+    if (ts != NULL) {
+        if (nstime_is_unset(&entry->first) || nstime_cmp(ts, &entry->first) < 0)
+            entry->first = *ts;
+        if (nstime_is_unset(&entry->last) || nstime_cmp(ts, &entry->last) > 0)
+            entry->last = *ts;
+    }
+
+    /* Usually it's the interface of the last packet, or the only one */
+    if (ifaces->len != 0 &&
+        g_array_index(ifaces, guint32, ifaces->len - 1) == interface_id)
+        return;
+    for (i = 0; i < ifaces->len; i++) {
+        guint32 id = g_array_index(ifaces, guint32, i);
+
+        if (id == interface_id)
+            return;
+        if (id > interface_id)
+            break;
+    }
+    g_array_insert_val(ifaces, i, interface_id);
+}
+
+static void
+append_time(GString *line, const nstime_t *ts)
+{
+    if (nstime_is_unset(ts))
+        g_string_append_c(line, '-');
+    else
+        g_string_append_printf(line, "%" G_GINT64_FORMAT ".%09d",
+                               (gint64)ts->secs, ts->nsecs);
+}
+
+gboolean
+capture_manifest_write(const capture_manifest *manifest, const char *path,
+    int *err)
+{
+    GString *contents = g_string_new(NULL);
+    gchar   *tmp_path;
+    FILE    *fp;
+    guint    i, j;
+    gboolean ok;
+
+    for (i = 0; i < manifest->entries->len; i++) {
+        const capture_manifest_entry *entry =
+            (const capture_manifest_entry *)g_ptr_array_index(manifest->entries, i);
+
+        g_string_append(contents, entry->name);
+        g_string_append_c(contents, '\t');
+        append_time(contents, &entry->first);
+        g_string_append_c(contents, '\t');
+        append_time(contents, &entry->last);
+        g_string_append_printf(contents, "\t%" G_GUINT64_FORMAT "\t%" G_GUINT64_FORMAT "\t",
+                               entry->packets, entry->bytes);
+        for (j = 0; j < entry->interfaces->len; j++) {
+            g_string_append_printf(contents, j == 0 ? "%u" : ",%u",
+                                   g_array_index(entry->interfaces, guint32, j));
+        }
+        g_string_append_c(contents, '\n');
+    }
+
+    /* Write it next to the old one and rename it over it */
+    tmp_path = g_strconcat(path, ".tmp", NULL);
+    fp = ws_fopen(tmp_path, "wb");
+    if (fp == NULL) {
+        *err = errno;
+        g_free(tmp_path);
+        g_string_free(contents, TRUE);
+        return FALSE;
+    }
+    ok = fwrite(contents->str, 1, contents->len, fp) == contents->len;
+    if (!ok)
+        *err = errno;
+    if (fclose(fp) == EOF && ok) {
+        *err = errno;
+        ok = FALSE;
+    }
+    if (ok && ws_rename(tmp_path, path) != 0) {
+        *err = errno;
+        ok = FALSE;
+    }
+    if (!ok)
+        ws_unlink(tmp_path);
+    g_free(tmp_path);
+    g_string_free(contents, TRUE);
+    return ok;
+}
+
+static gboolean
+parse_time(const char *str, nstime_t *ts)
+{
+    char   *end;
+    gint64  secs;
+    guint64 nsecs;
+
+    if (strcmp(str, "-") == 0) {
+        nstime_set_unset(ts);
+        return TRUE;
+    }
+    secs = g_ascii_strtoll(str, &end, 10);
+    if (end == str || *end != '.')
+        return FALSE;
+    str = end + 1;
+    if (strlen(str) != 9)
+        return FALSE;
+    nsecs = g_ascii_strtoull(str, &end, 10);
+    if (end == str || *end != '\0' || nsecs >= 1000000000)
+        return FALSE;
+    ts->secs = (time_t)secs;
+    ts->nsecs = (int)nsecs;
+    return TRUE;
+}
+
+static gboolean
+parse_count(const char *str, guint64 *count)
+{
+    char *end;
+
+    if (!g_ascii_isdigit(*str))
+        return FALSE;
+    *count = g_ascii_strtoull(str, &end, 10);
+    return *end == '\0';
+}
+
+static capture_manifest_entry *
+parse_entry(char *line)
+{
+    gchar                 **fields = g_strsplit(line, "\t", -1);
+    capture_manifest_entry *entry = NULL;
+    guint64                 id;
+    guint                   i;
+
+    if (g_strv_length(fields) != 6 || fields[0][0] == '\0')
+        goto done;
+    entry = capture_manifest_entry_new(fields[0]);
+    if (!parse_time(fields[1], &entry->first) ||
+        !parse_time(fields[2], &entry->last) ||
+        !parse_count(fields[3], &entry->packets) ||
+        !parse_count(fields[4], &entry->bytes))
+        goto bad;
+    if (fields[5][0] != '\0') {
+        gchar **ids = g_strsplit(fields[5], ",", -1);
+
+        for (i = 0; ids[i] != NULL; i++) {
+            guint32 interface_id;
+
+            if (!parse_count(ids[i], &id) || id > G_MAXUINT32) {
+                g_strfreev(ids);
+                goto bad;
+            }
+            interface_id = (guint32)id;
+            g_array_append_val(entry->interfaces, interface_id);
+        }
+        g_strfreev(ids);
+    }
+    goto done;
+
+bad:
+    capture_manifest_entry_free(entry);
+    entry = NULL;
+done:
+    g_strfreev(fields);
+    return entry;
+}
+
+capture_manifest *
+capture_manifest_read(const char *path, int *err)
+{
+    capture_manifest *manifest;
+    gchar            *dir;
+    FILE             *fp;
+    GString          *line;
+    char              buf[1024];
+    gboolean          ok = TRUE;
+
+    fp = ws_fopen(path, "r");
+    if (fp == NULL) {
+        *err = errno;
+        return NULL;
+    }
+
+    dir = g_path_get_dirname(path);
+    manifest = capture_manifest_new(dir);
+    g_free(dir);
+
+    line = g_string_new(NULL);
+    while (ok && fgets(buf, sizeof buf, fp) != NULL) {
+        capture_manifest_entry *entry;
+
+        g_string_append(line, buf);
+        if (line->len == 0 || line->str[line->len - 1] != '\n') {
+            /* The rest of the line is still to come, unless this is the end */
+            if (!feof(fp))
+                continue;
+        } else {
+            g_string_truncate(line, line->len - 1);
+        }
+        if (line->len != 0 && line->str[line->len - 1] == '\r')
+            g_string_truncate(line, line->len - 1);
+
+        entry = parse_entry(line->str);
+        if (entry != NULL) {
+            g_ptr_array_add(manifest->entries, entry);
+        } else {
+            *err = EINVAL;
+            ok = FALSE;
+        }
+        g_string_truncate(line, 0);
+    }
+    if (ok && ferror(fp)) {
+        *err = errno;
+        ok = FALSE;
+    }
+    g_string_free(line, TRUE);
+    fclose(fp);
+
+    if (!ok) {
+        capture_manifest_free(manifest);
+        return NULL;
+    }
+    return manifest;
+}
+
+GPtrArray *
+capture_manifest_select(const capture_manifest *manifest,
+    const nstime_t *start, const nstime_t *stop)
+{
+    GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+    guint      i;
+
+    for (i = 0; i < manifest->entries->len; i++) {
+        const capture_manifest_entry *entry =
+            (const capture_manifest_entry *)g_ptr_array_index(manifest->entries, i);
+        gboolean wanted;
+
+        if (nstime_is_unset(&entry->first)) {
+            /*
+             * Either it has no packets, or they have no time stamps,
+             * so we can't rule it out.
+             */
+            wanted = entry->packets != 0 || i == manifest->entries->len - 1;
+        } else {
+            wanted = (stop == NULL || nstime_cmp(&entry->first, stop) < 0) &&
+                     (start == NULL || nstime_cmp(&entry->last, start) >= 0);
+        }
+        if (!wanted)
+            continue;
+
+        if (manifest->dir != NULL)
+            g_ptr_array_add(paths, g_build_filename(manifest->dir, entry->name, NULL));
+        else
+            g_ptr_array_add(paths, g_strdup(entry->name));
+    }
+    return paths;
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,126 @@
+/* capture_manifest.h
+ * Declarations of routines for manifests of ring buffer capture files
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CAPTURE_MANIFEST_H__
+#define __CAPTURE_MANIFEST_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+#include "nstime.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A manifest lists the files of a ring buffer capture, oldest first, with
+ * the time stamps of the earliest and latest packets in each of them, how
+ * many packets and bytes of packet data each holds and which interfaces
+ * the packets were captured on, so that a reader looking for the packets
+ * of a span of time only has to open the files that can have them.
+ *
+ * It's a text file, next to the capture files, with a line for each file:
+ * the file name, without its directory, the first and last time stamps
+ * as seconds.nanoseconds, the packet and byte counts, and the interface
+ * IDs separated by commas, separated by tabs.
+ */
+
+/** What a manifest's file name ends with */
+#define CAPTURE_MANIFEST_SUFFIX ".manifest"
+
+/** A file of a ring buffer capture */
+typedef struct {
+    gchar      *name;           /**< file name, without its directory */
+    nstime_t    first;          /**< time stamp of the earliest packet */
+    nstime_t    last;           /**< time stamp of the latest packet */
+    guint64     packets;        /**< packets in the file */
+    guint64     bytes;          /**< bytes of packet data in the file */
+    GArray     *interfaces;     /**< guint32 IDs of the packets' interfaces, ascending */
+} capture_manifest_entry;
+
+typedef struct {
+    gchar      *dir;            /**< directory of the files, or NULL for the current one */
+    GPtrArray  *entries;        /**< capture_manifest_entry *, oldest file first */
+} capture_manifest;
+
+/** Make an empty manifest, for files in the given directory, which may be NULL. */
+WS_DLL_PUBLIC capture_manifest *capture_manifest_new(const char *dir);
+
+WS_DLL_PUBLIC void capture_manifest_free(capture_manifest *manifest);
+
+/**
+ * Add a file, with no packets yet, as the newest file of a manifest.
+ * Any directory in the name is left out.
+ *
+ * @return The file's entry, to add its packets to.
+ */
+WS_DLL_PUBLIC capture_manifest_entry *capture_manifest_add_file(
+    capture_manifest *manifest, const char *name);
+
+/** Take a file, which has been deleted, out of a manifest. */
+WS_DLL_PUBLIC void capture_manifest_remove_file(capture_manifest *manifest,
+    const char *name);
+
+/**
+ * Count a packet, captured on an interface, in a file's entry.  ts is
+ * NULL if the packet has no time stamp.
+ */
+WS_DLL_PUBLIC void capture_manifest_add_packet(capture_manifest_entry *entry,
+    guint32 interface_id, const nstime_t *ts, guint32 caplen);
+
+/**
+ * Write a manifest to a file, replacing it as a whole, so that a reader
+ * never sees it half written.
+ *
+ * @return TRUE on success, FALSE with *err set to an errno otherwise.
+ */
+WS_DLL_PUBLIC gboolean capture_manifest_write(const capture_manifest *manifest,
+    const char *path, int *err);
+
+/**
+ * Read a manifest.  Its dir is set to the directory of the manifest.
+ *
+ * @return The manifest, or NULL with *err set to an errno, which is
+ * EINVAL if the file isn't a manifest.
+ */
+WS_DLL_PUBLIC capture_manifest *capture_manifest_read(const char *path,
+    int *err);
+
+/**
+ * Get the paths of the files of a manifest that can have packets with
+ * time stamps from start up to, but not including, stop, oldest first.
+ * Either may be NULL, for no limit.  The newest file is included if it
+ * has no packets yet, as it may still be being written.
+ *
+ * @return A GPtrArray of g_malloc'ed paths, which frees them when it's
+ * freed.
+ */
+WS_DLL_PUBLIC GPtrArray *capture_manifest_select(const capture_manifest *manifest,
+    const nstime_t *start, const nstime_t *stop);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CAPTURE_MANIFEST_H__ */
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,545 @@
+/* cwstream.c
+ * Routines for writing compressed streams
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#ifdef HAVE_FOPENCOOKIE
+#define _GNU_SOURCE /* Otherwise fopencookie() won't be defined on Linux */
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <glib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif /* HAVE_LZ4FRAME_H */
+
+#include "cwstream.h"
+#include <wsutil/file_util.h>
+
+/*
+ * How many frames can be waiting to be compressed, or being compressed,
+ * before the writer has to wait for them.
+ */
+#define CWSTREAM_MAX_BUSY 4
+
+/* zstd's own default level, which is about as fast as gzip's fastest */
+#define CWSTREAM_ZSTD_LEVEL 3
+
+/*
+ * What the buffers of uncompressed frames are aligned to, and what the
+ * length of a frame has to be a multiple of, for direct I/O.
+ */
+#define CWSTREAM_ALIGN 4096
+
+struct cw_frame {
+    guint8 *mem;                /* what was allocated */
+    guint8 *data;               /* mem, aligned */
+    size_t len;
+};
+
+struct ws_cwstream {
+    int fd;
+    ws_cwstream_type type;
+    struct cw_frame *cur;       /* frame the writer is filling */
+    GThread *thread;            /* thread compressing and writing frames */
+
+    /* shared with the thread */
+    GMutex mutex;
+    GCond cond;                 /* signalled whenever any of these change */
+    GQueue full;                /* frames waiting to be compressed */
+    GQueue spare;               /* frames to be filled again */
+    guint busy;                 /* frames waiting or being compressed */
+    gboolean closing;           /* no more frames are coming */
+    int err;                    /* first error compressing or writing */
+
+    gboolean direct;            /* the thread is writing with O_DIRECT */
+    ws_cwstream_stats *stats;   /* the writer's counters, or NULL */
+};
+
+gboolean
+ws_cwstream_type_supported(ws_cwstream_type type)
+{
+    switch (type) {
+
+#ifdef HAVE_ZSTD
+    case WS_CWSTREAM_ZSTD:
+        return TRUE;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+    case WS_CWSTREAM_LZ4:
+        return TRUE;
+#endif
+
+    case WS_CWSTREAM_NONE:
+        return TRUE;
+
+    default:
+        return FALSE;
+    }
+}
+
+gboolean
+ws_cwstream_name_to_type(const char *name, ws_cwstream_type *type)
+{
+    if (strcmp(name, "zstd") == 0) {
+        *type = WS_CWSTREAM_ZSTD;
+        return TRUE;
+    }
+    if (strcmp(name, "lz4") == 0) {
+        *type = WS_CWSTREAM_LZ4;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static struct cw_frame *
+cw_frame_new(void)
+{
+    struct cw_frame *frame = g_new(struct cw_frame, 1);
+
+    frame->mem = (guint8 *)g_malloc(WS_CWSTREAM_FRAME_SIZE + CWSTREAM_ALIGN - 1);
+    frame->data = (guint8 *)(((guintptr)frame->mem + CWSTREAM_ALIGN - 1) &
+                             ~(guintptr)(CWSTREAM_ALIGN - 1));
+    frame->len = 0;
+    return frame;
+}
+
+static void
+cw_frame_free(struct cw_frame *frame)
+{
+    g_free(frame->mem);
+    g_free(frame);
+}
+
+/* Write the rest of the file through the page cache. */
+static void
+cwstream_end_direct_io(ws_cwstream *stream)
+{
+#ifdef O_DIRECT
+    int flags = fcntl(stream->fd, F_GETFL);
+
+    if (flags != -1)
+        (void)fcntl(stream->fd, F_SETFL, flags & ~O_DIRECT);
+#endif
+    stream->direct = FALSE;
+}
+
+/* Write all of a buffer, returning 0 or an errno. */
+static int
+write_all(ws_cwstream *stream, const guint8 *buf, size_t len)
+{
+    ssize_t ret;
+
+    /* Direct I/O only takes whole blocks */
+    if (stream->direct && len % CWSTREAM_ALIGN != 0)
+        cwstream_end_direct_io(stream);
+
+    while (len != 0) {
+        ret = ws_write(stream->fd, buf, (unsigned int)MIN(len, G_MAXINT));
+        if (ret < 0) {
+            if (errno == EINVAL && stream->direct) {
+                /* The file system won't take it directly after all */
+                cwstream_end_direct_io(stream);
+                continue;
+            }
+            return errno;
+        }
+        buf += ret;
+        len -= ret;
+        /* What's left of a short write isn't aligned */
+        if (len != 0 && stream->direct)
+            cwstream_end_direct_io(stream);
+    }
+    return 0;
+}
+
+static gpointer
+cwstream_thread(gpointer data)
+{
+    ws_cwstream *stream = (ws_cwstream *)data;
+    struct cw_frame *frame;
+    guint8 *out = NULL;
+    size_t out_size = 0, out_len = 0;
+    int err;
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zctx = NULL;
+#endif
+#ifdef HAVE_LZ4FRAME_H
+    LZ4F_preferences_t prefs;
+
+    memset(&prefs, 0, sizeof prefs);
+#endif
+
+    switch (stream->type) {
+
+#ifdef HAVE_ZSTD
+    case WS_CWSTREAM_ZSTD:
+        out_size = ZSTD_compressBound(WS_CWSTREAM_FRAME_SIZE);
+        zctx = ZSTD_createCCtx();
+        break;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+    case WS_CWSTREAM_LZ4:
+        out_size = LZ4F_compressFrameBound(WS_CWSTREAM_FRAME_SIZE, &prefs);
+        break;
+#endif
+
+    default:
+        break;
+    }
+    if (out_size != 0)
+        out = (guint8 *)g_try_malloc(out_size);
+
+    for (;;) {
+        g_mutex_lock(&stream->mutex);
+        while (g_queue_is_empty(&stream->full) && !stream->closing)
+            g_cond_wait(&stream->cond, &stream->mutex);
+        frame = (struct cw_frame *)g_queue_pop_head(&stream->full);
+        err = stream->err;
+        g_mutex_unlock(&stream->mutex);
+        if (frame == NULL)
+            break;      /* closing, with nothing left to write */
+
+        /* Once there's been an error, just drop the frames. */
+        if (err == 0 && stream->type == WS_CWSTREAM_NONE) {
+            err = write_all(stream, frame->data, frame->len);
+        } else if (err == 0) {
+            if (out == NULL)
+                err = ENOMEM;
+            else switch (stream->type) {
+
+#ifdef HAVE_ZSTD
+            case WS_CWSTREAM_ZSTD:
+                if (zctx == NULL) {
+                    err = ENOMEM;
+                    break;
+                }
+                out_len = ZSTD_compressCCtx(zctx, out, out_size,
+                                            frame->data, frame->len,
+                                            CWSTREAM_ZSTD_LEVEL);
+                if (ZSTD_isError(out_len))
+                    err = EIO;  /* "shouldn't happen" */
+                break;
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+            case WS_CWSTREAM_LZ4:
+                out_len = LZ4F_compressFrame(out, out_size,
+                                             frame->data, frame->len, &prefs);
+                if (LZ4F_isError(out_len))
+                    err = EIO;  /* "shouldn't happen" */
+                break;
+#endif
+
+            default:
+                err = EINVAL;
+                break;
+            }
+            if (err == 0)
+                err = write_all(stream, out, out_len);
+        }
+
+        g_mutex_lock(&stream->mutex);
+        if (stream->err == 0)
+            stream->err = err;
+        frame->len = 0;
+        g_queue_push_tail(&stream->spare, frame);
+        stream->busy--;
+        g_cond_broadcast(&stream->cond);
+        g_mutex_unlock(&stream->mutex);
+    }
+
+#ifdef HAVE_ZSTD
+    ZSTD_freeCCtx(zctx);
+#endif
+    g_free(out);
+    return NULL;
+}
+
+/*
+ * Have the thread write an uncompressed stream with O_DIRECT, if the file
+ * can be opened that way and we're at a block boundary of it.
+ */
+static void
+cwstream_start_direct_io(ws_cwstream *stream)
+{
+#ifdef O_DIRECT
+    int flags;
+    gint64 offset;
+
+    offset = ws_lseek64(stream->fd, 0, SEEK_CUR);
+    if (offset == -1 || offset % CWSTREAM_ALIGN != 0)
+        return;
+    flags = fcntl(stream->fd, F_GETFL);
+    if (flags == -1 || fcntl(stream->fd, F_SETFL, flags | O_DIRECT) == -1)
+        return;
+    stream->direct = TRUE;
+#else
+    (void)stream;
+#endif
+}
+
+ws_cwstream *
+ws_cwstream_fdopen(int fd, ws_cwstream_type type,
+                   const ws_cwstream_options *options)
+{
+    ws_cwstream *stream;
+
+    if (!ws_cwstream_type_supported(type)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    stream = g_new0(ws_cwstream, 1);
+    stream->fd = fd;
+    stream->type = type;
+    stream->cur = cw_frame_new();
+    if (options != NULL) {
+        stream->stats = options->stats;
+        /* Compressed frames aren't whole blocks */
+        if (options->direct_io && type == WS_CWSTREAM_NONE)
+            cwstream_start_direct_io(stream);
+    }
+    g_mutex_init(&stream->mutex);
+    g_cond_init(&stream->cond);
+    g_queue_init(&stream->full);
+    g_queue_init(&stream->spare);
+
+    stream->thread = g_thread_try_new("cwstream", cwstream_thread, stream, NULL);
+    if (stream->thread == NULL) {
+        if (stream->direct)
+            cwstream_end_direct_io(stream);
+        cw_frame_free(stream->cur);
+        g_mutex_clear(&stream->mutex);
+        g_cond_clear(&stream->cond);
+        g_free(stream);
+        errno = EAGAIN;
+        return NULL;
+    }
+    return stream;
+}
+
+/* Hand the current frame to the thread, and get another one to fill. */
+static gboolean
+cwstream_submit(ws_cwstream *stream, int *err)
+{
+    gint64 start;
+
+    g_mutex_lock(&stream->mutex);
+    if (stream->busy >= CWSTREAM_MAX_BUSY && stream->err == 0) {
+        /* The thread can't keep up; wait for it */
+        start = g_get_monotonic_time();
+        while (stream->busy >= CWSTREAM_MAX_BUSY && stream->err == 0)
+            g_cond_wait(&stream->cond, &stream->mutex);
+        if (stream->stats != NULL) {
+            stream->stats->stalls++;
+            stream->stats->stall_usec += g_get_monotonic_time() - start;
+        }
+    }
+    if (stream->err != 0) {
+        *err = stream->err;
+        g_mutex_unlock(&stream->mutex);
+        return FALSE;
+    }
+    g_queue_push_tail(&stream->full, stream->cur);
+    stream->busy++;
+    if (stream->stats != NULL)
+        stream->stats->frames++;
+    stream->cur = (struct cw_frame *)g_queue_pop_head(&stream->spare);
+    g_cond_broadcast(&stream->cond);
+    g_mutex_unlock(&stream->mutex);
+
+    if (stream->cur == NULL)
+        stream->cur = cw_frame_new();
+    return TRUE;
+}
+
+gboolean
+ws_cwstream_write(ws_cwstream *stream, const void *buf, size_t len, int *err)
+{
+    const guint8 *p = (const guint8 *)buf;
+    size_t n;
+
+    if (stream->stats != NULL)
+        stream->stats->bytes += len;
+    while (len != 0) {
+        n = MIN(len, WS_CWSTREAM_FRAME_SIZE - stream->cur->len);
+        memcpy(stream->cur->data + stream->cur->len, p, n);
+        stream->cur->len += n;
+        p += n;
+        len -= n;
+        if (stream->cur->len == WS_CWSTREAM_FRAME_SIZE &&
+            !cwstream_submit(stream, err))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean
+ws_cwstream_flush(ws_cwstream *stream, int *err)
+{
+    int ret;
+
+    if (stream->cur->len != 0 && !cwstream_submit(stream, err))
+        return FALSE;
+
+    g_mutex_lock(&stream->mutex);
+    while (stream->busy != 0)
+        g_cond_wait(&stream->cond, &stream->mutex);
+    ret = stream->err;
+    g_mutex_unlock(&stream->mutex);
+    if (ret != 0) {
+        *err = ret;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Stop the thread, once it's done with the frames it has, and free the
+   stream, without closing its file descriptor. */
+static void
+cwstream_free(ws_cwstream *stream)
+{
+    struct cw_frame *frame;
+
+    g_mutex_lock(&stream->mutex);
+    stream->closing = TRUE;
+    g_cond_broadcast(&stream->cond);
+    g_mutex_unlock(&stream->mutex);
+    g_thread_join(stream->thread);
+
+    cw_frame_free(stream->cur);
+    while ((frame = (struct cw_frame *)g_queue_pop_head(&stream->spare)) != NULL)
+        cw_frame_free(frame);
+    g_mutex_clear(&stream->mutex);
+    g_cond_clear(&stream->cond);
+    g_free(stream);
+}
+
+gboolean
+ws_cwstream_close(ws_cwstream *stream, int *err)
+{
+    gboolean ok;
+    int fd = stream->fd;
+
+    ok = ws_cwstream_flush(stream, err);
+    cwstream_free(stream);
+    if (ws_close(fd) == -1 && ok) {
+        *err = errno;
+        ok = FALSE;
+    }
+    return ok;
+}
+
+#if defined(HAVE_FOPENCOOKIE)
+static ssize_t
+cwstream_cookie_write(void *cookie, const char *buf, size_t size)
+{
+    int err;
+
+    if (!ws_cwstream_write((ws_cwstream *)cookie, buf, size, &err)) {
+        errno = err;
+        return 0;
+    }
+    return size;
+}
+#elif defined(HAVE_FUNOPEN)
+static int
+cwstream_cookie_write(void *cookie, const char *buf, int size)
+{
+    int err;
+
+    if (!ws_cwstream_write((ws_cwstream *)cookie, buf, size, &err)) {
+        errno = err;
+        return -1;
+    }
+    return size;
+}
+#endif
+
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+static int
+cwstream_cookie_close(void *cookie)
+{
+    int err;
+
+    if (!ws_cwstream_close((ws_cwstream *)cookie, &err)) {
+        errno = err;
+        return EOF;
+    }
+    return 0;
+}
+
+FILE *
+ws_cwstream_fdopen_stdio(int fd, ws_cwstream_type type,
+                         const ws_cwstream_options *options)
+{
+    ws_cwstream *stream;
+    FILE *fp;
+    int save_errno;
+#ifdef HAVE_FOPENCOOKIE
+    cookie_io_functions_t funcs;
+
+    memset(&funcs, 0, sizeof funcs);
+    funcs.write = cwstream_cookie_write;
+    funcs.close = cwstream_cookie_close;
+#endif
+
+    stream = ws_cwstream_fdopen(fd, type, options);
+    if (stream == NULL)
+        return NULL;
+#ifdef HAVE_FOPENCOOKIE
+    fp = fopencookie(stream, "w", funcs);
+#else
+    fp = funopen(stream, NULL, cwstream_cookie_write, NULL, cwstream_cookie_close);
+#endif
+    if (fp == NULL) {
+        save_errno = errno;
+        cwstream_free(stream);
+        errno = save_errno;
+    }
+    return fp;
+}
+#else
+FILE *
+ws_cwstream_fdopen_stdio(int fd _U_, ws_cwstream_type type _U_,
+                         const ws_cwstream_options *options _U_)
+{
+    errno = ENOSYS;
+    return NULL;
+}
+#endif
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
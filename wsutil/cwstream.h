@@ -0,0 +1,138 @@
+/* cwstream.h
+ * Declarations of routines for writing compressed streams
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CWSTREAM_H__
+#define __CWSTREAM_H__
+
+#include <stdio.h>
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A stream that compresses what's written to it into a file, as a
+ * sequence of independent frames, on a thread of its own.
+ *
+ * Each frame holds WS_CWSTREAM_FRAME_SIZE bytes of the data, or less
+ * if the stream was flushed, so a reader can start decompressing at the
+ * start of any frame rather than only at the start of the file.  The
+ * writer only copies the data; it's compressed and written to the file
+ * on another thread, so a writer that has to keep up with something,
+ * such as a capture, isn't held up by the compression.
+ *
+ * A stream can also write the frames as they are, so that a writer that
+ * makes lots of small writes has them gathered into large ones, made
+ * on another thread.
+ */
+
+typedef enum {
+    WS_CWSTREAM_ZSTD,   /**< Zstandard frames */
+    WS_CWSTREAM_LZ4,    /**< LZ4 frames */
+    WS_CWSTREAM_NONE    /**< the data, uncompressed */
+} ws_cwstream_type;
+
+#define WS_CWSTREAM_FRAME_SIZE (1024 * 1024)
+
+typedef struct ws_cwstream ws_cwstream;
+
+/**
+ * How much has been written to a stream, and how often the writer had to
+ * wait for the thread writing the file to catch up with it.  The counters
+ * are only updated by the thread writing to the stream.
+ */
+typedef struct {
+    guint64 bytes;          /**< bytes written to the stream */
+    guint64 frames;         /**< frames handed to the thread */
+    guint64 stalls;         /**< times the writer had to wait for the thread */
+    guint64 stall_usec;     /**< microseconds spent waiting */
+} ws_cwstream_stats;
+
+/** How a stream is to write its file */
+typedef struct {
+    /**
+     * Write uncompressed frames with direct I/O (O_DIRECT), bypassing the
+     * page cache, where the platform and the file system allow it.  Once
+     * a frame that's less than full has been written, as on a flush, the
+     * rest of the file is written through the page cache.
+     */
+    gboolean            direct_io;
+    ws_cwstream_stats  *stats;      /**< counters to add to, or NULL */
+} ws_cwstream_options;
+
+/**
+ * Return TRUE if streams of the given type can be written, i.e. if we
+ * were built with the library for it.
+ */
+WS_DLL_PUBLIC gboolean ws_cwstream_type_supported(ws_cwstream_type type);
+
+/**
+ * Look up a stream type by the name used for it on command lines,
+ * "zstd" or "lz4".
+ *
+ * @return TRUE, with *type set, if the name is known, FALSE otherwise.
+ */
+WS_DLL_PUBLIC gboolean ws_cwstream_name_to_type(const char *name,
+    ws_cwstream_type *type);
+
+/**
+ * Start writing a compressed stream to a file descriptor, which the
+ * stream then owns.  options may be NULL.
+ *
+ * @return The stream, or NULL with errno set.
+ */
+WS_DLL_PUBLIC ws_cwstream *ws_cwstream_fdopen(int fd, ws_cwstream_type type,
+    const ws_cwstream_options *options);
+
+/**
+ * Add data to a stream.  An error compressing or writing earlier data
+ * is reported by a later call, at the latest by ws_cwstream_flush().
+ *
+ * @return TRUE on success, FALSE with *err set to an errno otherwise.
+ */
+WS_DLL_PUBLIC gboolean ws_cwstream_write(ws_cwstream *stream, const void *buf,
+    size_t len, int *err);
+
+/**
+ * End the current frame, and wait for everything written so far to be
+ * written to the file.
+ *
+ * @return TRUE on success, FALSE with *err set to an errno otherwise.
+ */
+WS_DLL_PUBLIC gboolean ws_cwstream_flush(ws_cwstream *stream, int *err);
+
+/**
+ * Flush a stream, close its file descriptor and free it.
+ *
+ * @return TRUE on success, FALSE with *err set to an errno otherwise.
+ */
+WS_DLL_PUBLIC gboolean ws_cwstream_close(ws_cwstream *stream, int *err);
+
+/**
+ * Start writing a compressed stream to a file descriptor, as with
+ * ws_cwstream_fdopen(), through a standard I/O stream, for code that
+ * writes with fwrite().  fflush() doesn't end the current frame;
+ * fclose() flushes the stream and closes the file descriptor.
+ *
+ * @return The standard I/O stream, or NULL with errno set; errno is
+ * ENOSYS if standard I/O streams can't be made on this platform.
+ */
+WS_DLL_PUBLIC FILE *ws_cwstream_fdopen_stdio(int fd, ws_cwstream_type type,
+    const ws_cwstream_options *options);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __CWSTREAM_H__ */
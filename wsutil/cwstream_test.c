@@ -0,0 +1,302 @@
+/* cwstream_test.c
+ * Standalone program to test writing compressed streams, by writing
+ * them through standard I/O and decompressing them frame by frame.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+
+#include <glib.h>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif /* HAVE_ZSTD */
+
+#ifdef HAVE_LZ4FRAME_H
+#include <lz4frame.h>
+#endif /* HAVE_LZ4FRAME_H */
+
+#include <wsutil/cwstream.h>
+#include <wsutil/file_util.h>
+
+/* Two and a half frames, and a bit, so that the last one isn't full. */
+#define TEST_DATA_LEN   (5 * WS_CWSTREAM_FRAME_SIZE / 2 + 123)
+
+typedef struct {
+    ws_cwstream_type type;
+    gboolean direct_io;
+} test_stream_params;
+
+static const test_stream_params test_zstd = { WS_CWSTREAM_ZSTD, FALSE };
+static const test_stream_params test_lz4 = { WS_CWSTREAM_LZ4, FALSE };
+static const test_stream_params test_none = { WS_CWSTREAM_NONE, FALSE };
+static const test_stream_params test_none_direct = { WS_CWSTREAM_NONE, TRUE };
+
+/* Data that compresses, but not to nothing. */
+static guint8 *
+make_test_data(void)
+{
+    guint8 *data = (guint8 *)g_malloc(TEST_DATA_LEN);
+    GRand *rand = g_rand_new_with_seed(1);
+    gsize i;
+
+    for (i = 0; i < TEST_DATA_LEN; i++)
+        data[i] = (guint8)g_rand_int_range(rand, 0, 16);
+    g_rand_free(rand);
+    return data;
+}
+
+static int
+open_tmp_file(gchar **path)
+{
+    int fd;
+
+    fd = g_file_open_tmp("cwstream_test_XXXXXX", path, NULL);
+    g_assert_cmpint(fd, !=, -1);
+    return fd;
+}
+
+/*
+ * Check that a file holds the frames of data: full frames, but for the
+ * last one, each of which can be decompressed by itself.
+ */
+static void
+check_frames(ws_cwstream_type type, const guint8 *file, gsize file_len,
+             const guint8 *data, gsize data_len, guint64 *n_frames)
+{
+    const guint8 *in = file, *end = file + file_len;
+    guint8 *out = (guint8 *)g_malloc(WS_CWSTREAM_FRAME_SIZE);
+    gsize done = 0, frame_len = 0;
+#ifdef HAVE_LZ4FRAME_H
+    LZ4F_decompressionContext_t dctx;
+    size_t ret, src_len, dst_len;
+#endif
+
+    *n_frames = 0;
+    while (in < end) {
+        switch (type) {
+
+#ifdef HAVE_ZSTD
+        case WS_CWSTREAM_ZSTD:
+        {
+            size_t comp_len = ZSTD_findFrameCompressedSize(in, end - in);
+
+            g_assert_false(ZSTD_isError(comp_len));
+            frame_len = ZSTD_decompress(out, WS_CWSTREAM_FRAME_SIZE, in, comp_len);
+            g_assert_false(ZSTD_isError(frame_len));
+            in += comp_len;
+            break;
+        }
+#endif
+
+#ifdef HAVE_LZ4FRAME_H
+        case WS_CWSTREAM_LZ4:
+            g_assert_false(LZ4F_isError(LZ4F_createDecompressionContext(&dctx, LZ4F_VERSION)));
+            frame_len = 0;
+            do {
+                src_len = end - in;
+                dst_len = WS_CWSTREAM_FRAME_SIZE - frame_len;
+                ret = LZ4F_decompress(dctx, out + frame_len, &dst_len, in, &src_len, NULL);
+                g_assert_false(LZ4F_isError(ret));
+                g_assert_true(src_len != 0 || dst_len != 0);
+                in += src_len;
+                frame_len += dst_len;
+            } while (ret != 0);
+            LZ4F_freeDecompressionContext(dctx);
+            break;
+#endif
+
+        case WS_CWSTREAM_NONE:
+            frame_len = MIN((gsize)(end - in), WS_CWSTREAM_FRAME_SIZE);
+            memcpy(out, in, frame_len);
+            in += frame_len;
+            break;
+
+        default:
+            g_assert_not_reached();
+        }
+
+        /* Only the last frame can be short. */
+        if (in < end)
+            g_assert_cmpuint(frame_len, ==, WS_CWSTREAM_FRAME_SIZE);
+        g_assert_cmpuint(done + frame_len, <=, data_len);
+        g_assert_true(memcmp(out, data + done, frame_len) == 0);
+        done += frame_len;
+        (*n_frames)++;
+    }
+    g_assert_cmpuint(done, ==, data_len);
+    g_free(out);
+}
+
+/*
+ * Write a stream with fwrite(), in pieces of all sizes, flushing it
+ * along the way, and check what ends up in the file.
+ */
+static void
+cwstream_test_stdio(gconstpointer user_data)
+{
+    const test_stream_params *params = (const test_stream_params *)user_data;
+    ws_cwstream_options options;
+    ws_cwstream_stats stats;
+    guint8 *data;
+    gchar *path, *file;
+    gsize done, len, file_len;
+    guint64 n_frames;
+    GRand *rand;
+    FILE *fp;
+    int fd;
+
+    if (!ws_cwstream_type_supported(params->type)) {
+        g_test_skip("Not built with the library for this type");
+        return;
+    }
+
+    data = make_test_data();
+    fd = open_tmp_file(&path);
+    memset(&stats, 0, sizeof stats);
+    options.direct_io = params->direct_io;
+    options.stats = &stats;
+    fp = ws_cwstream_fdopen_stdio(fd, params->type, &options);
+    if (fp == NULL && errno == ENOSYS) {
+        g_test_skip("No standard I/O streams of our own on this platform");
+        ws_close(fd);
+        ws_unlink(path);
+        g_free(path);
+        g_free(data);
+        return;
+    }
+    g_assert_nonnull(fp);
+
+    rand = g_rand_new_with_seed(2);
+    for (done = 0; done < TEST_DATA_LEN; done += len) {
+        len = MIN(TEST_DATA_LEN - done, (gsize)g_rand_int_range(rand, 1, 100000));
+        g_assert_cmpuint(fwrite(data + done, 1, len, fp), ==, len);
+        if (g_rand_int_range(rand, 0, 10) == 0)
+            g_assert_cmpint(fflush(fp), ==, 0);
+    }
+    g_rand_free(rand);
+    g_assert_cmpint(fclose(fp), ==, 0);
+
+    g_assert_true(g_file_get_contents(path, &file, &file_len, NULL));
+    check_frames(params->type, (const guint8 *)file, file_len,
+                 data, TEST_DATA_LEN, &n_frames);
+
+    /* fflush() doesn't end a frame; only fclose() does. */
+    g_assert_cmpuint(n_frames, ==,
+                     (TEST_DATA_LEN + WS_CWSTREAM_FRAME_SIZE - 1) / WS_CWSTREAM_FRAME_SIZE);
+    g_assert_cmpuint(stats.bytes, ==, TEST_DATA_LEN);
+    g_assert_cmpuint(stats.frames, ==, n_frames);
+    g_assert_cmpuint(stats.stalls, <=, stats.frames);
+    if (stats.stalls == 0)
+        g_assert_cmpuint(stats.stall_usec, ==, 0);
+
+    g_free(file);
+    ws_unlink(path);
+    g_free(path);
+    g_free(data);
+}
+
+/*
+ * A write that fails on the thread writing the file is reported by the
+ * next write that hands the thread a frame, or by the next flush, and
+ * again when the stream is closed.
+ */
+static void
+cwstream_test_write_error(void)
+{
+    guint8 *data;
+    gchar *path;
+    ws_cwstream *stream;
+    FILE *fp;
+    int fd, err, i;
+    gboolean failed = FALSE;
+
+    data = make_test_data();
+    ws_close(open_tmp_file(&path));
+
+    /* Only a flush. */
+    fd = ws_open(path, O_RDONLY | O_BINARY, 0);
+    g_assert_cmpint(fd, !=, -1);
+    stream = ws_cwstream_fdopen(fd, WS_CWSTREAM_NONE, NULL);
+    g_assert_nonnull(stream);
+    g_assert_true(ws_cwstream_write(stream, data, 100, &err));
+    err = 0;
+    g_assert_false(ws_cwstream_flush(stream, &err));
+    g_assert_cmpint(err, ==, EBADF);
+    err = 0;
+    g_assert_false(ws_cwstream_close(stream, &err));
+    g_assert_cmpint(err, ==, EBADF);
+
+    /* Writes, which find out once the thread has failed. */
+    fd = ws_open(path, O_RDONLY | O_BINARY, 0);
+    g_assert_cmpint(fd, !=, -1);
+    stream = ws_cwstream_fdopen(fd, WS_CWSTREAM_NONE, NULL);
+    g_assert_nonnull(stream);
+    for (i = 0; i < 100 && !failed; i++) {
+        err = 0;
+        failed = !ws_cwstream_write(stream, data, WS_CWSTREAM_FRAME_SIZE, &err);
+    }
+    g_assert_true(failed);
+    g_assert_cmpint(err, ==, EBADF);
+    err = 0;
+    g_assert_false(ws_cwstream_close(stream, &err));
+    g_assert_cmpint(err, ==, EBADF);
+
+    /* Through standard I/O, the error comes back from fclose(). */
+    fd = ws_open(path, O_RDONLY | O_BINARY, 0);
+    g_assert_cmpint(fd, !=, -1);
+    fp = ws_cwstream_fdopen_stdio(fd, WS_CWSTREAM_NONE, NULL);
+    if (fp == NULL && errno == ENOSYS) {
+        ws_close(fd);
+    } else {
+        g_assert_nonnull(fp);
+        g_assert_cmpuint(fwrite(data, 1, 100, fp), ==, 100);
+        errno = 0;
+        g_assert_cmpint(fclose(fp), ==, EOF);
+        g_assert_cmpint(errno, ==, EBADF);
+    }
+
+    ws_unlink(path);
+    g_free(path);
+    g_free(data);
+}
+
+int
+main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_data_func("/cwstream/stdio/zstd", &test_zstd, cwstream_test_stdio);
+    g_test_add_data_func("/cwstream/stdio/lz4", &test_lz4, cwstream_test_stdio);
+    g_test_add_data_func("/cwstream/stdio/none", &test_none, cwstream_test_stdio);
+    g_test_add_data_func("/cwstream/stdio/none_direct_io", &test_none_direct, cwstream_test_stdio);
+    g_test_add_func("/cwstream/write_error", cwstream_test_write_error);
+
+    return g_test_run();
+}
+
+/*
+ * Editor modelines  -  http://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */